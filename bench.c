@@ -0,0 +1,742 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "json.h"
+
+// throughput benchmarks: build ~8 MB of each kind of input in memory and
+// report how fast every parser configuration gets through it
+
+#define CORPUS_SIZE (8u << 20)
+
+typedef struct {
+	char * buf;
+	size_t length, capacity;
+} text;
+
+static void put(text * t, char const * s) {
+	size_t n = strlen(s);
+	if (t->length + n + 1 > t->capacity) {
+		t->capacity = (t->length + n + 1) * 2;
+		t->buf = (char*)realloc(t->buf, t->capacity);
+		if (!t->buf) {
+			fprintf(stderr, "out of memory\n");
+			exit(1);
+		}
+	}
+	memcpy(t->buf + t->length, s, n + 1);
+	t->length += n;
+}
+
+static unsigned int rnd(void) {
+	static unsigned int x = 2463534242u;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return x;
+}
+
+static double now(void) {
+#if defined CLOCK_MONOTONIC
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+#else
+	return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+//
+// corpora
+//
+static void gen_records(text * t, bool pretty) {
+	char item[512];
+	char const * nl = pretty ? "\n" : "";
+	char const * in = pretty ? "        " : "";
+	unsigned int id = 0;
+	put(t, "[");
+	put(t, nl);
+	while (t->length < CORPUS_SIZE) {
+		if (id)
+			put(t, pretty ? ",\n" : ",");
+		sprintf(item, "%s{%s%s\"id\": %u,%s%s\"name\": \"user%u\",%s%s\"score\": %u.%02u,%s"
+					  "%s\"active\": %s,%s%s\"tags\": [\"a\", \"b\\n\", \"c\"],%s%s\"parent\": null%s%s}"
+				, pretty ? "    " : "", nl
+				, in, id, nl
+				, in, rnd() % 100000, nl
+				, in, rnd() % 1000, rnd() % 100, nl
+				, in, rnd() & 1 ? "true" : "false", nl
+				, in, nl
+				, in, nl, pretty ? "    " : "");
+		put(t, item);
+		++id;
+	}
+	put(t, nl);
+	put(t, "]");
+}
+
+static void gen_ndjson(text * t) {
+	char item[512];
+	unsigned int id = 0;
+	while (t->length < CORPUS_SIZE) {
+		sprintf(item, "{\"id\": %u, \"name\": \"user%u\", \"score\": %u.%02u, \"active\": %s, \"tags\": [\"a\", \"b\\n\"]}\n"
+				, id++, rnd() % 100000, rnd() % 1000, rnd() % 100, rnd() & 1 ? "true" : "false");
+		put(t, item);
+	}
+}
+
+static void gen_strings(text * t) {
+	static char const b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	char item[1100];
+	put(t, "[");
+	while (t->length < CORPUS_SIZE) {
+		size_t i, n = 200 + rnd() % 800;
+		if (t->length > 1)
+			put(t, ",");
+		item[0] = '"';
+		for (i = 1; i <= n; ++i)
+			item[i] = b64[rnd() % 64];
+		if (rnd() % 4 == 0) // now and then a log line with escapes in it
+			memcpy(item + n / 2, "\\t\\\"x\\\"\\n", 9);
+		item[n + 1] = '"';
+		item[n + 2] = '\0';
+		put(t, item);
+	}
+	put(t, "]");
+}
+
+static void gen_numbers(text * t) {
+	char item[64];
+	put(t, "[");
+	while (t->length < CORPUS_SIZE) {
+		if (t->length > 1)
+			put(t, ",");
+		switch (rnd() % 3) {
+		case 0: sprintf(item, "%d", (int)rnd()); break;
+		case 1: sprintf(item, "%.17g", (double)rnd() / (rnd() | 1)); break;
+		case 2: sprintf(item, "%u.%ue%d", rnd() % 1000, rnd() % 1000, (int)(rnd() % 60) - 30); break;
+		}
+		put(t, item);
+	}
+	put(t, "]");
+}
+
+//
+// parser configurations
+//
+typedef struct {
+	char const * name;
+	int settings;
+	bool document, in_situ, intern, events;
+	size_t piece; // fed to a push parser this much at a time
+} parser;
+
+static parser const parsers[] = {
+	{ "two pass"   , 0               , false, false, false, false, 0 },
+	{ "single pass", json_single_pass, false, false, false, false, 0 },
+	{ "interned"   , 0               , false, false, true , false, 0 },
+	{ "document"   , 0               , true , false, false, false, 0 },
+	{ "doc interned", 0              , true , false, true , false, 0 },
+	{ "in situ"    , 0               , true , true , false, false, 0 }, // includes copying the input
+	{ "two stage"  , json_two_stage  , false, false, false, false, 0 },
+	{ "2 stage doc", json_two_stage  , true , false, false, false, 0 },
+	{ "push 16 KB" , 0               , false, false, false, false, 16384 },
+	{ "events"     , 0               , false, false, false, true , 0 }, // callbacks counting values
+};
+static int const parser_size = sizeof(parsers)/sizeof(parsers[0]);
+
+static int count_value(void * values) { ++*(long*)values; return 1; }
+static int count_key(json_char const * name, unsigned int length, void * values) { return 1; }
+static int count_string(json_char const * string, unsigned int length, void * values) { return count_value(values); }
+static int count_integer(json_int_t value, void * values) { return count_value(values); }
+static int count_double(double value, void * values) { return count_value(values); }
+static int count_boolean(int value, void * values) { return count_value(values); }
+
+static json_handler const counting = {
+	count_value, count_key, NULL, count_value, NULL,
+	count_string, count_integer, count_double, count_boolean, count_value
+};
+
+static void bench(char const * corpus, text const * t) {
+	char * copy = (char*)malloc(t->length);
+	int p;
+	for (p = 0; p < parser_size; ++p) {
+		json_settings settings;
+		double begin, elapsed;
+		int runs = 0;
+		memset(&settings, 0, sizeof(json_settings));
+		settings.settings = parsers[p].settings;
+		settings.intern = parsers[p].intern ? json_intern_new(NULL) : NULL;
+		begin = now();
+		do {
+			json_document * doc = parsers[p].document ? json_document_new(&settings) : NULL;
+			json_value * v;
+			if (parsers[p].events) {
+				long values = 0;
+				if (!json_parse_events(&settings, &counting, &values, t->buf, t->length, NULL)) {
+					fprintf(stderr, "%s: %s failed\n", corpus, parsers[p].name);
+					break;
+				}
+				++runs;
+				continue;
+			}
+			if (parsers[p].piece) {
+				json_parser * push = json_parser_new(&settings);
+				size_t at, k;
+				for (at = 0; at < t->length; at += k) {
+					k = t->length - at < parsers[p].piece ? t->length - at : parsers[p].piece;
+					if (!json_parser_feed(push, t->buf + at, k, NULL))
+						break;
+				}
+				v = json_parser_finish(push, NULL);
+				json_parser_free(push);
+			} else if (parsers[p].in_situ) {
+				memcpy(copy, t->buf, t->length);
+				v = json_document_parse_insitu(doc, copy, t->length, NULL);
+			} else
+				v = doc ? json_document_parse(doc, t->buf, NULL)
+						: json_parse_ex(&settings, t->buf, NULL);
+			if (!v) {
+				fprintf(stderr, "%s: %s failed\n", corpus, parsers[p].name);
+				break;
+			}
+			if (doc)
+				json_document_free(doc);
+			else
+				json_value_free(v);
+			++runs;
+		} while ((elapsed = now() - begin) < 1.0);
+		printf("%-10s %-14s %8.1f MB/s\n", corpus, parsers[p].name
+					, runs * (t->length / 1e6) / elapsed);
+		json_intern_free(settings.intern);
+	}
+	free(copy);
+}
+
+// reference: the C library converting the same numbers, with nothing else to do
+static void bench_strtod(char const * corpus, text const * t) {
+	volatile double sink = 0;
+	double begin, elapsed;
+	int runs = 0;
+	begin = now();
+	do {
+		char const * p = t->buf + 1;
+		while (*p != ']') {
+			char * end;
+			sink += strtod(p, &end);
+			p = end + (*end == ',');
+		}
+		++runs;
+	} while ((elapsed = now() - begin) < 1.0);
+	printf("%-10s %-14s %8.1f MB/s\n", corpus, "strtod", runs * (t->length / 1e6) / elapsed);
+	(void)sink;
+}
+
+// newline delimited records: a parse per line against a reader
+static void bench_ndjson(char const * corpus, text const * t) {
+	double begin, elapsed;
+	int runs = 0, mode;
+	for (mode=0; mode<2; ++mode) {
+		begin = now();
+		do {
+			if (mode == 0) {
+				json_settings settings;
+				char const * line = t->buf, * end;
+				memset(&settings, 0, sizeof(json_settings));
+				settings.settings = json_single_pass;
+				for (; (end = strchr(line, '\n')); line = end + 1)
+					json_value_free(json_parse_n(&settings, line, end - line, NULL));
+			} else {
+				json_reader * reader = json_reader_new(NULL, t->buf, t->length);
+				while (json_reader_next(reader, NULL))
+					;
+				json_reader_free(reader);
+			}
+			++runs;
+		} while ((elapsed = now() - begin) < 1.0);
+		printf("%-10s %-14s %8.1f MB/s\n", corpus, mode ? "reader" : "parse per line"
+					, runs * (t->length / 1e6) / elapsed);
+		runs = 0;
+	}
+}
+
+// the ndjson corpus through the pipeline on 1, 2, 4, ... threads, records
+// handed on in order, and then out of order on the most
+static int count_record(json_value * value, size_t offset, json_char const * error, void * records) {
+	++*(long*)records;
+	return 1;
+}
+
+static void pipeline_row(char const * corpus, text const * t, int threads, int unordered) {
+	json_ndjson_opts opts = { threads, unordered, 0, 0 };
+	char name[32];
+	double begin, elapsed;
+	long records;
+	int runs = 0;
+	begin = now();
+	do {
+		records = 0;
+		json_parse_ndjson(NULL, t->buf, t->length, &opts, count_record, &records, NULL);
+		++runs;
+	} while ((elapsed = now() - begin) < 1.0);
+	sprintf(name, "%s %d", unordered ? "unordered" : "pipeline", threads);
+	printf("%-10s %-14s %8.1f MB/s\n", corpus, name, runs * (t->length / 1e6) / elapsed);
+}
+
+static void bench_pipeline(char const * corpus, text const * t, int max) {
+	int threads;
+	for (threads = 1; threads <= max; threads *= 2)
+		pipeline_row(corpus, t, threads, 0);
+	pipeline_row(corpus, t, max, 1);
+}
+
+// the corpus from a file: read into a buffer and parsed, against parsed
+// from a mapping of it (into a tree, and in situ into a document)
+static void bench_file(char const * corpus, text const * t) {
+	char path[] = "/tmp/json-bench-XXXXXX";
+	double begin, elapsed;
+	int fd = mkstemp(path), runs, mode;
+	if (fd == -1 || write(fd, t->buf, t->length) != (long)t->length) {
+		fprintf(stderr, "can't write %s\n", path);
+		return;
+	}
+	close(fd);
+	for (mode=0; mode<3; ++mode) {
+		runs = 0;
+		begin = now();
+		do {
+			if (mode == 0) {
+				FILE * fp = fopen(path, "rb");
+				char * buf = (char*)malloc(t->length);
+				size_t length = fread(buf, 1, t->length, fp);
+				json_value_free(json_parse_n(NULL, buf, length, NULL));
+				free(buf);
+				fclose(fp);
+			} else if (mode == 1)
+				json_value_free(json_parse_file(NULL, path, NULL));
+			else {
+				json_document * doc = json_document_new(NULL);
+				json_document_parse_file(doc, path, NULL);
+				json_document_free(doc);
+			}
+			++runs;
+		} while ((elapsed = now() - begin) < 1.0);
+		printf("%-10s %-14s %8.1f MB/s\n", corpus, mode == 0 ? "fread, parse" : mode == 1 ? "parse file" : "doc file"
+					, runs * (t->length / 1e6) / elapsed);
+	}
+	unlink(path);
+}
+
+// the tree against the tape: memory per node (what the result holds, through
+// an allocator that keeps count), building, walking every node, and finding
+// two fields in each record
+static size_t live;
+static volatile double sink;  // where walks and finds put what they read
+
+static void * counted_alloc(size_t size, int zero, void * user_data) {
+	size_t * mem = (size_t*)(zero ? calloc(1, size + 16) : malloc(size + 16));
+	if (!mem)
+		return NULL;
+	*mem = size;
+	live += size;
+	return (char*)mem + 16;
+}
+
+static void counted_free(void * ptr, void * user_data) {
+	if (ptr) {
+		live -= *(size_t*)((char*)ptr - 16);
+		free((char*)ptr - 16);
+	}
+}
+
+static long tree_walk(json_value const * v, double * sum) {
+	long nodes = 1;
+	unsigned int i;
+	switch (v->type) {
+	case json_object:
+		for (i = 0; i < v->u.object.length; ++i)
+			nodes += 1 + tree_walk(v->u.object.values[i].value, sum);
+		break;
+	case json_array:
+		for (i = 0; i < v->u.array.length; ++i)
+			nodes += tree_walk(v->u.array.values[i], sum);
+		break;
+	case json_string: *sum += v->u.string.length; break;
+	case json_integer: *sum += v->u.integer; break;
+	case json_double: *sum += v->u.dbl; break;
+	default: break;
+	}
+	return nodes;
+}
+
+static long tape_walk(json_node const * n, size_t count, double * sum) {
+	json_node const * end = n + count;
+	for (; n < end; ++n)
+		switch (n->type) {
+		case json_string: *sum += n->length; break;
+		case json_integer: *sum += n->u.integer; break;
+		case json_double: *sum += n->u.dbl; break;
+		default: break;
+		}
+	return (long)count;
+}
+
+static void bench_tape(char const * corpus, text const * t) {
+	json_settings settings;
+	json_value * v;
+	json_tape * tape;
+	json_node const * n;
+	double begin, elapsed, sum = 0;
+	long nodes = 0, runs;
+	unsigned int i;
+	int mode;
+	memset(&settings, 0, sizeof(settings));
+	settings.mem_alloc = counted_alloc;
+	settings.mem_free = counted_free;
+	v = json_parse_n(&settings, t->buf, t->length, NULL);
+	printf("%-10s %-14s %8.1f B/node\n", corpus, "tree memory", (double)live / tree_walk(v, &sum));
+	live = 0;
+	tape = json_tape_parse(&settings, t->buf, t->length, NULL);
+	printf("%-10s %-14s %8.1f B/node\n", corpus, "tape memory", (double)live / json_tape_size(tape));
+	runs = 0;
+	begin = now();
+	do {
+		json_tape_free(json_tape_parse(NULL, t->buf, t->length, NULL));
+		++runs;
+	} while ((elapsed = now() - begin) < 1.0);
+	printf("%-10s %-14s %8.1f MB/s\n", corpus, "tape build", runs * (t->length / 1e6) / elapsed);
+	for (mode=0; mode<4; ++mode) {
+		runs = nodes = 0;
+		begin = now();
+		do {
+			if (mode == 0)
+				nodes += tree_walk(v, &sum);
+			else if (mode == 1)
+				nodes += tape_walk(json_tape_root(tape), json_tape_size(tape), &sum);
+			else if (mode == 2)
+				for (i = 0; i < v->u.array.length; ++i, nodes += 2)
+					sum += find_json_object(v->u.array.values[i], "id")->u.integer
+						+ find_json_object(v->u.array.values[i], "score")->u.dbl;
+			else
+				for (n = json_tape_root(tape) + 1, i = 0; i < json_tape_root(tape)->length; ++i, n = json_node_next(n), nodes += 2)
+					sum += json_node_find(n, "id")->u.integer + json_node_find(n, "score")->u.dbl;
+			++runs;
+		} while ((elapsed = now() - begin) < 1.0);
+		printf("%-10s %-14s %8.1f M/s\n", corpus
+					, mode == 0 ? "tree walk" : mode == 1 ? "tape walk" : mode == 2 ? "tree find" : "tape find"
+					, nodes / 1e6 / elapsed);
+	}
+	sink = sum;
+	json_value_free_ex(&settings, v);
+	json_tape_free(tape);
+}
+
+// copying a parsed tree: node by node, into one block, and into a document
+static void bench_dup(char const * corpus, text const * t) {
+	json_value * v = json_parse_n(NULL, t->buf, t->length, NULL);
+	json_document * doc = json_document_new(NULL);
+	double begin, elapsed;
+	long runs;
+	int mode;
+	for (mode=0; mode<3; ++mode) {
+		runs = 0;
+		begin = now();
+		do {
+			if (mode == 0)
+				json_value_free(json_value_dup(v));
+			else if (mode == 1)
+				free(json_value_dup_block(NULL, v));
+			else {
+				json_document_dup(doc, v);
+				json_document_reset(doc);
+			}
+			++runs;
+		} while ((elapsed = now() - begin) < 1.0);
+		printf("%-10s %-14s %8.1f MB/s\n", corpus
+					, mode == 0 ? "dup" : mode == 1 ? "dup block" : "doc dup"
+					, runs * (t->length / 1e6) / elapsed);
+	}
+	json_document_free(doc);
+	json_value_free(v);
+}
+
+// hashing a parsed tree, all of it or only its types
+static void bench_hash(char const * corpus, text const * t) {
+	json_value * v = json_parse_n(NULL, t->buf, t->length, NULL);
+	uint64_t hash[2];
+	double begin, elapsed;
+	long runs;
+	int mode;
+	for (mode=0; mode<2; ++mode) {
+		runs = 0;
+		begin = now();
+		do {
+			if (!(mode ? json_type_hash(NULL, v, hash) : json_value_hash(NULL, v, hash)))
+				fprintf(stderr, "hash: out of memory\n");
+			++runs;
+		} while ((elapsed = now() - begin) < 1.0);
+		printf("%-10s %-14s %8.1f MB/s\n", corpus, mode ? "type hash" : "hash", runs * (t->length / 1e6) / elapsed);
+	}
+	json_value_free(v);
+}
+
+// checking records against a schema of one, as a tree and as text, against
+// json_type_equal with a tree of the same shape and the events alone
+static void bench_schema(char const * corpus, text const * t) {
+	static char const * record = "[{\"id\": 1, \"name\": \"\", \"score\": 0.5, \"active\": true,"
+		" \"tags\": [\"\"], \"parent\": null}]";
+	json_value * v = json_parse_n(NULL, t->buf, t->length, NULL);
+	json_value * example = json_parse(record), * same = json_value_dup(v);
+	json_schema * schema = json_schema_compile(NULL, example, json_schema_uniform_arrays, NULL);
+	double begin, elapsed;
+	long runs, values;
+	int mode;
+	for (mode=0; mode<4; ++mode) {
+		runs = 0;
+		begin = now();
+		do {
+			bool ok = mode == 0 ? json_type_equal(same, v)
+				: mode == 1 ? json_schema_check(schema, v, NULL)
+				: mode == 2 ? json_parse_events(NULL, &counting, &values, t->buf, t->length, NULL)
+				: json_schema_check_events(schema, NULL, &counting, &values, t->buf, t->length, NULL);
+			if (!ok)
+				fprintf(stderr, "schema: check failed\n");
+			++runs;
+		} while ((elapsed = now() - begin) < 1.0);
+		printf("%-10s %-14s %8.1f MB/s\n", corpus
+					, mode == 0 ? "type equal" : mode == 1 ? "schema check" : mode == 2 ? "events" : "schema events"
+					, runs * (t->length / 1e6) / elapsed);
+	}
+	json_schema_free(schema);
+	json_value_free(example);
+	json_value_free(same);
+	json_value_free(v);
+}
+
+// a few fields out of the last record: the whole tree built into a document,
+// against a lazy document stepping over everything before it
+static void bench_fields(char const * corpus, text const * t) {
+	static char const * fields[] = { "id", "name", "score" };
+	double begin, elapsed;
+	int runs = 0, mode, f;
+	for (mode=0; mode<2; ++mode) {
+		begin = now();
+		do {
+			if (mode == 0) {
+				json_document * doc = json_document_new(NULL);
+				json_value * v = json_document_parse_n(doc, t->buf, t->length, NULL);
+				json_value const * last = v->u.array.values[v->u.array.length - 1];
+				for (f = 0; f < 3; ++f)
+					if (!find_json_object(last, fields[f]))
+						fprintf(stderr, "%s: %s missing\n", corpus, fields[f]);
+				json_document_free(doc);
+			} else {
+				json_lazy * lazy = json_lazy_new(NULL, t->buf, t->length, NULL);
+				json_cursor row = json_lazy_root(lazy), field;
+				json_cursor_enter(&row);
+				while (json_cursor_next(&row))
+					;
+				for (f = 0; f < 3; ++f) {
+					field = row;
+					if (!json_cursor_find(&field, fields[f]))
+						fprintf(stderr, "%s: %s missing\n", corpus, fields[f]);
+				}
+				json_lazy_free(lazy);
+			}
+			++runs;
+		} while ((elapsed = now() - begin) < 1.0);
+		printf("%-10s %-14s %8.1f MB/s\n", corpus, mode ? "lazy fields" : "doc fields"
+					, runs * (t->length / 1e6) / elapsed);
+		runs = 0;
+	}
+}
+
+// serializing a parsed corpus, compact and pretty into a reused buffer, and
+// compact through a sink; MB/s of output
+static int discard(json_char const * text, size_t length, void * user_data) {
+	*(size_t*)user_data += length;
+	return 1;
+}
+
+static void bench_serialize(char const * corpus, text const * t) {
+	static json_serialize_opts const pretty = { json_serialize_pretty, 4 };
+	json_value * v = json_parse_n(NULL, t->buf, t->length, NULL);
+	json_buffer out;
+	double begin, elapsed, bytes;
+	int mode;
+	json_buffer_init(&out, NULL);
+	for (mode=0; mode<3; ++mode) {
+		bytes = 0;
+		begin = now();
+		do {
+			size_t length = 0;
+			out.length = 0;
+			if (mode == 2)
+				json_serialize_sink(NULL, v, NULL, discard, &length);
+			else if (json_serialize(&out, v, mode ? &pretty : NULL))
+				length = out.length;
+			bytes += length;
+		} while ((elapsed = now() - begin) < 1.0);
+		printf("%-10s %-14s %8.1f MB/s\n", corpus
+					, mode == 0 ? "write compact" : mode == 1 ? "write pretty" : "write sink"
+					, bytes / 1e6 / elapsed);
+	}
+	json_buffer_free(&out);
+	json_value_free(v);
+}
+
+// the same corpus parsed by 1, 2, 4, ... threads; 1 is the serial parser
+static void bench_parallel(char const * corpus, text const * t, int max) {
+	char name[32];
+	double begin, elapsed;
+	int runs, threads;
+	for (threads = 1; threads <= max; threads *= 2) {
+		runs = 0;
+		begin = now();
+		do {
+			json_value_free(json_parse_parallel(NULL, t->buf, t->length, threads, NULL));
+			++runs;
+		} while ((elapsed = now() - begin) < 1.0);
+		sprintf(name, "parallel %d", threads);
+		printf("%-10s %-14s %8.1f MB/s\n", corpus, name, runs * (t->length / 1e6) / elapsed);
+	}
+}
+
+// rows like the records corpus, written straight into a reused buffer
+static void bench_writer(void) {
+	static char const * tags[] = { "a", "b\n", "c" };
+	char name[32];
+	json_buffer out;
+	json_writer * w;
+	double begin, elapsed, bytes = 0;
+	int i, t;
+	json_buffer_init(&out, NULL);
+	w = json_writer_new(&out, NULL);
+	begin = now();
+	do {
+		out.length = 0;
+		json_writer_begin_array(w);
+		for (i = 0; i < 10000; ++i) {
+			json_writer_begin_object(w);
+			json_writer_key(w, "id", 2);
+			json_writer_integer(w, i);
+			json_writer_key(w, "name", 4);
+			json_writer_string(w, name, sprintf(name, "user%u", rnd() % 100000));
+			json_writer_key(w, "score", 5);
+			json_writer_double(w, (rnd() % 100000) / 100.0);
+			json_writer_key(w, "active", 6);
+			json_writer_bool(w, rnd() & 1);
+			json_writer_key(w, "tags", 4);
+			json_writer_begin_array(w);
+			for (t = 0; t < 3; ++t)
+				json_writer_string(w, tags[t], strlen(tags[t]));
+			json_writer_end_array(w);
+			json_writer_key(w, "parent", 6);
+			json_writer_null(w);
+			json_writer_end_object(w);
+		}
+		json_writer_end_array(w);
+		json_writer_finish(w);
+		bytes += out.length;
+	} while ((elapsed = now() - begin) < 1.0);
+	printf("%-10s %-14s %8.1f MB/s\n", "records", "writer", bytes / 1e6 / elapsed);
+	json_writer_free(w);
+	json_buffer_free(&out);
+}
+
+// key lookups in one wide indexed object, and comparing it with a copy of
+// itself and with the same keys in reverse
+static void bench_lookup(int keys) {
+	text t = {0}, reversed = {0};
+	json_settings settings;
+	char key[32];
+	json_value * v, * copy, * other;
+	double begin, elapsed;
+	long lookups = 0;
+	int i, runs = 0, mode;
+	put(&t, "{");
+	put(&reversed, "{");
+	for (i=0; i<keys; ++i) {
+		sprintf(key, "%s\"field_%d\": %d", i ? "," : "", i, i);
+		put(&t, key);
+		sprintf(key, "%s\"field_%d\": %d", i ? "," : "", keys - 1 - i, keys - 1 - i);
+		put(&reversed, key);
+	}
+	put(&t, "}");
+	put(&reversed, "}");
+	memset(&settings, 0, sizeof(json_settings));
+	settings.settings = json_index_objects;
+	v = json_parse_ex(&settings, t.buf, NULL);
+	copy = json_value_dup(v);
+	other = json_parse_ex(&settings, reversed.buf, NULL);
+	begin = now();
+	do {
+		for (i=0; i<keys; ++i, ++lookups) {
+			sprintf(key, "field_%d", (int)(rnd() % keys));
+			if (!find_json_object(v, key))
+				fprintf(stderr, "lookup: %s missing\n", key);
+		}
+	} while ((elapsed = now() - begin) < 1.0);
+	printf("%-10s %-14s %8.1f M/s\n", "lookup", "find", lookups / elapsed / 1e6);
+	begin = now();
+	do {
+		if (!json_value_equal(v, copy))
+			fprintf(stderr, "lookup: copy differs\n");
+		++runs;
+	} while ((elapsed = now() - begin) < 1.0);
+	printf("%-10s %-14s %8.1f /s (%d keys)\n", "lookup", "equal", runs / elapsed, keys);
+	for (mode=0; mode<2; ++mode) {
+		runs = 0;
+		begin = now();
+		do {
+			if (json_value_compare(NULL, v, mode ? other : copy, NULL, NULL, 0) != 1)
+				fprintf(stderr, "lookup: copy differs\n");
+			++runs;
+		} while ((elapsed = now() - begin) < 1.0);
+		printf("%-10s %-14s %8.1f /s (%d keys)\n", "lookup", mode ? "compare rev" : "compare", runs / elapsed, keys);
+	}
+	json_value_free(v);
+	json_value_free(copy);
+	json_value_free(other);
+	free(t.buf);
+	free(reversed.buf);
+}
+
+int main (void) {
+	text records = {0}, pretty = {0}, strings = {0}, numbers = {0}, ndjson = {0};
+	gen_records(&records, false);
+	gen_records(&pretty, true);
+	gen_strings(&strings);
+	gen_numbers(&numbers);
+	gen_ndjson(&ndjson);
+	bench("records", &records);
+	bench("pretty" , &pretty);
+	bench("strings", &strings);
+	bench("numbers", &numbers);
+	bench_strtod("numbers", &numbers);
+	bench_ndjson("ndjson", &ndjson);
+	bench_pipeline("ndjson", &ndjson, 8);
+	bench_fields("records", &records);
+	bench_file("records", &records);
+	bench_tape("records", &records);
+	bench_dup("records", &records);
+	bench_hash("records", &records);
+	bench_hash("strings", &strings);
+	bench_schema("records", &records);
+	bench_serialize("records", &records);
+	bench_serialize("strings", &strings);
+	bench_serialize("numbers", &numbers);
+	bench_writer();
+	bench_parallel("records", &records, 8);
+	bench_parallel("strings", &strings, 8);
+	bench_lookup(2000);
+	free(records.buf);
+	free(pretty.buf);
+	free(strings.buf);
+	free(numbers.buf);
+	free(ndjson.buf);
+	return 0;
+}
@@ -55,6 +55,31 @@
 #include <float.h>
 #include <errno.h>
 
+#include <fcntl.h>
+
+#ifdef _WIN32
+#  include <io.h>
+#else
+#  include <unistd.h>
+#  include <sys/stat.h>
+#  include <sys/mman.h>
+#endif
+
+#ifndef O_BINARY
+#  define O_BINARY 0
+#endif
+
+#if !defined JSON_NO_THREADS && defined __GNUC__ && !defined _WIN32
+#  define JSON_THREADS
+#  include <pthread.h>
+#endif
+
+#if !defined JSON_NO_SIMD && defined __GNUC__ \
+      && (defined __x86_64__ || defined __i386__) && defined __SSE2__
+#  define JSON_SSE2
+#  include <immintrin.h>
+#endif
+
 typedef unsigned short json_uchar;
 
 static unsigned char hex_value (json_char c)
@@ -71,746 +96,8447 @@ static unsigned char hex_value (json_char c)
    return 0xFF;
 }
 
-typedef struct
-{
-   json_settings settings;
-   int first_pass;
-
-   unsigned long used_memory;
-
-   unsigned int uint_max;
-   unsigned long ulong_max;
+/* Scanning string bodies: the number of characters from `json` up to the
+ * first quote, backslash or control character (or `length`).  The SSE2 and
+ * AVX2 versions test 16 and 32 characters at a time; which one is used is
+ * decided on the first call, from what the CPU supports.
+ */
+static const uint64_t ones = 0x0101010101010101ULL, highs = 0x8080808080808080ULL;
 
-} json_state;
+#define has_zero(v)     (((v) - ones) & ~(v) & highs)
+#define has_less(v, n)  (((v) - ones * (n)) & ~(v) & highs)
 
-static void * json_alloc (json_state * state, unsigned long size, int zero)
+static size_t scan_string_scalar (const json_char * json, size_t length)
 {
-   void * mem;
+   const json_char * i = json, * end = json + length;
 
-   if ((state->ulong_max - state->used_memory) < size)
-      return 0;
+   /* eight at a time, as far as that goes */
 
-   if (state->settings.max_memory
-         && (state->used_memory += size) > state->settings.max_memory)
+   for (; end - i >= 8; i += 8)
    {
-      return 0;
+      uint64_t v;
+      memcpy (&v, i, 8);
+
+      if (has_zero (v ^ (ones * '"')) | has_zero (v ^ (ones * '\\')) | has_less (v, 0x20))
+         break;
    }
 
-   if (! (mem = zero ? calloc (1, size) : malloc (size)))
-      return 0;
+   for (; i < end; ++ i)
+      if (*i == '"' || *i == '\\' || (unsigned char) *i < 0x20)
+         break;
 
-   return mem;
+   return i - json;
 }
 
-static int new_value
-   (json_state * state, json_value ** top, json_value ** root, json_value ** alloc, json_type type)
+#ifdef JSON_SSE2
+
+static size_t scan_string_sse2 (const json_char * json, size_t length)
 {
-   json_value * value;
-   int values_size;
+   const __m128i quote = _mm_set1_epi8 ('"'), backslash = _mm_set1_epi8 ('\\'),
+                 control = _mm_set1_epi8 (0x1F);
+   size_t i = 0;
 
-   if (!state->first_pass)
+   for (; length - i >= 16; i += 16)
    {
-      value = *top = *alloc;
-      *alloc = (*alloc)->_reserved.next_alloc;
-
-      if (!*root)
-         *root = value;
-
-      switch (value->type)
-      {
-         case json_array:
+      __m128i v = _mm_loadu_si128 ((const __m128i *) (json + i));
 
-            if (! (value->u.array.values = (json_value **) json_alloc
-               (state, value->u.array.length * sizeof (json_value *), 0)) )
-            {
-               return 0;
-            }
+      unsigned int mask = _mm_movemask_epi8 (_mm_or_si128 (_mm_or_si128
+         (_mm_cmpeq_epi8 (v, quote), _mm_cmpeq_epi8 (v, backslash)),
+          _mm_cmpeq_epi8 (_mm_max_epu8 (v, control), control)));
 
-            break;
+      if (mask)
+         return i + __builtin_ctz (mask);
+   }
 
-         case json_object:
+   return i + scan_string_scalar (json + i, length - i);
+}
 
-            values_size = sizeof (*value->u.object.values) * value->u.object.length;
+__attribute__ ((target ("avx2")))
+static size_t scan_string_avx2 (const json_char * json, size_t length)
+{
+   const __m256i quote = _mm256_set1_epi8 ('"'), backslash = _mm256_set1_epi8 ('\\'),
+                 control = _mm256_set1_epi8 (0x1F);
+   size_t i = 0;
 
-            if (! ((*(void **) &value->u.object.values) = json_alloc
-                  (state, values_size + ((unsigned long) value->u.object.values), 0)) )
-            {
-               return 0;
-            }
+   for (; length - i >= 32; i += 32)
+   {
+      __m256i v = _mm256_loadu_si256 ((const __m256i *) (json + i));
 
-            value->_reserved.object_mem = (*(char **) &value->u.object.values) + values_size;
+      unsigned int mask = _mm256_movemask_epi8 (_mm256_or_si256 (_mm256_or_si256
+         (_mm256_cmpeq_epi8 (v, quote), _mm256_cmpeq_epi8 (v, backslash)),
+          _mm256_cmpeq_epi8 (_mm256_max_epu8 (v, control), control)));
 
-            break;
+      if (mask)
+         return i + __builtin_ctz (mask);
+   }
 
-         case json_string:
+   return i + scan_string_sse2 (json + i, length - i);
+}
 
-            if (! (value->u.string.ptr = (json_char *) json_alloc
-               (state, (value->u.string.length + 1) * sizeof (json_char), 0)) )
-            {
-               return 0;
-            }
+#endif
 
-            break;
+/* Skipping whitespace: returns the first non-whitespace character at or
+ * after `i`, counting the newlines passed into `line` and leaving
+ * `line_begin` on the last of them, as the parser's error messages expect.
+ */
+static const json_char * skip_whitespace_scalar
+   (const json_char * i, const json_char * end, unsigned int * line, const json_char ** line_begin)
+{
+   for (; i < end; ++ i)
+   {
+      switch (*i)
+      {
+         case '\n': ++ *line;  *line_begin = i;
+         case ' ': case '\t': case '\r':
+            continue;
 
          default:
-            break;
+            return i;
       };
-
-      value->u.array.length = 0;
-
-      return 1;
    }
 
-   value = (json_value *) json_alloc (state, sizeof (json_value), 1);
+   return i;
+}
 
-   if (!value)
-      return 0;
+#ifdef JSON_SSE2
 
-   if (!*root)
-      *root = value;
+/* `ws` has a bit set for each of the `n` characters that are whitespace and
+ * `nl` for each that is a newline.
+ */
+#define ws_advance(n, all)                                              \
+   do {                                                                 \
+      unsigned int run = ws == all ? n : __builtin_ctz (~ws);           \
+      if (run < n)                                                      \
+         nl &= (1u << run) - 1;                                         \
+      if (nl)                                                           \
+      {  *line += __builtin_popcount (nl);                              \
+         *line_begin = i + 31 - __builtin_clz (nl);                     \
+      }                                                                 \
+      if (run < n)                                                      \
+         return i + run;                                                \
+   } while (0)
+
+static const json_char * skip_whitespace_sse2
+   (const json_char * i, const json_char * end, unsigned int * line, const json_char ** line_begin)
+{
+   const __m128i space = _mm_set1_epi8 (' '), tab = _mm_set1_epi8 ('\t'),
+                 cr = _mm_set1_epi8 ('\r'), lf = _mm_set1_epi8 ('\n');
 
-   value->type = type;
-   value->parent = *top;
+   for (; end - i >= 16; i += 16)
+   {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) i), newline = _mm_cmpeq_epi8 (v, lf);
 
-   if (*alloc)
-      (*alloc)->_reserved.next_alloc = value;
+      unsigned int nl = _mm_movemask_epi8 (newline),
+                   ws = _mm_movemask_epi8 (_mm_or_si128 (_mm_or_si128
+                           (_mm_cmpeq_epi8 (v, space), _mm_cmpeq_epi8 (v, tab)),
+                            _mm_or_si128 (_mm_cmpeq_epi8 (v, cr), newline)));
 
-   *alloc = *top = value;
+      ws_advance (16, 0xFFFFu);
+   }
 
-   return 1;
+   return skip_whitespace_scalar (i, end, line, line_begin);
 }
 
-#define e_off \
-   ((int) (i - cur_line_begin))
+__attribute__ ((target ("avx2,popcnt")))
+static const json_char * skip_whitespace_avx2
+   (const json_char * i, const json_char * end, unsigned int * line, const json_char ** line_begin)
+{
+   const __m256i space = _mm256_set1_epi8 (' '), tab = _mm256_set1_epi8 ('\t'),
+                 cr = _mm256_set1_epi8 ('\r'), lf = _mm256_set1_epi8 ('\n');
 
-#define whitespace \
-   case '\n': ++ cur_line;  cur_line_begin = i; \
-   case ' ': case '\t': case '\r'
+   for (; end - i >= 32; i += 32)
+   {
+      __m256i v = _mm256_loadu_si256 ((const __m256i *) i), newline = _mm256_cmpeq_epi8 (v, lf);
 
-#define string_add(b)  \
-   do { if (!state.first_pass) string [string_length] = b;  ++ string_length; } while (0);
+      unsigned int nl = _mm256_movemask_epi8 (newline),
+                   ws = _mm256_movemask_epi8 (_mm256_or_si256 (_mm256_or_si256
+                           (_mm256_cmpeq_epi8 (v, space), _mm256_cmpeq_epi8 (v, tab)),
+                            _mm256_or_si256 (_mm256_cmpeq_epi8 (v, cr), newline)));
 
-static const int
-   flag_next = 1, flag_reproc = 2, flag_need_comma = 4, flag_seek_value = 8, flag_exponent = 16,
-   flag_got_exponent_sign = 32, flag_escaped = 64, flag_string = 128, flag_need_colon = 256,
-   flag_done = 512;
+      ws_advance (32, 0xFFFFFFFFu);
+   }
 
-json_value * json_parse_ex (json_settings * settings, const json_char * json, char * error_buf)
+   return skip_whitespace_sse2 (i, end, line, line_begin);
+}
+
+static int have_avx2 (void)
 {
-   json_char error [128];
-   unsigned int cur_line;
-   const json_char * cur_line_begin, * i;
-   json_value * top, * root, * alloc = 0;
-   json_state state;
-   int flags;
+   __builtin_cpu_init ();
+   return __builtin_cpu_supports ("avx2") && __builtin_cpu_supports ("popcnt");
+}
+
+#endif
 
-   error[0] = '\0';
+/* Classifying 64 characters at a time, for the first stage of the two stage
+ * parse: bit n of each mask is for json [n].
+ */
+typedef struct
+{
+   uint64_t quote, backslash, op, space;  /* op: { } [ ] : , */
 
-   memset (&state, 0, sizeof (json_state));
-   memcpy (&state.settings, settings, sizeof (json_settings));
+} json_classes;
 
-   memset (&state.uint_max, 0xFF, sizeof (state.uint_max));
-   memset (&state.ulong_max, 0xFF, sizeof (state.ulong_max));
+static void classify_scalar (const json_char * json, json_classes * classes)
+{
+   uint64_t bit = 1;
+   int n;
 
-   state.uint_max -= 8; /* limit of how much can be added before next check */
-   state.ulong_max -= 8;
+   memset (classes, 0, sizeof (json_classes));
 
-   for (state.first_pass = 1; state.first_pass >= 0; -- state.first_pass)
+   for (n = 0; n < 64; ++ n, bit <<= 1)
    {
-      json_uchar uchar;
-      unsigned char uc_b1, uc_b2, uc_b3, uc_b4;
-      json_char * string;
-      unsigned int string_length;
+      switch (json [n])
+      {
+         case '"':
+            classes->quote |= bit;
+            break;
 
-      top = root = 0;
-      flags = flag_seek_value;
+         case '\\':
+            classes->backslash |= bit;
+            break;
 
-      cur_line = 1;
-      cur_line_begin = json;
+         case '{': case '}': case '[': case ']': case ':': case ',':
+            classes->op |= bit;
+            break;
 
-      for (i = json ;; ++ i)
-      {
-         json_char b = *i;
+         case ' ': case '\t': case '\r': case '\n':
+            classes->space |= bit;
+            break;
 
-         if (flags & flag_done)
-         {
-            if (!b)
-               break;
+         default:
+            break;
+      };
+   }
+}
 
-            switch (b)
-            {
-               whitespace:
-                  continue;
+#ifdef JSON_SSE2
 
-               default:
-                  sprintf (error, "%d:%d: Trailing garbage: `%c`", cur_line, e_off, b);
-                  goto e_failed;
-            };
-         }
+/* `[` and `]` are `{` and `}` but for the 0x20 bit */
 
-         if (flags & flag_string)
-         {
-            if (!b)
-            {  sprintf (error, "Unexpected EOF in string (at %d:%d)", cur_line, e_off);
-               goto e_failed;
-            }
+static void classify_sse2 (const json_char * json, json_classes * classes)
+{
+   const __m128i quote = _mm_set1_epi8 ('"'), backslash = _mm_set1_epi8 ('\\'),
+                 fold = _mm_set1_epi8 (0x20), open = _mm_set1_epi8 ('{'), close = _mm_set1_epi8 ('}'),
+                 colon = _mm_set1_epi8 (':'), comma = _mm_set1_epi8 (','),
+                 space = _mm_set1_epi8 (' '), tab = _mm_set1_epi8 ('\t'),
+                 cr = _mm_set1_epi8 ('\r'), lf = _mm_set1_epi8 ('\n');
+   int n;
 
-            if (string_length > state.uint_max)
-               goto e_toolong;
+   memset (classes, 0, sizeof (json_classes));
 
-            if (flags & flag_escaped)
-            {
-               flags &= ~ flag_escaped;
+   for (n = 0; n < 64; n += 16)
+   {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) (json + n)), folded = _mm_or_si128 (v, fold);
 
-               switch (b)
-               {
-                  case 'b':  string_add ('\b');  break;
-                  case 'f':  string_add ('\f');  break;
-                  case 'n':  string_add ('\n');  break;
-                  case 'r':  string_add ('\r');  break;
-                  case 't':  string_add ('\t');  break;
-                  case 'u':
-
-                    if ((uc_b1 = hex_value (*++ i)) == 0xFF || (uc_b2 = hex_value (*++ i)) == 0xFF
-                          || (uc_b3 = hex_value (*++ i)) == 0xFF || (uc_b4 = hex_value (*++ i)) == 0xFF)
-                    {
-                        sprintf (error, "Invalid character value `%c` (at %d:%d)", b, cur_line, e_off);
-                        goto e_failed;
-                    }
-
-                    uc_b1 = uc_b1 * 16 + uc_b2;
-                    uc_b2 = uc_b3 * 16 + uc_b4;
-
-                    uchar = ((json_char) uc_b1) * 256 + uc_b2;
-
-                    if (sizeof (json_char) >= sizeof (json_uchar) || (uc_b1 == 0 && uc_b2 <= 0x7F))
-                    {
-                       string_add ((json_char) uchar);
-                       break;
-                    }
-
-                    if (uchar <= 0x7FF)
-                    {
-                        if (state.first_pass)
-                           string_length += 2;
-                        else
-                        {  string [string_length ++] = 0xC0 | ((uc_b2 & 0xC0) >> 6) | ((uc_b1 & 0x3) << 3);
-                           string [string_length ++] = 0x80 | (uc_b2 & 0x3F);
-                        }
+      classes->quote |= (uint64_t) (unsigned int) _mm_movemask_epi8 (_mm_cmpeq_epi8 (v, quote)) << n;
+      classes->backslash |= (uint64_t) (unsigned int) _mm_movemask_epi8 (_mm_cmpeq_epi8 (v, backslash)) << n;
 
-                        break;
-                    }
+      classes->op |= (uint64_t) (unsigned int) _mm_movemask_epi8 (_mm_or_si128 (_mm_or_si128
+         (_mm_cmpeq_epi8 (folded, open), _mm_cmpeq_epi8 (folded, close)),
+          _mm_or_si128 (_mm_cmpeq_epi8 (v, colon), _mm_cmpeq_epi8 (v, comma)))) << n;
 
-                    if (state.first_pass)
-                       string_length += 3;
-                    else
-                    {  string [string_length ++] = 0xE0 | ((uc_b1 & 0xF0) >> 4);
-                       string [string_length ++] = 0x80 | ((uc_b1 & 0xF) << 2) | ((uc_b2 & 0xC0) >> 6);
-                       string [string_length ++] = 0x80 | (uc_b2 & 0x3F);
-                    }
+      classes->space |= (uint64_t) (unsigned int) _mm_movemask_epi8 (_mm_or_si128 (_mm_or_si128
+         (_mm_cmpeq_epi8 (v, space), _mm_cmpeq_epi8 (v, tab)),
+          _mm_or_si128 (_mm_cmpeq_epi8 (v, cr), _mm_cmpeq_epi8 (v, lf)))) << n;
+   }
+}
 
-                    break;
+__attribute__ ((target ("avx2")))
+static void classify_avx2 (const json_char * json, json_classes * classes)
+{
+   const __m256i quote = _mm256_set1_epi8 ('"'), backslash = _mm256_set1_epi8 ('\\'),
+                 fold = _mm256_set1_epi8 (0x20), open = _mm256_set1_epi8 ('{'), close = _mm256_set1_epi8 ('}'),
+                 colon = _mm256_set1_epi8 (':'), comma = _mm256_set1_epi8 (','),
+                 space = _mm256_set1_epi8 (' '), tab = _mm256_set1_epi8 ('\t'),
+                 cr = _mm256_set1_epi8 ('\r'), lf = _mm256_set1_epi8 ('\n');
+   int n;
 
-                  default:
-                     string_add (b);
-               };
+   memset (classes, 0, sizeof (json_classes));
 
-               continue;
-            }
+   for (n = 0; n < 64; n += 32)
+   {
+      __m256i v = _mm256_loadu_si256 ((const __m256i *) (json + n)), folded = _mm256_or_si256 (v, fold);
 
-            if (b == '\\')
-            {
-               flags |= flag_escaped;
-               continue;
-            }
+      classes->quote |= (uint64_t) (unsigned int) _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (v, quote)) << n;
+      classes->backslash |= (uint64_t) (unsigned int) _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (v, backslash)) << n;
 
-            if (b == '"')
-            {
-               if (!state.first_pass)
-                  string [string_length] = 0;
+      classes->op |= (uint64_t) (unsigned int) _mm256_movemask_epi8 (_mm256_or_si256 (_mm256_or_si256
+         (_mm256_cmpeq_epi8 (folded, open), _mm256_cmpeq_epi8 (folded, close)),
+          _mm256_or_si256 (_mm256_cmpeq_epi8 (v, colon), _mm256_cmpeq_epi8 (v, comma)))) << n;
 
-               flags &= ~ flag_string;
-               string = 0;
+      classes->space |= (uint64_t) (unsigned int) _mm256_movemask_epi8 (_mm256_or_si256 (_mm256_or_si256
+         (_mm256_cmpeq_epi8 (v, space), _mm256_cmpeq_epi8 (v, tab)),
+          _mm256_or_si256 (_mm256_cmpeq_epi8 (v, cr), _mm256_cmpeq_epi8 (v, lf)))) << n;
+   }
+}
 
-               switch (top->type)
-               {
-                  case json_string:
+#endif
 
-                     top->u.string.length = string_length;
-                     flags |= flag_next;
+/* The scanners start out pointing at stubs which call simd_init, which
+ * swaps in the best implementations, once.  Every entry point calls it
+ * through settings_init as well, before it starts any threads, so that
+ * threads only ever see the scanners chosen.
+ */
+static void simd_init (void);
 
-                     break;
+static size_t scan_string_init (const json_char *, size_t);
 
-                  case json_object:
+static const json_char * skip_whitespace_init
+   (const json_char *, const json_char *, unsigned int *, const json_char **);
 
-                     if (state.first_pass)
-                        (*(json_char **) &top->u.object.values) += string_length + 1;
-                     else
-                     {  
-                        top->u.object.values [top->u.object.length].name
-                           = (json_char *) top->_reserved.object_mem;
+static void classify_init (const json_char *, json_classes *);
 
-                        (*(json_char **) &top->_reserved.object_mem) += string_length + 1;
-                     }
+static size_t (* scan_string) (const json_char *, size_t) = scan_string_init;
 
-                     flags |= flag_seek_value | flag_need_colon;
-                     continue;
+static const json_char * (* skip_whitespace)
+   (const json_char *, const json_char *, unsigned int *, const json_char **) = skip_whitespace_init;
 
-                  default:
-                     break;
-               };
-            }
-            else
-            {
-               string_add (b);
-               continue;
-            }
-         }
+static void (* classify) (const json_char *, json_classes *) = classify_init;
 
-         if (flags & flag_seek_value)
-         {
-            switch (b)
-            {
-               whitespace:
-                  continue;
+static size_t scan_string_init (const json_char * json, size_t length)
+{
+   simd_init ();
+   return scan_string (json, length);
+}
 
-               case ']':
+static const json_char * skip_whitespace_init
+   (const json_char * i, const json_char * end, unsigned int * line, const json_char ** line_begin)
+{
+   simd_init ();
+   return skip_whitespace (i, end, line, line_begin);
+}
 
-                  if (top->type == json_array)
-                     flags = (flags & ~ (flag_need_comma | flag_seek_value)) | flag_next;
-                  else if (!state.settings.settings & json_relaxed_commas)
-                  {  sprintf (error, "%d:%d: Unexpected ]", cur_line, e_off);
-                     goto e_failed;
-                  }
+static void classify_init (const json_char * json, json_classes * classes)
+{
+   simd_init ();
+   classify (json, classes);
+}
 
-                  break;
+static void simd_choose (void)
+{
+   #ifdef JSON_SSE2
+      if (have_avx2 ())
+      {
+         scan_string = scan_string_avx2;
+         skip_whitespace = skip_whitespace_avx2;
+         classify = classify_avx2;
+      }
+      else
+      {
+         scan_string = scan_string_sse2;
+         skip_whitespace = skip_whitespace_sse2;
+         classify = classify_sse2;
+      }
+   #else
+      scan_string = scan_string_scalar;
+      skip_whitespace = skip_whitespace_scalar;
+      classify = classify_scalar;
+   #endif
+}
 
-               default:
+#ifdef JSON_THREADS
+static pthread_once_t simd_once = PTHREAD_ONCE_INIT;
+#endif
 
-                  if (flags & flag_need_comma)
-                  {
-                     if (b == ',')
-                     {  flags &= ~ flag_need_comma;
-                        continue;
-                     }
-                     else
-                     {  sprintf (error, "%d:%d: Expected , before %c", cur_line, e_off, b);
-                        goto e_failed;
-                     }
-                  }
+static void simd_init (void)
+{
+   #ifdef JSON_THREADS
+      pthread_once (&simd_once, simd_choose);
+   #else
+      simd_choose ();
+   #endif
+}
 
-                  if (flags & flag_need_colon)
-                  {
-                     if (b == ':')
-                     {  flags &= ~ flag_need_colon;
-                        continue;
-                     }
-                     else
-                     {  sprintf (error, "%d:%d: Expected : before %c", cur_line, e_off, b);
-                        goto e_failed;
-                     }
-                  }
+/* Growable scratch area used by the single pass engine.  Only ever
+ * appended to and truncated, so offsets into it stay valid across growth.
+ */
+typedef struct
+{
+   char * mem;
+   size_t length, capacity;
 
-                  flags &= ~ flag_seek_value;
+} json_stack;
 
-                  switch (b)
-                  {
-                     case '{':
+/* A child of an open container.  `name` is the offset of the key in
+ * `json_state.names` (objects only), unless it's been interned as `key`.
+ */
+typedef struct
+{
+   size_t name;
+   json_char * key;
+   json_value * value;
 
-                        if (!new_value (&state, &top, &root, &alloc, json_object))
-                           goto e_alloc_failure;
+} json_entry;
 
-                        continue;
+static void * default_alloc (size_t size, int zero, void * user_data)
+{
+   return zero ? calloc (1, size) : malloc (size);
+}
 
-                     case '[':
+static void default_free (void * ptr, void * user_data)
+{
+   free (ptr);
+}
 
-                        if (!new_value (&state, &top, &root, &alloc, json_array))
-                           goto e_alloc_failure;
+/* Copy `settings`, filling in the default allocator where none was given
+ * (and choose the scanners, if that's not been done)
+ */
+static void settings_init (json_settings * dest, const json_settings * settings)
+{
+   simd_init ();
 
-                        flags |= flag_seek_value;
-                        continue;
+   if (settings)
+      memcpy (dest, settings, sizeof (json_settings));
+   else
+      memset (dest, 0, sizeof (json_settings));
 
-                     case '"':
+   if (!dest->mem_alloc)
+      dest->mem_alloc = default_alloc;
 
-                        if (!new_value (&state, &top, &root, &alloc, json_string))
-                           goto e_alloc_failure;
+   if (!dest->mem_free)
+      dest->mem_free = default_free;
+}
 
-                        flags |= flag_string;
+/* Arena for documents: allocations are carved out of a short list of
+ * chunks, each twice the size of the last, and are only ever released all
+ * at once.
+ */
+typedef union
+{
+   double d;
+   long l;
+   void * p;
 
-                        string = top->u.string.ptr;
-                        string_length = 0;
+} json_align;
 
-                        continue;
+#define align_size(size) \
+   (((size) + sizeof (json_align) - 1) / sizeof (json_align) * sizeof (json_align))
 
-                     case 't':
+typedef struct _json_chunk
+{
+   struct _json_chunk * next;
+   size_t size;
 
-                        if (*(++ i) != 'r' || *(++ i) != 'u' || *(++ i) != 'e')
-                           goto e_unknown_value;
+} json_chunk;
 
-                        if (!new_value (&state, &top, &root, &alloc, json_boolean))
-                           goto e_alloc_failure;
+#define chunk_data(chunk) \
+   (((char *) (chunk)) + align_size (sizeof (json_chunk)))
 
-                        top->u.boolean = 1;
+static const size_t chunk_min = 16384, chunk_max = 16777216;
 
-                        flags |= flag_next;
-                        break;
+typedef struct
+{
+   json_chunk * chunks; /* newest first */
+   char * next, * end;  /* free space in the newest chunk */
 
-                     case 'f':
+} json_arena;
 
-                        if (*(++ i) != 'a' || *(++ i) != 'l' || *(++ i) != 's' || *(++ i) != 'e')
-                           goto e_unknown_value;
+static void * arena_alloc (json_settings * settings, json_arena * arena, size_t size)
+{
+   char * mem;
 
-                        if (!new_value (&state, &top, &root, &alloc, json_boolean))
-                           goto e_alloc_failure;
+   size = align_size (size);
 
-                        flags |= flag_next;
-                        break;
+   if ((size_t) (arena->end - arena->next) < size)
+   {
+      json_chunk * chunk;
+      size_t chunk_size = arena->chunks ? arena->chunks->size * 2 : chunk_min;
 
-                     case 'n':
+      if (chunk_size > chunk_max)
+         chunk_size = chunk_max;
 
-                        if (*(++ i) != 'u' || *(++ i) != 'l' || *(++ i) != 'l')
-                           goto e_unknown_value;
+      if (chunk_size < size)
+         chunk_size = size;
 
-                        if (!new_value (&state, &top, &root, &alloc, json_null))
-                           goto e_alloc_failure;
+      if (! (chunk = (json_chunk *) settings->mem_alloc
+            (align_size (sizeof (json_chunk)) + chunk_size, 0, settings->user_data)) )
+      {
+         return 0;
+      }
 
-                        flags |= flag_next;
-                        break;
+      chunk->next = arena->chunks;
+      chunk->size = chunk_size;
 
-                     default:
+      arena->chunks = chunk;
+      arena->next = chunk_data (chunk);
+      arena->end = arena->next + chunk_size;
+   }
 
-                        if (isdigit ((int)b) || b == '-')
-                        {
-                           if (!new_value (&state, &top, &root, &alloc, json_integer))
-                              goto e_alloc_failure;
+   mem = arena->next;
+   arena->next += size;
 
-                           flags &= ~ (flag_exponent | flag_got_exponent_sign);
+   return mem;
+}
+
+/* Give back the end of the most recent allocation */
+static void arena_shrink (json_arena * arena, void * mem, size_t size)
+{
+   arena->next = ((char *) mem) + align_size (size);
+}
+
+/* Free everything allocated since `mark` was taken */
+static void arena_rollback (json_settings * settings, json_arena * arena, json_arena mark)
+{
+   while (arena->chunks != mark.chunks)
+   {
+      json_chunk * chunk = arena->chunks;
+
+      arena->chunks = chunk->next;
+      settings->mem_free (chunk, settings->user_data);
+   }
+
+   *arena = mark;
+}
+
+typedef struct
+{
+   json_settings settings;
+   int first_pass, single_pass;
+
+   unsigned long used_memory;
+
+   unsigned int uint_max;
+   unsigned long ulong_max;
+
+   /* single pass: children and keys of the open containers, held until the
+    * container is closed and its values block can be allocated at its final
+    * size
+    */
+   json_stack children, names;
+
+   /* two stage: offsets of the structural characters found by stage 1 */
+   json_stack positions;
+
+   json_arena * arena; /* allocating for a document? */
+
+   json_char * in_situ; /* decoding strings in place in this input? */
+
+   /* events: values are reported to the handler rather than kept, and the
+    * nodes of those that are done reused (chained through next_alloc)
+    */
+   const json_handler * handler;
+   void * handler_data;
+   json_value * spare;
+
+} json_state;
+
+/* The text of a file, mapped or read into memory */
+typedef struct _json_held
+{
+   struct _json_held * next;
+
+   json_char * text;
+   size_t length;
+   int mapped;
+
+} json_held;
+
+struct _json_document
+{
+   json_settings settings;
+   unsigned long used_memory;
+
+   json_arena arena;
+
+   /* files parsed in situ, which the values' strings point into */
+   json_held * held;
+
+   /* the parse stacks are kept too, so that reparsing into the same
+    * document doesn't need to grow them again
+    */
+   json_stack children, names, positions;
+};
+
+/* Intern table: one copy of every key, kept in an arena and found through
+ * an open addressed table of pointers to them.  Once max_memory would be
+ * exceeded the table is saturated and takes no more keys (the ones it has
+ * are still handed out).
+ */
+typedef struct
+{
+   uint32_t hash;
+   unsigned int length;
+
+} json_interned;  /* followed by the key, terminated */
+
+struct _json_intern
+{
+   json_settings settings;
+   unsigned long used_memory;
+
+   json_arena arena;
+
+   json_interned ** table;
+   uint32_t mask, count;
+
+   int saturated;
+};
+
+#define interned_key(entry) \
+   ((json_char *) ((json_interned *) (entry) + 1))
+
+static int intern_charge (json_intern * intern, size_t size)
+{
+   if (intern->settings.max_memory
+         && intern->settings.max_memory - intern->used_memory < size)
+   {
+      intern->saturated = 1;
+      return 0;
+   }
+
+   intern->used_memory += size;
+   return 1;
+}
+
+static int intern_grow (json_intern * intern)
+{
+   uint32_t slots = intern->table ? (intern->mask + 1) * 2 : 64, i, slot;
+   json_interned ** table;
+
+   if (!intern_charge (intern, slots * sizeof (json_interned *)))
+      return 0;
+
+   if (! (table = (json_interned **) intern->settings.mem_alloc
+         (slots * sizeof (json_interned *), 1, intern->settings.user_data)) )
+   {
+      return 0;
+   }
+
+   if (intern->table)
+   {
+      for (i = 0; i <= intern->mask; ++ i)
+      {
+         if (!intern->table [i])
+            continue;
+
+         for (slot = intern->table [i]->hash & (slots - 1); table [slot]; slot = (slot + 1) & (slots - 1))
+            ;
+
+         table [slot] = intern->table [i];
+      }
+
+      intern->settings.mem_free (intern->table, intern->settings.user_data);
+      intern->used_memory -= (intern->mask + 1) * sizeof (json_interned *);
+   }
+
+   intern->table = table;
+   intern->mask = slots - 1;
+
+   return 1;
+}
+
+/* The interned copy of `key`, added if it isn't there yet, or 0 if the
+ * table is saturated or out of memory
+ */
+static json_char * intern_key (json_intern * intern, const json_char * key, size_t length)
+{
+   uint32_t hash = json_key_hash (key, length), slot;
+   json_interned * entry;
+   size_t size;
+
+   if (intern->table)
+   {
+      for (slot = hash & intern->mask; (entry = intern->table [slot]); slot = (slot + 1) & intern->mask)
+      {
+         if (entry->hash == hash && entry->length == length
+               && !memcmp (interned_key (entry), key, length * sizeof (json_char)))
+         {
+            return interned_key (entry);
+         }
+      }
+   }
+
+   if (intern->saturated || length > UINT_MAX)
+      return 0;
+
+   if ((intern->count + 1) * 2 > (intern->table ? intern->mask + 1 : 0)
+         && !intern_grow (intern))
+   {
+      return 0;
+   }
+
+   size = sizeof (json_interned) + (length + 1) * sizeof (json_char);
+
+   if (!intern_charge (intern, size))
+      return 0;
+
+   if (! (entry = (json_interned *) arena_alloc (&intern->settings, &intern->arena, size)) )
+      return 0;
+
+   entry->hash = hash;
+   entry->length = (unsigned int) length;
+
+   memcpy (interned_key (entry), key, length * sizeof (json_char));
+   interned_key (entry) [length] = 0;
+
+   for (slot = hash & intern->mask; intern->table [slot]; slot = (slot + 1) & intern->mask)
+      ;
+
+   intern->table [slot] = entry;
+   ++ intern->count;
+
+   return interned_key (entry);
+}
+
+static void * stack_push (json_settings * settings, json_stack * stack, size_t size)
+{
+   char * mem;
+
+   if (stack->capacity - stack->length < size)
+   {
+      size_t capacity = stack->capacity ? stack->capacity : 256;
+
+      while (capacity - stack->length < size)
+         capacity *= 2;
+
+      if (! (mem = (char *) settings->mem_alloc (capacity, 0, settings->user_data)))
+         return 0;
+
+      if (stack->mem)
+      {
+         memcpy (mem, stack->mem, stack->length);
+         settings->mem_free (stack->mem, settings->user_data);
+      }
+
+      stack->mem = mem;
+      stack->capacity = capacity;
+   }
+
+   mem = stack->mem + stack->length;
+   stack->length += size;
+
+   return mem;
+}
+
+#define stack_top(stack, type) \
+   (((type *) ((stack).mem + (stack).length)) - 1)
+
+static void stack_free (json_settings * settings, json_stack * stack)
+{
+   if (stack->mem)
+      settings->mem_free (stack->mem, settings->user_data);
+}
+
+static void * json_alloc (json_state * state, unsigned long size, int zero)
+{
+   void * mem;
+
+   if ((state->ulong_max - state->used_memory) < size)
+      return 0;
+
+   if (state->settings.max_memory
+         && (state->used_memory += size) > state->settings.max_memory)
+   {
+      return 0;
+   }
+
+   if (state->arena)
+   {
+      if ((mem = arena_alloc (&state->settings, state->arena, size)) && zero)
+         memset (mem, 0, size);
+
+      return mem;
+   }
+
+   if (! (mem = state->settings.mem_alloc (size, zero, state->settings.user_data)))
+      return 0;
+
+   return mem;
+}
+
+/* With json_index_objects, objects of index_min keys or more get a hash
+ * index of their keys, between the values and the keys in the object's
+ * block: the hash of each key in order, then an open addressed table of
+ * entry numbers (plus one) at least twice as long.  It's filled in as the
+ * object is closed, and `_reserved.object_mem` then points at it.
+ * Without, there's no room for one, and lookups go through the keys in turn.
+ */
+#define index_min 16
+#define index_magic 0x4A534958u  /* "JSIX" */
+
+typedef struct
+{
+   uint32_t mask;   /* table length - 1 */
+   uint32_t magic;  /* index_magic, once built */
+
+} json_index;
+
+static uint32_t index_slots (unsigned int length)
+{
+   uint32_t slots = 32;
+
+   while (slots < length * 2)
+      slots *= 2;
+
+   return slots;
+}
+
+static size_t index_size (unsigned int length)
+{
+   if (length < index_min)
+      return 0;
+
+   return sizeof (json_index) + (length + index_slots (length)) * sizeof (uint32_t);
+}
+
+/* The room to make for the index of an object as it's parsed */
+static size_t index_room (json_state * state, unsigned int length)
+{
+   return state->settings.settings & json_index_objects ? index_size (length) : 0;
+}
+
+uint32_t json_key_hash (const json_char * key, size_t length)
+{
+   uint32_t hash = 2166136261u;
+
+   for (; length; -- length)
+      hash = (hash ^ (unsigned char) *key ++) * 16777619u;
+
+   return hash;
+}
+
+static void index_build (json_value * value)
+{
+   json_index * index = (json_index *) value->_reserved.object_mem;
+   unsigned int length = value->u.object.length, i;
+   uint32_t * hashes = (uint32_t *) (index + 1), * table = hashes + length,
+            mask = index_slots (length) - 1, slot;
+
+   memset (table, 0, (mask + 1) * sizeof (uint32_t));
+
+   for (i = 0; i < length; ++ i)
+   {
+      const json_char * name = value->u.object.values [i].name;
+
+      hashes [i] = json_key_hash (name, strlen (name));
+
+      for (slot = hashes [i] & mask; table [slot]; slot = (slot + 1) & mask)
+         ;
+
+      table [slot] = i + 1;
+   }
+
+   index->mask = mask;
+   index->magic = index_magic;
+}
+
+/* The index of a complete object, or 0 if it hasn't got one (too small,
+ * parsed without json_index_objects, or not made by the parser or
+ * json_value_dup).  Where an index would be isn't enough to go on, as an
+ * object put together by hand may have anything there: it has to be marked
+ * as built, for as many keys as the object has.
+ */
+static json_index * object_index (const json_value * value)
+{
+   json_index * index;
+
+   if (value->u.object.length < index_min)
+      return 0;
+
+   index = (json_index *) value->_reserved.object_mem;
+
+   if (index != (json_index *) (value->u.object.values + value->u.object.length)
+         || index->magic != index_magic || index->mask != index_slots (value->u.object.length) - 1)
+   {
+      return 0;
+   }
+
+   return index;
+}
+
+/* The object's keys are all in: point `_reserved.object_mem` at the index
+ * (or clear it)
+ */
+static void finish_object (json_state * state, json_value * value)
+{
+   if (!index_room (state, value->u.object.length))
+   {  value->_reserved.object_mem = 0;
+      return;
+   }
+
+   value->_reserved.object_mem = value->u.object.values + value->u.object.length;
+   index_build (value);
+}
+
+static int new_value
+   (json_state * state, json_value ** top, json_value ** root, json_value ** alloc, json_type type)
+{
+   json_value * value;
+   int values_size;
+
+   if (!state->first_pass && !state->single_pass)
+   {
+      value = *top = *alloc;
+      *alloc = (*alloc)->_reserved.next_alloc;
+
+      if (!*root)
+         *root = value;
+
+      switch (value->type)
+      {
+         case json_array:
+
+            if (! (value->u.array.values = (json_value **) json_alloc
+               (state, value->u.array.length * sizeof (json_value *), 0)) )
+            {
+               return 0;
+            }
+
+            break;
+
+         case json_object:
+
+            values_size = sizeof (*value->u.object.values) * value->u.object.length
+                             + index_room (state, value->u.object.length);
+
+            if (! ((*(void **) &value->u.object.values) = json_alloc
+                  (state, values_size + ((unsigned long) value->u.object.values), 0)) )
+            {
+               return 0;
+            }
+
+            value->_reserved.object_mem = (*(char **) &value->u.object.values) + values_size;
+
+            break;
+
+         case json_string:
+
+            if (! (value->u.string.ptr = (json_char *) json_alloc
+               (state, (value->u.string.length + 1) * sizeof (json_char), 0)) )
+            {
+               return 0;
+            }
+
+            break;
+
+         default:
+            break;
+      };
+
+      value->u.array.length = 0;
+
+      return 1;
+   }
+
+   if ( (value = state->spare) )
+   {
+      state->spare = value->_reserved.next_alloc;
+      memset (value, 0, sizeof (json_value));
+   }
+   else if (! (value = (json_value *) json_alloc (state, sizeof (json_value), 1)) )
+      return 0;
+
+   if (!*root)
+      *root = value;
+
+   value->type = type;
+   value->parent = *top;
+
+   if (state->single_pass)
+   {
+      /* nothing to size later, so no need to chain the allocations */
+
+      *top = value;
+      return 1;
+   }
+
+   if (*alloc)
+      (*alloc)->_reserved.next_alloc = value;
+
+   *alloc = *top = value;
+
+   return 1;
+}
+
+/* Single pass: the container is complete, so move its children off the
+ * stack into a values block of exactly the size the two pass parse would
+ * have allocated (keys are copied in behind the values, as there).
+ */
+static int close_value (json_state * state, json_value * value)
+{
+   unsigned int length = value->u.array.length, i;
+   json_entry * entries = 0;
+   size_t names, values_size;
+
+   if (value->type != json_array && value->type != json_object)
+      return 1;
+
+   if (length)
+      entries = stack_top (state->children, json_entry) + 1 - length;
+
+   switch (value->type)
+   {
+      case json_array:
+
+         if (! (value->u.array.values = (json_value **) json_alloc
+            (state, length * sizeof (json_value *), 0)) )
+         {
+            return 0;
+         }
+
+         for (i = 0; i < length; ++ i)
+            value->u.array.values [i] = entries [i].value;
+
+         break;
+
+      case json_object:
+
+         if (state->in_situ)
+            names = state->names.length;  /* the keys stay in the input */
+         else
+            names = length ? entries [0].name : state->names.length;
+
+         values_size = sizeof (*value->u.object.values) * length + index_room (state, length);
+
+         if (! ((*(void **) &value->u.object.values) = json_alloc
+               (state, values_size + (state->names.length - names), 0)) )
+         {
+            return 0;
+         }
+
+         value->_reserved.object_mem = (*(char **) &value->u.object.values) + values_size;
+
+         if (state->names.length - names)
+         {
+            memcpy (value->_reserved.object_mem, state->names.mem + names,
+                    state->names.length - names);
+         }
+
+         for (i = 0; i < length; ++ i)
+         {
+            if (entries [i].key)
+               value->u.object.values [i].name = entries [i].key;
+            else if (state->in_situ)
+               value->u.object.values [i].name = state->in_situ + entries [i].name;
+            else
+            {
+               value->u.object.values [i].name = (json_char *) value->_reserved.object_mem
+                                                   + (entries [i].name - names);
+            }
+
+            value->u.object.values [i].value = entries [i].value;
+         }
+
+         state->names.length = names;
+         finish_object (state, value);
+
+         break;
+
+      default:
+         break;
+   };
+
+   state->children.length -= length * sizeof (json_entry);
+
+   return 1;
+}
+
+/* Events: the value is complete, so report it, and once the handler's done
+ * with it keep its node (and the room its string took) for the next ones
+ */
+static int value_event (json_state * state, json_value * value)
+{
+   const json_handler * handler = state->handler;
+   void * data = state->handler_data;
+   int result = 1;
+
+   switch (value->type)
+   {
+      case json_object:
+
+         if (handler->end_object)
+            result = handler->end_object (data);
+
+         break;
+
+      case json_array:
+
+         if (handler->end_array)
+            result = handler->end_array (data);
+
+         break;
+
+      case json_string:
+
+         if (handler->string)
+            result = handler->string (value->u.string.ptr, value->u.string.length, data);
+
+         state->names.length = (char *) value->u.string.ptr - state->names.mem;
+         break;
+
+      case json_integer:
+
+         if (handler->integer)
+            result = handler->integer (value->u.integer, data);
+
+         break;
+
+      case json_double:
+
+         if (handler->dbl)
+            result = handler->dbl (value->u.dbl, data);
+
+         break;
+
+      case json_boolean:
+
+         if (handler->boolean)
+            result = handler->boolean (value->u.boolean, data);
+
+         break;
+
+      case json_null:
+
+         if (handler->null)
+            result = handler->null (data);
+
+         break;
+
+      default:
+         break;
+   };
+
+   if (!result)
+      return 0;
+
+   value->_reserved.next_alloc = state->spare;
+   state->spare = value;
+
+   return 1;
+}
+
+/* Events: free the nodes of the open values (`top` and its parents) and the
+ * spare ones
+ */
+static void events_free (json_state * state, json_value * top)
+{
+   json_value * next;
+
+   for (; top; top = next)
+   {
+      next = top->parent;
+      state->settings.mem_free (top, state->settings.user_data);
+   }
+
+   for (top = state->spare; top; top = next)
+   {
+      next = top->_reserved.next_alloc;
+      state->settings.mem_free (top, state->settings.user_data);
+   }
+
+   state->spare = 0;
+}
+
+/* Single pass: free whatever was built before an error.  The open containers
+ * (`top` and its parents) have no values block yet; their finished children
+ * are still on the stack.
+ */
+static void single_pass_free (json_state * state, json_value * top)
+{
+   json_entry * entries = (json_entry *) state->children.mem;
+   size_t i = state->children.length / sizeof (json_entry);
+   json_value * parent;
+
+   while (i --)
+      json_value_free_ex (&state->settings, entries [i].value);
+
+   for (; top; top = parent)
+   {
+      parent = top->parent;
+
+      if (top->type == json_string)
+         state->settings.mem_free (top->u.string.ptr, state->settings.user_data);
+
+      state->settings.mem_free (top, state->settings.user_data);
+   }
+}
+
+/* Upper bound on the decoded length of the string starting at `json` (just
+ * past the opening quote): escapes only ever shrink.
+ */
+static size_t string_span (const json_char * json, const json_char * end)
+{
+   const json_char * i = json;
+
+   while ((i += scan_string (i, end - i)) < end && *i != '"')
+   {
+      /* skip the escaped character (or the control character) */
+
+      if (*i == '\\' && ++ i == end)
+         break;
+
+      ++ i;
+   }
+
+   return i - json;
+}
+
+/* Numbers are decoded here, in the same sweep that finds their end, without
+ * going through strtol/strtod (which depend on the locale and need the
+ * number copied out and terminated).
+ *
+ * Integers are exact over the whole of json_int_t.  Doubles are correctly
+ * rounded: the common cases are settled by a multiplication in double
+ * precision (when that's exact) or by the Eisel-Lemire algorithm, which
+ * scales the significand by a 128-bit approximation of the power of ten,
+ * and whatever's left is done exactly with big integers.
+ */
+
+/* 128 bits of 5^q, normalized so the top bit is set, for q from -342
+ * to 308
+ */
+static const uint64_t power_of_five [] =
+{
+   0xeef453d6923bd65aULL, 0x113faa2906a13b3fULL,
+   0x9558b4661b6565f8ULL, 0x4ac7ca59a424c507ULL,
+   0xbaaee17fa23ebf76ULL, 0x5d79bcf00d2df649ULL,
+   0xe95a99df8ace6f53ULL, 0xf4d82c2c107973dcULL,
+   0x91d8a02bb6c10594ULL, 0x79071b9b8a4be869ULL,
+   0xb64ec836a47146f9ULL, 0x9748e2826cdee284ULL,
+   0xe3e27a444d8d98b7ULL, 0xfd1b1b2308169b25ULL,
+   0x8e6d8c6ab0787f72ULL, 0xfe30f0f5e50e20f7ULL,
+   0xb208ef855c969f4fULL, 0xbdbd2d335e51a935ULL,
+   0xde8b2b66b3bc4723ULL, 0xad2c788035e61382ULL,
+   0x8b16fb203055ac76ULL, 0x4c3bcb5021afcc31ULL,
+   0xaddcb9e83c6b1793ULL, 0xdf4abe242a1bbf3dULL,
+   0xd953e8624b85dd78ULL, 0xd71d6dad34a2af0dULL,
+   0x87d4713d6f33aa6bULL, 0x8672648c40e5ad68ULL,
+   0xa9c98d8ccb009506ULL, 0x680efdaf511f18c2ULL,
+   0xd43bf0effdc0ba48ULL, 0x0212bd1b2566def2ULL,
+   0x84a57695fe98746dULL, 0x014bb630f7604b57ULL,
+   0xa5ced43b7e3e9188ULL, 0x419ea3bd35385e2dULL,
+   0xcf42894a5dce35eaULL, 0x52064cac828675b9ULL,
+   0x818995ce7aa0e1b2ULL, 0x7343efebd1940993ULL,
+   0xa1ebfb4219491a1fULL, 0x1014ebe6c5f90bf8ULL,
+   0xca66fa129f9b60a6ULL, 0xd41a26e077774ef6ULL,
+   0xfd00b897478238d0ULL, 0x8920b098955522b4ULL,
+   0x9e20735e8cb16382ULL, 0x55b46e5f5d5535b0ULL,
+   0xc5a890362fddbc62ULL, 0xeb2189f734aa831dULL,
+   0xf712b443bbd52b7bULL, 0xa5e9ec7501d523e4ULL,
+   0x9a6bb0aa55653b2dULL, 0x47b233c92125366eULL,
+   0xc1069cd4eabe89f8ULL, 0x999ec0bb696e840aULL,
+   0xf148440a256e2c76ULL, 0xc00670ea43ca250dULL,
+   0x96cd2a865764dbcaULL, 0x380406926a5e5728ULL,
+   0xbc807527ed3e12bcULL, 0xc605083704f5ecf2ULL,
+   0xeba09271e88d976bULL, 0xf7864a44c633682eULL,
+   0x93445b8731587ea3ULL, 0x7ab3ee6afbe0211dULL,
+   0xb8157268fdae9e4cULL, 0x5960ea05bad82964ULL,
+   0xe61acf033d1a45dfULL, 0x6fb92487298e33bdULL,
+   0x8fd0c16206306babULL, 0xa5d3b6d479f8e056ULL,
+   0xb3c4f1ba87bc8696ULL, 0x8f48a4899877186cULL,
+   0xe0b62e2929aba83cULL, 0x331acdabfe94de87ULL,
+   0x8c71dcd9ba0b4925ULL, 0x9ff0c08b7f1d0b14ULL,
+   0xaf8e5410288e1b6fULL, 0x07ecf0ae5ee44dd9ULL,
+   0xdb71e91432b1a24aULL, 0xc9e82cd9f69d6150ULL,
+   0x892731ac9faf056eULL, 0xbe311c083a225cd2ULL,
+   0xab70fe17c79ac6caULL, 0x6dbd630a48aaf406ULL,
+   0xd64d3d9db981787dULL, 0x092cbbccdad5b108ULL,
+   0x85f0468293f0eb4eULL, 0x25bbf56008c58ea5ULL,
+   0xa76c582338ed2621ULL, 0xaf2af2b80af6f24eULL,
+   0xd1476e2c07286faaULL, 0x1af5af660db4aee1ULL,
+   0x82cca4db847945caULL, 0x50d98d9fc890ed4dULL,
+   0xa37fce126597973cULL, 0xe50ff107bab528a0ULL,
+   0xcc5fc196fefd7d0cULL, 0x1e53ed49a96272c8ULL,
+   0xff77b1fcbebcdc4fULL, 0x25e8e89c13bb0f7aULL,
+   0x9faacf3df73609b1ULL, 0x77b191618c54e9acULL,
+   0xc795830d75038c1dULL, 0xd59df5b9ef6a2417ULL,
+   0xf97ae3d0d2446f25ULL, 0x4b0573286b44ad1dULL,
+   0x9becce62836ac577ULL, 0x4ee367f9430aec32ULL,
+   0xc2e801fb244576d5ULL, 0x229c41f793cda73fULL,
+   0xf3a20279ed56d48aULL, 0x6b43527578c1110fULL,
+   0x9845418c345644d6ULL, 0x830a13896b78aaa9ULL,
+   0xbe5691ef416bd60cULL, 0x23cc986bc656d553ULL,
+   0xedec366b11c6cb8fULL, 0x2cbfbe86b7ec8aa8ULL,
+   0x94b3a202eb1c3f39ULL, 0x7bf7d71432f3d6a9ULL,
+   0xb9e08a83a5e34f07ULL, 0xdaf5ccd93fb0cc53ULL,
+   0xe858ad248f5c22c9ULL, 0xd1b3400f8f9cff68ULL,
+   0x91376c36d99995beULL, 0x23100809b9c21fa1ULL,
+   0xb58547448ffffb2dULL, 0xabd40a0c2832a78aULL,
+   0xe2e69915b3fff9f9ULL, 0x16c90c8f323f516cULL,
+   0x8dd01fad907ffc3bULL, 0xae3da7d97f6792e3ULL,
+   0xb1442798f49ffb4aULL, 0x99cd11cfdf41779cULL,
+   0xdd95317f31c7fa1dULL, 0x40405643d711d583ULL,
+   0x8a7d3eef7f1cfc52ULL, 0x482835ea666b2572ULL,
+   0xad1c8eab5ee43b66ULL, 0xda3243650005eecfULL,
+   0xd863b256369d4a40ULL, 0x90bed43e40076a82ULL,
+   0x873e4f75e2224e68ULL, 0x5a7744a6e804a291ULL,
+   0xa90de3535aaae202ULL, 0x711515d0a205cb36ULL,
+   0xd3515c2831559a83ULL, 0x0d5a5b44ca873e03ULL,
+   0x8412d9991ed58091ULL, 0xe858790afe9486c2ULL,
+   0xa5178fff668ae0b6ULL, 0x626e974dbe39a872ULL,
+   0xce5d73ff402d98e3ULL, 0xfb0a3d212dc8128fULL,
+   0x80fa687f881c7f8eULL, 0x7ce66634bc9d0b99ULL,
+   0xa139029f6a239f72ULL, 0x1c1fffc1ebc44e80ULL,
+   0xc987434744ac874eULL, 0xa327ffb266b56220ULL,
+   0xfbe9141915d7a922ULL, 0x4bf1ff9f0062baa8ULL,
+   0x9d71ac8fada6c9b5ULL, 0x6f773fc3603db4a9ULL,
+   0xc4ce17b399107c22ULL, 0xcb550fb4384d21d3ULL,
+   0xf6019da07f549b2bULL, 0x7e2a53a146606a48ULL,
+   0x99c102844f94e0fbULL, 0x2eda7444cbfc426dULL,
+   0xc0314325637a1939ULL, 0xfa911155fefb5308ULL,
+   0xf03d93eebc589f88ULL, 0x793555ab7eba27caULL,
+   0x96267c7535b763b5ULL, 0x4bc1558b2f3458deULL,
+   0xbbb01b9283253ca2ULL, 0x9eb1aaedfb016f16ULL,
+   0xea9c227723ee8bcbULL, 0x465e15a979c1cadcULL,
+   0x92a1958a7675175fULL, 0x0bfacd89ec191ec9ULL,
+   0xb749faed14125d36ULL, 0xcef980ec671f667bULL,
+   0xe51c79a85916f484ULL, 0x82b7e12780e7401aULL,
+   0x8f31cc0937ae58d2ULL, 0xd1b2ecb8b0908810ULL,
+   0xb2fe3f0b8599ef07ULL, 0x861fa7e6dcb4aa15ULL,
+   0xdfbdcece67006ac9ULL, 0x67a791e093e1d49aULL,
+   0x8bd6a141006042bdULL, 0xe0c8bb2c5c6d24e0ULL,
+   0xaecc49914078536dULL, 0x58fae9f773886e18ULL,
+   0xda7f5bf590966848ULL, 0xaf39a475506a899eULL,
+   0x888f99797a5e012dULL, 0x6d8406c952429603ULL,
+   0xaab37fd7d8f58178ULL, 0xc8e5087ba6d33b83ULL,
+   0xd5605fcdcf32e1d6ULL, 0xfb1e4a9a90880a64ULL,
+   0x855c3be0a17fcd26ULL, 0x5cf2eea09a55067fULL,
+   0xa6b34ad8c9dfc06fULL, 0xf42faa48c0ea481eULL,
+   0xd0601d8efc57b08bULL, 0xf13b94daf124da26ULL,
+   0x823c12795db6ce57ULL, 0x76c53d08d6b70858ULL,
+   0xa2cb1717b52481edULL, 0x54768c4b0c64ca6eULL,
+   0xcb7ddcdda26da268ULL, 0xa9942f5dcf7dfd09ULL,
+   0xfe5d54150b090b02ULL, 0xd3f93b35435d7c4cULL,
+   0x9efa548d26e5a6e1ULL, 0xc47bc5014a1a6dafULL,
+   0xc6b8e9b0709f109aULL, 0x359ab6419ca1091bULL,
+   0xf867241c8cc6d4c0ULL, 0xc30163d203c94b62ULL,
+   0x9b407691d7fc44f8ULL, 0x79e0de63425dcf1dULL,
+   0xc21094364dfb5636ULL, 0x985915fc12f542e4ULL,
+   0xf294b943e17a2bc4ULL, 0x3e6f5b7b17b2939dULL,
+   0x979cf3ca6cec5b5aULL, 0xa705992ceecf9c42ULL,
+   0xbd8430bd08277231ULL, 0x50c6ff782a838353ULL,
+   0xece53cec4a314ebdULL, 0xa4f8bf5635246428ULL,
+   0x940f4613ae5ed136ULL, 0x871b7795e136be99ULL,
+   0xb913179899f68584ULL, 0x28e2557b59846e3fULL,
+   0xe757dd7ec07426e5ULL, 0x331aeada2fe589cfULL,
+   0x9096ea6f3848984fULL, 0x3ff0d2c85def7621ULL,
+   0xb4bca50b065abe63ULL, 0x0fed077a756b53a9ULL,
+   0xe1ebce4dc7f16dfbULL, 0xd3e8495912c62894ULL,
+   0x8d3360f09cf6e4bdULL, 0x64712dd7abbbd95cULL,
+   0xb080392cc4349decULL, 0xbd8d794d96aacfb3ULL,
+   0xdca04777f541c567ULL, 0xecf0d7a0fc5583a0ULL,
+   0x89e42caaf9491b60ULL, 0xf41686c49db57244ULL,
+   0xac5d37d5b79b6239ULL, 0x311c2875c522ced5ULL,
+   0xd77485cb25823ac7ULL, 0x7d633293366b828bULL,
+   0x86a8d39ef77164bcULL, 0xae5dff9c02033197ULL,
+   0xa8530886b54dbdebULL, 0xd9f57f830283fdfcULL,
+   0xd267caa862a12d66ULL, 0xd072df63c324fd7bULL,
+   0x8380dea93da4bc60ULL, 0x4247cb9e59f71e6dULL,
+   0xa46116538d0deb78ULL, 0x52d9be85f074e608ULL,
+   0xcd795be870516656ULL, 0x67902e276c921f8bULL,
+   0x806bd9714632dff6ULL, 0x00ba1cd8a3db53b6ULL,
+   0xa086cfcd97bf97f3ULL, 0x80e8a40eccd228a4ULL,
+   0xc8a883c0fdaf7df0ULL, 0x6122cd128006b2cdULL,
+   0xfad2a4b13d1b5d6cULL, 0x796b805720085f81ULL,
+   0x9cc3a6eec6311a63ULL, 0xcbe3303674053bb0ULL,
+   0xc3f490aa77bd60fcULL, 0xbedbfc4411068a9cULL,
+   0xf4f1b4d515acb93bULL, 0xee92fb5515482d44ULL,
+   0x991711052d8bf3c5ULL, 0x751bdd152d4d1c4aULL,
+   0xbf5cd54678eef0b6ULL, 0xd262d45a78a0635dULL,
+   0xef340a98172aace4ULL, 0x86fb897116c87c34ULL,
+   0x9580869f0e7aac0eULL, 0xd45d35e6ae3d4da0ULL,
+   0xbae0a846d2195712ULL, 0x8974836059cca109ULL,
+   0xe998d258869facd7ULL, 0x2bd1a438703fc94bULL,
+   0x91ff83775423cc06ULL, 0x7b6306a34627ddcfULL,
+   0xb67f6455292cbf08ULL, 0x1a3bc84c17b1d542ULL,
+   0xe41f3d6a7377eecaULL, 0x20caba5f1d9e4a93ULL,
+   0x8e938662882af53eULL, 0x547eb47b7282ee9cULL,
+   0xb23867fb2a35b28dULL, 0xe99e619a4f23aa43ULL,
+   0xdec681f9f4c31f31ULL, 0x6405fa00e2ec94d4ULL,
+   0x8b3c113c38f9f37eULL, 0xde83bc408dd3dd04ULL,
+   0xae0b158b4738705eULL, 0x9624ab50b148d445ULL,
+   0xd98ddaee19068c76ULL, 0x3badd624dd9b0957ULL,
+   0x87f8a8d4cfa417c9ULL, 0xe54ca5d70a80e5d6ULL,
+   0xa9f6d30a038d1dbcULL, 0x5e9fcf4ccd211f4cULL,
+   0xd47487cc8470652bULL, 0x7647c3200069671fULL,
+   0x84c8d4dfd2c63f3bULL, 0x29ecd9f40041e073ULL,
+   0xa5fb0a17c777cf09ULL, 0xf468107100525890ULL,
+   0xcf79cc9db955c2ccULL, 0x7182148d4066eeb4ULL,
+   0x81ac1fe293d599bfULL, 0xc6f14cd848405530ULL,
+   0xa21727db38cb002fULL, 0xb8ada00e5a506a7cULL,
+   0xca9cf1d206fdc03bULL, 0xa6d90811f0e4851cULL,
+   0xfd442e4688bd304aULL, 0x908f4a166d1da663ULL,
+   0x9e4a9cec15763e2eULL, 0x9a598e4e043287feULL,
+   0xc5dd44271ad3cdbaULL, 0x40eff1e1853f29fdULL,
+   0xf7549530e188c128ULL, 0xd12bee59e68ef47cULL,
+   0x9a94dd3e8cf578b9ULL, 0x82bb74f8301958ceULL,
+   0xc13a148e3032d6e7ULL, 0xe36a52363c1faf01ULL,
+   0xf18899b1bc3f8ca1ULL, 0xdc44e6c3cb279ac1ULL,
+   0x96f5600f15a7b7e5ULL, 0x29ab103a5ef8c0b9ULL,
+   0xbcb2b812db11a5deULL, 0x7415d448f6b6f0e7ULL,
+   0xebdf661791d60f56ULL, 0x111b495b3464ad21ULL,
+   0x936b9fcebb25c995ULL, 0xcab10dd900beec34ULL,
+   0xb84687c269ef3bfbULL, 0x3d5d514f40eea742ULL,
+   0xe65829b3046b0afaULL, 0x0cb4a5a3112a5112ULL,
+   0x8ff71a0fe2c2e6dcULL, 0x47f0e785eaba72abULL,
+   0xb3f4e093db73a093ULL, 0x59ed216765690f56ULL,
+   0xe0f218b8d25088b8ULL, 0x306869c13ec3532cULL,
+   0x8c974f7383725573ULL, 0x1e414218c73a13fbULL,
+   0xafbd2350644eeacfULL, 0xe5d1929ef90898faULL,
+   0xdbac6c247d62a583ULL, 0xdf45f746b74abf39ULL,
+   0x894bc396ce5da772ULL, 0x6b8bba8c328eb783ULL,
+   0xab9eb47c81f5114fULL, 0x066ea92f3f326564ULL,
+   0xd686619ba27255a2ULL, 0xc80a537b0efefebdULL,
+   0x8613fd0145877585ULL, 0xbd06742ce95f5f36ULL,
+   0xa798fc4196e952e7ULL, 0x2c48113823b73704ULL,
+   0xd17f3b51fca3a7a0ULL, 0xf75a15862ca504c5ULL,
+   0x82ef85133de648c4ULL, 0x9a984d73dbe722fbULL,
+   0xa3ab66580d5fdaf5ULL, 0xc13e60d0d2e0ebbaULL,
+   0xcc963fee10b7d1b3ULL, 0x318df905079926a8ULL,
+   0xffbbcfe994e5c61fULL, 0xfdf17746497f7052ULL,
+   0x9fd561f1fd0f9bd3ULL, 0xfeb6ea8bedefa633ULL,
+   0xc7caba6e7c5382c8ULL, 0xfe64a52ee96b8fc0ULL,
+   0xf9bd690a1b68637bULL, 0x3dfdce7aa3c673b0ULL,
+   0x9c1661a651213e2dULL, 0x06bea10ca65c084eULL,
+   0xc31bfa0fe5698db8ULL, 0x486e494fcff30a62ULL,
+   0xf3e2f893dec3f126ULL, 0x5a89dba3c3efccfaULL,
+   0x986ddb5c6b3a76b7ULL, 0xf89629465a75e01cULL,
+   0xbe89523386091465ULL, 0xf6bbb397f1135823ULL,
+   0xee2ba6c0678b597fULL, 0x746aa07ded582e2cULL,
+   0x94db483840b717efULL, 0xa8c2a44eb4571cdcULL,
+   0xba121a4650e4ddebULL, 0x92f34d62616ce413ULL,
+   0xe896a0d7e51e1566ULL, 0x77b020baf9c81d17ULL,
+   0x915e2486ef32cd60ULL, 0x0ace1474dc1d122eULL,
+   0xb5b5ada8aaff80b8ULL, 0x0d819992132456baULL,
+   0xe3231912d5bf60e6ULL, 0x10e1fff697ed6c69ULL,
+   0x8df5efabc5979c8fULL, 0xca8d3ffa1ef463c1ULL,
+   0xb1736b96b6fd83b3ULL, 0xbd308ff8a6b17cb2ULL,
+   0xddd0467c64bce4a0ULL, 0xac7cb3f6d05ddbdeULL,
+   0x8aa22c0dbef60ee4ULL, 0x6bcdf07a423aa96bULL,
+   0xad4ab7112eb3929dULL, 0x86c16c98d2c953c6ULL,
+   0xd89d64d57a607744ULL, 0xe871c7bf077ba8b7ULL,
+   0x87625f056c7c4a8bULL, 0x11471cd764ad4972ULL,
+   0xa93af6c6c79b5d2dULL, 0xd598e40d3dd89bcfULL,
+   0xd389b47879823479ULL, 0x4aff1d108d4ec2c3ULL,
+   0x843610cb4bf160cbULL, 0xcedf722a585139baULL,
+   0xa54394fe1eedb8feULL, 0xc2974eb4ee658828ULL,
+   0xce947a3da6a9273eULL, 0x733d226229feea32ULL,
+   0x811ccc668829b887ULL, 0x0806357d5a3f525fULL,
+   0xa163ff802a3426a8ULL, 0xca07c2dcb0cf26f7ULL,
+   0xc9bcff6034c13052ULL, 0xfc89b393dd02f0b5ULL,
+   0xfc2c3f3841f17c67ULL, 0xbbac2078d443ace2ULL,
+   0x9d9ba7832936edc0ULL, 0xd54b944b84aa4c0dULL,
+   0xc5029163f384a931ULL, 0x0a9e795e65d4df11ULL,
+   0xf64335bcf065d37dULL, 0x4d4617b5ff4a16d5ULL,
+   0x99ea0196163fa42eULL, 0x504bced1bf8e4e45ULL,
+   0xc06481fb9bcf8d39ULL, 0xe45ec2862f71e1d6ULL,
+   0xf07da27a82c37088ULL, 0x5d767327bb4e5a4cULL,
+   0x964e858c91ba2655ULL, 0x3a6a07f8d510f86fULL,
+   0xbbe226efb628afeaULL, 0x890489f70a55368bULL,
+   0xeadab0aba3b2dbe5ULL, 0x2b45ac74ccea842eULL,
+   0x92c8ae6b464fc96fULL, 0x3b0b8bc90012929dULL,
+   0xb77ada0617e3bbcbULL, 0x09ce6ebb40173744ULL,
+   0xe55990879ddcaabdULL, 0xcc420a6a101d0515ULL,
+   0x8f57fa54c2a9eab6ULL, 0x9fa946824a12232dULL,
+   0xb32df8e9f3546564ULL, 0x47939822dc96abf9ULL,
+   0xdff9772470297ebdULL, 0x59787e2b93bc56f7ULL,
+   0x8bfbea76c619ef36ULL, 0x57eb4edb3c55b65aULL,
+   0xaefae51477a06b03ULL, 0xede622920b6b23f1ULL,
+   0xdab99e59958885c4ULL, 0xe95fab368e45ecedULL,
+   0x88b402f7fd75539bULL, 0x11dbcb0218ebb414ULL,
+   0xaae103b5fcd2a881ULL, 0xd652bdc29f26a119ULL,
+   0xd59944a37c0752a2ULL, 0x4be76d3346f0495fULL,
+   0x857fcae62d8493a5ULL, 0x6f70a4400c562ddbULL,
+   0xa6dfbd9fb8e5b88eULL, 0xcb4ccd500f6bb952ULL,
+   0xd097ad07a71f26b2ULL, 0x7e2000a41346a7a7ULL,
+   0x825ecc24c873782fULL, 0x8ed400668c0c28c8ULL,
+   0xa2f67f2dfa90563bULL, 0x728900802f0f32faULL,
+   0xcbb41ef979346bcaULL, 0x4f2b40a03ad2ffb9ULL,
+   0xfea126b7d78186bcULL, 0xe2f610c84987bfa8ULL,
+   0x9f24b832e6b0f436ULL, 0x0dd9ca7d2df4d7c9ULL,
+   0xc6ede63fa05d3143ULL, 0x91503d1c79720dbbULL,
+   0xf8a95fcf88747d94ULL, 0x75a44c6397ce912aULL,
+   0x9b69dbe1b548ce7cULL, 0xc986afbe3ee11abaULL,
+   0xc24452da229b021bULL, 0xfbe85badce996168ULL,
+   0xf2d56790ab41c2a2ULL, 0xfae27299423fb9c3ULL,
+   0x97c560ba6b0919a5ULL, 0xdccd879fc967d41aULL,
+   0xbdb6b8e905cb600fULL, 0x5400e987bbc1c920ULL,
+   0xed246723473e3813ULL, 0x290123e9aab23b68ULL,
+   0x9436c0760c86e30bULL, 0xf9a0b6720aaf6521ULL,
+   0xb94470938fa89bceULL, 0xf808e40e8d5b3e69ULL,
+   0xe7958cb87392c2c2ULL, 0xb60b1d1230b20e04ULL,
+   0x90bd77f3483bb9b9ULL, 0xb1c6f22b5e6f48c2ULL,
+   0xb4ecd5f01a4aa828ULL, 0x1e38aeb6360b1af3ULL,
+   0xe2280b6c20dd5232ULL, 0x25c6da63c38de1b0ULL,
+   0x8d590723948a535fULL, 0x579c487e5a38ad0eULL,
+   0xb0af48ec79ace837ULL, 0x2d835a9df0c6d851ULL,
+   0xdcdb1b2798182244ULL, 0xf8e431456cf88e65ULL,
+   0x8a08f0f8bf0f156bULL, 0x1b8e9ecb641b58ffULL,
+   0xac8b2d36eed2dac5ULL, 0xe272467e3d222f3fULL,
+   0xd7adf884aa879177ULL, 0x5b0ed81dcc6abb0fULL,
+   0x86ccbb52ea94baeaULL, 0x98e947129fc2b4e9ULL,
+   0xa87fea27a539e9a5ULL, 0x3f2398d747b36224ULL,
+   0xd29fe4b18e88640eULL, 0x8eec7f0d19a03aadULL,
+   0x83a3eeeef9153e89ULL, 0x1953cf68300424acULL,
+   0xa48ceaaab75a8e2bULL, 0x5fa8c3423c052dd7ULL,
+   0xcdb02555653131b6ULL, 0x3792f412cb06794dULL,
+   0x808e17555f3ebf11ULL, 0xe2bbd88bbee40bd0ULL,
+   0xa0b19d2ab70e6ed6ULL, 0x5b6aceaeae9d0ec4ULL,
+   0xc8de047564d20a8bULL, 0xf245825a5a445275ULL,
+   0xfb158592be068d2eULL, 0xeed6e2f0f0d56712ULL,
+   0x9ced737bb6c4183dULL, 0x55464dd69685606bULL,
+   0xc428d05aa4751e4cULL, 0xaa97e14c3c26b886ULL,
+   0xf53304714d9265dfULL, 0xd53dd99f4b3066a8ULL,
+   0x993fe2c6d07b7fabULL, 0xe546a8038efe4029ULL,
+   0xbf8fdb78849a5f96ULL, 0xde98520472bdd033ULL,
+   0xef73d256a5c0f77cULL, 0x963e66858f6d4440ULL,
+   0x95a8637627989aadULL, 0xdde7001379a44aa8ULL,
+   0xbb127c53b17ec159ULL, 0x5560c018580d5d52ULL,
+   0xe9d71b689dde71afULL, 0xaab8f01e6e10b4a6ULL,
+   0x9226712162ab070dULL, 0xcab3961304ca70e8ULL,
+   0xb6b00d69bb55c8d1ULL, 0x3d607b97c5fd0d22ULL,
+   0xe45c10c42a2b3b05ULL, 0x8cb89a7db77c506aULL,
+   0x8eb98a7a9a5b04e3ULL, 0x77f3608e92adb242ULL,
+   0xb267ed1940f1c61cULL, 0x55f038b237591ed3ULL,
+   0xdf01e85f912e37a3ULL, 0x6b6c46dec52f6688ULL,
+   0x8b61313bbabce2c6ULL, 0x2323ac4b3b3da015ULL,
+   0xae397d8aa96c1b77ULL, 0xabec975e0a0d081aULL,
+   0xd9c7dced53c72255ULL, 0x96e7bd358c904a21ULL,
+   0x881cea14545c7575ULL, 0x7e50d64177da2e54ULL,
+   0xaa242499697392d2ULL, 0xdde50bd1d5d0b9e9ULL,
+   0xd4ad2dbfc3d07787ULL, 0x955e4ec64b44e864ULL,
+   0x84ec3c97da624ab4ULL, 0xbd5af13bef0b113eULL,
+   0xa6274bbdd0fadd61ULL, 0xecb1ad8aeacdd58eULL,
+   0xcfb11ead453994baULL, 0x67de18eda5814af2ULL,
+   0x81ceb32c4b43fcf4ULL, 0x80eacf948770ced7ULL,
+   0xa2425ff75e14fc31ULL, 0xa1258379a94d028dULL,
+   0xcad2f7f5359a3b3eULL, 0x096ee45813a04330ULL,
+   0xfd87b5f28300ca0dULL, 0x8bca9d6e188853fcULL,
+   0x9e74d1b791e07e48ULL, 0x775ea264cf55347eULL,
+   0xc612062576589ddaULL, 0x95364afe032a819eULL,
+   0xf79687aed3eec551ULL, 0x3a83ddbd83f52205ULL,
+   0x9abe14cd44753b52ULL, 0xc4926a9672793543ULL,
+   0xc16d9a0095928a27ULL, 0x75b7053c0f178294ULL,
+   0xf1c90080baf72cb1ULL, 0x5324c68b12dd6339ULL,
+   0x971da05074da7beeULL, 0xd3f6fc16ebca5e04ULL,
+   0xbce5086492111aeaULL, 0x88f4bb1ca6bcf585ULL,
+   0xec1e4a7db69561a5ULL, 0x2b31e9e3d06c32e6ULL,
+   0x9392ee8e921d5d07ULL, 0x3aff322e62439fd0ULL,
+   0xb877aa3236a4b449ULL, 0x09befeb9fad487c3ULL,
+   0xe69594bec44de15bULL, 0x4c2ebe687989a9b4ULL,
+   0x901d7cf73ab0acd9ULL, 0x0f9d37014bf60a11ULL,
+   0xb424dc35095cd80fULL, 0x538484c19ef38c95ULL,
+   0xe12e13424bb40e13ULL, 0x2865a5f206b06fbaULL,
+   0x8cbccc096f5088cbULL, 0xf93f87b7442e45d4ULL,
+   0xafebff0bcb24aafeULL, 0xf78f69a51539d749ULL,
+   0xdbe6fecebdedd5beULL, 0xb573440e5a884d1cULL,
+   0x89705f4136b4a597ULL, 0x31680a88f8953031ULL,
+   0xabcc77118461cefcULL, 0xfdc20d2b36ba7c3eULL,
+   0xd6bf94d5e57a42bcULL, 0x3d32907604691b4dULL,
+   0x8637bd05af6c69b5ULL, 0xa63f9a49c2c1b110ULL,
+   0xa7c5ac471b478423ULL, 0x0fcf80dc33721d54ULL,
+   0xd1b71758e219652bULL, 0xd3c36113404ea4a9ULL,
+   0x83126e978d4fdf3bULL, 0x645a1cac083126eaULL,
+   0xa3d70a3d70a3d70aULL, 0x3d70a3d70a3d70a4ULL,
+   0xccccccccccccccccULL, 0xcccccccccccccccdULL,
+   0x8000000000000000ULL, 0x0000000000000000ULL,
+   0xa000000000000000ULL, 0x0000000000000000ULL,
+   0xc800000000000000ULL, 0x0000000000000000ULL,
+   0xfa00000000000000ULL, 0x0000000000000000ULL,
+   0x9c40000000000000ULL, 0x0000000000000000ULL,
+   0xc350000000000000ULL, 0x0000000000000000ULL,
+   0xf424000000000000ULL, 0x0000000000000000ULL,
+   0x9896800000000000ULL, 0x0000000000000000ULL,
+   0xbebc200000000000ULL, 0x0000000000000000ULL,
+   0xee6b280000000000ULL, 0x0000000000000000ULL,
+   0x9502f90000000000ULL, 0x0000000000000000ULL,
+   0xba43b74000000000ULL, 0x0000000000000000ULL,
+   0xe8d4a51000000000ULL, 0x0000000000000000ULL,
+   0x9184e72a00000000ULL, 0x0000000000000000ULL,
+   0xb5e620f480000000ULL, 0x0000000000000000ULL,
+   0xe35fa931a0000000ULL, 0x0000000000000000ULL,
+   0x8e1bc9bf04000000ULL, 0x0000000000000000ULL,
+   0xb1a2bc2ec5000000ULL, 0x0000000000000000ULL,
+   0xde0b6b3a76400000ULL, 0x0000000000000000ULL,
+   0x8ac7230489e80000ULL, 0x0000000000000000ULL,
+   0xad78ebc5ac620000ULL, 0x0000000000000000ULL,
+   0xd8d726b7177a8000ULL, 0x0000000000000000ULL,
+   0x878678326eac9000ULL, 0x0000000000000000ULL,
+   0xa968163f0a57b400ULL, 0x0000000000000000ULL,
+   0xd3c21bcecceda100ULL, 0x0000000000000000ULL,
+   0x84595161401484a0ULL, 0x0000000000000000ULL,
+   0xa56fa5b99019a5c8ULL, 0x0000000000000000ULL,
+   0xcecb8f27f4200f3aULL, 0x0000000000000000ULL,
+   0x813f3978f8940984ULL, 0x4000000000000000ULL,
+   0xa18f07d736b90be5ULL, 0x5000000000000000ULL,
+   0xc9f2c9cd04674edeULL, 0xa400000000000000ULL,
+   0xfc6f7c4045812296ULL, 0x4d00000000000000ULL,
+   0x9dc5ada82b70b59dULL, 0xf020000000000000ULL,
+   0xc5371912364ce305ULL, 0x6c28000000000000ULL,
+   0xf684df56c3e01bc6ULL, 0xc732000000000000ULL,
+   0x9a130b963a6c115cULL, 0x3c7f400000000000ULL,
+   0xc097ce7bc90715b3ULL, 0x4b9f100000000000ULL,
+   0xf0bdc21abb48db20ULL, 0x1e86d40000000000ULL,
+   0x96769950b50d88f4ULL, 0x1314448000000000ULL,
+   0xbc143fa4e250eb31ULL, 0x17d955a000000000ULL,
+   0xeb194f8e1ae525fdULL, 0x5dcfab0800000000ULL,
+   0x92efd1b8d0cf37beULL, 0x5aa1cae500000000ULL,
+   0xb7abc627050305adULL, 0xf14a3d9e40000000ULL,
+   0xe596b7b0c643c719ULL, 0x6d9ccd05d0000000ULL,
+   0x8f7e32ce7bea5c6fULL, 0xe4820023a2000000ULL,
+   0xb35dbf821ae4f38bULL, 0xdda2802c8a800000ULL,
+   0xe0352f62a19e306eULL, 0xd50b2037ad200000ULL,
+   0x8c213d9da502de45ULL, 0x4526f422cc340000ULL,
+   0xaf298d050e4395d6ULL, 0x9670b12b7f410000ULL,
+   0xdaf3f04651d47b4cULL, 0x3c0cdd765f114000ULL,
+   0x88d8762bf324cd0fULL, 0xa5880a69fb6ac800ULL,
+   0xab0e93b6efee0053ULL, 0x8eea0d047a457a00ULL,
+   0xd5d238a4abe98068ULL, 0x72a4904598d6d880ULL,
+   0x85a36366eb71f041ULL, 0x47a6da2b7f864750ULL,
+   0xa70c3c40a64e6c51ULL, 0x999090b65f67d924ULL,
+   0xd0cf4b50cfe20765ULL, 0xfff4b4e3f741cf6dULL,
+   0x82818f1281ed449fULL, 0xbff8f10e7a8921a4ULL,
+   0xa321f2d7226895c7ULL, 0xaff72d52192b6a0dULL,
+   0xcbea6f8ceb02bb39ULL, 0x9bf4f8a69f764490ULL,
+   0xfee50b7025c36a08ULL, 0x02f236d04753d5b4ULL,
+   0x9f4f2726179a2245ULL, 0x01d762422c946590ULL,
+   0xc722f0ef9d80aad6ULL, 0x424d3ad2b7b97ef5ULL,
+   0xf8ebad2b84e0d58bULL, 0xd2e0898765a7deb2ULL,
+   0x9b934c3b330c8577ULL, 0x63cc55f49f88eb2fULL,
+   0xc2781f49ffcfa6d5ULL, 0x3cbf6b71c76b25fbULL,
+   0xf316271c7fc3908aULL, 0x8bef464e3945ef7aULL,
+   0x97edd871cfda3a56ULL, 0x97758bf0e3cbb5acULL,
+   0xbde94e8e43d0c8ecULL, 0x3d52eeed1cbea317ULL,
+   0xed63a231d4c4fb27ULL, 0x4ca7aaa863ee4bddULL,
+   0x945e455f24fb1cf8ULL, 0x8fe8caa93e74ef6aULL,
+   0xb975d6b6ee39e436ULL, 0xb3e2fd538e122b44ULL,
+   0xe7d34c64a9c85d44ULL, 0x60dbbca87196b616ULL,
+   0x90e40fbeea1d3a4aULL, 0xbc8955e946fe31cdULL,
+   0xb51d13aea4a488ddULL, 0x6babab6398bdbe41ULL,
+   0xe264589a4dcdab14ULL, 0xc696963c7eed2dd1ULL,
+   0x8d7eb76070a08aecULL, 0xfc1e1de5cf543ca2ULL,
+   0xb0de65388cc8ada8ULL, 0x3b25a55f43294bcbULL,
+   0xdd15fe86affad912ULL, 0x49ef0eb713f39ebeULL,
+   0x8a2dbf142dfcc7abULL, 0x6e3569326c784337ULL,
+   0xacb92ed9397bf996ULL, 0x49c2c37f07965404ULL,
+   0xd7e77a8f87daf7fbULL, 0xdc33745ec97be906ULL,
+   0x86f0ac99b4e8dafdULL, 0x69a028bb3ded71a3ULL,
+   0xa8acd7c0222311bcULL, 0xc40832ea0d68ce0cULL,
+   0xd2d80db02aabd62bULL, 0xf50a3fa490c30190ULL,
+   0x83c7088e1aab65dbULL, 0x792667c6da79e0faULL,
+   0xa4b8cab1a1563f52ULL, 0x577001b891185938ULL,
+   0xcde6fd5e09abcf26ULL, 0xed4c0226b55e6f86ULL,
+   0x80b05e5ac60b6178ULL, 0x544f8158315b05b4ULL,
+   0xa0dc75f1778e39d6ULL, 0x696361ae3db1c721ULL,
+   0xc913936dd571c84cULL, 0x03bc3a19cd1e38e9ULL,
+   0xfb5878494ace3a5fULL, 0x04ab48a04065c723ULL,
+   0x9d174b2dcec0e47bULL, 0x62eb0d64283f9c76ULL,
+   0xc45d1df942711d9aULL, 0x3ba5d0bd324f8394ULL,
+   0xf5746577930d6500ULL, 0xca8f44ec7ee36479ULL,
+   0x9968bf6abbe85f20ULL, 0x7e998b13cf4e1ecbULL,
+   0xbfc2ef456ae276e8ULL, 0x9e3fedd8c321a67eULL,
+   0xefb3ab16c59b14a2ULL, 0xc5cfe94ef3ea101eULL,
+   0x95d04aee3b80ece5ULL, 0xbba1f1d158724a12ULL,
+   0xbb445da9ca61281fULL, 0x2a8a6e45ae8edc97ULL,
+   0xea1575143cf97226ULL, 0xf52d09d71a3293bdULL,
+   0x924d692ca61be758ULL, 0x593c2626705f9c56ULL,
+   0xb6e0c377cfa2e12eULL, 0x6f8b2fb00c77836cULL,
+   0xe498f455c38b997aULL, 0x0b6dfb9c0f956447ULL,
+   0x8edf98b59a373fecULL, 0x4724bd4189bd5eacULL,
+   0xb2977ee300c50fe7ULL, 0x58edec91ec2cb657ULL,
+   0xdf3d5e9bc0f653e1ULL, 0x2f2967b66737e3edULL,
+   0x8b865b215899f46cULL, 0xbd79e0d20082ee74ULL,
+   0xae67f1e9aec07187ULL, 0xecd8590680a3aa11ULL,
+   0xda01ee641a708de9ULL, 0xe80e6f4820cc9495ULL,
+   0x884134fe908658b2ULL, 0x3109058d147fdcddULL,
+   0xaa51823e34a7eedeULL, 0xbd4b46f0599fd415ULL,
+   0xd4e5e2cdc1d1ea96ULL, 0x6c9e18ac7007c91aULL,
+   0x850fadc09923329eULL, 0x03e2cf6bc604ddb0ULL,
+   0xa6539930bf6bff45ULL, 0x84db8346b786151cULL,
+   0xcfe87f7cef46ff16ULL, 0xe612641865679a63ULL,
+   0x81f14fae158c5f6eULL, 0x4fcb7e8f3f60c07eULL,
+   0xa26da3999aef7749ULL, 0xe3be5e330f38f09dULL,
+   0xcb090c8001ab551cULL, 0x5cadf5bfd3072cc5ULL,
+   0xfdcb4fa002162a63ULL, 0x73d9732fc7c8f7f6ULL,
+   0x9e9f11c4014dda7eULL, 0x2867e7fddcdd9afaULL,
+   0xc646d63501a1511dULL, 0xb281e1fd541501b8ULL,
+   0xf7d88bc24209a565ULL, 0x1f225a7ca91a4226ULL,
+   0x9ae757596946075fULL, 0x3375788de9b06958ULL,
+   0xc1a12d2fc3978937ULL, 0x0052d6b1641c83aeULL,
+   0xf209787bb47d6b84ULL, 0xc0678c5dbd23a49aULL,
+   0x9745eb4d50ce6332ULL, 0xf840b7ba963646e0ULL,
+   0xbd176620a501fbffULL, 0xb650e5a93bc3d898ULL,
+   0xec5d3fa8ce427affULL, 0xa3e51f138ab4cebeULL,
+   0x93ba47c980e98cdfULL, 0xc66f336c36b10137ULL,
+   0xb8a8d9bbe123f017ULL, 0xb80b0047445d4184ULL,
+   0xe6d3102ad96cec1dULL, 0xa60dc059157491e5ULL,
+   0x9043ea1ac7e41392ULL, 0x87c89837ad68db2fULL,
+   0xb454e4a179dd1877ULL, 0x29babe4598c311fbULL,
+   0xe16a1dc9d8545e94ULL, 0xf4296dd6fef3d67aULL,
+   0x8ce2529e2734bb1dULL, 0x1899e4a65f58660cULL,
+   0xb01ae745b101e9e4ULL, 0x5ec05dcff72e7f8fULL,
+   0xdc21a1171d42645dULL, 0x76707543f4fa1f73ULL,
+   0x899504ae72497ebaULL, 0x6a06494a791c53a8ULL,
+   0xabfa45da0edbde69ULL, 0x0487db9d17636892ULL,
+   0xd6f8d7509292d603ULL, 0x45a9d2845d3c42b6ULL,
+   0x865b86925b9bc5c2ULL, 0x0b8a2392ba45a9b2ULL,
+   0xa7f26836f282b732ULL, 0x8e6cac7768d7141eULL,
+   0xd1ef0244af2364ffULL, 0x3207d795430cd926ULL,
+   0x8335616aed761f1fULL, 0x7f44e6bd49e807b8ULL,
+   0xa402b9c5a8d3a6e7ULL, 0x5f16206c9c6209a6ULL,
+   0xcd036837130890a1ULL, 0x36dba887c37a8c0fULL,
+   0x802221226be55a64ULL, 0xc2494954da2c9789ULL,
+   0xa02aa96b06deb0fdULL, 0xf2db9baa10b7bd6cULL,
+   0xc83553c5c8965d3dULL, 0x6f92829494e5acc7ULL,
+   0xfa42a8b73abbf48cULL, 0xcb772339ba1f17f9ULL,
+   0x9c69a97284b578d7ULL, 0xff2a760414536efbULL,
+   0xc38413cf25e2d70dULL, 0xfef5138519684abaULL,
+   0xf46518c2ef5b8cd1ULL, 0x7eb258665fc25d69ULL,
+   0x98bf2f79d5993802ULL, 0xef2f773ffbd97a61ULL,
+   0xbeeefb584aff8603ULL, 0xaafb550ffacfd8faULL,
+   0xeeaaba2e5dbf6784ULL, 0x95ba2a53f983cf38ULL,
+   0x952ab45cfa97a0b2ULL, 0xdd945a747bf26183ULL,
+   0xba756174393d88dfULL, 0x94f971119aeef9e4ULL,
+   0xe912b9d1478ceb17ULL, 0x7a37cd5601aab85dULL,
+   0x91abb422ccb812eeULL, 0xac62e055c10ab33aULL,
+   0xb616a12b7fe617aaULL, 0x577b986b314d6009ULL,
+   0xe39c49765fdf9d94ULL, 0xed5a7e85fda0b80bULL,
+   0x8e41ade9fbebc27dULL, 0x14588f13be847307ULL,
+   0xb1d219647ae6b31cULL, 0x596eb2d8ae258fc8ULL,
+   0xde469fbd99a05fe3ULL, 0x6fca5f8ed9aef3bbULL,
+   0x8aec23d680043beeULL, 0x25de7bb9480d5854ULL,
+   0xada72ccc20054ae9ULL, 0xaf561aa79a10ae6aULL,
+   0xd910f7ff28069da4ULL, 0x1b2ba1518094da04ULL,
+   0x87aa9aff79042286ULL, 0x90fb44d2f05d0842ULL,
+   0xa99541bf57452b28ULL, 0x353a1607ac744a53ULL,
+   0xd3fa922f2d1675f2ULL, 0x42889b8997915ce8ULL,
+   0x847c9b5d7c2e09b7ULL, 0x69956135febada11ULL,
+   0xa59bc234db398c25ULL, 0x43fab9837e699095ULL,
+   0xcf02b2c21207ef2eULL, 0x94f967e45e03f4bbULL,
+   0x8161afb94b44f57dULL, 0x1d1be0eebac278f5ULL,
+   0xa1ba1ba79e1632dcULL, 0x6462d92a69731732ULL,
+   0xca28a291859bbf93ULL, 0x7d7b8f7503cfdcfeULL,
+   0xfcb2cb35e702af78ULL, 0x5cda735244c3d43eULL,
+   0x9defbf01b061adabULL, 0x3a0888136afa64a7ULL,
+   0xc56baec21c7a1916ULL, 0x088aaa1845b8fdd0ULL,
+   0xf6c69a72a3989f5bULL, 0x8aad549e57273d45ULL,
+   0x9a3c2087a63f6399ULL, 0x36ac54e2f678864bULL,
+   0xc0cb28a98fcf3c7fULL, 0x84576a1bb416a7ddULL,
+   0xf0fdf2d3f3c30b9fULL, 0x656d44a2a11c51d5ULL,
+   0x969eb7c47859e743ULL, 0x9f644ae5a4b1b325ULL,
+   0xbc4665b596706114ULL, 0x873d5d9f0dde1feeULL,
+   0xeb57ff22fc0c7959ULL, 0xa90cb506d155a7eaULL,
+   0x9316ff75dd87cbd8ULL, 0x09a7f12442d588f2ULL,
+   0xb7dcbf5354e9beceULL, 0x0c11ed6d538aeb2fULL,
+   0xe5d3ef282a242e81ULL, 0x8f1668c8a86da5faULL,
+   0x8fa475791a569d10ULL, 0xf96e017d694487bcULL,
+   0xb38d92d760ec4455ULL, 0x37c981dcc395a9acULL,
+   0xe070f78d3927556aULL, 0x85bbe253f47b1417ULL,
+   0x8c469ab843b89562ULL, 0x93956d7478ccec8eULL,
+   0xaf58416654a6babbULL, 0x387ac8d1970027b2ULL,
+   0xdb2e51bfe9d0696aULL, 0x06997b05fcc0319eULL,
+   0x88fcf317f22241e2ULL, 0x441fece3bdf81f03ULL,
+   0xab3c2fddeeaad25aULL, 0xd527e81cad7626c3ULL,
+   0xd60b3bd56a5586f1ULL, 0x8a71e223d8d3b074ULL,
+   0x85c7056562757456ULL, 0xf6872d5667844e49ULL,
+   0xa738c6bebb12d16cULL, 0xb428f8ac016561dbULL,
+   0xd106f86e69d785c7ULL, 0xe13336d701beba52ULL,
+   0x82a45b450226b39cULL, 0xecc0024661173473ULL,
+   0xa34d721642b06084ULL, 0x27f002d7f95d0190ULL,
+   0xcc20ce9bd35c78a5ULL, 0x31ec038df7b441f4ULL,
+   0xff290242c83396ceULL, 0x7e67047175a15271ULL,
+   0x9f79a169bd203e41ULL, 0x0f0062c6e984d386ULL,
+   0xc75809c42c684dd1ULL, 0x52c07b78a3e60868ULL,
+   0xf92e0c3537826145ULL, 0xa7709a56ccdf8a82ULL,
+   0x9bbcc7a142b17ccbULL, 0x88a66076400bb691ULL,
+   0xc2abf989935ddbfeULL, 0x6acff893d00ea435ULL,
+   0xf356f7ebf83552feULL, 0x0583f6b8c4124d43ULL,
+   0x98165af37b2153deULL, 0xc3727a337a8b704aULL,
+   0xbe1bf1b059e9a8d6ULL, 0x744f18c0592e4c5cULL,
+   0xeda2ee1c7064130cULL, 0x1162def06f79df73ULL,
+   0x9485d4d1c63e8be7ULL, 0x8addcb5645ac2ba8ULL,
+   0xb9a74a0637ce2ee1ULL, 0x6d953e2bd7173692ULL,
+   0xe8111c87c5c1ba99ULL, 0xc8fa8db6ccdd0437ULL,
+   0x910ab1d4db9914a0ULL, 0x1d9c9892400a22a2ULL,
+   0xb54d5e4a127f59c8ULL, 0x2503beb6d00cab4bULL,
+   0xe2a0b5dc971f303aULL, 0x2e44ae64840fd61dULL,
+   0x8da471a9de737e24ULL, 0x5ceaecfed289e5d2ULL,
+   0xb10d8e1456105dadULL, 0x7425a83e872c5f47ULL,
+   0xdd50f1996b947518ULL, 0xd12f124e28f77719ULL,
+   0x8a5296ffe33cc92fULL, 0x82bd6b70d99aaa6fULL,
+   0xace73cbfdc0bfb7bULL, 0x636cc64d1001550bULL,
+   0xd8210befd30efa5aULL, 0x3c47f7e05401aa4eULL,
+   0x8714a775e3e95c78ULL, 0x65acfaec34810a71ULL,
+   0xa8d9d1535ce3b396ULL, 0x7f1839a741a14d0dULL,
+   0xd31045a8341ca07cULL, 0x1ede48111209a050ULL,
+   0x83ea2b892091e44dULL, 0x934aed0aab460432ULL,
+   0xa4e4b66b68b65d60ULL, 0xf81da84d5617853fULL,
+   0xce1de40642e3f4b9ULL, 0x36251260ab9d668eULL,
+   0x80d2ae83e9ce78f3ULL, 0xc1d72b7c6b426019ULL,
+   0xa1075a24e4421730ULL, 0xb24cf65b8612f81fULL,
+   0xc94930ae1d529cfcULL, 0xdee033f26797b627ULL,
+   0xfb9b7cd9a4a7443cULL, 0x169840ef017da3b1ULL,
+   0x9d412e0806e88aa5ULL, 0x8e1f289560ee864eULL,
+   0xc491798a08a2ad4eULL, 0xf1a6f2bab92a27e2ULL,
+   0xf5b5d7ec8acb58a2ULL, 0xae10af696774b1dbULL,
+   0x9991a6f3d6bf1765ULL, 0xacca6da1e0a8ef29ULL,
+   0xbff610b0cc6edd3fULL, 0x17fd090a58d32af3ULL,
+   0xeff394dcff8a948eULL, 0xddfc4b4cef07f5b0ULL,
+   0x95f83d0a1fb69cd9ULL, 0x4abdaf101564f98eULL,
+   0xbb764c4ca7a4440fULL, 0x9d6d1ad41abe37f1ULL,
+   0xea53df5fd18d5513ULL, 0x84c86189216dc5edULL,
+   0x92746b9be2f8552cULL, 0x32fd3cf5b4e49bb4ULL,
+   0xb7118682dbb66a77ULL, 0x3fbc8c33221dc2a1ULL,
+   0xe4d5e82392a40515ULL, 0x0fabaf3feaa5334aULL,
+   0x8f05b1163ba6832dULL, 0x29cb4d87f2a7400eULL,
+   0xb2c71d5bca9023f8ULL, 0x743e20e9ef511012ULL,
+   0xdf78e4b2bd342cf6ULL, 0x914da9246b255416ULL,
+   0x8bab8eefb6409c1aULL, 0x1ad089b6c2f7548eULL,
+   0xae9672aba3d0c320ULL, 0xa184ac2473b529b1ULL,
+   0xda3c0f568cc4f3e8ULL, 0xc9e5d72d90a2741eULL,
+   0x8865899617fb1871ULL, 0x7e2fa67c7a658892ULL,
+   0xaa7eebfb9df9de8dULL, 0xddbb901b98feeab7ULL,
+   0xd51ea6fa85785631ULL, 0x552a74227f3ea565ULL,
+   0x8533285c936b35deULL, 0xd53a88958f87275fULL,
+   0xa67ff273b8460356ULL, 0x8a892abaf368f137ULL,
+   0xd01fef10a657842cULL, 0x2d2b7569b0432d85ULL,
+   0x8213f56a67f6b29bULL, 0x9c3b29620e29fc73ULL,
+   0xa298f2c501f45f42ULL, 0x8349f3ba91b47b8fULL,
+   0xcb3f2f7642717713ULL, 0x241c70a936219a73ULL,
+   0xfe0efb53d30dd4d7ULL, 0xed238cd383aa0110ULL,
+   0x9ec95d1463e8a506ULL, 0xf4363804324a40aaULL,
+   0xc67bb4597ce2ce48ULL, 0xb143c6053edcd0d5ULL,
+   0xf81aa16fdc1b81daULL, 0xdd94b7868e94050aULL,
+   0x9b10a4e5e9913128ULL, 0xca7cf2b4191c8326ULL,
+   0xc1d4ce1f63f57d72ULL, 0xfd1c2f611f63a3f0ULL,
+   0xf24a01a73cf2dccfULL, 0xbc633b39673c8cecULL,
+   0x976e41088617ca01ULL, 0xd5be0503e085d813ULL,
+   0xbd49d14aa79dbc82ULL, 0x4b2d8644d8a74e18ULL,
+   0xec9c459d51852ba2ULL, 0xddf8e7d60ed1219eULL,
+   0x93e1ab8252f33b45ULL, 0xcabb90e5c942b503ULL,
+   0xb8da1662e7b00a17ULL, 0x3d6a751f3b936243ULL,
+   0xe7109bfba19c0c9dULL, 0x0cc512670a783ad4ULL,
+   0x906a617d450187e2ULL, 0x27fb2b80668b24c5ULL,
+   0xb484f9dc9641e9daULL, 0xb1f9f660802dedf6ULL,
+   0xe1a63853bbd26451ULL, 0x5e7873f8a0396973ULL,
+   0x8d07e33455637eb2ULL, 0xdb0b487b6423e1e8ULL,
+   0xb049dc016abc5e5fULL, 0x91ce1a9a3d2cda62ULL,
+   0xdc5c5301c56b75f7ULL, 0x7641a140cc7810fbULL,
+   0x89b9b3e11b6329baULL, 0xa9e904c87fcb0a9dULL,
+   0xac2820d9623bf429ULL, 0x546345fa9fbdcd44ULL,
+   0xd732290fbacaf133ULL, 0xa97c177947ad4095ULL,
+   0x867f59a9d4bed6c0ULL, 0x49ed8eabcccc485dULL,
+   0xa81f301449ee8c70ULL, 0x5c68f256bfff5a74ULL,
+   0xd226fc195c6a2f8cULL, 0x73832eec6fff3111ULL,
+   0x83585d8fd9c25db7ULL, 0xc831fd53c5ff7eabULL,
+   0xa42e74f3d032f525ULL, 0xba3e7ca8b77f5e55ULL,
+   0xcd3a1230c43fb26fULL, 0x28ce1bd2e55f35ebULL,
+   0x80444b5e7aa7cf85ULL, 0x7980d163cf5b81b3ULL,
+   0xa0555e361951c366ULL, 0xd7e105bcc332621fULL,
+   0xc86ab5c39fa63440ULL, 0x8dd9472bf3fefaa7ULL,
+   0xfa856334878fc150ULL, 0xb14f98f6f0feb951ULL,
+   0x9c935e00d4b9d8d2ULL, 0x6ed1bf9a569f33d3ULL,
+   0xc3b8358109e84f07ULL, 0x0a862f80ec4700c8ULL,
+   0xf4a642e14c6262c8ULL, 0xcd27bb612758c0faULL,
+   0x98e7e9cccfbd7dbdULL, 0x8038d51cb897789cULL,
+   0xbf21e44003acdd2cULL, 0xe0470a63e6bd56c3ULL,
+   0xeeea5d5004981478ULL, 0x1858ccfce06cac74ULL,
+   0x95527a5202df0ccbULL, 0x0f37801e0c43ebc8ULL,
+   0xbaa718e68396cffdULL, 0xd30560258f54e6baULL,
+   0xe950df20247c83fdULL, 0x47c6b82ef32a2069ULL,
+   0x91d28b7416cdd27eULL, 0x4cdc331d57fa5441ULL,
+   0xb6472e511c81471dULL, 0xe0133fe4adf8e952ULL,
+   0xe3d8f9e563a198e5ULL, 0x58180fddd97723a6ULL,
+   0x8e679c2f5e44ff8fULL, 0x570f09eaa7ea7648ULL
+};
+
+static const double exact_power_of_ten [] =
+{
+   1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+   1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static uint64_t mul_128 (uint64_t a, uint64_t b, uint64_t * high)
+{
+   #ifdef __SIZEOF_INT128__
+
+      __extension__ typedef unsigned __int128 uint128;
+
+      uint128 r = (uint128) a * b;
+
+      *high = (uint64_t) (r >> 64);
+      return (uint64_t) r;
+
+   #else
+
+      uint64_t a_lo = (uint32_t) a, a_hi = a >> 32, b_lo = (uint32_t) b, b_hi = b >> 32,
+               lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo, lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi,
+               cross = (lo_lo >> 32) + (uint32_t) hi_lo + lo_hi;
+
+      *high = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+      return (cross << 32) | (uint32_t) lo_lo;
+
+   #endif
+}
+
+static int leading_zeros (uint64_t x)
+{
+   #ifdef __GNUC__
+
+      return __builtin_clzll (x);
+
+   #else
+
+      int n = 0;
+
+      for (; ! (x & 0x8000000000000000ULL); x <<= 1)
+         ++ n;
+
+      return n;
+
+   #endif
+}
+
+#define double_infinity  0x7FF0000000000000ULL
+
+/* w * 10^q (w non-zero) as the bits of a double, or 0 if it can't be
+ * settled this way
+ */
+static int eisel_lemire (uint64_t w, int64_t q, uint64_t * bits)
+{
+   uint64_t low, high, high2, mantissa;
+   int lz, upper, shift;
+   int64_t power2;
+
+   if (q < -342)
+   {  *bits = 0;
+      return 1;
+   }
+
+   if (q > 308)
+   {  *bits = double_infinity;
+      return 1;
+   }
+
+   lz = leading_zeros (w);
+   w <<= lz;
+
+   low = mul_128 (w, power_of_five [2 * (q + 342)], &high);
+
+   if ((high & 0x1FF) == 0x1FF)
+   {
+      /* not enough bits to be sure of the rounding: bring in the low half
+       * of the power too
+       */
+
+      mul_128 (w, power_of_five [2 * (q + 342) + 1], &high2);
+
+      low += high2;
+
+      if (low < high2)
+         ++ high;
+   }
+
+   if (low == 0xFFFFFFFFFFFFFFFFULL && (q < -27 || q > 55))
+      return 0;
+
+   upper = (int) (high >> 63);
+   shift = upper + 64 - 52 - 3;
+
+   mantissa = high >> shift;
+   power2 = (((217706 * q) >> 16) + 63) + upper - lz + 1023;
+
+   if (power2 <= 0)
+   {
+      /* subnormal */
+
+      if (-power2 + 1 >= 64)
+      {  *bits = 0;
+         return 1;
+      }
+
+      mantissa >>= -power2 + 1;
+      mantissa += mantissa & 1;
+      mantissa >>= 1;
+
+      *bits = mantissa;  /* carries into the exponent if it rounded up */
+      return 1;
+   }
+
+   /* exactly halfway: round to even */
+
+   if (low <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1
+         && (mantissa << shift) == high)
+   {
+      mantissa &= ~ (uint64_t) 1;
+   }
+
+   mantissa += mantissa & 1;
+   mantissa >>= 1;
+
+   if (mantissa >= (2ULL << 52))
+   {
+      mantissa = 1ULL << 52;
+      ++ power2;
+   }
+
+   if (power2 >= 0x7FF)
+   {  *bits = double_infinity;
+      return 1;
+   }
+
+   *bits = (mantissa & ~ (1ULL << 52)) | ((uint64_t) power2 << 52);
+   return 1;
+}
+
+/* Arbitrary precision fallback, for more than 19 significant digits and the
+ * rare cases where the 128-bit product isn't enough.  The value is taken as
+ * the ratio of two big integers, which is divided out to 53 bits and
+ * rounded on the remainder.  768 significant digits are always enough to
+ * tell which side of halfway a number falls, so any beyond that are only
+ * remembered as being there.
+ */
+#define bignum_words     128
+#define max_digits       768
+
+typedef struct
+{
+   uint32_t word [bignum_words];  /* least significant first */
+   int length;
+
+} json_bignum;
+
+static void big_mul_add (json_bignum * b, uint32_t m, uint32_t a)
+{
+   uint64_t carry = a;
+   int i;
+
+   for (i = 0; i < b->length; ++ i)
+   {
+      carry += (uint64_t) b->word [i] * m;
+      b->word [i] = (uint32_t) carry;
+      carry >>= 32;
+   }
+
+   if (carry)
+      b->word [b->length ++] = (uint32_t) carry;
+}
+
+static void big_mul_pow5 (json_bignum * b, int64_t e)
+{
+   for (; e >= 13; e -= 13)
+      big_mul_add (b, 1220703125, 0);  /* 5^13 */
+
+   for (; e > 0; -- e)
+      big_mul_add (b, 5, 0);
+}
+
+static void big_shl (json_bignum * b, int64_t n)
+{
+   int words = (int) (n / 32), bits = (int) (n % 32), i;
+
+   if (!b->length || !n)
+      return;
+
+   b->word [b->length] = 0;
+
+   for (i = b->length; i >= 0; -- i)
+   {
+      b->word [i + words] = (b->word [i] << bits)
+         | (bits && i ? b->word [i - 1] >> (32 - bits) : 0);
+   }
+
+   for (i = 0; i < words; ++ i)
+      b->word [i] = 0;
+
+   b->length += words + 1;
+
+   while (b->length && !b->word [b->length - 1])
+      -- b->length;
+}
+
+static void big_shr1 (json_bignum * b)
+{
+   int i;
+
+   for (i = 0; i < b->length; ++ i)
+   {
+      b->word [i] = (b->word [i] >> 1)
+         | (i + 1 < b->length ? b->word [i + 1] << 31 : 0);
+   }
+
+   if (b->length && !b->word [b->length - 1])
+      -- b->length;
+}
+
+static int big_cmp (const json_bignum * a, const json_bignum * b)
+{
+   int i;
+
+   if (a->length != b->length)
+      return a->length < b->length ? -1 : 1;
+
+   for (i = a->length - 1; i >= 0; -- i)
+      if (a->word [i] != b->word [i])
+         return a->word [i] < b->word [i] ? -1 : 1;
+
+   return 0;
+}
+
+static void big_sub (json_bignum * a, const json_bignum * b)  /* a >= b */
+{
+   int64_t borrow = 0;
+   int i;
+
+   for (i = 0; i < a->length; ++ i)
+   {
+      borrow += (int64_t) a->word [i] - (i < b->length ? b->word [i] : 0);
+      a->word [i] = (uint32_t) borrow;
+      borrow = borrow < 0 ? -1 : 0;
+   }
+
+   while (a->length && !a->word [a->length - 1])
+      -- a->length;
+}
+
+static int64_t big_bits (const json_bignum * b)
+{
+   return b->length ? (int64_t) b->length * 32 - (leading_zeros (b->word [b->length - 1]) - 32) : 0;
+}
+
+/* The number whose significand starts at `p` (the integral and fractional
+ * digits, already checked, ending before `end`) and which has explicit
+ * exponent `exponent`
+ */
+static uint64_t big_decimal (const json_char * p, const json_char * end, int64_t exponent)
+{
+   json_bignum num, den, rem;
+   int digits = 0, truncated = 0, fraction = 0, chunk_digits = 0, c;
+   uint32_t chunk = 0;
+   int64_t e = exponent, k, s;
+   uint64_t q = 0, bit;
+
+   num.length = 0;
+
+   for (; p < end; ++ p)
+   {
+      if (*p == '.')
+      {  fraction = 1;
+         continue;
+      }
+
+      if (!isdigit ((unsigned char) *p))
+         break;
+
+      if (digits == max_digits)
+      {
+         /* only its position matters now */
+
+         truncated |= *p != '0';
+
+         if (!fraction)
+            ++ e;
+
+         continue;
+      }
+
+      if (fraction)
+         -- e;
+
+      if (!digits && *p == '0')
+         continue;
+
+      chunk = chunk * 10 + (*p - '0');
+      ++ digits;
+
+      if (++ chunk_digits == 9)
+      {
+         big_mul_add (&num, 1000000000, chunk);
+         chunk = chunk_digits = 0;
+      }
+   }
+
+   for (c = 0, k = 1; c < chunk_digits; ++ c)
+      k *= 10;
+
+   big_mul_add (&num, (uint32_t) k, chunk);
+
+   if (!num.length)
+      return 0;
+
+   /* digits * 10^e, with all the digits before the point */
+
+   if (digits - 1 + e >= 309)
+      return double_infinity;
+
+   if (digits + e <= -325)
+      return 0;
+
+   den.length = 1;
+   den.word [0] = 1;
+
+   if (e >= 0)
+      big_mul_pow5 (&num, e);
+   else
+      big_mul_pow5 (&den, -e);
+
+   /* num / den * 2^e, to be brought to num / den * 2^k with the quotient
+    * 53 or 54 bits long (or fewer, if it's subnormal)
+    */
+
+   s = big_bits (&num) - big_bits (&den) - 53;
+   k = s + e;
+
+   if (k < -1074)
+   {
+      s += -1074 - k;
+      k = -1074;
+   }
+
+   if (s > 0)
+      big_shl (&den, s);
+   else
+      big_shl (&num, -s);
+
+   rem = den;
+   big_shl (&rem, 54);
+
+   for (bit = 1ULL << 54; bit; bit >>= 1)
+   {
+      if (big_cmp (&num, &rem) >= 0)
+      {
+         big_sub (&num, &rem);
+         q |= bit;
+      }
+
+      big_shr1 (&rem);
+   }
+
+   /* num is now the remainder */
+
+   if (q >> 53)
+   {
+      int half = (int) (q & 1);
+
+      q >>= 1;
+      ++ k;
+
+      if (half && (num.length || truncated || (q & 1)))
+         ++ q;
+   }
+   else
+   {
+      big_shl (&num, 1);
+      c = big_cmp (&num, &den);
+
+      if (c > 0 || (c == 0 && (truncated || (q & 1))))
+         ++ q;
+   }
+
+   if (q >> 53)
+   {
+      q >>= 1;
+      ++ k;
+   }
+
+   if (q < (1ULL << 52))
+      return q;  /* subnormal */
+
+   if (k + 1075 >= 0x7FF)
+      return double_infinity;
+
+   return (q & ~ (1ULL << 52)) | ((uint64_t) (k + 1075) << 52);
+}
+
+/* Decode the number starting at `*i` and leave `*i` just past it.  Returns
+ * 0 on success, 1 if it isn't a number and 2 if it's out of range.
+ */
+static int parse_number (json_value * value, const json_char ** i, const json_char * end)
+{
+   const json_char * p = *i, * significand;
+   uint64_t w = 0, bits;
+   int64_t exp10 = 0, exponent = 0;
+   int negative = 0, digits = 0, truncated = 0, is_double = 0, any = 0;
+
+   if (p < end && *p == '-')
+   {  negative = 1;
+      ++ p;
+   }
+
+   significand = p;
+
+   for (; p < end && isdigit ((unsigned char) *p); ++ p, any = 1)
+   {
+      if (!digits && *p == '0')
+         continue;
+
+      if (digits < 19)
+      {  w = w * 10 + (*p - '0');
+         ++ digits;
+      }
+      else
+      {  truncated = 1;
+         ++ exp10;
+      }
+   }
+
+   if (p < end && *p == '.')
+   {
+      is_double = 1;
+
+      for (++ p; p < end && isdigit ((unsigned char) *p); ++ p, any = 1)
+      {
+         if (!digits && *p == '0')
+         {  -- exp10;
+            continue;
+         }
+
+         if (digits < 19)
+         {  w = w * 10 + (*p - '0');
+            ++ digits;
+            -- exp10;
+         }
+         else
+            truncated = 1;
+      }
+   }
+
+   if (!any)
+      return 1;
+
+   if (p < end && (*p == 'e' || *p == 'E'))
+   {
+      int exponent_negative = 0;
+
+      is_double = 1;
+
+      if (++ p < end && (*p == '+' || *p == '-'))
+         exponent_negative = *p ++ == '-';
+
+      if (p == end || !isdigit ((unsigned char) *p))
+         return 1;
+
+      for (; p < end && isdigit ((unsigned char) *p); ++ p)
+         if (exponent < 1000000)
+            exponent = exponent * 10 + (*p - '0');
+
+      if (exponent_negative)
+         exponent = -exponent;
+   }
+
+   /* anything else that could be part of a number makes it malformed */
+
+   if (p < end && (isdigit ((unsigned char) *p) || *p == '.' || *p == 'e'
+         || *p == 'E' || *p == '+' || *p == '-'))
+   {
+      return 1;
+   }
+
+   *i = p;
+
+   if (!is_double)
+   {
+      if (truncated || w > (uint64_t) INT64_MAX + negative)
+         return 2;
+
+      value->type = json_integer;
+      value->u.integer = negative ? (json_int_t) (0 - w) : (json_int_t) w;
+
+      return 0;
+   }
+
+   value->type = json_double;
+   exp10 += exponent;
+
+   #if defined FLT_EVAL_METHOD && FLT_EVAL_METHOD == 0
+
+      if (!truncated && w <= (1ULL << 53) && exp10 >= -22 && exp10 <= 22)
+      {
+         value->u.dbl = exp10 < 0 ? (double) w / exact_power_of_ten [-exp10]
+                                  : (double) w * exact_power_of_ten [exp10];
+
+         if (negative)
+            value->u.dbl = -value->u.dbl;
+
+         return 0;
+      }
+
+   #endif
+
+   if (!w)
+      bits = 0;
+   else if (truncated || !eisel_lemire (w, exp10, &bits))
+      bits = big_decimal (significand, end, exponent);
+
+   if (bits == double_infinity)
+      return 2;
+
+   if (negative)
+      bits |= 0x8000000000000000ULL;
+
+   memcpy (&value->u.dbl, &bits, sizeof (double));
+
+   return 0;
+}
+
+#define e_off \
+   ((int) (i - cur_line_begin) + (cur_line == carried_line ? carried_column : 0))
+
+#define whitespace \
+   case '\n': case ' ': case '\t': case '\r'
+
+#define string_add(b)  \
+   do { if (!state.first_pass) string [string_length] = b;  ++ string_length; } while (0);
+
+static const int
+   flag_next = 1, flag_reproc = 2, flag_need_comma = 4, flag_seek_value = 8,
+   flag_escaped = 64, flag_string = 128, flag_need_colon = 256,
+   flag_done = 512;
+
+/* Everything a parse keeps between one stretch of input and the next */
+typedef struct
+{
+   json_state state;
+
+   json_document * doc;
+   json_arena mark;  /* where the document's arena was before the parse */
+
+   int flags;
+   json_value * top, * root, * alloc;
+
+   unsigned int cur_line;
+   size_t line_begin;  /* offset in the input of the current line */
+   size_t offset;      /* of the stretch being parsed */
+
+   json_char error [128];
+
+} json_parse_state;
+
+static void parse_init (json_parse_state * p, json_settings * settings, json_document * doc,
+                        json_char * in_situ)
+{
+   json_state * state = &p->state;
+
+   memset (p, 0, sizeof (json_parse_state));
+   settings_init (&state->settings, settings);
+
+   /* keys are only interned in a single pass */
+
+   state->single_pass = (state->settings.settings & json_single_pass) != 0
+                           || state->settings.intern;
+
+   if (doc)
+   {
+      /* there's nothing for a first pass to size in an arena */
+
+      state->single_pass = 1;
+      state->arena = &doc->arena;
+      state->used_memory = doc->used_memory;
+      state->children = doc->children;
+      state->names = doc->names;
+      state->positions = doc->positions;
+      state->in_situ = in_situ;
+
+      p->doc = doc;
+      p->mark = doc->arena;
+   }
+
+   memset (&state->uint_max, 0xFF, sizeof (state->uint_max));
+   memset (&state->ulong_max, 0xFF, sizeof (state->ulong_max));
+
+   state->uint_max -= 8; /* limit of how much can be added before next check */
+   state->ulong_max -= 8;
+
+   state->first_pass = !state->single_pass;
+}
+
+/* Start a pass over the input from the top */
+static void parse_start (json_parse_state * p)
+{
+   p->top = p->root = 0;
+   p->flags = flag_seek_value;
+
+   p->cur_line = 1;
+   p->line_begin = p->offset = 0;
+}
+
+/* Whether the string, number or literal starting at json [0] is over before
+ * `end` (anything else is over straight away).  Numbers are only over once
+ * something that can't be in a number follows them.
+ */
+static int token_complete (const json_char * json, const json_char * end)
+{
+   switch (*json)
+   {
+      case '"':
+
+         return json + 1 + string_span (json + 1, end) < end;
+
+      case 't': case 'n':
+
+         return end - json >= 4;
+
+      case 'f':
+
+         return end - json >= 5;
+
+      default:
+
+         if (!isdigit ((int) *json) && *json != '-')
+            return 1;
+
+         while (++ json < end && (isdigit ((int) *json) || *json == '.' || *json == 'e'
+                                     || *json == 'E' || *json == '+' || *json == '-'))
+         {
+         }
+
+         return json < end;
+   };
+}
+
+/* Runs the parse over json [0, length), the stretch of the input following
+ * the last one.  Returns -1 on failure, with the message in p->error, and 1
+ * when the input is done with: at its end, or, with `stop_at_root`, just
+ * past the root value.
+ *
+ * With `partial`, more input is to follow, so rather than taking the end
+ * for the end of the input the parse returns 0 there, or at the start of a
+ * string, number or literal which isn't over before it.  That one is left
+ * to parse again along with what follows.
+ *
+ * *stop is left at the offset the parse got to.
+ */
+static int parse_run (json_parse_state * p, const json_char * json, size_t length,
+                      int partial, int stop_at_root, size_t * stop)
+{
+   json_char * error = p->error;
+   const json_char * i, * end = json + length, * cur_line_begin = json;
+   unsigned int cur_line = p->cur_line, carried_line = p->cur_line;
+   int carried_column = (int) (p->offset - p->line_begin);
+   json_value * top = p->top, * root = p->root, * alloc = p->alloc;
+   json_state state = p->state;
+   int flags = p->flags, result = 1;
+
+   json_uchar uchar;
+   unsigned char uc_b1, uc_b2, uc_b3, uc_b4;
+   json_char * string = 0;
+   unsigned int string_length = 0;
+   size_t string_reserved = 0;
+
+   for (i = json ;; ++ i)
+   {
+      json_char b = (i == end ? 0 : *i);
+
+      if (i == end && partial)
+         goto suspend;
+
+      if (flags & flag_done)
+      {
+         if (i == end)
+            break;
+
+         switch (b)
+         {
+            whitespace:
+               i = skip_whitespace (i, end, &cur_line, &cur_line_begin) - 1;
+               continue;
+
+            default:
+               sprintf (error, "%d:%d: Trailing garbage: `%c`", cur_line, e_off, b);
+               goto e_failed;
+         };
+      }
+
+      if (flags & flag_string)
+      {
+         if (i == end)
+         {  sprintf (error, "Unexpected EOF in string (at %d:%d)", cur_line, e_off);
+            goto e_failed;
+         }
+
+         if (string_length > state.uint_max)
+            goto e_toolong;
+
+         if (flags & flag_escaped)
+         {
+            flags &= ~ flag_escaped;
+
+            switch (b)
+            {
+               case 'b':  string_add ('\b');  break;
+               case 'f':  string_add ('\f');  break;
+               case 'n':  string_add ('\n');  break;
+               case 'r':  string_add ('\r');  break;
+               case 't':  string_add ('\t');  break;
+               case 'u':
+
+                 /* each digit is checked against the end, so that a failure is
+                  * reported at the same digit however much input follows
+                  */
+
+                 if (end - i < 2 || (uc_b1 = hex_value (*++ i)) == 0xFF
+                       || end - i < 2 || (uc_b2 = hex_value (*++ i)) == 0xFF
+                       || end - i < 2 || (uc_b3 = hex_value (*++ i)) == 0xFF
+                       || end - i < 2 || (uc_b4 = hex_value (*++ i)) == 0xFF)
+                 {
+                     sprintf (error, "Invalid character value `%c` (at %d:%d)", b, cur_line, e_off);
+                     goto e_failed;
+                 }
+
+                 uc_b1 = uc_b1 * 16 + uc_b2;
+                 uc_b2 = uc_b3 * 16 + uc_b4;
+
+                 uchar = ((json_char) uc_b1) * 256 + uc_b2;
+
+                 if (sizeof (json_char) >= sizeof (json_uchar) || (uc_b1 == 0 && uc_b2 <= 0x7F))
+                 {
+                    string_add ((json_char) uchar);
+                    break;
+                 }
+
+                 if (uchar <= 0x7FF)
+                 {
+                     if (state.first_pass)
+                        string_length += 2;
+                     else
+                     {  string [string_length ++] = 0xC0 | ((uc_b2 & 0xC0) >> 6) | ((uc_b1 & 0x3) << 3);
+                        string [string_length ++] = 0x80 | (uc_b2 & 0x3F);
+                     }
+
+                     break;
+                 }
+
+                 if (state.first_pass)
+                    string_length += 3;
+                 else
+                 {  string [string_length ++] = 0xE0 | ((uc_b1 & 0xF0) >> 4);
+                    string [string_length ++] = 0x80 | ((uc_b1 & 0xF) << 2) | ((uc_b2 & 0xC0) >> 6);
+                    string [string_length ++] = 0x80 | (uc_b2 & 0x3F);
+                 }
+
+                 break;
+
+               default:
+                  string_add (b);
+            };
+
+            continue;
+         }
+
+         if (b == '\\')
+         {
+            flags |= flag_escaped;
+            continue;
+         }
+
+         if (b == '"')
+         {
+            if (!state.first_pass)
+               string [string_length] = 0;
+
+            flags &= ~ flag_string;
+            string = 0;
+
+            switch (top->type)
+            {
+               case json_string:
+
+                  top->u.string.length = string_length;
+                  flags |= flag_next;
+
+                  if (state.arena && !state.in_situ)
+                  {
+                     /* give back what the escapes saved */
+
+                     arena_shrink (state.arena, top->u.string.ptr,
+                                   (string_length + 1) * sizeof (json_char));
+
+                     if (state.settings.max_memory)
+                        state.used_memory -= string_reserved - (string_length + 1) * sizeof (json_char);
+                  }
+
+                  break;
+
+               case json_object:
+
+                  if (state.first_pass)
+                     (*(json_char **) &top->u.object.values) += string_length + 1;
+                  else if (state.handler)
+                  {
+                     state.names.length -= string_reserved;
+
+                     if (state.handler->key
+                           && !state.handler->key ((json_char *) (state.names.mem + state.names.length),
+                                                   string_length, state.handler_data))
+                     {
+                        goto e_stopped;
+                     }
+                  }
+                  else if (state.single_pass)
+                  {
+                     json_entry * entry = stack_top (state.children, json_entry);
+
+                     if (state.settings.intern
+                           && (entry->key = intern_key (state.settings.intern,
+                                    state.in_situ ? state.in_situ + entry->name
+                                                  : (json_char *) (state.names.mem + entry->name),
+                                    string_length)) )
+                     {
+                        if (!state.in_situ)
+                           state.names.length = entry->name;  /* no need to keep it */
+                     }
+                     else if (!state.in_situ)
+                     {
+                        state.names.length = entry->name
+                                                + (string_length + 1) * sizeof (json_char);
+                     }
+                  }
+                  else
+                  {  
+                     top->u.object.values [top->u.object.length].name
+                        = (json_char *) top->_reserved.object_mem;
+
+                     (*(json_char **) &top->_reserved.object_mem) += string_length + 1;
+                  }
+
+                  flags |= flag_seek_value | flag_need_colon;
+                  continue;
+
+               default:
+                  break;
+            };
+         }
+         else
+         {
+            /* copy up to the next character that needs a look in one go */
+
+            size_t run = 1 + scan_string (i + 1, end - (i + 1));
+
+            if (run > state.uint_max - string_length)
+               goto e_toolong;
+
+            if (state.in_situ)
+               memmove (string + string_length, i, run * sizeof (json_char));
+            else if (!state.first_pass)
+               memcpy (string + string_length, i, run * sizeof (json_char));
+
+            string_length += run;
+            i += run - 1;
+
+            continue;
+         }
+      }
+
+      if (flags & flag_seek_value)
+      {
+         switch (b)
+         {
+            whitespace:
+               i = skip_whitespace (i, end, &cur_line, &cur_line_begin) - 1;
+               continue;
+
+            case ']':
+
+               if (top && top->type == json_array)
+                  flags = (flags & ~ (flag_need_comma | flag_seek_value)) | flag_next;
+               else if (!(state.settings.settings & json_relaxed_commas))
+               {  sprintf (error, "%d:%d: Unexpected ]", cur_line, e_off);
+                  goto e_failed;
+               }
+
+               break;
+
+            default:
+
+               if (flags & flag_need_comma)
+               {
+                  if (b == ',')
+                  {  flags &= ~ flag_need_comma;
+                     continue;
+                  }
+                  else
+                  {  sprintf (error, "%d:%d: Expected , before %c", cur_line, e_off, b);
+                     goto e_failed;
+                  }
+               }
+
+               if (flags & flag_need_colon)
+               {
+                  if (b == ':')
+                  {  flags &= ~ flag_need_colon;
+                     continue;
+                  }
+                  else
+                  {  sprintf (error, "%d:%d: Expected : before %c", cur_line, e_off, b);
+                     goto e_failed;
+                  }
+               }
+
+               if (partial && !token_complete (i, end))
+                  goto suspend;
+
+               flags &= ~ flag_seek_value;
+
+               switch (b)
+               {
+                  case '{':
+
+                     if (!new_value (&state, &top, &root, &alloc, json_object))
+                        goto e_alloc_failure;
+
+                     if (state.handler && state.handler->start_object
+                           && !state.handler->start_object (state.handler_data))
+                     {
+                        goto e_stopped;
+                     }
+
+                     continue;
+
+                  case '[':
+
+                     if (!new_value (&state, &top, &root, &alloc, json_array))
+                        goto e_alloc_failure;
+
+                     if (state.handler && state.handler->start_array
+                           && !state.handler->start_array (state.handler_data))
+                     {
+                        goto e_stopped;
+                     }
+
+                     flags |= flag_seek_value;
+                     continue;
+
+                  case '"':
+
+                     if (!new_value (&state, &top, &root, &alloc, json_string))
+                        goto e_alloc_failure;
+
+                     if (state.in_situ)
+                        top->u.string.ptr = state.in_situ + (i + 1 - json);
+                     else if (state.handler)
+                     {
+                        /* only needed until it's reported */
+
+                        if (! (top->u.string.ptr = (json_char *) stack_push
+                              (&state.settings, &state.names, (string_span (i + 1, end) + 1) * sizeof (json_char))) )
+                        {
+                           goto e_alloc_failure;
+                        }
+                     }
+                     else if (state.single_pass)
+                     {
+                        string_reserved = (string_span (i + 1, end) + 1) * sizeof (json_char);
+
+                        if (! (top->u.string.ptr = (json_char *) json_alloc
+                              (&state, string_reserved, 0)) )
+                        {
+                           goto e_alloc_failure;
+                        }
+                     }
+
+                     flags |= flag_string;
+
+                     string = top->u.string.ptr;
+                     string_length = 0;
+
+                     continue;
+
+                  case 't':
+
+                     if ((end - i) < 4 || *(++ i) != 'r' || *(++ i) != 'u' || *(++ i) != 'e')
+                        goto e_unknown_value;
+
+                     if (!new_value (&state, &top, &root, &alloc, json_boolean))
+                        goto e_alloc_failure;
+
+                     top->u.boolean = 1;
+
+                     flags |= flag_next;
+                     break;
+
+                  case 'f':
+
+                     if ((end - i) < 5 || *(++ i) != 'a' || *(++ i) != 'l' || *(++ i) != 's' || *(++ i) != 'e')
+                        goto e_unknown_value;
+
+                     if (!new_value (&state, &top, &root, &alloc, json_boolean))
+                        goto e_alloc_failure;
+
+                     flags |= flag_next;
+                     break;
+
+                  case 'n':
+
+                     if ((end - i) < 4 || *(++ i) != 'u' || *(++ i) != 'l' || *(++ i) != 'l')
+                        goto e_unknown_value;
+
+                     if (!new_value (&state, &top, &root, &alloc, json_null))
+                        goto e_alloc_failure;
+
+                     flags |= flag_next;
+                     break;
+
+                  default:
+
+                     if (isdigit ((int)b) || b == '-')
+                     {
+                        if (!new_value (&state, &top, &root, &alloc, json_integer))
+                           goto e_alloc_failure;
+
+                        switch (parse_number (top, &i, end))
+                        {
+                           case 1: goto e_unknown_value;
+                           case 2: goto e_overflow;
+                        };
+
+                        flags |= flag_next | flag_reproc;
+                     }
+                     else
+                     {  sprintf (error, "%d:%d: Unexpected %c when seeking value", cur_line, e_off, b);
+                        goto e_failed;
+                     }
+               };
+         };
+      }
+      else
+      {
+         switch (top->type)
+         {
+         case json_object:
+            
+            switch (b)
+            {
+               whitespace:
+                  i = skip_whitespace (i, end, &cur_line, &cur_line_begin) - 1;
+                  continue;
+
+               case '"':
+
+                  if (partial && !token_complete (i, end))
+                     goto suspend;
+
+                  if (flags & flag_need_comma && (!(state.settings.settings & json_relaxed_commas)))
+                  {
+                     sprintf (error, "%d:%d: Expected , before \"", cur_line, e_off);
+                     goto e_failed;
+                  }
+
+                  flags |= flag_string;
+
+                  if (state.handler)
+                  {
+                     string_reserved = (string_span (i + 1, end) + 1) * sizeof (json_char);
+
+                     if (! (string = (json_char *) stack_push
+                           (&state.settings, &state.names, string_reserved)) )
+                     {
+                        goto e_alloc_failure;
+                     }
+                  }
+                  else if (state.single_pass)
+                  {
+                     json_entry * entry;
+
+                     if (! (entry = (json_entry *) stack_push (&state.settings, &state.children, sizeof (json_entry))) )
+                        goto e_alloc_failure;
+
+                     entry->key = 0;
+                     entry->value = 0;
+
+                     if (state.in_situ)
+                     {
+                        entry->name = i + 1 - json;
+                        string = state.in_situ + entry->name;
+                     }
+                     else
+                     {
+                        entry->name = state.names.length;
+
+                        if (! (string = (json_char *) stack_push
+                              (&state.settings, &state.names, (string_span (i + 1, end) + 1) * sizeof (json_char))) )
+                        {
+                           goto e_alloc_failure;
+                        }
+                     }
+                  }
+                  else
+                     string = (json_char *) top->_reserved.object_mem;
+
+                  string_length = 0;
+
+                  break;
+               
+               case '}':
+
+                  flags = (flags & ~ flag_need_comma) | flag_next;
+                  break;
+
+               case ',':
+
+                  if (flags & flag_need_comma)
+                  {
+                     flags &= ~ flag_need_comma;
+                     break;
+                  }
+
+               default:
+
+                  sprintf (error, "%d:%d: Unexpected `%c` in object", cur_line, e_off, b);
+                  goto e_failed;
+            };
+
+            break;
+
+         default:
+            break;
+         };
+      }
+
+      if (flags & flag_reproc)
+      {
+         flags &= ~ flag_reproc;
+         -- i;
+      }
+
+      if (flags & flag_next)
+      {
+         flags = (flags & ~ flag_next) | flag_need_comma;
+
+         if (state.handler)
+         {
+            if (!value_event (&state, top))
+               goto e_stopped;
+         }
+         else if (state.single_pass)
+         {
+            if (!close_value (&state, top))
+               goto e_alloc_failure;
+         }
+         else if (!state.first_pass && top->type == json_object)
+            finish_object (&state, top);
+
+         if (!top->parent)
+         {
+            /* root value done */
+
+            if (stop_at_root)
+            {  ++ i;
+               break;
+            }
+
+            flags |= flag_done;
+            continue;
+         }
+
+         if (top->parent->type == json_array)
+            flags |= flag_seek_value;
+            
+         if (state.single_pass && !state.handler)
+         {
+            if (top->parent->type == json_object)
+               stack_top (state.children, json_entry)->value = top;
+            else
+            {
+               json_entry * entry;
+
+               if (! (entry = (json_entry *) stack_push (&state.settings, &state.children, sizeof (json_entry))) )
+               {
+                  /* already complete, so not one of the open containers */
+
+                  alloc = top->parent;
+                  json_value_free_ex (&state.settings, top);
+                  top = alloc;
+
+                  goto e_alloc_failure;
+               }
+
+               entry->value = top;
+            }
+         }
+         else if (!state.single_pass && !state.first_pass)
+         {
+            json_value * parent = top->parent;
+
+            switch (parent->type)
+            {
+               case json_object:
+
+                  parent->u.object.values
+                     [parent->u.object.length].value = top;
+
+                  break;
+
+               case json_array:
+
+                  parent->u.array.values
+                        [parent->u.array.length] = top;
+
+                  break;
+
+               default:
+                  break;
+            };
+         }
+
+         if ( (++ top->parent->u.array.length) > state.uint_max)
+            goto e_toolong;
+
+         top = top->parent;
+
+         continue;
+      }
+   }
+
+   goto leave;
+
+suspend:
+
+   result = 0;
+   goto leave;
+
+e_unknown_value:
+
+   sprintf (error, "%d:%d: Unknown value", cur_line, e_off);
+   goto e_failed;
+
+e_alloc_failure:
+
+   strcpy (error, "Memory allocation failure");
+   goto e_failed;
+
+e_overflow:
+
+   sprintf (error, "%d:%d: numeral parser have occurred overflow", cur_line, e_off);
+   goto e_failed;
+
+e_toolong:
+
+   sprintf (error, "%d:%d: Too long size object", cur_line, e_off);
+   goto e_failed;
+
+e_stopped:
+
+   sprintf (error, "%d:%d: Stopped by the handler", cur_line, e_off);
+   goto e_failed;
+
+e_failed:
+
+   if (!*error)
+      strcpy (error, "Unknown error");
+
+   if (i > end)
+      i = end;
+
+   result = -1;
+
+leave:
+
+   p->state = state;
+   p->flags = flags;
+   p->top = top;
+   p->root = root;
+   p->alloc = alloc;
+
+   if (cur_line != carried_line)
+   {
+      p->cur_line = cur_line;
+      p->line_begin = p->offset + (cur_line_begin - json);
+   }
+
+   p->offset += i - json;
+
+   *stop = i - json;
+
+   return result;
+}
+
+/* Hands over the root of a parse that's done */
+static json_value * parse_done (json_parse_state * p)
+{
+   json_state * state = &p->state;
+
+   if (p->doc)
+   {
+      p->doc->used_memory = state->used_memory;
+      p->doc->children = state->children;
+      p->doc->names = state->names;
+      p->doc->positions = state->positions;
+
+      return p->root;
+   }
+
+   if (state->handler)
+      events_free (state, 0);
+
+   stack_free (&state->settings, &state->children);
+   stack_free (&state->settings, &state->names);
+   stack_free (&state->settings, &state->positions);
+
+   return p->root;
+}
+
+/* Frees whatever a parse that won't be finished has built */
+static void parse_abort (json_parse_state * p)
+{
+   json_state * state = &p->state;
+   json_value * alloc = p->alloc, * next;
+
+   if (p->doc)
+   {
+      /* nothing to free one by one: just drop everything this parse took */
+
+      arena_rollback (&state->settings, &p->doc->arena, p->mark);
+
+      p->doc->children = state->children;
+      p->doc->names = state->names;
+      p->doc->positions = state->positions;
+      p->doc->children.length = p->doc->names.length = 0;
+
+      return;
+   }
+
+   if (state->handler)
+   {
+      /* once the root's done it's spare like the rest */
+
+      events_free (state, p->flags & flag_done ? 0 : p->top);
+
+      stack_free (&state->settings, &state->children);
+      stack_free (&state->settings, &state->names);
+
+      return;
+   }
+
+   if (state->single_pass)
+   {
+      if (p->flags & flag_done)
+         json_value_free_ex (&state->settings, p->root);
+      else
+         single_pass_free (state, p->top);
+
+      stack_free (&state->settings, &state->children);
+      stack_free (&state->settings, &state->names);
+      stack_free (&state->settings, &state->positions);
+
+      return;
+   }
+
+   if (state->first_pass)
+      alloc = p->root;
+
+   while (alloc)
+   {
+      next = alloc->_reserved.next_alloc;
+      state->settings.mem_free (alloc, state->settings.user_data);
+      alloc = next;
+   }
+
+   if (!state->first_pass)
+      json_value_free_ex (&state->settings, p->root);
+}
+
+/* The two stage parse.  Stage 1 goes over the input 64 characters at a
+ * time, working out from the masks of quotes, backslashes, brackets and
+ * whitespace which characters are in strings, and lists the offset of every
+ * character the tree is built from: the brackets, colons and commas outside
+ * strings, the opening quote of each string and the first character of each
+ * number or literal.  Stage 2 then builds the tree from that list alone,
+ * going to the input only for the values themselves, as a single pass parse
+ * would (so the tree comes out the same).
+ */
+
+static uint64_t prefix_xor (uint64_t bits)
+{
+   bits ^= bits << 1;
+   bits ^= bits << 2;
+   bits ^= bits << 4;
+   bits ^= bits << 8;
+   bits ^= bits << 16;
+   bits ^= bits << 32;
+
+   return bits;
+}
+
+#ifdef __GNUC__
+   #define trailing_zeros(bits) __builtin_ctzll (bits)
+#else
+   static int trailing_zeros (uint64_t bits)
+   {
+      int n = 0;
+
+      for (; !(bits & 1); bits >>= 1)
+         ++ n;
+
+      return n;
+   }
+#endif
+
+/* Stage 1 goes through the input a block of 64 characters at a time,
+ * carrying what it knows about the end of one block into the next
+ */
+typedef struct
+{
+   const json_char * json;
+   size_t length, base;  /* json [0, base) is done */
+
+   uint64_t prev_escaped, prev_in_string, prev_scalar;
+
+} json_stage1;
+
+/* Classifies the block at s->base (padding the last out with whitespace),
+ * and works out its unescaped quotes and which characters are in strings
+ */
+static void stage1_strings (json_stage1 * s, json_classes * c, uint64_t * quote, uint64_t * in_string)
+{
+   const uint64_t even_bits = 0x5555555555555555ULL;
+   uint64_t backslash, follows_escape, odd_starts, sequences, escaped;
+   json_char block [64];
+   size_t base = s->base;
+
+   if (s->length - base >= 64)
+      classify (s->json + base, c);
+   else
+   {
+      memset (block, ' ', sizeof (block));
+      memcpy (block, s->json + base, (s->length - base) * sizeof (json_char));
+
+      classify_scalar (block, c);
+   }
+
+   /* escaped characters follow an odd number of backslashes: adding the
+    * backslashes to the starts of the runs that begin on odd bits carries
+    * past the end of each of those runs
+    */
+
+   backslash = c->backslash & ~ s->prev_escaped;
+   follows_escape = (backslash << 1) | s->prev_escaped;
+   odd_starts = backslash & ~ even_bits & ~ follows_escape;
+
+   sequences = odd_starts + backslash;
+   s->prev_escaped = sequences < backslash;
+
+   escaped = (even_bits ^ (sequences << 1)) & follows_escape;
+
+   /* in_string is set from each opening quote up to its closing one */
+
+   *quote = c->quote & ~ escaped;
+   *in_string = prefix_xor (*quote) ^ s->prev_in_string;
+   s->prev_in_string = 0 - (*in_string >> 63);
+}
+
+/* Lists the positions in the next block at `out` (room for 64), returning
+ * the end of the list
+ */
+static uint32_t * stage1_block (json_stage1 * s, uint32_t * out)
+{
+   uint64_t quote, in_string, scalar, structurals;
+   json_classes c;
+   size_t base = s->base;
+
+   stage1_strings (s, &c, &quote, &in_string);
+
+   scalar = ~ (c.op | c.space | quote | in_string);
+
+   structurals = (c.op & ~ in_string) | quote
+                    | (scalar & ~ ((scalar << 1) | s->prev_scalar));
+
+   s->prev_scalar = scalar >> 63;
+   s->base += 64;
+
+   for (; structurals; structurals &= structurals - 1)
+      *out ++ = (uint32_t) (base + trailing_zeros (structurals));
+
+   return out;
+}
+
+/* Stage 1: fills state->positions, ending with `length` itself.  Returns 0
+ * on allocation failure.  A string left open at the end has nothing listed
+ * after its opening quote: stage 2 finds it's unterminated when it gets
+ * there, so errors before it are reported first, as by the parse loop.
+ */
+static int find_structurals (json_state * state, const json_char * json, size_t length)
+{
+   json_stage1 s;
+   uint32_t * out;
+
+   memset (&s, 0, sizeof (json_stage1));
+   s.json = json;
+   s.length = length;
+
+   state->positions.length = 0;
+
+   while (s.base < length)
+   {
+      if (! (out = (uint32_t *) stack_push (&state->settings, &state->positions,
+                                            64 * sizeof (uint32_t))) )
+      {
+         return 0;
+      }
+
+      out = stage1_block (&s, out);
+
+      state->positions.length = (char *) out - state->positions.mem;
+   }
+
+   if (! (out = (uint32_t *) stack_push (&state->settings, &state->positions, sizeof (uint32_t))) )
+      return 0;
+
+   *out = (uint32_t) length;
+
+   return 1;
+}
+
+/* Two stage: decode the string from `i` (just past its opening quote) into
+ * `string` the way the parse loop does, returning its closing quote, or
+ * NULL for a bad \u escape or the end of the input (with *bad at it)
+ */
+static const json_char * decode_string (const json_char * i, const json_char * end,
+                                        json_char * string, unsigned int * length,
+                                        const json_char ** bad)
+{
+   unsigned int string_length = 0;
+   unsigned char uc_b1, uc_b2, uc_b3, uc_b4;
+   json_uchar uchar;
+
+   for (;;)
+   {
+      size_t run = scan_string (i, end - i);
+
+      /* in place, the string only ever moves back */
+
+      memmove (string + string_length, i, run * sizeof (json_char));
+      string_length += run;
+      i += run;
+
+      if (i == end)
+      {  *bad = i;
+         return 0;
+      }
+
+      if (*i == '"')
+         break;
+
+      if (*i != '\\')
+      {
+         string [string_length ++] = *i ++;  /* a control character */
+         continue;
+      }
+
+      if (++ i == end)
+      {  *bad = i;
+         return 0;
+      }
+
+      switch (*i)
+      {
+         case 'b':  string [string_length ++] = '\b';  break;
+         case 'f':  string [string_length ++] = '\f';  break;
+         case 'n':  string [string_length ++] = '\n';  break;
+         case 'r':  string [string_length ++] = '\r';  break;
+         case 't':  string [string_length ++] = '\t';  break;
+         case 'u':
+
+            if (end - i < 2 || (uc_b1 = hex_value (*++ i)) == 0xFF
+                  || end - i < 2 || (uc_b2 = hex_value (*++ i)) == 0xFF
+                  || end - i < 2 || (uc_b3 = hex_value (*++ i)) == 0xFF
+                  || end - i < 2 || (uc_b4 = hex_value (*++ i)) == 0xFF)
+            {
+               *bad = i;
+               return 0;
+            }
+
+            uc_b1 = uc_b1 * 16 + uc_b2;
+            uc_b2 = uc_b3 * 16 + uc_b4;
+
+            uchar = ((json_char) uc_b1) * 256 + uc_b2;
+
+            if (sizeof (json_char) >= sizeof (json_uchar) || (uc_b1 == 0 && uc_b2 <= 0x7F))
+               string [string_length ++] = (json_char) uchar;
+            else if (uchar <= 0x7FF)
+            {
+               string [string_length ++] = 0xC0 | ((uc_b2 & 0xC0) >> 6) | ((uc_b1 & 0x3) << 3);
+               string [string_length ++] = 0x80 | (uc_b2 & 0x3F);
+            }
+            else
+            {
+               string [string_length ++] = 0xE0 | ((uc_b1 & 0xF0) >> 4);
+               string [string_length ++] = 0x80 | ((uc_b1 & 0xF) << 2) | ((uc_b2 & 0xC0) >> 6);
+               string [string_length ++] = 0x80 | (uc_b2 & 0x3F);
+            }
+
+            break;
+
+         default:
+            string [string_length ++] = *i;
+      };
+
+      ++ i;
+   }
+
+   string [string_length] = 0;
+   *length = string_length;
+
+   return i;
+}
+
+/* Two stage: where the literal at `i` stops matching `literal` (of `length`
+ * characters, all matched when it's there), as the parse loop tells
+ */
+static const json_char * match_literal (const json_char * i, const json_char * end,
+                                        const char * literal, size_t length)
+{
+   if ((size_t) (end - i) < length)
+      return i;
+
+   for (; length && *i == *literal; ++ i, ++ literal, -- length);
+
+   return i;
+}
+
+/* Line and column of `i` for error messages, as the parse loop counts them:
+ * newlines inside strings don't start a line.  The strings are skipped by
+ * way of stage 1's positions, as they may have been decoded in place.
+ */
+static void where (const json_state * state, const json_char * json, const json_char * i,
+                   unsigned int * line, int * col)
+{
+   const uint32_t * next = (const uint32_t *) state->positions.mem;
+   const json_char * line_begin = json, * from = json, * to;
+
+   for (*line = 1; from < i; ++ next)
+   {
+      if ((to = json + *next) > i)
+         to = i;
+
+      for (; from < to; ++ from)
+      {
+         if (*from == '\n')
+         {  ++ *line;
+            line_begin = from;
+         }
+      }
+
+      if (from < i && *from == '"')
+         from = json + *++ next;  /* its closing quote, or the end */
+   }
+
+   *col = (int) (i - line_begin);
+}
+
+/* Stage 2 (after stage 1), for parse_ex.  Returns -1 on failure, with the
+ * message in p->error, and 1 otherwise.
+ */
+static int parse_structurals (json_parse_state * p, const json_char * json, size_t length)
+{
+   json_state * state = &p->state;
+   json_char * error = p->error;
+   const json_char * i = json, * end = json + length, * bad;
+   const uint32_t * next;
+   json_value * top = 0, * root = 0, * alloc = 0, * container;
+   json_char * string;
+   unsigned int string_length, line;
+   size_t string_reserved;
+   int col;
+
+   if (!find_structurals (state, json, length))
+      goto e_alloc_failure;
+
+   next = (const uint32_t *) state->positions.mem;
+
+value:
+
+   i = json + *next ++;
+
+   switch (i < end ? *i : 0)
+   {
+      case '{':
+
+         if (!new_value (state, &top, &root, &alloc, json_object))
+            goto e_alloc_failure;
+
+         if (json + *next < end && json [*next] == '}')
+         {  ++ next;
+            goto value_done;
+         }
+
+         goto key;
+
+      case '[':
+
+         if (!new_value (state, &top, &root, &alloc, json_array))
+            goto e_alloc_failure;
+
+         if (json + *next < end && json [*next] == ']')
+         {  ++ next;
+            goto value_done;
+         }
+
+         goto value;
+
+      case '"':
+
+         if (!new_value (state, &top, &root, &alloc, json_string))
+            goto e_alloc_failure;
+
+         /* the string and its terminator fit before its closing quote (or
+          * the end, if there's none)
+          */
+
+         string_reserved = (json + *next - i) * sizeof (json_char);
+
+         if (state->in_situ)
+            top->u.string.ptr = state->in_situ + (i + 1 - json);
+         else if (! (top->u.string.ptr = (json_char *) json_alloc (state, string_reserved, 0)) )
+            goto e_alloc_failure;
+
+         if (! (decode_string (i + 1, end, top->u.string.ptr, &string_length, &bad)) )
+         {  i = bad;
+            goto e_bad_escape;
+         }
+
+         top->u.string.length = string_length;
+         ++ next;
+
+         if (state->arena && !state->in_situ)
+         {
+            /* give back what the escapes saved */
+
+            arena_shrink (state->arena, top->u.string.ptr, (string_length + 1) * sizeof (json_char));
+
+            if (state->settings.max_memory)
+               state->used_memory -= string_reserved - (string_length + 1) * sizeof (json_char);
+         }
+
+         goto value_done;
+
+      case 't':
+
+         if ((bad = match_literal (i, end, "true", 4)) != i + 4)
+         {  i = bad;
+            goto e_unknown_value;
+         }
+
+         if (!new_value (state, &top, &root, &alloc, json_boolean))
+            goto e_alloc_failure;
+
+         top->u.boolean = 1;
+         i += 4;
+
+         goto scalar_done;
+
+      case 'f':
+
+         if ((bad = match_literal (i, end, "false", 5)) != i + 5)
+         {  i = bad;
+            goto e_unknown_value;
+         }
+
+         if (!new_value (state, &top, &root, &alloc, json_boolean))
+            goto e_alloc_failure;
+
+         i += 5;
+
+         goto scalar_done;
+
+      case 'n':
+
+         if ((bad = match_literal (i, end, "null", 4)) != i + 4)
+         {  i = bad;
+            goto e_unknown_value;
+         }
+
+         if (!new_value (state, &top, &root, &alloc, json_null))
+            goto e_alloc_failure;
+
+         i += 4;
+
+         goto scalar_done;
+
+      default:
+
+         if (i == end || !(isdigit ((int) *i) || *i == '-'))
+         {
+            where (state, json, i, &line, &col);
+
+            if (i < end && *i == ']')
+               sprintf (error, "%d:%d: Unexpected ]", line, col);
+            else
+               sprintf (error, "%d:%d: Unexpected %c when seeking value", line, col, i < end ? *i : 0);
+
+            goto e_failed;
+         }
+
+         if (!new_value (state, &top, &root, &alloc, json_integer))
+            goto e_alloc_failure;
+
+         switch (parse_number (top, &i, end))
+         {
+            case 1: goto e_unknown_value;
+            case 2: goto e_overflow;
+         };
+
+         goto scalar_done;
+   };
+
+scalar_done:
+
+   /* nothing but whitespace up to the next structural character (anything
+    * else would have one of its own)
+    */
+
+   while (i < json + *next && (*i == ' ' || *i == '\t' || *i == '\r' || *i == '\n'))
+      ++ i;
+
+   if (i < json + *next)
+      goto e_unexpected;
+
+value_done:
+
+   if (!close_value (state, top))
+      goto e_alloc_failure;
+
+   if (!top->parent)
+   {
+      /* root value done */
+
+      p->flags |= flag_done;
+
+      if (json + *next < end)
+      {  i = json + *next;
+         goto e_unexpected;
+      }
+
+      goto done;
+   }
+
+   if (top->parent->type == json_object)
+      stack_top (state->children, json_entry)->value = top;
+   else
+   {
+      json_entry * entry;
+
+      if (! (entry = (json_entry *) stack_push (&state->settings, &state->children, sizeof (json_entry))) )
+      {
+         /* already complete, so not one of the open containers */
+
+         alloc = top->parent;
+         json_value_free_ex (&state->settings, top);
+         top = alloc;
+
+         goto e_alloc_failure;
+      }
+
+      entry->value = top;
+   }
+
+   if ( (++ top->parent->u.array.length) > state->uint_max)
+      goto e_toolong;
+
+   top = top->parent;
+
+   /* a comma (maybe before the end after all) or the end */
+
+   i = json + *next ++;
+
+   if (i < end && *i == ',')
+   {
+      if (json + *next < end && json [*next] == (top->type == json_array ? ']' : '}'))
+      {  ++ next;
+         goto value_done;
+      }
+
+      if (top->type == json_array)
+         goto value;
+
+      goto key;
+   }
+
+   if (i < end && *i == (top->type == json_array ? ']' : '}'))
+      goto value_done;
+
+   goto e_unexpected;
+
+key:
+
+   i = json + *next ++;
+
+   if (i == end || *i != '"')
+      goto e_unexpected;
+
+   {  json_entry * entry;
+
+      if (! (entry = (json_entry *) stack_push (&state->settings, &state->children, sizeof (json_entry))) )
+         goto e_alloc_failure;
+
+      entry->key = 0;
+      entry->value = 0;
+
+      if (state->in_situ)
+      {
+         entry->name = i + 1 - json;
+         string = state->in_situ + entry->name;
+      }
+      else
+      {
+         entry->name = state->names.length;
+
+         if (! (string = (json_char *) stack_push
+               (&state->settings, &state->names, (json + *next - i) * sizeof (json_char))) )
+         {
+            goto e_alloc_failure;
+         }
+      }
+
+      if (! (decode_string (i + 1, end, string, &string_length, &bad)) )
+      {  i = bad;
+         goto e_bad_escape;
+      }
+
+      if (state->settings.intern
+            && (entry->key = intern_key (state->settings.intern, string, string_length)) )
+      {
+         if (!state->in_situ)
+            state->names.length = entry->name;  /* no need to keep it */
+      }
+      else if (!state->in_situ)
+         state->names.length = entry->name + (string_length + 1) * sizeof (json_char);
+
+      ++ next;
+   }
+
+   i = json + *next ++;
+
+   if (i == end || *i != ':')
+   {
+      where (state, json, i, &line, &col);
+
+      if (i < end && *i == ']')
+         sprintf (error, "%d:%d: Unexpected ]", line, col);
+      else
+         sprintf (error, "%d:%d: Expected : before %c", line, col, i < end ? *i : 0);
+
+      goto e_failed;
+   }
+
+   goto value;
+
+done:
+
+   p->top = top;
+   p->root = root;
+
+   return 1;
+
+e_unexpected:
+
+   /* whatever's at i where a value, or a key, should have ended (the end
+    * of the input read as a 0, as by the parse loop)
+    */
+
+   where (state, json, i, &line, &col);
+
+   if ((p->flags & flag_done) || !(container = top->type == json_object
+                                      || top->type == json_array ? top : top->parent))
+   {
+      sprintf (error, "%d:%d: Trailing garbage: `%c`", line, col, *i);
+   }
+   else if (container->type == json_array)
+      sprintf (error, "%d:%d: Expected , before %c", line, col, i < end ? *i : 0);
+   else if (i < end && *i == '"')
+      sprintf (error, "%d:%d: Expected , before \"", line, col);
+   else
+      sprintf (error, "%d:%d: Unexpected `%c` in object", line, col, i < end ? *i : 0);
+
+   goto e_failed;
+
+e_bad_escape:
+
+   where (state, json, i, &line, &col);
+
+   if (i == end)
+      sprintf (error, "Unexpected EOF in string (at %d:%d)", line, col);
+   else
+      sprintf (error, "Invalid character value `u` (at %d:%d)", line, col);
+
+   goto e_failed;
+
+e_unknown_value:
+
+   where (state, json, i, &line, &col);
+   sprintf (error, "%d:%d: Unknown value", line, col);
+   goto e_failed;
+
+e_alloc_failure:
+
+   strcpy (error, "Memory allocation failure");
+   goto e_failed;
+
+e_overflow:
+
+   where (state, json, i, &line, &col);
+   sprintf (error, "%d:%d: numeral parser have occurred overflow", line, col);
+   goto e_failed;
+
+e_toolong:
+
+   where (state, json, i, &line, &col);
+   sprintf (error, "%d:%d: Too long size object", line, col);
+   goto e_failed;
+
+e_failed:
+
+   p->top = top;
+   p->root = root;
+
+   return -1;
+}
+
+/* Two stage: whether the string from `i` (just past its opening quote) up
+ * to its closing quote at `close` would decode
+ */
+static int string_valid (const json_char * i, const json_char * close)
+{
+   /* any character may be escaped, but \u needs four hex digits (the
+    * closing quote isn't one, so this doesn't read past it)
+    */
+
+   for (; (i = (const json_char *) memchr (i, '\\', close - i)); i += 2)
+   {
+      if (i [1] == 'u'
+            && (hex_value (i [2]) == 0xFF || hex_value (i [3]) == 0xFF
+                  || hex_value (i [4]) == 0xFF || hex_value (i [5]) == 0xFF))
+      {
+         return 0;
+      }
+   }
+
+   return 1;
+}
+
+/* The validator runs stage 1 a window of blocks at a time, so that the
+ * positions it goes by stay few (and in the cache): returns the first of
+ * the next ones, with *last past them, or NULL on allocation failure.  Once
+ * the input is all done, each window is just `length`.
+ */
+#define window_blocks 64
+
+static const uint32_t * stage1_window (json_state * state, json_stage1 * s, const uint32_t ** last)
+{
+   uint32_t * first, * out;
+   int blocks;
+
+   state->positions.length = 0;
+
+   if (! (first = (uint32_t *) stack_push (&state->settings, &state->positions,
+                                           (window_blocks * 64 + 1) * sizeof (uint32_t))) )
+   {
+      return 0;
+   }
+
+   for (out = first; out == first; )
+   {
+      for (blocks = 0; blocks < window_blocks && s->base < s->length; ++ blocks)
+         out = stage1_block (s, out);
+
+      if (s->base >= s->length)
+         *out ++ = (uint32_t) s->length;
+   }
+
+   *last = out;
+
+   return first;
+}
+
+/* Two stage, for lazy documents: whether the input would parse, going by
+ * stage 1's positions and building nothing.  The open containers are kept
+ * on the children stack, a character each.  Failures aren't explained (an
+ * allocation failure included): that's left to the parse loop.
+ */
+#define more_positions()                                                \
+   do {                                                                 \
+      if (next == last && ! (next = stage1_window (state, &s, &last)))  \
+         return 0;                                                      \
+   } while (0)
+
+static int validate_structurals (json_state * state, const json_char * json, size_t length)
+{
+   const json_char * i, * end = json + length;
+   const uint32_t * next = 0, * last = 0;
+   json_stage1 s;
+   json_value number;
+   char * open, close;
+
+   memset (&s, 0, sizeof (json_stage1));
+   s.json = json;
+   s.length = length;
+
+   state->children.length = 0;
+
+value:
+
+   more_positions ();
+   i = json + *next ++;
+
+   switch (i < end ? *i : 0)
+   {
+      case '{': case '[':
+
+         if (! (open = (char *) stack_push (&state->settings, &state->children, 1)) )
+            return 0;
+
+         *open = *i == '{' ? '}' : ']';
+
+         more_positions ();
+
+         if (json + *next < end && json [*next] == *open)
+         {  ++ next;
+            goto closed;
+         }
+
+         if (*i == '{')
+            goto key;
+
+         goto value;
+
+      case '"':
+
+         more_positions ();
+
+         if (json + *next == end || !string_valid (i + 1, json + *next))
+            return 0;
+
+         ++ next;
+         goto value_done;
+
+      case 't':
+
+         if (match_literal (i, end, "true", 4) != i + 4)
+            return 0;
+
+         i += 4;
+         goto scalar_done;
+
+      case 'f':
+
+         if (match_literal (i, end, "false", 5) != i + 5)
+            return 0;
+
+         i += 5;
+         goto scalar_done;
+
+      case 'n':
+
+         if (match_literal (i, end, "null", 4) != i + 4)
+            return 0;
+
+         i += 4;
+         goto scalar_done;
+
+      default:
+
+         if (i == end || !(isdigit ((int) *i) || *i == '-')
+               || parse_number (&number, &i, end))
+         {
+            return 0;
+         }
+
+         goto scalar_done;
+   };
+
+scalar_done:
+
+   more_positions ();
+
+   while (i < json + *next && (*i == ' ' || *i == '\t' || *i == '\r' || *i == '\n'))
+      ++ i;
+
+   if (i < json + *next)
+      return 0;
+
+value_done:
+
+   more_positions ();
+
+   if (!state->children.length)
+      return json + *next == end;  /* the root, with nothing after it */
+
+   close = state->children.mem [state->children.length - 1];
+
+   i = json + *next ++;
+
+   if (i < end && *i == ',')
+   {
+      /* maybe before the end after all */
+
+      more_positions ();
+
+      if (json + *next < end && json [*next] == close)
+      {  ++ next;
+         goto closed;
+      }
+
+      if (close == ']')
+         goto value;
+
+      goto key;
+   }
+
+   if (i < end && *i == close)
+      goto closed;
+
+   return 0;
+
+closed:
+
+   -- state->children.length;
+   goto value_done;
+
+key:
+
+   more_positions ();
+   i = json + *next ++;
+
+   if (i == end || *i != '"')
+      return 0;
+
+   more_positions ();
+
+   if (json + *next == end || !string_valid (i + 1, json + *next))
+      return 0;
+
+   ++ next;
+
+   more_positions ();
+   i = json + *next ++;
+
+   if (i == end || *i != ':')
+      return 0;
+
+   goto value;
+}
+
+/* With `stop`, the parse ends with the root value rather than the input,
+ * and *stop is left at the offset it got to: just past the value, or where
+ * it failed.
+ */
+static json_value * parse_ex (json_settings * settings, json_document * doc, int in_situ,
+                              const json_char * json, size_t length, size_t * stop,
+                              char * error_buf)
+{
+   json_parse_state p;
+   size_t position;
+
+   parse_init (&p, settings, doc, in_situ ? (json_char *) json : 0);
+
+   if ((p.state.settings.settings & (json_two_stage | json_relaxed_commas)) == json_two_stage
+         && !stop && length < 0xFFFFFFFF)
+   {
+      p.state.single_pass = 1;
+      p.state.first_pass = 0;
+
+      parse_start (&p);
+
+      if (parse_structurals (&p, json, length) < 0)
+      {
+         if (error_buf)
+            strcpy (error_buf, p.error);
+
+         parse_abort (&p);
+
+         return 0;
+      }
+
+      return parse_done (&p);
+   }
+
+   for (; p.state.first_pass >= 0; -- p.state.first_pass)
+   {
+      parse_start (&p);
+
+      if (parse_run (&p, json, length, 0, stop != 0, &position) < 0)
+      {
+         if (stop)
+            *stop = position;
+
+         if (error_buf)
+            strcpy (error_buf, p.error);
+
+         parse_abort (&p);
+
+         return 0;
+      }
+
+      p.alloc = p.root;
+   }
+
+   if (stop)
+      *stop = position;
+
+   return parse_done (&p);
+}
+
+/* Parse json [0, length) in place as the elements of an array whose `[`
+ * would come before it: with `closed`, it ends with the array's `]` (and
+ * whatever may follow that), and otherwise with the comma after an element,
+ * where the array is closed.  For parallel parsing, a part at a time.
+ */
+static json_value * parse_elements (json_settings * settings, const json_char * json,
+                                    size_t length, int closed)
+{
+   static const json_char open = '[', close = ']';
+   json_parse_state p;
+   size_t stop;
+
+   parse_init (&p, settings, 0, 0);
+
+   for (; p.state.first_pass >= 0; -- p.state.first_pass)
+   {
+      parse_start (&p);
+
+      /* a part that's cut short of a token fails, as a copy would */
+
+      if (parse_run (&p, &open, 1, 1, 0, &stop) < 0
+            || parse_run (&p, json, length, !closed, 0, &stop) < 0 || stop < length
+            || (!closed && parse_run (&p, &close, 1, 0, 0, &stop) < 0))
+      {
+         parse_abort (&p);
+         return 0;
+      }
+
+      p.alloc = p.root;
+   }
+
+   return parse_done (&p);
+}
+
+json_value * json_parse_ex (json_settings * settings, const json_char * json, char * error_buf)
+{
+   return parse_ex (settings, 0, 0, json, strlen (json), 0, error_buf);
+}
+
+json_value * json_parse_n (json_settings * settings, const json_char * json,
+                           size_t length, char * error_buf)
+{
+   return parse_ex (settings, 0, 0, json, length, 0, error_buf);
+}
+
+int json_parse_events (json_settings * settings, const json_handler * handler, void * user_data,
+                       const json_char * json, size_t length, char * error_buf)
+{
+   json_parse_state p;
+   size_t stop;
+
+   parse_init (&p, settings, 0, 0);
+   parse_start (&p);
+
+   p.state.single_pass = 1;
+   p.state.first_pass = 0;
+   p.state.handler = handler;
+   p.state.handler_data = user_data;
+
+   if (parse_run (&p, json, length, 0, 0, &stop) < 0)
+   {
+      if (error_buf)
+         strcpy (error_buf, p.error);
+
+      parse_abort (&p);
+
+      return 0;
+   }
+
+   parse_done (&p);
+
+   return 1;
+}
+
+json_document * json_document_new (json_settings * settings)
+{
+   json_settings doc_settings;
+   json_document * doc;
+
+   settings_init (&doc_settings, settings);
+
+   if (! (doc = (json_document *) doc_settings.mem_alloc
+         (sizeof (json_document), 1, doc_settings.user_data)) )
+   {
+      return 0;
+   }
+
+   doc->settings = doc_settings;
+
+   return doc;
+}
+
+json_value * json_document_parse (json_document * doc, const json_char * json, char * error_buf)
+{
+   return parse_ex (&doc->settings, doc, 0, json, strlen (json), 0, error_buf);
+}
+
+json_value * json_document_parse_n (json_document * doc, const json_char * json,
+                                    size_t length, char * error_buf)
+{
+   return parse_ex (&doc->settings, doc, 0, json, length, 0, error_buf);
+}
+
+json_value * json_document_parse_insitu (json_document * doc, json_char * json,
+                                         size_t length, char * error_buf)
+{
+   return parse_ex (&doc->settings, doc, 1, json, length, 0, error_buf);
+}
+
+static void held_release (json_settings * settings, json_held * held)
+{
+   #ifndef _WIN32
+      if (held->mapped)
+      {
+         munmap (held->text, held->length);
+         return;
+      }
+   #endif
+
+   settings->mem_free (held->text, settings->user_data);
+}
+
+static void document_release_held (json_document * doc)
+{
+   json_held * held;
+
+   while ( (held = doc->held) )
+   {
+      doc->held = held->next;
+
+      held_release (&doc->settings, held);
+      doc->settings.mem_free (held, doc->settings.user_data);
+   }
+}
+
+void json_document_reset (json_document * doc)
+{
+   json_chunk * chunk = doc->arena.chunks, * older;
+
+   document_release_held (doc);
+
+   /* keep the newest (and largest) chunk to carve the next values from */
+
+   if (chunk)
+   {
+      for (older = chunk->next; older; older = chunk->next)
+      {
+         chunk->next = older->next;
+         doc->settings.mem_free (older, doc->settings.user_data);
+      }
+
+      doc->arena.next = chunk_data (chunk);
+      doc->arena.end = doc->arena.next + chunk->size;
+   }
+
+   doc->used_memory = 0;
+}
+
+void json_document_free (json_document * doc)
+{
+   json_arena empty;
+
+   if (!doc)
+      return;
+
+   memset (&empty, 0, sizeof (json_arena));
+   arena_rollback (&doc->settings, &doc->arena, empty);
+
+   document_release_held (doc);
+
+   stack_free (&doc->settings, &doc->children);
+   stack_free (&doc->settings, &doc->names);
+   stack_free (&doc->settings, &doc->positions);
+
+   doc->settings.mem_free (doc, doc->settings.user_data);
+}
+
+/* Readers parse one root value after another into their own document,
+ * which is reset in between, from a buffer or from what `read` returns.
+ * Streams are read into `buffer`, which only grows when a value doesn't fit
+ * in it.
+ */
+struct _json_reader
+{
+   json_document * doc;
+
+   const json_char * json;  /* json [position, length) is still to be read */
+   size_t position, length;
+
+   size_t base;    /* offset of json [0] in the stream */
+   size_t offset;  /* of the value last read */
+
+   size_t (* read) (json_char * buf, size_t size, void * user_data);
+   void * user_data;
+
+   json_char * buffer;
+   size_t capacity;
+   int eof;
+
+   json_char error [128];  /* failures are final */
+};
+
+static json_reader * reader_new (json_settings * settings)
+{
+   json_document * doc;
+   json_reader * reader;
+
+   if (! (doc = json_document_new (settings)) )
+      return 0;
+
+   if (! (reader = (json_reader *) doc->settings.mem_alloc
+         (sizeof (json_reader), 1, doc->settings.user_data)) )
+   {
+      json_document_free (doc);
+      return 0;
+   }
+
+   reader->doc = doc;
+
+   return reader;
+}
+
+json_reader * json_reader_new (json_settings * settings, const json_char * json, size_t length)
+{
+   json_reader * reader;
+
+   if (! (reader = reader_new (settings)) )
+      return 0;
+
+   reader->json = json;
+   reader->length = length;
+
+   return reader;
+}
+
+json_reader * json_reader_new_stream
+   (json_settings * settings, size_t (* read) (json_char *, size_t, void *), void * user_data)
+{
+   json_reader * reader;
+
+   if (! (reader = reader_new (settings)) )
+      return 0;
+
+   reader->read = read;
+   reader->user_data = user_data;
+
+   return reader;
+}
+
+/* Move what's left to the start of the buffer and read more after it: at
+ * least as much again as is left (unless the buffer fills or the stream
+ * ends first), so that a value which spans many reads is parsed again only
+ * as often as what's been read of it doubles
+ */
+static int reader_fill (json_reader * reader)
+{
+   json_settings * settings = &reader->doc->settings;
+   size_t got, want;
+
+   if (reader->position)
+   {
+      reader->length -= reader->position;
+      memmove (reader->buffer, reader->buffer + reader->position, reader->length * sizeof (json_char));
+
+      reader->base += reader->position;
+      reader->position = 0;
+   }
+
+   if (reader->length == reader->capacity)
+   {
+      size_t capacity = reader->capacity ? reader->capacity * 2 : 65536;
+      json_char * buffer;
+
+      if (capacity < reader->capacity
+            || (settings->max_memory && capacity * sizeof (json_char) > settings->max_memory)
+            || ! (buffer = (json_char *) settings->mem_alloc
+                     (capacity * sizeof (json_char), 0, settings->user_data)) )
+      {
+         return 0;
+      }
+
+      if (reader->length)
+         memcpy (buffer, reader->buffer, reader->length * sizeof (json_char));
+
+      settings->mem_free (reader->buffer, settings->user_data);
+
+      reader->buffer = buffer;
+      reader->capacity = capacity;
+   }
+
+   want = reader->length;
+
+   do
+   {
+      got = reader->read (reader->buffer + reader->length, reader->capacity - reader->length,
+                          reader->user_data);
+
+      if (!got)
+      {
+         reader->eof = 1;
+         break;
+      }
+
+      reader->length += got;
+      want -= got < want ? got : want;
+
+   } while (want && reader->length < reader->capacity);
+
+   reader->json = reader->buffer;
+
+   return 1;
+}
+
+json_value * json_reader_next (json_reader * reader, char * error_buf)
+{
+   unsigned int line = 0;
+   const json_char * line_begin;
+   json_value * root;
+   size_t stop;
+
+   if (error_buf)
+      strcpy (error_buf, reader->error);
+
+   if (*reader->error)
+      return 0;
+
+   json_document_reset (reader->doc);
+
+   for (;;)
+   {
+      int more = reader->read && !reader->eof;
+
+      reader->position = skip_whitespace (reader->json + reader->position,
+                                          reader->json + reader->length, &line, &line_begin)
+                            - reader->json;
+
+      reader->offset = reader->base + reader->position;
+
+      if (reader->position < reader->length)
+      {
+         root = parse_ex (&reader->doc->settings, reader->doc, 0, reader->json + reader->position,
+                          reader->length - reader->position, &stop, reader->error);
+
+         /* a value that runs up to the end of what's been read may go on
+          * (a number), and a failure near the end may only be for the want
+          * of what's to come: if there's more, read it and start again
+          */
+
+         if (root && (reader->position + stop < reader->length || !more))
+         {
+            reader->position += stop;
+            return root;
+         }
+
+         if (!root && (reader->length - reader->position - stop > 16 || !more))
+         {
+            if (error_buf)
+               strcpy (error_buf, reader->error);
+
+            return 0;
+         }
+
+         *reader->error = 0;
+         json_document_reset (reader->doc);
+      }
+      else if (!more)
+         return 0;
+
+      if (!reader_fill (reader))
+      {
+         strcpy (reader->error, "Memory allocation failure");
+
+         if (error_buf)
+            strcpy (error_buf, reader->error);
+
+         return 0;
+      }
+   }
+}
+
+size_t json_reader_offset (json_reader * reader)
+{
+   return reader->offset;
+}
+
+void json_reader_free (json_reader * reader)
+{
+   json_document * doc;
+
+   if (!reader)
+      return;
+
+   doc = reader->doc;
+
+   doc->settings.mem_free (reader->buffer, doc->settings.user_data);
+   doc->settings.mem_free (reader, doc->settings.user_data);
+
+   json_document_free (doc);
+}
+
+/* Files: a regular file is mapped (privately, so that a parse in situ
+ * writes to copies of its pages and never to the file), and anything else
+ * (a pipe, a terminal, or where there's no mmap) read into memory, which
+ * counts against max_memory as a reader's buffer does.
+ */
+static int file_read (json_settings * settings, int fd, size_t size, json_held * held)
+{
+   size_t capacity = size ? size + 1 : 65536, want;
+   json_char * text;
+   long got;
+
+   for (;;)
+   {
+      if (held->length == capacity || !held->text)
+      {
+         if (held->text && (capacity *= 2) < held->length)
+            return 0;
+
+         if ((settings->max_memory && capacity * sizeof (json_char) > settings->max_memory)
+               || ! (text = (json_char *) settings->mem_alloc
+                        (capacity * sizeof (json_char), 0, settings->user_data)) )
+         {
+            return 0;
+         }
+
+         if (held->text)
+         {
+            memcpy (text, held->text, held->length * sizeof (json_char));
+            settings->mem_free (held->text, settings->user_data);
+         }
+
+         held->text = text;
+      }
+
+      if ((want = capacity - held->length) > 0x40000000)
+         want = 0x40000000;
+
+      got = (long) read (fd, held->text + held->length, (unsigned int) want);
+
+      if (got == 0)
+         return 1;
+
+      if (got < 0)
+      {
+         if (errno == EINTR)
+            continue;
+
+         return -1;
+      }
+
+      held->length += (size_t) got;
+   }
+}
+
+/* Returns 0 with `error` set on failure */
+static int file_load (json_settings * settings, const char * path, int writable,
+                      json_held * held, char * error)
+{
+   size_t size = 0;
+   int fd, loaded;
+
+   memset (held, 0, sizeof (json_held));
+
+   if ((fd = open (path, O_RDONLY | O_BINARY)) == -1)
+   {
+      if (error)
+         sprintf (error, "Can't open the file: %.100s", strerror (errno));
+
+      return 0;
+   }
+
+   #ifndef _WIN32
+   {
+      struct stat st;
+      void * map;
+
+      if (!fstat (fd, &st) && S_ISREG (st.st_mode) && st.st_size > 0
+            && (uint64_t) st.st_size == (size_t) st.st_size)
+      {
+         size = (size_t) st.st_size;
+
+         map = mmap (0, size, PROT_READ | (writable ? PROT_WRITE : 0), MAP_PRIVATE, fd, 0);
+
+         if (map != MAP_FAILED)
+         {
+            #ifdef MADV_SEQUENTIAL
+               madvise (map, size, MADV_SEQUENTIAL);
+            #endif
+
+            close (fd);
+
+            held->text = (json_char *) map;
+            held->length = size;
+            held->mapped = 1;
+
+            return 1;
+         }
+      }
+   }
+   #endif
+
+   if ((loaded = file_read (settings, fd, size, held)) <= 0)
+   {
+      if (error)
+      {
+         if (loaded < 0)
+            sprintf (error, "Can't read the file: %.100s", strerror (errno));
+         else
+            strcpy (error, "Memory allocation failure");
+      }
+
+      settings->mem_free (held->text, settings->user_data);
+   }
+
+   close (fd);
+
+   return loaded > 0;
+}
+
+json_value * json_parse_file (json_settings * settings, const char * path, char * error_buf)
+{
+   json_settings file_settings;
+   json_value * value;
+   json_held held;
+
+   settings_init (&file_settings, settings);
+
+   if (!file_load (&file_settings, path, 0, &held, error_buf))
+      return 0;
+
+   value = json_parse_n (settings, held.text, held.length, error_buf);
+
+   held_release (&file_settings, &held);
+
+   return value;
+}
+
+json_value * json_document_parse_file (json_document * doc, const char * path, char * error_buf)
+{
+   json_value * value;
+   json_held * held;
+
+   if (! (held = (json_held *) doc->settings.mem_alloc
+            (sizeof (json_held), 0, doc->settings.user_data)) )
+   {
+      if (error_buf)
+         strcpy (error_buf, "Memory allocation failure");
+
+      return 0;
+   }
+
+   if (!file_load (&doc->settings, path, 1, held, error_buf))
+   {
+      doc->settings.mem_free (held, doc->settings.user_data);
+      return 0;
+   }
+
+   if (! (value = parse_ex (&doc->settings, doc, 1, held->text, held->length, 0, error_buf)) )
+   {
+      held_release (&doc->settings, held);
+      doc->settings.mem_free (held, doc->settings.user_data);
+
+      return 0;
+   }
+
+   held->next = doc->held;
+   doc->held = held;
+
+   return value;
+}
+
+/* Push parsers run the parse over each piece of input as it comes, always
+ * in a single pass.  A string, number or literal cut off by the end of a
+ * piece is kept back in `carry` and parsed once the rest of it has come.
+ */
+struct _json_parser
+{
+   json_parse_state parse;
+
+   json_char * carry;
+   size_t carry_length, carry_capacity;
+
+   int status;  /* 1 once finished, -1 after a failure */
+};
+
+static json_parser * parser_new (json_settings * settings, json_document * doc)
+{
+   json_settings parser_settings;
+   json_parser * parser;
+
+   settings_init (&parser_settings, settings);
+
+   if (! (parser = (json_parser *) parser_settings.mem_alloc
+         (sizeof (json_parser), 1, parser_settings.user_data)) )
+   {
+      return 0;
+   }
+
+   parse_init (&parser->parse, settings, doc, 0);
+   parse_start (&parser->parse);
+
+   parser->parse.state.single_pass = 1;
+   parser->parse.state.first_pass = 0;
+
+   return parser;
+}
+
+json_parser * json_parser_new (json_settings * settings)
+{
+   return parser_new (settings, 0);
+}
+
+json_parser * json_document_parser_new (json_document * doc)
+{
+   return parser_new (&doc->settings, doc);
+}
+
+static int carry_add (json_parser * parser, const json_char * json, size_t length)
+{
+   json_settings * settings = &parser->parse.state.settings;
+
+   if (parser->carry_capacity - parser->carry_length < length)
+   {
+      size_t capacity = parser->carry_capacity ? parser->carry_capacity : 64;
+      json_char * carry;
+
+      while (capacity - parser->carry_length < length)
+      {
+         if (capacity * 2 < capacity)
+            return 0;
+
+         capacity *= 2;
+      }
+
+      if ((settings->max_memory && capacity * sizeof (json_char) > settings->max_memory)
+            || ! (carry = (json_char *) settings->mem_alloc
+                     (capacity * sizeof (json_char), 0, settings->user_data)) )
+      {
+         return 0;
+      }
+
+      if (parser->carry_length)
+         memcpy (carry, parser->carry, parser->carry_length * sizeof (json_char));
+
+      settings->mem_free (parser->carry, settings->user_data);
+
+      parser->carry = carry;
+      parser->carry_capacity = capacity;
+   }
+
+   if (length)
+      memcpy (parser->carry + parser->carry_length, json, length * sizeof (json_char));
+
+   parser->carry_length += length;
+
+   return 1;
+}
+
+/* How much of json [0, length) the token in the carry needs to be over
+ * (with the character after it, for a number), or all of it if that isn't
+ * enough, leaving *over 0
+ */
+static size_t carry_rest (json_parser * parser, const json_char * json, size_t length,
+                          int * over)
+{
+   const json_char * carry = parser->carry, * i = json, * end = json + length;
+   size_t n = parser->carry_length, backslashes = 0, want;
+
+   *over = 0;
+
+   switch (*carry)
+   {
+      case '"':
+
+         /* an odd number of backslashes at the end of the carry escape
+          * whatever comes first
+          */
+
+         while (backslashes < n - 1 && carry [n - 1 - backslashes] == '\\')
+            ++ backslashes;
+
+         if (backslashes % 2 && i < end)
+            ++ i;
+
+         if ((i += string_span (i, end)) == end)
+            return length;
+
+         break;
+
+      case 't': case 'n': case 'f':
+
+         want = (*carry == 'f' ? 5 : 4) - n;
+
+         if (want > length)
+            return length;
+
+         *over = 1;
+         return want;
+
+      default:
+
+         while (i < end && (isdigit ((int) *i) || *i == '.' || *i == 'e'
+                               || *i == 'E' || *i == '+' || *i == '-'))
+         {
+            ++ i;
+         }
+
+         if (i == end)
+            return length;
+
+         break;
+   };
+
+   *over = 1;
+   return i + 1 - json;
+}
+
+static int parser_fail (json_parser * parser, char * error_buf)
+{
+   if (!parser->status)
+   {
+      parser->status = -1;
+      parse_abort (&parser->parse);
+   }
+
+   if (error_buf)
+      strcpy (error_buf, parser->parse.error);
+
+   return 0;
+}
+
+int json_parser_feed (json_parser * parser, const json_char * json, size_t length,
+                      char * error_buf)
+{
+   json_parse_state * p = &parser->parse;
+   size_t stop, taken;
+   int over;
+
+   if (parser->status)
+   {
+      if (parser->status > 0)
+         strcpy (p->error, "Parse already finished");
+
+      return parser_fail (parser, error_buf);
+   }
+
+   while (parser->carry_length)
+   {
+      taken = carry_rest (parser, json, length, &over);
+
+      if (!carry_add (parser, json, taken))
+      {
+         strcpy (p->error, "Memory allocation failure");
+         return parser_fail (parser, error_buf);
+      }
+
+      json += taken;
+      length -= taken;
+
+      if (!over)
+         return 1;
+
+      if (parse_run (p, parser->carry, parser->carry_length, 1, 0, &stop) < 0)
+         return parser_fail (parser, error_buf);
+
+      /* what's left is the start of a token after that one */
+
+      parser->carry_length -= stop;
+      memmove (parser->carry, parser->carry + stop, parser->carry_length * sizeof (json_char));
+   }
+
+   if (parse_run (p, json, length, 1, 0, &stop) < 0)
+      return parser_fail (parser, error_buf);
+
+   if (!carry_add (parser, json + stop, length - stop))
+   {
+      strcpy (p->error, "Memory allocation failure");
+      return parser_fail (parser, error_buf);
+   }
+
+   return 1;
+}
+
+json_value * json_parser_finish (json_parser * parser, char * error_buf)
+{
+   static const json_char nothing = 0;
+   json_parse_state * p = &parser->parse;
+   size_t stop;
+
+   if (parser->status)
+   {
+      if (parser->status > 0)
+         strcpy (p->error, "Parse already finished");
+
+      parser_fail (parser, error_buf);
+      return 0;
+   }
+
+   if (parse_run (p, parser->carry_length ? parser->carry : &nothing,
+                  parser->carry_length, 0, 0, &stop) < 0)
+   {
+      parser_fail (parser, error_buf);
+      return 0;
+   }
+
+   parser->carry_length = 0;
+   parser->status = 1;
+
+   return parse_done (p);
+}
+
+void json_parser_free (json_parser * parser)
+{
+   json_settings settings;
+
+   if (!parser)
+      return;
+
+   settings = parser->parse.state.settings;
+
+   if (!parser->status)
+      parse_abort (&parser->parse);
+
+   settings.mem_free (parser->carry, settings.user_data);
+   settings.mem_free (parser, settings.user_data);
+}
+
+/* Lazy documents check the whole input up front, with the two stage
+ * engine's structural index, then only step over it: cursors hold the position of a value
+ * and, in an object, of its key.  Nothing is decoded until it's asked for,
+ * and what is (strings, and the values built by json_cursor_value) goes
+ * into the lazy document's own document.
+ */
+struct _json_lazy
+{
+   json_document * doc;
+
+   const json_char * json, * end;
+
+   json_stack scratch;  /* keys with escapes, decoded to compare them */
+};
+
+json_lazy * json_lazy_new (json_settings * settings, const json_char * json,
+                           size_t length, char * error_buf)
+{
+   static const json_handler none = { 0 };
+   json_parse_state p;
+   json_document * doc;
+   json_lazy * lazy;
+   int valid;
+
+   if (! (doc = json_document_new (settings)) )
+   {
+      if (error_buf)
+         strcpy (error_buf, "Memory allocation failure");
+
+      return 0;
+   }
+
+   /* the quick check first, with the parse loop for the verdict (and the
+    * error) if that fails
+    */
+
+   parse_init (&p, &doc->settings, doc, 0);
+
+   valid = !(doc->settings.settings & json_relaxed_commas) && length < 0xFFFFFFFF
+              && validate_structurals (&p.state, json, length);
+
+   parse_done (&p);
+
+   if (!valid && !json_parse_events (&doc->settings, &none, 0, json, length, error_buf))
+   {
+      json_document_free (doc);
+      return 0;
+   }
+
+   if (! (lazy = (json_lazy *) doc->settings.mem_alloc
+         (sizeof (json_lazy), 1, doc->settings.user_data)) )
+   {
+      if (error_buf)
+         strcpy (error_buf, "Memory allocation failure");
+
+      json_document_free (doc);
+      return 0;
+   }
+
+   lazy->doc = doc;
+   lazy->json = json;
+   lazy->end = json + length;
+
+   return lazy;
+}
+
+void json_lazy_free (json_lazy * lazy)
+{
+   json_document * doc;
+
+   if (!lazy)
+      return;
+
+   doc = lazy->doc;
+
+   stack_free (&doc->settings, &lazy->scratch);
+   doc->settings.mem_free (lazy, doc->settings.user_data);
+
+   json_document_free (doc);
+}
+
+static const json_char * lazy_space (const json_char * i, const json_char * end)
+{
+   unsigned int line = 0;
+   const json_char * line_begin;
+
+   return skip_whitespace (i, end, &line, &line_begin);
+}
+
+/* Past the end of the value at `i`, which is known to be valid: strings are
+ * run through with scan_string, and arrays and objects stepped over by
+ * matching their brackets, without looking at what's inside.
+ */
+static const json_char * lazy_skip (const json_char * i, const json_char * end)
+{
+   int depth = 0;
+
+   switch (*i)
+   {
+      case '"':
+         return i + 1 + string_span (i + 1, end) + 1;
+
+      case '{': case '[':
+
+         for (;;)
+         {
+            switch (*i ++)
+            {
+               case '"':
+                  i += string_span (i, end) + 1;
+                  break;
+
+               case '{': case '[':
+                  ++ depth;
+                  break;
+
+               case '}': case ']':
+
+                  if (! -- depth)
+                     return i;
+
+                  break;
+            };
+         }
+
+      default:
+
+         while (i < end && !strchr (" \t\r\n,]}", *i))
+            ++ i;
+
+         return i;
+   };
+}
+
+/* Onto the object member whose key starts at `i` */
+static void lazy_member (json_cursor * cursor, const json_char * i)
+{
+   const json_char * end = cursor->lazy->end;
+
+   cursor->key = i;
+   cursor->value = lazy_space (lazy_space (lazy_skip (i, end), end) + 1, end);
+}
+
+json_cursor json_lazy_root (json_lazy * lazy)
+{
+   json_cursor cursor;
+
+   cursor.lazy = lazy;
+   cursor.key = 0;
+   cursor.value = lazy_space (lazy->json, lazy->end);
+
+   return cursor;
+}
+
+json_type json_cursor_type (const json_cursor * cursor)
+{
+   json_value number;
+   const json_char * i = cursor->value;
+
+   switch (*i)
+   {
+      case '{':  return json_object;
+      case '[':  return json_array;
+      case '"':  return json_string;
+      case 't': case 'f':  return json_boolean;
+      case 'n':  return json_null;
+
+      default:
+
+         memset (&number, 0, sizeof (json_value));
+         parse_number (&number, &i, cursor->lazy->end);
+
+         return number.type;
+   };
+}
+
+int json_cursor_enter (json_cursor * cursor)
+{
+   const json_char * i, * end = cursor->lazy->end;
+
+   if (*cursor->value != '{' && *cursor->value != '[')
+      return 0;
+
+   i = lazy_space (cursor->value + 1, end);
+
+   if (*i == '}' || *i == ']')
+      return 0;
+
+   if (*cursor->value == '{')
+      lazy_member (cursor, i);
+   else
+   {  cursor->key = 0;
+      cursor->value = i;
+   }
+
+   return 1;
+}
+
+int json_cursor_next (json_cursor * cursor)
+{
+   const json_char * i, * end = cursor->lazy->end;
+
+   i = lazy_space (lazy_skip (cursor->value, end), end);
+
+   if (i == end || *i != ',')
+      return 0;
+
+   /* a trailing comma, with json_relaxed_commas? */
+
+   i = lazy_space (i + 1, end);
+
+   if (*i == '}' || *i == ']')
+      return 0;
+
+   if (cursor->key)
+      lazy_member (cursor, i);
+   else
+      cursor->value = i;
+
+   return 1;
+}
+
+/* Does the key starting at `quote` read `key`?  Keys with no escapes are
+ * compared where they are, others decoded into the scratch stack first.
+ */
+static int lazy_key_is (json_lazy * lazy, const json_char * quote,
+                        const json_char * key, size_t length)
+{
+   const json_char * i = quote + 1, * bad;
+   size_t span = string_span (i, lazy->end);
+   unsigned int decoded;
+   json_char * string;
+
+   if (scan_string (i, span) == span)
+      return span == length && !memcmp (i, key, length * sizeof (json_char));
+
+   if (span < length)
+      return 0;
+
+   lazy->scratch.length = 0;
+
+   if (! (string = (json_char *) stack_push (&lazy->doc->settings, &lazy->scratch,
+                                             (span + 1) * sizeof (json_char))) )
+   {
+      return 0;
+   }
+
+   decode_string (i, lazy->end, string, &decoded, &bad);
+
+   return decoded == length && !memcmp (string, key, length * sizeof (json_char));
+}
+
+int json_cursor_find (json_cursor * cursor, const json_char * key)
+{
+   json_cursor member = *cursor;
+   size_t length = strlen (key);
+
+   if (*cursor->value != '{' || !json_cursor_enter (&member))
+      return 0;
+
+   do
+   {
+      if (lazy_key_is (cursor->lazy, member.key, key, length))
+      {
+         *cursor = member;
+         return 1;
+      }
+
+   } while (json_cursor_next (&member));
+
+   return 0;
+}
+
+/* Decode the string starting at `quote` into the document */
+static const json_char * lazy_string (json_lazy * lazy, const json_char * quote,
+                                      unsigned int * length)
+{
+   json_document * doc = lazy->doc;
+   size_t size = (string_span (quote + 1, lazy->end) + 1) * sizeof (json_char);
+   json_char * string;
+   const json_char * bad;
+
+   if (doc->settings.max_memory && (doc->used_memory += size) > doc->settings.max_memory)
+      return 0;
+
+   if (! (string = (json_char *) arena_alloc (&doc->settings, &doc->arena, size)) )
+      return 0;
+
+   decode_string (quote + 1, lazy->end, string, length, &bad);
+
+   /* give back what the escapes saved */
+
+   arena_shrink (&doc->arena, string, (*length + 1) * sizeof (json_char));
+
+   if (doc->settings.max_memory)
+      doc->used_memory -= size - (*length + 1) * sizeof (json_char);
+
+   return string;
+}
+
+const json_char * json_cursor_key (const json_cursor * cursor, unsigned int * length)
+{
+   unsigned int key_length;
+
+   if (!cursor->key)
+      return 0;
+
+   return lazy_string (cursor->lazy, cursor->key, length ? length : &key_length);
+}
+
+const json_char * json_cursor_get_string (const json_cursor * cursor, unsigned int * length)
+{
+   unsigned int string_length;
+
+   if (*cursor->value != '"')
+      return 0;
+
+   return lazy_string (cursor->lazy, cursor->value, length ? length : &string_length);
+}
+
+int json_cursor_get_int (const json_cursor * cursor, json_int_t * x)
+{
+   json_value number;
+   const json_char * i = cursor->value;
+
+   memset (&number, 0, sizeof (json_value));
+
+   if (!(isdigit ((unsigned char) *i) || *i == '-')
+         || parse_number (&number, &i, cursor->lazy->end) || number.type != json_integer)
+   {
+      return 0;
+   }
+
+   *x = number.u.integer;
+
+   return 1;
+}
+
+int json_cursor_get_double (const json_cursor * cursor, double * x)
+{
+   json_value number;
+   const json_char * i = cursor->value;
+
+   memset (&number, 0, sizeof (json_value));
+
+   if (!(isdigit ((unsigned char) *i) || *i == '-')
+         || parse_number (&number, &i, cursor->lazy->end))
+   {
+      return 0;
+   }
+
+   *x = number.type == json_integer ? (double) number.u.integer : number.u.dbl;
+
+   return 1;
+}
+
+int json_cursor_get_bool (const json_cursor * cursor, int * x)
+{
+   if (*cursor->value != 't' && *cursor->value != 'f')
+      return 0;
+
+   *x = *cursor->value == 't';
+
+   return 1;
+}
+
+json_value * json_cursor_value (const json_cursor * cursor, char * error_buf)
+{
+   json_document * doc = cursor->lazy->doc;
+   const json_char * end = lazy_skip (cursor->value, cursor->lazy->end);
+
+   return parse_ex (&doc->settings, doc, 0, cursor->value, end - cursor->value, 0, error_buf);
+}
+
+/* Tapes are built from the events of a parse: nodes are appended to one
+ * growing array, and strings (terminated) to another, their nodes holding
+ * their offsets in it for now.  The open containers' nodes are on a stack,
+ * to count their elements in and to set their skip once they're closed.
+ * At the end, the header, the nodes and the strings are copied into a
+ * single block of exactly the size needed, and the offsets made pointers.
+ */
+struct _json_tape
+{
+   json_settings settings;
+   size_t count;  /* nodes */
+};
+
+#define tape_nodes(tape) ((json_node *) ((json_tape *) (tape) + 1))
+
+typedef struct
+{
+   json_settings settings;
+   json_stack nodes, strings, open;
+
+   int failed;  /* out of memory, rather than stopped by the grammar */
+
+} json_tape_state;
+
+static json_node * tape_push (json_tape_state * state, json_type type)
+{
+   json_node * node;
+
+   if (state->open.length)
+   {
+      json_node * parent = (json_node *) state->nodes.mem + *stack_top (state->open, size_t);
+
+      if (parent->type == json_array)
+         ++ parent->length;
+   }
+
+   if ((state->settings.max_memory && state->nodes.length + state->strings.length
+            + sizeof (json_node) > state->settings.max_memory)
+         || ! (node = (json_node *) stack_push (&state->settings, &state->nodes, sizeof (json_node))) )
+   {
+      state->failed = 1;
+      return 0;
+   }
+
+   node->type = type;
+   node->length = 0;
+   node->u.skip = 1;
+
+   return node;
+}
+
+static int tape_open (json_tape_state * state, json_type type)
+{
+   size_t * index;
+
+   if (!tape_push (state, type))
+      return 0;
+
+   if (! (index = (size_t *) stack_push (&state->settings, &state->open, sizeof (size_t))) )
+   {
+      state->failed = 1;
+      return 0;
+   }
+
+   *index = state->nodes.length / sizeof (json_node) - 1;
+
+   return 1;
+}
+
+static int tape_close (json_tape_state * state)
+{
+   size_t index = *stack_top (state->open, size_t);
+
+   ((json_node *) state->nodes.mem) [index].u.skip = state->nodes.length / sizeof (json_node) - index;
+   state->open.length -= sizeof (size_t);
+
+   return 1;
+}
+
+static int tape_text (json_tape_state * state, json_node * node, const json_char * text, unsigned int length)
+{
+   size_t size = (length + 1) * sizeof (json_char);
+   json_char * copy;
+
+   if (!node
+         || (state->settings.max_memory && state->nodes.length + state->strings.length
+               + size > state->settings.max_memory)
+         || ! (copy = (json_char *) stack_push (&state->settings, &state->strings, size)) )
+   {
+      state->failed = 1;
+      return 0;
+   }
+
+   memcpy (copy, text, size);
+
+   node->length = length;
+   node->u.skip = state->strings.length - size;  /* made a pointer at the end */
+
+   return 1;
+}
+
+static int tape_start_object (void * data)
+{
+   return tape_open ((json_tape_state *) data, json_object);
+}
+
+static int tape_start_array (void * data)
+{
+   return tape_open ((json_tape_state *) data, json_array);
+}
+
+static int tape_end (void * data)
+{
+   return tape_close ((json_tape_state *) data);
+}
+
+static int tape_key (const json_char * name, unsigned int length, void * data)
+{
+   json_tape_state * state = (json_tape_state *) data;
+
+   ++ ((json_node *) state->nodes.mem) [*stack_top (state->open, size_t)].length;
+
+   return tape_text (state, tape_push (state, json_string), name, length);
+}
+
+static int tape_string (const json_char * string, unsigned int length, void * data)
+{
+   json_tape_state * state = (json_tape_state *) data;
+
+   return tape_text (state, tape_push (state, json_string), string, length);
+}
+
+static int tape_integer (json_int_t value, void * data)
+{
+   json_node * node = tape_push ((json_tape_state *) data, json_integer);
+
+   if (node)
+      node->u.integer = value;
+
+   return node != 0;
+}
+
+static int tape_double (double value, void * data)
+{
+   json_node * node = tape_push ((json_tape_state *) data, json_double);
+
+   if (node)
+      node->u.dbl = value;
+
+   return node != 0;
+}
+
+static int tape_boolean (int value, void * data)
+{
+   json_node * node = tape_push ((json_tape_state *) data, json_boolean);
+
+   if (node)
+      node->u.boolean = value;
+
+   return node != 0;
+}
+
+static int tape_null (void * data)
+{
+   return tape_push ((json_tape_state *) data, json_null) != 0;
+}
+
+static const json_handler tape_handler =
+{
+   tape_start_object, tape_key, tape_end,
+   tape_start_array, tape_end,
+   tape_string, tape_integer, tape_double, tape_boolean, tape_null
+};
+
+json_tape * json_tape_parse (json_settings * settings, const json_char * json,
+                             size_t length, char * error_buf)
+{
+   json_tape_state state;
+   json_tape * tape = 0;
+   json_node * node, * end;
+   json_char * strings;
+   char error [128];
+
+   memset (&state, 0, sizeof (state));
+   settings_init (&state.settings, settings);
+
+   if (json_parse_events (settings, &tape_handler, &state, json, length, error))
+   {
+      if ( (tape = (json_tape *) state.settings.mem_alloc
+               (sizeof (json_tape) + state.nodes.length + state.strings.length,
+                0, state.settings.user_data)) )
+      {
+         tape->settings = state.settings;
+         tape->count = state.nodes.length / sizeof (json_node);
+
+         node = tape_nodes (tape);
+         end = node + tape->count;
+         strings = (json_char *) end;
+
+         memcpy (node, state.nodes.mem, state.nodes.length);
+         if (state.strings.length)
+            memcpy (strings, state.strings.mem, state.strings.length);
+
+         for (; node < end; ++ node)
+         {
+            if (node->type == json_string)
+               node->u.string = strings + node->u.skip / sizeof (json_char);
+         }
+
+         if (error_buf)
+            *error_buf = 0;
+      }
+      else
+         state.failed = 1;
+   }
+
+   if (error_buf && !tape)
+      strcpy (error_buf, state.failed ? "Memory allocation failure" : error);
+
+   stack_free (&state.settings, &state.nodes);
+   stack_free (&state.settings, &state.strings);
+   stack_free (&state.settings, &state.open);
+
+   return tape;
+}
+
+const json_node * json_tape_root (const json_tape * tape)
+{
+   return tape_nodes (tape);
+}
+
+size_t json_tape_size (const json_tape * tape)
+{
+   return tape->count;
+}
+
+void json_tape_free (json_tape * tape)
+{
+   if (tape)
+      tape->settings.mem_free (tape, tape->settings.user_data);
+}
+
+const json_node * json_node_next (const json_node * node)
+{
+   return node + (node->type == json_array || node->type == json_object ? node->u.skip : 1);
+}
+
+const json_node * json_node_at (const json_node * array, unsigned int index)
+{
+   const json_node * node;
+
+   if (!array || array->type != json_array || index >= array->length)
+      return 0;
+
+   for (node = array + 1; index; -- index)
+      node = json_node_next (node);
+
+   return node;
+}
+
+const json_node * json_node_find (const json_node * object, char const * field)
+{
+   const json_node * key;
+   unsigned int i;
+   size_t length;
+
+   if (!object || object->type != json_object)
+      return 0;
+
+   length = strlen (field);
+
+   for (i = 0, key = object + 1; i < object->length; ++ i, key = json_node_next (key + 1))
+   {
+      if (key->length == length && !memcmp (key->u.string, field, length * sizeof (json_char)))
+         return key + 1;
+   }
+
+   return 0;
+}
+
+/* Schemas: an example value compiled into a table of ops in document order,
+ * one for each value, an array or object's taking up `skip` ops with all it
+ * holds (as nodes do on a tape).  An object's members are found through a
+ * table of slots (op index plus one) by the hash of their key, as an index
+ * finds keys.  Checks keep their place in a fixed stack of frames: no value
+ * can pass deeper than the example goes, and it goes no deeper than this.
+ */
+#define schema_max_depth 128
+
+#define schema_member   1  /* the op has a key */
+#define schema_uniform  2  /* every element takes the op after */
+
+typedef struct
+{
+   json_type type;
+   unsigned int flags;
+   unsigned int length;  /* members or elements */
+   unsigned int skip;
+
+   unsigned int key_length;
+   uint32_t hash;
+   uint32_t table, mask;  /* of an object: first slot, slots less one */
+   const json_char * key;
+
+} schema_op;
+
+struct _json_schema
+{
+   json_settings settings;
+   unsigned int count;  /* ops */
+   schema_op * ops;
+   uint32_t * slots;
+};
+
+typedef struct
+{
+   const schema_op * op, * at;  /* an array or object, and the child last gone to */
+   unsigned int index;          /* children gone to */
+   const json_value * value;
+
+} schema_frame;
+
+static const char * schema_type_name (json_type type)
+{
+   switch (type)
+   {
+      case json_object:  return "an object";
+      case json_array:   return "an array";
+      case json_integer: return "an integer";
+      case json_double:  return "a double";
+      case json_string:  return "a string";
+      case json_boolean: return "a boolean";
+      case json_null:    return "null";
+      default:           return "nothing";
+   };
+}
+
+/* The JSON pointer to the child at the top of the first `depth` frames,
+ * cut short to fit `size`
+ */
+static void schema_path (const schema_frame * frames, unsigned int depth, char * path, size_t size)
+{
+   size_t used = 0;
+   char index [16];
+   const json_char * step;
+   unsigned int i;
+
+   for (i = 0; i < depth; ++ i)
+   {
+      if (frames [i].op->type == json_object)
+         step = frames [i].at->key;
+      else
+      {
+         sprintf (index, "%u", frames [i].index - 1);
+         step = index;
+      }
+
+      if (used + 1 < size)
+         path [used ++] = '/';
+
+      for (; *step && used + 1 < size; ++ step)
+      {
+         if (*step == '~' || *step == '/')
+         {
+            if (used + 2 >= size)
+               break;
+
+            path [used ++] = '~';
+            path [used ++] = *step == '~' ? '0' : '1';
+         }
+         else
+            path [used ++] = *step;
+      }
+   }
+
+   path [used] = 0;
+}
+
+/* Writes where the check failed and why, as "/a/0: Expected an integer" */
+static void schema_error (char * error, const schema_frame * frames, unsigned int depth, const char * message)
+{
+   char path [48];
+
+   if (!error)
+      return;
+
+   schema_path (frames, depth, path, sizeof (path));
+
+   sprintf (error, "%s%s%.60s", path, *path ? ": " : "", message);
+}
+
+static schema_op * schema_emit (json_settings * settings, json_stack * ops,
+                                const json_value * value, const json_char * key, int options)
+{
+   schema_op * op = (schema_op *) stack_push (settings, ops, sizeof (schema_op));
+
+   if (!op)
+      return 0;
+
+   memset (op, 0, sizeof (schema_op));
+
+   op->type = value->type;
+   op->skip = 1;
+
+   if (value->type == json_object)
+      op->length = value->u.object.length;
+   else if (value->type == json_array)
+   {
+      op->length = value->u.array.length;
+
+      if ((options & json_schema_uniform_arrays) && op->length == 1)
+         op->flags |= schema_uniform;
+   }
+
+   if (key)
+   {
+      op->flags |= schema_member;
+      op->key = key;  /* the example's, until it's copied */
+      op->key_length = strlen (key);
+      op->hash = json_key_hash (key, op->key_length);
+   }
+
+   return op;
+}
+
+/* Lays out the slots of the object at `index`, once its members are in.
+ * Returns 0 (leaving `error` as it should be) if a key comes twice.
+ */
+static int schema_table (json_settings * settings, json_stack * ops, json_stack * slots,
+                         unsigned int index, char * error)
+{
+   schema_op * op = (schema_op *) ops->mem + index, * member;
+   uint32_t count = 2, * table, slot;
+   unsigned int i;
+
+   while (count < op->length * 2)
+      count *= 2;
+
+   op->table = slots->length / sizeof (uint32_t);
+   op->mask = count - 1;
+
+   if (! (table = (uint32_t *) stack_push (settings, slots, count * sizeof (uint32_t))) )
+   {
+      strcpy (error, "Memory allocation failure");
+      return 0;
+   }
+
+   memset (table, 0, count * sizeof (uint32_t));
+
+   for (i = 0, member = op + 1; i < op->length; ++ i, member += member->skip)
+   {
+      for (slot = member->hash & op->mask; table [slot]; slot = (slot + 1) & op->mask)
+      {
+         const schema_op * other = (schema_op *) ops->mem + table [slot] - 1;
+
+         if (other->hash == member->hash && !strcmp (other->key, member->key))
+         {
+            sprintf (error, "Duplicate key in the schema: %.80s", member->key);
+            return 0;
+         }
+      }
+
+      table [slot] = (uint32_t) (member - (schema_op *) ops->mem) + 1;
+   }
+
+   return 1;
+}
+
+typedef struct
+{
+   const json_value * value;
+   unsigned int op, index;  /* the value's op, and its children gone to */
+
+} schema_compile_frame;
+
+static int schema_compile_push (json_settings * settings, json_stack * frames, const json_value * value,
+                                unsigned int op, char * error)
+{
+   schema_compile_frame * frame;
+
+   if (frames->length / sizeof (schema_compile_frame) == schema_max_depth)
+   {
+      sprintf (error, "Schema nested over %d deep", schema_max_depth);
+      return 0;
+   }
+
+   if (! (frame = (schema_compile_frame *) stack_push (settings, frames, sizeof (schema_compile_frame))) )
+      return 0;
+
+   frame->value = value;
+   frame->op = op;
+   frame->index = 0;
+
+   return 1;
+}
+
+json_schema * json_schema_compile (json_settings * settings, const json_value * example,
+                                   int options, char * error_buf)
+{
+   json_settings schema_settings;
+   json_stack ops = { 0, 0, 0 }, slots = { 0, 0, 0 }, keys = { 0, 0, 0 }, frames = { 0, 0, 0 };
+   json_schema * schema = 0;
+   schema_compile_frame * frame;
+   schema_op * op, * end;
+   const json_value * child;
+   json_char * key;
+   size_t header = align_size (sizeof (json_schema));
+   char error [128];
+   unsigned int i;
+
+   settings_init (&schema_settings, settings);
+   strcpy (error, "Memory allocation failure");
+
+   if (!example)
+   {
+      strcpy (error, "No example to compile");
+      goto done;
+   }
+
+   if (! (op = schema_emit (&schema_settings, &ops, example, 0, options))
+         || (op->length && !schema_compile_push (&schema_settings, &frames, example, 0, error)) )
+   {
+      goto done;
+   }
+
+   while (frames.length)
+   {
+      frame = stack_top (frames, schema_compile_frame);
+      op = (schema_op *) ops.mem + frame->op;
+
+      /* of an array taken as uniform, only the first element */
+      if (frame->index == ((op->flags & schema_uniform) ? 1 : op->length))
+      {
+         op->skip = ops.length / sizeof (schema_op) - frame->op;
+
+         if (op->type == json_object
+               && !schema_table (&schema_settings, &ops, &slots, frame->op, error))
+         {
+            goto done;
+         }
+
+         frames.length -= sizeof (schema_compile_frame);
+         continue;
+      }
+
+      i = frame->index ++;
+
+      if (frame->value->type == json_object)
+      {
+         child = frame->value->u.object.values [i].value;
+         op = schema_emit (&schema_settings, &ops, child, frame->value->u.object.values [i].name, options);
+      }
+      else
+      {
+         child = frame->value->u.array.values [i];
+         op = schema_emit (&schema_settings, &ops, child, 0, options);
+      }
+
+      if (!op || (op->length && !schema_compile_push
+            (&schema_settings, &frames, child, ops.length / sizeof (schema_op) - 1, error)) )
+      {
+         goto done;
+      }
+   }
+
+   /* empty objects get (empty) slots too, and every key is copied */
+   for (op = (schema_op *) ops.mem, end = op + ops.length / sizeof (schema_op); op < end; ++ op)
+   {
+      if (op->type == json_object && !op->length
+            && !schema_table (&schema_settings, &ops, &slots, op - (schema_op *) ops.mem, error))
+      {
+         goto done;
+      }
+
+      if (op->flags & schema_member)
+      {
+         if (! (key = (json_char *) stack_push
+                  (&schema_settings, &keys, (op->key_length + 1) * sizeof (json_char))) )
+         {
+            goto done;
+         }
+
+         memcpy (key, op->key, (op->key_length + 1) * sizeof (json_char));
+      }
+   }
+
+   if (! (schema = (json_schema *) schema_settings.mem_alloc
+            (header + ops.length + slots.length + keys.length, 0, schema_settings.user_data)) )
+   {
+      goto done;
+   }
+
+   schema->settings = schema_settings;
+   schema->count = ops.length / sizeof (schema_op);
+   schema->ops = (schema_op *) ((char *) schema + header);
+   schema->slots = (uint32_t *) ((char *) schema->ops + ops.length);
+   key = (json_char *) ((char *) schema->slots + slots.length);
+
+   memcpy (schema->ops, ops.mem, ops.length);
+
+   if (slots.length)
+      memcpy (schema->slots, slots.mem, slots.length);
+
+   if (keys.length)
+      memcpy (key, keys.mem, keys.length);
+
+   for (op = schema->ops, end = op + schema->count; op < end; ++ op)
+   {
+      if (op->flags & schema_member)
+      {
+         op->key = key;
+         key += op->key_length + 1;
+      }
+   }
+
+done:
+
+   if (error_buf)
+      strcpy (error_buf, schema ? "" : error);
+
+   stack_free (&schema_settings, &ops);
+   stack_free (&schema_settings, &slots);
+   stack_free (&schema_settings, &keys);
+   stack_free (&schema_settings, &frames);
+
+   return schema;
+}
+
+void json_schema_free (json_schema * schema)
+{
+   if (schema)
+      schema->settings.mem_free (schema, schema->settings.user_data);
+}
+
+/* The member of the object at `op` with the key `name`, or NULL */
+static const schema_op * schema_find (const json_schema * schema, const schema_op * op,
+                                      const json_char * name, unsigned int length)
+{
+   uint32_t hash = json_key_hash (name, length), slot, found;
+
+   for (slot = hash & op->mask; (found = schema->slots [op->table + slot]); slot = (slot + 1) & op->mask)
+   {
+      const schema_op * member = schema->ops + found - 1;
+
+      if (member->hash == hash && member->key_length == length
+            && !memcmp (member->key, name, length * sizeof (json_char)))
+      {
+         return member;
+      }
+   }
+
+   return 0;
+}
+
+/* Checks `value` against `op`, but not what it holds, pushing a frame for
+ * that if there's any
+ */
+static int schema_enter (const json_schema * schema, const schema_op * op, const json_value * value,
+                         schema_frame * frames, unsigned int * depth, char * error)
+{
+   const schema_op * member;
+   unsigned int length = 0, i;
+   char message [64];
+
+   if (!value || value->type != op->type)
+   {
+      sprintf (message, "Expected %s", schema_type_name (op->type));
+      schema_error (error, frames, *depth, message);
+      return 0;
+   }
+
+   if (op->type == json_object)
+      length = value->u.object.length;
+   else if (op->type == json_array)
+      length = value->u.array.length;
+
+   if (length != op->length && ! (op->flags & schema_uniform))
+   {
+      sprintf (message, "Expected %u %s", op->length, op->type == json_object ? "members" : "elements");
+
+      /* rather, a key that shouldn't be there or one that isn't */
+      if (op->type == json_object && length > op->length)
+      {
+         for (i = 0; i < length; ++ i)
+         {
+            const json_char * name = value->u.object.values [i].name;
+
+            if (!schema_find (schema, op, name, strlen (name)))
+            {
+               sprintf (message, "Unexpected key \"%.24s\"", name);
+               break;
+            }
+         }
+      }
+      else if (op->type == json_object)
+      {
+         for (i = 0, member = op + 1; i < op->length; ++ i, member += member->skip)
+         {
+            if (!find_json_object_hashed (value, member->key, member->key_length, member->hash))
+            {
+               sprintf (message, "Missing key \"%.24s\"", member->key);
+               break;
+            }
+         }
+      }
+
+      schema_error (error, frames, *depth, message);
+      return 0;
+   }
+
+   if (length)
+   {
+      schema_frame * frame = frames + (*depth) ++;
+
+      frame->op = op;
+      frame->at = 0;
+      frame->index = 0;
+      frame->value = value;
+   }
+
+   return 1;
+}
+
+int json_schema_check (const json_schema * schema, const json_value * value, char * error)
+{
+   schema_frame frames [schema_max_depth], * frame;
+   unsigned int depth = 0, length;
+   const schema_op * op;
+   char message [64];
+
+   if (!schema_enter (schema, schema->ops, value, frames, &depth, error))
+      return 0;
+
+   while (depth)
+   {
+      frame = frames + depth - 1;
+      op = frame->op;
+      length = op->type == json_object ? op->length : frame->value->u.array.length;
+
+      if (frame->index == length)
+      {
+         -- depth;
+         continue;
+      }
+
+      if (op->flags & schema_uniform)
+         frame->at = op + 1;
+      else
+         frame->at = frame->index ? frame->at + frame->at->skip : op + 1;
+
+      if (op->type == json_object)
+      {
+         value = find_json_object_hashed (frame->value, frame->at->key,
+                                          frame->at->key_length, frame->at->hash);
+         ++ frame->index;
+
+         if (!value)
+         {
+            sprintf (message, "Missing key \"%.24s\"", frame->at->key);
+            schema_error (error, frames, depth - 1, message);
+            return 0;
+         }
+      }
+      else
+         value = frame->value->u.array.values [frame->index ++];
+
+      if (!schema_enter (schema, frame->at, value, frames, &depth, error))
+         return 0;
+   }
+
+   if (error)
+      *error = 0;
+
+   return 1;
+}
+
+/* Checking as the events come, ahead of `handler`, if there is one */
+typedef struct
+{
+   const json_schema * schema;
+   const json_handler * handler;
+   void * user_data;
+
+   schema_frame frames [schema_max_depth];
+   unsigned int depth;
+
+   const schema_op * member;  /* named by the last key */
+   unsigned char * seen;      /* a bit for each op, set as its key comes */
+
+   char error [128];  /* the schema's, when it stops the parse */
+
+} schema_events;
+
+#define schema_seen(state, op) \
+   ((state)->seen [((op) - (state)->schema->ops) / 8] & (1 << (((op) - (state)->schema->ops) % 8)))
+
+/* Passes an event on to the handler, if it has a callback for it */
+#define schema_forward(state, event, args) \
+   (!(state)->handler || !(state)->handler->event || (state)->handler->event args)
+
+/* The op for the next value, checked for its type */
+static const schema_op * schema_event (schema_events * state, json_type type)
+{
+   schema_frame * frame = state->depth ? state->frames + state->depth - 1 : 0;
+   const schema_op * op;
+   char message [64];
+
+   if (!frame)
+      op = state->schema->ops;
+   else if (frame->op->type == json_object)
+      op = state->member;
+   else if (frame->op->flags & schema_uniform)
+   {
+      op = frame->at = frame->op + 1;
+      ++ frame->index;
+   }
+   else if (frame->index == frame->op->length)
+   {
+      sprintf (message, "Expected %u elements", frame->op->length);
+      schema_error (state->error, state->frames, state->depth - 1, message);
+      return 0;
+   }
+   else
+   {
+      op = frame->at = frame->index ? frame->at + frame->at->skip : frame->op + 1;
+      ++ frame->index;
+   }
+
+   if (op->type != type)
+   {
+      sprintf (message, "Expected %s", schema_type_name (op->type));
+      schema_error (state->error, state->frames, state->depth, message);
+      return 0;
+   }
+
+   return op;
+}
+
+static int schema_open (schema_events * state, json_type type)
+{
+   const schema_op * op = schema_event (state, type), * member;
+   schema_frame * frame;
+   unsigned int i;
+
+   if (!op)
+      return 0;
+
+   frame = state->frames + state->depth ++;
+   frame->op = op;
+   frame->at = 0;
+   frame->index = 0;
+
+   if (type == json_object)
+   {
+      for (i = 0, member = op + 1; i < op->length; ++ i, member += member->skip)
+         state->seen [(member - state->schema->ops) / 8] &= ~(1 << ((member - state->schema->ops) % 8));
+   }
+
+   return 1;
+}
+
+static int schema_close (schema_events * state)
+{
+   schema_frame * frame = state->frames + state->depth - 1;
+   const schema_op * op = frame->op, * member;
+   char message [64];
+   unsigned int i;
+
+   if (frame->index < op->length && ! (op->flags & schema_uniform))
+   {
+      if (op->type == json_object)
+      {
+         for (i = 0, member = op + 1; i < op->length && schema_seen (state, member); ++ i)
+            member += member->skip;
+
+         sprintf (message, "Missing key \"%.24s\"", member->key);
+         schema_error (state->error, state->frames, state->depth - 1, message);
+      }
+      else
+      {
+         sprintf (message, "Expected %u elements", op->length);
+         schema_error (state->error, state->frames, state->depth - 1, message);
+      }
+
+      return 0;
+   }
+
+   -- state->depth;
+
+   return 1;
+}
+
+static int schema_start_object (void * data)
+{
+   schema_events * state = (schema_events *) data;
+
+   return schema_open (state, json_object)
+      && schema_forward (state, start_object, (state->user_data));
+}
+
+static int schema_key (const json_char * name, unsigned int length, void * data)
+{
+   schema_events * state = (schema_events *) data;
+   schema_frame * frame = state->frames + state->depth - 1;
+   const schema_op * member = schema_find (state->schema, frame->op, name, length);
+   char message [64];
+
+   if (!member)
+      sprintf (message, "Unexpected key \"%.24s\"", name);
+   else if (schema_seen (state, member))
+      sprintf (message, "Duplicate key \"%.24s\"", name);
+   else
+   {
+      state->seen [(member - state->schema->ops) / 8] |= 1 << ((member - state->schema->ops) % 8);
+      state->member = frame->at = member;
+      ++ frame->index;
+
+      return schema_forward (state, key, (name, length, state->user_data));
+   }
+
+   schema_error (state->error, state->frames, state->depth - 1, message);
+
+   return 0;
+}
+
+static int schema_end (void * data)
+{
+   schema_events * state = (schema_events *) data;
+   json_type type = state->frames [state->depth - 1].op->type;
+
+   if (!schema_close (state))
+      return 0;
+
+   return type == json_object ? schema_forward (state, end_object, (state->user_data))
+                              : schema_forward (state, end_array, (state->user_data));
+}
+
+static int schema_start_array (void * data)
+{
+   schema_events * state = (schema_events *) data;
+
+   return schema_open (state, json_array)
+      && schema_forward (state, start_array, (state->user_data));
+}
+
+static int schema_string (const json_char * string, unsigned int length, void * data)
+{
+   schema_events * state = (schema_events *) data;
+
+   return schema_event (state, json_string)
+      && schema_forward (state, string, (string, length, state->user_data));
+}
+
+static int schema_integer (json_int_t value, void * data)
+{
+   schema_events * state = (schema_events *) data;
+
+   return schema_event (state, json_integer)
+      && schema_forward (state, integer, (value, state->user_data));
+}
+
+static int schema_double (double value, void * data)
+{
+   schema_events * state = (schema_events *) data;
+
+   return schema_event (state, json_double)
+      && schema_forward (state, dbl, (value, state->user_data));
+}
+
+static int schema_boolean (int value, void * data)
+{
+   schema_events * state = (schema_events *) data;
+
+   return schema_event (state, json_boolean)
+      && schema_forward (state, boolean, (value, state->user_data));
+}
+
+static int schema_null (void * data)
+{
+   schema_events * state = (schema_events *) data;
+
+   return schema_event (state, json_null)
+      && schema_forward (state, null, (state->user_data));
+}
+
+static const json_handler schema_handler =
+{
+   schema_start_object, schema_key, schema_end,
+   schema_start_array, schema_end,
+   schema_string, schema_integer, schema_double, schema_boolean, schema_null
+};
+
+int json_schema_check_events (const json_schema * schema, json_settings * settings,
+                              const json_handler * handler, void * user_data,
+                              const json_char * json, size_t length, char * error_buf)
+{
+   json_settings events_settings;
+   schema_events state;
+   char error [128], * stopped;
+   int result;
+
+   settings_init (&events_settings, settings);
+
+   state.schema = schema;
+   state.handler = handler;
+   state.user_data = user_data;
+   state.depth = 0;
+   state.member = 0;
+   state.error [0] = 0;
+
+   if (! (state.seen = (unsigned char *) events_settings.mem_alloc
+            (schema->count / 8 + 1, 0, events_settings.user_data)) )
+   {
+      if (error_buf)
+         strcpy (error_buf, "Memory allocation failure");
+
+      return 0;
+   }
+
+   result = json_parse_events (settings, &schema_handler, &state, json, length, error);
+
+   events_settings.mem_free (state.seen, events_settings.user_data);
+
+   if (error_buf)
+   {
+      /* "line:col: " and what the schema found, rather than that it stopped */
+      if (!result && *state.error && (stopped = strstr (error, "Stopped by the handler")))
+         strcpy (stopped, state.error);
+
+      strcpy (error_buf, result ? "" : error);
+   }
+
+   return result;
+}
+
+json_intern * json_intern_new (json_settings * settings)
+{
+   json_settings intern_settings;
+   json_intern * intern;
+
+   settings_init (&intern_settings, settings);
+
+   if (! (intern = (json_intern *) intern_settings.mem_alloc
+         (sizeof (json_intern), 1, intern_settings.user_data)) )
+   {
+      return 0;
+   }
+
+   intern->settings = intern_settings;
+   intern->settings.intern = 0;
+
+   return intern;
+}
+
+const json_char * json_intern_key (json_intern * intern, const json_char * key, size_t length)
+{
+   return intern_key (intern, key, length);
+}
+
+void json_intern_free (json_intern * intern)
+{
+   json_arena empty;
+
+   if (!intern)
+      return;
+
+   memset (&empty, 0, sizeof (json_arena));
+   arena_rollback (&intern->settings, &intern->arena, empty);
+
+   intern->settings.mem_free (intern->table, intern->settings.user_data);
+   intern->settings.mem_free (intern, intern->settings.user_data);
+}
+
+/* Jobs: `run` is called for each index below `count`, on up to `threads`
+ * threads (the caller's among them), each taking the next index as it's
+ * free.
+ */
+typedef struct
+{
+   void (* run) (void * data, size_t index);
+   void * data;
+
+   size_t count;
+   volatile size_t next;
+
+} json_jobs;
+
+#ifdef JSON_THREADS
+#  define jobs_take(jobs) __sync_fetch_and_add (&(jobs)->next, 1)
+#  define flag_get(flag) __atomic_load_n (&(flag), __ATOMIC_RELAXED)
+#  define flag_set(flag) __atomic_store_n (&(flag), 1, __ATOMIC_RELAXED)
+#else
+#  define jobs_take(jobs) ((jobs)->next ++)
+#  define flag_get(flag) (flag)
+#  define flag_set(flag) ((flag) = 1)
+#endif
+
+#define max_threads 256
+#define parallel_region_min 65536
+
+static void * jobs_worker (void * data)
+{
+   json_jobs * jobs = (json_jobs *) data;
+   size_t index;
+
+   while ((index = jobs_take (jobs)) < jobs->count)
+      jobs->run (jobs->data, index);
+
+   return 0;
+}
+
+static void run_jobs (json_jobs * jobs, int threads)
+{
+   #ifdef JSON_THREADS
+
+      pthread_t workers [max_threads];
+      int started = 0;
+
+      for (; started < threads - 1 && (size_t) started + 1 < jobs->count; ++ started)
+      {
+         if (pthread_create (&workers [started], 0, jobs_worker, jobs))
+            break;
+      }
+
+      jobs_worker (jobs);
+
+      while (started > 0)
+         pthread_join (workers [-- started], 0);
+
+   #else
+
+      jobs_worker (jobs);
+
+   #endif
+}
+
+static int cpu_count (void)
+{
+   #if defined JSON_THREADS && defined _SC_NPROCESSORS_ONLN
+
+      long n = sysconf (_SC_NPROCESSORS_ONLN);
+      return n < 1 ? 1 : n > max_threads ? max_threads : (int) n;
+
+   #else
+
+      return 1;
+
+   #endif
+}
+
+/* Parallel parsing of an array: the input is cut into regions, and each is
+ * scanned for its quotes and brackets as in stage 1 of the two stage parse.
+ * Not knowing yet whether the region starts in a string, the scan counts
+ * the change in depth both ways (what's out of strings one way being what's
+ * in them the other), so a pass over the regions in order can then settle
+ * where each starts.  That done, each region's first comma between elements
+ * is where a part of the array starts, and the parts are parsed in place,
+ * each as the elements of an array of its own, and joined.
+ *
+ * Should any part fail, or hold no element but the last, it's all parsed
+ * again in one piece: that reports any error just as json_parse_n does, and
+ * settles what splitting in the wrong place would otherwise have to.  Parts
+ * that parse can't have been split wrongly: each starts where the previous
+ * left off, out of any string and between elements.
+ */
+typedef struct
+{
+   size_t begin, end;
+
+   int quotes;     /* parity of the unescaped quotes */
+   long depth [2]; /* change in depth, starting out of a string and in one */
+
+   int in_string;
+   long start_depth;
+
+   size_t split;   /* the first comma between elements, or `no_split` */
+
+} json_region;
+
+typedef struct
+{
+   json_settings settings;
+   const json_char * json;
+   size_t length;
+
+   json_region * regions;
+
+   size_t count;
+   size_t * starts;     /* of each part; those after the first follow a comma */
+   json_value ** parts;
+   json_value * root;
+
+   int failed;
+
+} json_parallel;
+
+#define no_split ((size_t) -1)
+
+static void region_scan (void * data, size_t index)
+{
+   json_parallel * parallel = (json_parallel *) data;
+   json_region * region = &parallel->regions [index];
+   uint64_t quote, in_string, op;
+   json_classes c;
+   json_stage1 s;
+   size_t n;
+
+   memset (&s, 0, sizeof (s));
+   s.json = parallel->json + region->begin;
+   s.length = region->end - region->begin;
+
+   /* escaped if after an odd run of backslashes */
+
+   for (n = 0; n < region->begin && s.json [- (long) n - 1] == '\\'; ++ n)
+      ;
+
+   s.prev_escaped = n & 1;
+
+   for (; s.base < s.length; s.base += 64)
+   {
+      stage1_strings (&s, &c, &quote, &in_string);
+
+      for (op = c.op; op; op &= op - 1)
+      {
+         int bit = trailing_zeros (op);
+
+         switch (s.json [s.base + bit])
+         {
+            case '[': case '{':
+               ++ region->depth [(in_string >> bit) & 1];
+               break;
+
+            case ']': case '}':
+               -- region->depth [(in_string >> bit) & 1];
+               break;
+         };
+      }
+   }
+
+   /* starting out of a string, it ends in one after an odd number */
+
+   region->quotes = s.prev_in_string & 1;
+}
+
+static void region_split (void * data, size_t index)
+{
+   json_parallel * parallel = (json_parallel *) data;
+   json_region * region = &parallel->regions [index];
+   const json_char * i = parallel->json + region->begin,
+                   * end = parallel->json + region->end,
+                   * input_end = parallel->json + parallel->length;
+   long depth = region->start_depth;
+   size_t n;
+
+   region->split = no_split;
+
+   if (region->in_string)
+   {
+      for (n = 0; i - n > parallel->json && i [- (long) n - 1] == '\\'; ++ n)
+         ;
+
+      if (n & 1)
+         ++ i;
+
+      if ((i += string_span (i, input_end)) >= end)
+         return;
+
+      ++ i;
+   }
+
+   for (; i < end; ++ i)
+   {
+      switch (*i)
+      {
+         case '"':
+
+            if ((i += 1 + string_span (i + 1, input_end)) >= end)
+               return;
+
+            break;
+
+         case '[': case '{':
+            ++ depth;
+            break;
+
+         case ']': case '}':
+            -- depth;
+            break;
+
+         case ',':
+
+            if (depth == 1)
+            {
+               region->split = i - parallel->json;
+               return;
+            }
+
+            break;
+      };
+   }
+}
+
+static void part_parse (void * data, size_t index)
+{
+   json_parallel * parallel = (json_parallel *) data;
+   size_t begin = parallel->starts [index], length, i;
+   int last = index + 1 == parallel->count;
+   const json_char * tail;
+   json_value * part;
+
+   length = (last ? parallel->length : parallel->starts [index + 1] - 1) - begin;
+
+   if (flag_get (parallel->failed))
+      return;
+
+   /* the last has the array's own closing bracket, and the others the
+    * comma they were split at
+    */
+
+   part = parse_elements (&parallel->settings, parallel->json + begin, length + !last, last);
+
+   if (part && !last)
+   {
+      /* "[1,]" parses (as does "[]"), but not "1,," split after the first */
+
+      for (tail = parallel->json + begin + length; tail > parallel->json + begin; -- tail)
+      {
+         if (tail [-1] != ' ' && tail [-1] != '\t' && tail [-1] != '\n' && tail [-1] != '\r')
+            break;
+      }
+
+      if (!part->u.array.length || tail [-1] == ',')
+      {
+         json_value_free_ex (&parallel->settings, part);
+         part = 0;
+      }
+   }
+
+   if (!part)
+   {
+      flag_set (parallel->failed);
+      return;
+   }
+
+   for (i = 0; i < part->u.array.length; ++ i)
+      part->u.array.values [i]->parent = parallel->root;
+
+   parallel->parts [index] = part;
+}
+
+/* Frees the parts parsed, their elements given back to them first */
+static void parts_free (json_parallel * parallel)
+{
+   json_value * part;
+   size_t i, n;
+
+   for (i = 0; i < parallel->count; ++ i)
+   {
+      if (! (part = parallel->parts [i]))
+         continue;
+
+      for (n = 0; n < part->u.array.length; ++ n)
+         part->u.array.values [n]->parent = part;
+
+      json_value_free_ex (&parallel->settings, part);
+   }
+}
+
+json_value * json_parse_parallel
+   (json_settings * settings, const json_char * json, size_t length, int threads, char * error)
+{
+   json_parallel parallel;
+   json_jobs jobs;
+   const json_char * open = json;
+   size_t count, size, i, total = 0;
+   json_value ** values = 0;
+   long depth = 0;
+   int in_string = 0;
+
+   memset (&parallel, 0, sizeof (parallel));
+   settings_init (&parallel.settings, settings);
+
+   parallel.json = json;
+   parallel.length = length;
+
+   if (threads <= 0)
+      threads = cpu_count ();
+
+   if (threads > max_threads)
+      threads = max_threads;
+
+   #ifndef JSON_THREADS
+      threads = 1;
+   #endif
+
+   while (open < json + length && (*open == ' ' || *open == '\t' || *open == '\n' || *open == '\r'))
+      ++ open;
+
+   /* a few regions a thread, to even out the work */
+
+   count = (size_t) threads * 4;
+
+   if (length / count < parallel_region_min)
+      count = length / parallel_region_min;
+
+   if (threads < 2 || count < 2 || parallel.settings.intern
+         || open == json + length || *open != '[')
+   {
+      return json_parse_n (settings, json, length, error);
+   }
+
+   size = count * (sizeof (json_region) + sizeof (size_t) + sizeof (json_value *));
+
+   if (! (parallel.regions = (json_region *) parallel.settings.mem_alloc
+            (size, 1, parallel.settings.user_data)) )
+   {
+      goto fail;
+   }
+
+   parallel.starts = (size_t *) (parallel.regions + count);
+   parallel.parts = (json_value **) (parallel.starts + count);
+
+   for (i = 0; i < count; ++ i)
+   {
+      parallel.regions [i].begin = i * (length / count);
+      parallel.regions [i].end = i + 1 == count ? length : (i + 1) * (length / count);
+   }
+
+   jobs.run = region_scan;
+   jobs.data = &parallel;
+   jobs.count = count;
+   jobs.next = 0;
+
+   run_jobs (&jobs, threads);
+
+   for (i = 0; i < count; ++ i)
+   {
+      parallel.regions [i].in_string = in_string;
+      parallel.regions [i].start_depth = depth;
+
+      depth += parallel.regions [i].depth [in_string];
+      in_string ^= parallel.regions [i].quotes;
+   }
+
+   jobs.run = region_split;
+   jobs.next = 0;
+
+   run_jobs (&jobs, threads);
+
+   /* the parts: the first just inside the bracket, the rest after each split */
+
+   parallel.starts [0] = open + 1 - json;
+   parallel.count = 1;
+
+   for (i = 1; i < count; ++ i)
+   {
+      size_t split = parallel.regions [i].split;
+
+      if (split != no_split && split >= parallel.starts [parallel.count - 1])
+         parallel.starts [parallel.count ++] = split + 1;
+   }
+
+   if (parallel.count < 2)
+   {
+      parallel.settings.mem_free (parallel.regions, parallel.settings.user_data);
+      return json_parse_n (settings, json, length, error);
+   }
+
+   if (! (parallel.root = (json_value *) parallel.settings.mem_alloc
+            (sizeof (json_value), 1, parallel.settings.user_data)) )
+   {
+      goto fail;
+   }
+
+   parallel.root->type = json_array;
+
+   jobs.run = part_parse;
+   jobs.count = parallel.count;
+   jobs.next = 0;
+
+   run_jobs (&jobs, threads);
+
+   for (i = 0; i < parallel.count && !parallel.failed; ++ i)
+   {
+      if ((total += parallel.parts [i]->u.array.length) > UINT_MAX)
+         parallel.failed = 1;
+   }
+
+   if (parallel.failed)
+   {
+      /* parse it again in one piece, for the error */
+
+      parts_free (&parallel);
+
+      parallel.settings.mem_free (parallel.root, parallel.settings.user_data);
+      parallel.settings.mem_free (parallel.regions, parallel.settings.user_data);
+
+      return json_parse_n (settings, json, length, error);
+   }
+
+   if (! (values = (json_value **) parallel.settings.mem_alloc
+            (total * sizeof (json_value *), 0, parallel.settings.user_data)) )
+   {
+      goto fail;
+   }
+
+   /* join the parts' elements under the root, and free the parts */
+
+   for (i = 0, total = 0; i < parallel.count; ++ i)
+   {
+      json_value * part = parallel.parts [i];
+
+      memcpy (values + total, part->u.array.values, part->u.array.length * sizeof (json_value *));
+      total += part->u.array.length;
+
+      parallel.settings.mem_free (part->u.array.values, parallel.settings.user_data);
+      parallel.settings.mem_free (part, parallel.settings.user_data);
+   }
+
+   parallel.root->u.array.values = values;
+   parallel.root->u.array.length = (unsigned int) total;
+
+   parallel.settings.mem_free (parallel.regions, parallel.settings.user_data);
+
+   return parallel.root;
+
+fail:
+
+   if (parallel.regions)
+   {
+      parts_free (&parallel);
+
+      parallel.settings.mem_free (parallel.regions, parallel.settings.user_data);
+   }
+
+   if (parallel.root)
+      parallel.settings.mem_free (parallel.root, parallel.settings.user_data);
+
+   if (error)
+      strcpy (error, "Memory allocation failure");
+
+   return 0;
+}
+
+#undef no_split
+
+/* NDJSON pipelines: batches of whole lines are cut from the input as
+ * threads come to take them, each into a free slot, whose document and
+ * list of records it then fills without holding the lock.  The records go
+ * to the handler from whichever thread finds a slot ready for it while no
+ * other is handing records on (in input order, the slot of the oldest
+ * batch not yet handled), the lock again let go for the calls.  A batch
+ * takes a slot until its records have been handled, so the threads can't
+ * get more than `window` batches ahead of the handler.
+ */
+#define slot_free 0
+#define slot_busy 1
+#define slot_ready 2
+
+typedef struct
+{
+   json_value * value;
+   size_t offset;
+   size_t error;  /* offset of its message in `errors`, if value is NULL */
+
+} json_record;
+
+typedef struct
+{
+   json_document * doc;
+   json_stack records, errors;
+
+   size_t batch;
+   int state;
+
+} json_ndjson_slot;
+
+typedef struct
+{
+   json_settings settings;
+   const json_char * json;
+   size_t length;
+
+   json_ndjson_opts opts;
+   json_record_handler record;
+   void * user_data;
+
+   #ifdef JSON_THREADS
+      pthread_mutex_t lock;
+      pthread_cond_t freed;
+   #endif
+
+   json_ndjson_slot * slots;
+
+   size_t cut;               /* where the next batch starts */
+   size_t taken, handled;    /* batches */
+   int handing_on;
+
+   int status;               /* 1 once stopped by the handler, -1 on failure */
+
+} json_ndjson;
+
+#ifdef JSON_THREADS
+#  define ndjson_lock(nd) pthread_mutex_lock (&(nd)->lock)
+#  define ndjson_unlock(nd) pthread_mutex_unlock (&(nd)->lock)
+#  define ndjson_wait(nd) pthread_cond_wait (&(nd)->freed, &(nd)->lock)
+#  define ndjson_wake(nd) pthread_cond_broadcast (&(nd)->freed)
+#else
+#  define ndjson_lock(nd) ((void) 0)
+#  define ndjson_unlock(nd) ((void) 0)
+#  define ndjson_wait(nd) ((void) 0)
+#  define ndjson_wake(nd) ((void) 0)
+#endif
+
+/* Parses json [begin, end) a line at a time into the slot */
+static int batch_parse (json_ndjson * nd, json_ndjson_slot * slot, size_t begin, size_t end)
+{
+   const json_char * line = nd->json + begin, * stop = nd->json + end, * eol, * i;
+   json_char error [128];
+   json_record * record;
+   size_t length;
+
+   for (; line < stop; line = eol + 1)
+   {
+      if (! (eol = (const json_char *) memchr (line, '\n', stop - line)) )
+         eol = stop;
+
+      for (i = line; i < eol && (*i == ' ' || *i == '\t' || *i == '\r'); ++ i)
+         ;
+
+      if (i == eol)
+         continue;
+
+      if (! (record = (json_record *) stack_push (&nd->settings, &slot->records, sizeof (json_record))) )
+         return 0;
+
+      record->offset = line - nd->json;
+
+      if ( (record->value = json_document_parse_n (slot->doc, line, eol - line, error)) )
+         continue;
+
+      record->error = slot->errors.length;
+      length = strlen (error) + 1;
+
+      if (!stack_push (&nd->settings, &slot->errors, length))
+         return 0;
+
+      memcpy (slot->errors.mem + record->error, error, length);
+   }
+
+   return 1;
+}
+
+/* The next slot to hand on, or 0 if none is ready to be */
+static json_ndjson_slot * slot_ready_next (json_ndjson * nd)
+{
+   unsigned int i;
+
+   for (i = 0; i < nd->opts.window; ++ i)
+   {
+      json_ndjson_slot * slot = &nd->slots [i];
+
+      if (slot->state == slot_ready && (nd->opts.unordered || slot->batch == nd->handled))
+         return slot;
+   }
+
+   return 0;
+}
+
+/* Hands on every slot that's ready, with the lock held (but let go while
+ * the handler runs)
+ */
+static void slots_hand_on (json_ndjson * nd)
+{
+   json_ndjson_slot * slot;
+   json_record * record, * end;
+   int stopped = 0;
+
+   nd->handing_on = 1;
+
+   while (!nd->status && (slot = slot_ready_next (nd)))
+   {
+      slot->state = slot_busy;
+      ndjson_unlock (nd);
+
+      record = (json_record *) slot->records.mem;
+      end = (json_record *) (slot->records.mem + slot->records.length);
+
+      for (; record < end && !stopped; ++ record)
+      {
+         stopped = !nd->record (record->value, record->offset,
+                                record->value ? "" : slot->errors.mem + record->error, nd->user_data);
+      }
+
+      json_document_reset (slot->doc);
+      slot->records.length = slot->errors.length = 0;
+
+      ndjson_lock (nd);
+
+      slot->state = slot_free;
+      ++ nd->handled;
+
+      if (stopped)
+         nd->status = 1;
+
+      ndjson_wake (nd);
+   }
+
+   nd->handing_on = 0;
+}
+
+static void ndjson_worker (void * data, size_t index)
+{
+   json_ndjson * nd = (json_ndjson *) data;
+   json_ndjson_slot * slot = 0;
+   const json_char * eol;
+   size_t begin, end;
+   unsigned int i;
+   int parsed;
+
+   ndjson_lock (nd);
+
+   for (;;)
+   {
+      while (!nd->status && nd->cut < nd->length)
+      {
+         for (i = 0; i < nd->opts.window && nd->slots [i].state != slot_free; ++ i)
+            ;
+
+         if (i < nd->opts.window)
+         {
+            slot = &nd->slots [i];
+            break;
+         }
+
+         ndjson_wait (nd);
+      }
+
+      if (nd->status || nd->cut >= nd->length)
+         break;
+
+      /* the batch runs on to the end of the line it reaches `batch` in */
+
+      begin = nd->cut;
+      end = nd->length;
+
+      if (nd->length - begin > nd->opts.batch
+            && (eol = (const json_char *) memchr (nd->json + begin + nd->opts.batch, '\n',
+                                                  nd->length - begin - nd->opts.batch)) )
+      {
+         end = eol + 1 - nd->json;
+      }
+
+      nd->cut = end;
+
+      slot->batch = nd->taken ++;
+      slot->state = slot_busy;
+
+      ndjson_unlock (nd);
+
+      parsed = batch_parse (nd, slot, begin, end);
+
+      ndjson_lock (nd);
+
+      slot->state = slot_ready;
+
+      if (!parsed)
+      {
+         nd->status = -1;
+         ndjson_wake (nd);
+      }
+
+      if (!nd->handing_on)
+         slots_hand_on (nd);
+   }
+
+   ndjson_unlock (nd);
+}
+
+int json_parse_ndjson
+   (json_settings * settings, const json_char * json, size_t length,
+    const json_ndjson_opts * opts, json_record_handler record, void * user_data, char * error)
+{
+   json_ndjson nd;
+   json_jobs jobs;
+   unsigned int i;
+
+   memset (&nd, 0, sizeof (nd));
+   settings_init (&nd.settings, settings);
+
+   nd.json = json;
+   nd.length = length;
+   nd.record = record;
+   nd.user_data = user_data;
+
+   if (opts)
+      nd.opts = *opts;
+
+   if (nd.opts.threads <= 0)
+      nd.opts.threads = cpu_count ();
+
+   if (nd.opts.threads > max_threads)
+      nd.opts.threads = max_threads;
+
+   #ifndef JSON_THREADS
+      nd.opts.threads = 1;
+   #endif
+
+   if (nd.settings.intern)
+      nd.opts.threads = 1;
+
+   if (!nd.opts.batch)
+      nd.opts.batch = 65536;
+
+   if (!nd.opts.window)
+      nd.opts.window = nd.opts.threads * 4;
+
+   /* no more threads than batches */
+
+   if ((size_t) nd.opts.threads > length / nd.opts.batch + 1)
+      nd.opts.threads = (int) (length / nd.opts.batch + 1);
+
+   if (! (nd.slots = (json_ndjson_slot *) nd.settings.mem_alloc
+            (nd.opts.window * sizeof (json_ndjson_slot), 1, nd.settings.user_data)) )
+   {
+      nd.status = -1;
+   }
+
+   for (i = 0; i < nd.opts.window && !nd.status; ++ i)
+   {
+      if (! (nd.slots [i].doc = json_document_new (&nd.settings)) )
+         nd.status = -1;
+   }
+
+   if (!nd.status)
+   {
+      #ifdef JSON_THREADS
+         pthread_mutex_init (&nd.lock, 0);
+         pthread_cond_init (&nd.freed, 0);
+      #endif
+
+      jobs.run = ndjson_worker;
+      jobs.data = &nd;
+      jobs.count = nd.opts.threads;
+      jobs.next = 0;
+
+      run_jobs (&jobs, nd.opts.threads);
+
+      #ifdef JSON_THREADS
+         pthread_cond_destroy (&nd.freed);
+         pthread_mutex_destroy (&nd.lock);
+      #endif
+   }
+
+   if (nd.slots)
+   {
+      for (i = 0; i < nd.opts.window; ++ i)
+      {
+         json_document_free (nd.slots [i].doc);
+         stack_free (&nd.settings, &nd.slots [i].records);
+         stack_free (&nd.settings, &nd.slots [i].errors);
+      }
+
+      nd.settings.mem_free (nd.slots, nd.settings.user_data);
+   }
+
+   if (error)
+   {
+      strcpy (error, nd.status > 0 ? "Stopped by the handler"
+                   : nd.status < 0 ? "Memory allocation failure" : "");
+   }
+
+   return !nd.status;
+}
+
+#undef slot_free
+#undef slot_busy
+#undef slot_ready
+
+json_value * json_parse (const json_char * json)
+{
+   json_settings settings;
+   memset (&settings, 0, sizeof (json_settings));
+
+   return json_parse_ex (&settings, json, 0);
+}
+
+void json_value_free_ex (json_settings * settings, json_value * value)
+{
+   json_settings free_settings;
+   json_value * cur_value;
+
+   if (!value)
+      return;
+
+   settings_init (&free_settings, settings);
+   settings = &free_settings;
+
+   value->parent = 0;
+
+   while (value)
+   {
+      switch (value->type)
+      {
+         case json_array:
+
+            if (!value->u.array.length)
+            {
+               settings->mem_free (value->u.array.values, settings->user_data);
+               break;
+            }
+
+            value = value->u.array.values [-- value->u.array.length];
+            continue;
+
+         case json_object:
+
+            if (!value->u.object.length)
+            {
+               settings->mem_free (value->u.object.values, settings->user_data);
+               break;
+            }
+
+            value = value->u.object.values [-- value->u.object.length].value;
+            continue;
+
+         case json_string:
+
+            settings->mem_free (value->u.string.ptr, settings->user_data);
+            break;
+
+         default:
+            break;
+      };
+
+      cur_value = value;
+      value = value->parent;
+      settings->mem_free (cur_value, settings->user_data);
+   }
+}
+
+void json_value_free (json_value * value)
+{
+   json_value_free_ex (0, value);
+}
+
+/* Serializing: the output goes through a json_out, which either grows a
+ * json_buffer or fills a chunk at a time and passes each to a sink.
+ */
+typedef struct
+{
+   json_buffer * buffer;
+
+   json_sink sink;
+   void * user_data;
+
+   json_char * next, * end;  /* the free space */
+   int failed;
+
+   json_char chunk [4096];
+
+} json_out;
+
+static void out_init (json_out * out, json_buffer * buffer, json_sink sink, void * user_data)
+{
+   out->buffer = buffer;
+   out->sink = sink;
+   out->user_data = user_data;
+   out->failed = 0;
+
+   if (buffer)
+   {
+      /* one over for the terminator */
+
+      out->next = buffer->text + buffer->length;
+      out->end = buffer->capacity ? buffer->text + buffer->capacity - 1 : out->next;
+   }
+   else
+   {
+      out->next = out->chunk;
+      out->end = out->chunk + sizeof (out->chunk) / sizeof (json_char);
+   }
+}
+
+/* Make room for at least `size` characters (at most a chunk, for a sink) */
+static int out_room (json_out * out, size_t size)
+{
+   json_buffer * buffer = out->buffer;
+   json_char * text;
+   size_t length, capacity;
+
+   if (out->failed)
+      return 0;
+
+   if (!buffer)
+   {
+      if (!out->sink (out->chunk, out->next - out->chunk, out->user_data))
+      {
+         out->failed = 1;
+         return 0;
+      }
+
+      out->next = out->chunk;
+      return 1;
+   }
+
+   length = out->next - buffer->text;
+   capacity = buffer->capacity ? buffer->capacity : 256;
+
+   while (capacity - length - 1 < size)
+   {
+      if (capacity > ((size_t) -1) / 2 / sizeof (json_char))
+      {
+         out->failed = 1;
+         return 0;
+      }
+
+      capacity *= 2;
+   }
+
+   if ((buffer->settings.max_memory && capacity * sizeof (json_char) > buffer->settings.max_memory)
+         || ! (text = (json_char *) buffer->settings.mem_alloc
+                  (capacity * sizeof (json_char), 0, buffer->settings.user_data)) )
+   {
+      out->failed = 1;
+      return 0;
+   }
+
+   if (buffer->text)
+   {
+      memcpy (text, buffer->text, length * sizeof (json_char));
+      buffer->settings.mem_free (buffer->text, buffer->settings.user_data);
+   }
+
+   buffer->text = text;
+   buffer->capacity = capacity;
+
+   out->next = text + length;
+   out->end = text + capacity - 1;
+
+   return 1;
+}
+
+#define out_reserve(out, size) \
+   ((size_t) ((out)->end - (out)->next) >= (size) || out_room ((out), (size)))
+
+#define out_char(out, c) \
+   ((void) (out_reserve ((out), 1) && (*(out)->next ++ = (c))))
+
+/* A string constant, copied in one go */
+#define out_literal(out, s) \
+   ((void) (out_reserve ((out), sizeof (s) - 1) \
+      && (memcpy ((out)->next, (s), sizeof (s) - 1), (out)->next += sizeof (s) - 1)))
+
+static void out_text (json_out * out, const json_char * text, size_t length)
+{
+   for (;;)
+   {
+      size_t room = out->end - out->next;
+
+      if (room >= length)
+      {
+         memcpy (out->next, text, length * sizeof (json_char));
+         out->next += length;
+
+         return;
+      }
+
+      if (out->buffer)
+      {
+         if (!out_room (out, length))
+            return;
+
+         continue;
+      }
+
+      memcpy (out->next, text, room * sizeof (json_char));
+      out->next += room;
+      text += room;
+      length -= room;
+
+      if (!out_room (out, 1))
+         return;
+   }
+}
+
+/* Flush what's left to the sink, or terminate the buffer.  Returns 0 if
+ * anything failed, leaving the buffer's length as it was.
+ */
+static int out_done (json_out * out)
+{
+   json_buffer * buffer = out->buffer;
+
+   if (!buffer)
+   {
+      if (!out->failed && out->next > out->chunk)
+         out_room (out, 1);
+
+      return !out->failed;
+   }
+
+   if (!out->failed)
+      buffer->length = out->next - buffer->text;
+
+   if (buffer->text)
+      buffer->text [buffer->length] = 0;
+
+   return !out->failed;
+}
+
+/* What follows a backslash for each control character, 'u' being \u00XX */
+static const char escapes [] = "uuuuuuuubtnufruuuuuuuuuuuuuuuuuu";
+
+static void out_string (json_out * out, const json_char * string, size_t length)
+{
+   size_t run = scan_string (string, length);
+
+   if (run == length && (size_t) (out->end - out->next) >= length + 2)
+   {
+      /* nothing to escape, and room for it all */
+
+      *out->next ++ = '"';
+      memcpy (out->next, string, length * sizeof (json_char));
+      out->next += length;
+      *out->next ++ = '"';
+
+      return;
+   }
+
+   out_char (out, '"');
+
+   for (;;)
+   {
+      unsigned char c;
+
+      out_text (out, string, run);
+
+      if (run == length)
+         break;
+
+      string += run;
+      length -= run;
+
+      c = (unsigned char) *string ++;
+      -- length;
+      run = scan_string (string, length);
+
+      if (!out_reserve (out, 6))
+         return;
+
+      *out->next ++ = '\\';
+
+      if (c == '"' || c == '\\')
+      {
+         *out->next ++ = c;
+         continue;
+      }
+
+      if ((*out->next ++ = escapes [c]) == 'u')
+      {
+         *out->next ++ = '0';
+         *out->next ++ = '0';
+         *out->next ++ = "0123456789abcdef" [c >> 4];
+         *out->next ++ = "0123456789abcdef" [c & 15];
+      }
+   }
+
+   out_char (out, '"');
+}
+
+static void out_key (json_out * out, const json_char * name, size_t length,
+                     const json_serialize_opts * opts)
+{
+   out_string (out, name, length);
+   out_char (out, ':');
+
+   if (opts->mode == json_serialize_pretty)
+      out_char (out, ' ');
+}
+
+static const char digit_pairs [] =
+   "00010203040506070809101112131415161718192021222324"
+   "25262728293031323334353637383940414243444546474849"
+   "50515253545556575859606162636465666768697071727374"
+   "75767778798081828384858687888990919293949596979899";
+
+static void out_integer (json_out * out, json_int_t integer)
+{
+   char digits [24];
+   int n = sizeof (digits);
+   uint64_t x = integer < 0 ? - (uint64_t) integer : (uint64_t) integer;
+
+   for (; x >= 10; x /= 100)
+   {
+      n -= 2;
+      memcpy (digits + n, digit_pairs + 2 * (x % 100), 2);
+   }
+
+   if (x || n == sizeof (digits))
+      digits [-- n] = (char) ('0' + x);
+
+   if (integer < 0)
+      digits [-- n] = '-';
+
+   out_text (out, digits + n, sizeof (digits) - n);
+}
+
+/* 64 bits of 10^k for k from 309 to 324, rounded to nearest, which the
+ * smallest doubles need on top of power_of_five
+ */
+static const uint64_t high_power_of_ten [] =
+{
+   0xb201833b35d63f73ULL, 0xde81e40a034bcf50ULL, 0x8b112e86420f6192ULL,
+   0xadd57a27d29339f6ULL, 0xd94ad8b1c7380874ULL, 0x87cec76f1c830549ULL,
+   0xa9c2794ae3a3c69bULL, 0xd433179d9c8cb841ULL, 0x849feec281d7f329ULL,
+   0xa5c7ea73224deff3ULL, 0xcf39e50feae16bf0ULL, 0x81842f29f2cce376ULL,
+   0xa1e53af46f801c53ULL, 0xca5e89b18b602368ULL, 0xfcf62c1dee382c42ULL,
+   0x9e19db92b4e31ba9ULL
+};
+
+/* The top 64 bits of a * b, rounded */
+static uint64_t mul_round (uint64_t a, uint64_t b)
+{
+   uint64_t high, low = mul_128 (a, b, &high);
+   return high + (low >> 63);
+}
+
+/* Digits of a positive, finite double which read back as the same double,
+ * with `*exponent` the power of ten of the last.  This is Grisu2: the
+ * boundaries of the interval rounding to the double are scaled by a 64-bit
+ * power of ten so the integer part takes 32 bits at most, and digits are
+ * generated until they're within the (shrunk, to allow for the error)
+ * interval, the last then being moved as close to the double as it goes.
+ */
+static int grisu2 (uint64_t bits, char * digits, int * exponent, int * near)
+{
+   uint64_t f = bits & 0xFFFFFFFFFFFFFULL, v, plus, minus, c, delta, dist, one, rest, p2, error = 4;
+   int e = (int) (bits >> 52), lz, k, target, length = 0, n, m;
+   uint32_t p1, power;
+
+   if (e)
+   {
+      v = f | (1ULL << 52);
+      e -= 1075;
+   }
+   else
+   {
+      v = f;
+      e = -1074;
+   }
+
+   /* the boundaries, halfway to the neighbouring doubles (closer below at
+    * a power of two)
+    */
+
+   plus = 2 * v + 1;
+   minus = f == 0 && e > -1074 ? 4 * v - 1 : 2 * v - 1;
+
+   lz = leading_zeros (plus);
+
+   minus <<= lz + (f == 0 && e > -1074 ? -1 : 0);
+   plus <<= lz;
+   v <<= lz + 1;
+   e -= lz + 1;
+
+   /* 10^k, for the product's exponent to land in [-60, -32] */
+
+   target = -61 - e;
+
+   for (k = (target * 78913) / (1 << 18); ((217706 * k) >> 16) < target; ++ k)
+      ;
+
+   while (((217706 * (k - 1)) >> 16) >= target)
+      -- k;
+
+   c = k > 308 ? high_power_of_ten [k - 309]
+      : power_of_five [2 * (k + 342)] + (power_of_five [2 * (k + 342) + 1] >> 63);
+
+   e += ((217706 * k) >> 16) + 1;  /* the product's exponent, negated shift */
+
+   v = mul_round (v, c);
+   plus = mul_round (plus, c) - 1;
+   minus = mul_round (minus, c) + 1;
+
+   delta = plus - minus;
+   dist = plus - v;
+   one = 1ULL << -e;
+
+   p1 = (uint32_t) (plus >> -e);
+   p2 = plus & (one - 1);
+
+   /* the integer part */
+
+   for (n = 10, power = 1000000000; power > p1; -- n)
+      power /= 10;
+
+   while (n > 0)
+   {
+      digits [length ++] = (char) ('0' + p1 / power);
+      p1 %= power;
+      -- n;
+
+      if ((rest = ((uint64_t) p1 << -e) + p2) <= delta)
+      {
+         *exponent = n - k;
+         one = (uint64_t) power << -e;
+
+         goto round;
+      }
+
+      *near = rest - delta <= error || ((uint64_t) power << -e) - rest <= error;
+
+      power /= 10;
+   }
+
+   /* then the fraction */
+
+   for (m = 0; ; )
+   {
+      p2 *= 10;
+      digits [length ++] = (char) ('0' + (p2 >> -e));
+      p2 &= one - 1;
+      ++ m;
+
+      delta *= 10;
+      dist *= 10;
+      error *= 10;
+
+      if (p2 <= delta)
+         break;
+
+      *near = p2 - delta <= error || one - p2 <= error;
+   }
+
+   rest = p2;
+   *exponent = -m - k;
+
+round:
+
+   while (rest < dist && delta - rest >= one
+            && (rest + one < dist || dist - rest > rest + one - dist))
+   {
+      -- digits [length - 1];
+      rest += one;
+   }
+
+   return length;
+}
+
+/* Grisu2's 64 bits can't always settle a digit that's very close to the
+ * interval's boundary, leaving it a digit over the shortest: so try one
+ * less (rounded either way), checked by reading it back exactly.
+ */
+static int shorten (uint64_t bits, char * digits, int length, int * exponent)
+{
+   uint64_t w = 0, candidate, read;
+   int i, up;
+
+   if (length < 2)
+      return length;
+
+   for (i = 0; i < length - 1; ++ i)
+      w = w * 10 + (digits [i] - '0');
+
+   for (i = 0; i < 2; ++ i)
+   {
+      up = (digits [length - 1] >= '5') ^ i;
+
+      if (! (candidate = w + up)
+            || !eisel_lemire (candidate, *exponent + 1, &read) || read != bits)
+      {
+         continue;
+      }
+
+      for (++ *exponent; candidate % 10 == 0; candidate /= 10)
+         ++ *exponent;
+
+      for (length = 0, w = candidate; w; w /= 10)
+         ++ length;
+
+      for (i = length; i > 0; candidate /= 10)
+         digits [-- i] = (char) ('0' + candidate % 10);
+
+      return length;
+   }
+
+   return length;
+}
+
+/* The shortest text reading back as `d`: plain for 1e-7 <= |d| < 1e21,
+ * otherwise with an exponent, and always with a point or an exponent so it
+ * reads back as a double rather than an integer.  Infinities and NaN,
+ * having no JSON, are written as null.
+ */
+static int format_double (double d, json_char * text)
+{
+   char digits [24];
+   uint64_t bits;
+   int length, exponent, point, near = 0, n = 0, i;
+
+   memcpy (&bits, &d, sizeof (bits));
+
+   if ((bits & 0x7FF0000000000000ULL) == 0x7FF0000000000000ULL)
+   {
+      memcpy (text, "null", 4);
+      return 4;
+   }
+
+   if (bits >> 63)
+      text [n ++] = '-';
+
+   if (! (bits << 1))
+   {
+      memcpy (text + n, "0.0", 3);
+      return n + 3;
+   }
+
+   length = grisu2 (bits & 0x7FFFFFFFFFFFFFFFULL, digits, &exponent, &near);
+
+   if (near)
+      length = shorten (bits & 0x7FFFFFFFFFFFFFFFULL, digits, length, &exponent);
+   point = length + exponent;
+
+   if (point > 21 || point < -5)
+   {
+      text [n ++] = digits [0];
 
-                           if (state.first_pass)
-                              continue;
+      if (length > 1)
+      {
+         text [n ++] = '.';
 
-                           if (top->type == json_double) {
-                              top->u.dbl = strtod (i, (json_char **) &i);
-                              if (errno == ERANGE)
-                                 goto e_overflow;
-                           } else {
-                              top->u.integer = strtol (i, (json_char **) &i, 10);
-                              if (errno == ERANGE)
-                                 goto e_overflow;
-                           }
+         for (i = 1; i < length; ++ i)
+            text [n ++] = digits [i];
+      }
 
-                           flags |= flag_next | flag_reproc;
-                        }
-                        else
-                        {  sprintf (error, "%d:%d: Unexpected %c when seeking value", cur_line, e_off, b);
-                           goto e_failed;
-                        }
-                  };
-            };
-         }
-         else
-         {
-            switch (top->type)
-            {
-            case json_object:
-               
-               switch (b)
-               {
-                  whitespace:
-                     continue;
+      text [n ++] = 'e';
 
-                  case '"':
+      if (-- point < 0)
+      {
+         text [n ++] = '-';
+         point = -point;
+      }
 
-                     if (flags & flag_need_comma && (!state.settings.settings & json_relaxed_commas))
-                     {
-                        sprintf (error, "%d:%d: Expected , before \"", cur_line, e_off);
-                        goto e_failed;
-                     }
+      if (point >= 100)
+         text [n ++] = (char) ('0' + point / 100);
 
-                     flags |= flag_string;
+      if (point >= 10)
+         text [n ++] = (char) ('0' + point / 10 % 10);
 
-                     string = (json_char *) top->_reserved.object_mem;
-                     string_length = 0;
+      text [n ++] = (char) ('0' + point % 10);
 
-                     break;
-                  
-                  case '}':
+      return n;
+   }
 
-                     flags = (flags & ~ flag_need_comma) | flag_next;
-                     break;
+   if (point <= 0)
+   {
+      text [n ++] = '0';
+      text [n ++] = '.';
 
-                  case ',':
+      for (; point < 0; ++ point)
+         text [n ++] = '0';
 
-                     if (flags & flag_need_comma)
-                     {
-                        flags &= ~ flag_need_comma;
-                        break;
-                     }
+      for (i = 0; i < length; ++ i)
+         text [n ++] = digits [i];
 
-                  default:
+      return n;
+   }
 
-                     sprintf (error, "%d:%d: Unexpected `%c` in object", cur_line, e_off, b);
-                     goto e_failed;
-               };
+   for (i = 0; i < length || i < point; ++ i)
+   {
+      if (i == point)
+         text [n ++] = '.';
 
-               break;
+      text [n ++] = i < length ? digits [i] : '0';
+   }
 
-            case json_integer:
-            case json_double:
+   if (length <= point)
+   {
+      text [n ++] = '.';
+      text [n ++] = '0';
+   }
 
-               if (isdigit ((int)b))
-                  continue;
+   return n;
+}
 
-               if (b == 'e' || b == 'E')
-               {
-                  if (!(flags & flag_exponent))
-                  {
-                     flags |= flag_exponent;
-                     top->type = json_double;
+static void out_newline (json_out * out, const json_serialize_opts * opts, size_t depth)
+{
+   size_t spaces = depth * opts->indent;
 
-                     continue;
-                  }
-               }
-               else if (b == '+' || b == '-')
-               {
-                  if (flags & flag_exponent && !(flags & flag_got_exponent_sign))
-                  {
-                     flags |= flag_got_exponent_sign;
-                     continue;
-                  }
-               }
-               else if (b == '.' && top->type == json_integer)
-               {
-                  top->type = json_double;
-                  continue;
-               }
+   out_char (out, '\n');
 
-               flags |= flag_next | flag_reproc;
-               break;
+   while (spaces)
+   {
+      size_t run;
+
+      if (!out_reserve (out, 1))
+         return;
+
+      run = out->end - out->next;
+
+      if (run > spaces)
+         run = spaces;
+
+      memset (out->next, ' ', run * sizeof (json_char));
+      out->next += run;
+      spaces -= run;
+   }
+}
+
+typedef struct
+{
+   const json_value * value;
+   unsigned int index;
+
+} json_serialize_frame;
+
+/* `depth` being the nesting it's written at, for pretty indentation, and
+ * `stack` (which the caller frees) kept for the frames of open containers
+ */
+static void serialize (json_settings * settings, json_out * out, const json_value * value,
+                       const json_serialize_opts * opts, size_t depth, json_stack * stack)
+{
+   json_serialize_opts compact = { json_serialize_compact, 0 };
+   json_serialize_frame * frame;
+   const json_value * top;
+
+   if (!opts)
+      opts = &compact;
+
+   for (;;)
+   {
+      if (!value)
+      {
+         out_literal (out, "null");
+      }
+      else switch (value->type)
+      {
+         case json_array:
+         case json_object:
+
+            if ((value->type == json_array ? value->u.array.length : value->u.object.length) == 0)
+            {
+               if (value->type == json_array)
+                  out_literal (out, "[]");
+               else
+                  out_literal (out, "{}");
 
-            default:
                break;
-            };
-         }
+            }
+
+            if (! (frame = (json_serialize_frame *) stack_push
+                     (settings, stack, sizeof (json_serialize_frame))) )
+            {
+               out->failed = 1;
+               stack->length = 0;
+
+               return;
+            }
+
+            frame->value = value;
+            frame->index = 0;
+
+            out_char (out, value->type == json_array ? '[' : '{');
+
+            if (opts->mode == json_serialize_pretty)
+               out_newline (out, opts, ++ depth);
+
+            if (value->type == json_array)
+            {
+               value = value->u.array.values [0];
+               continue;
+            }
+
+            out_key (out, value->u.object.values [0].name,
+                     strlen (value->u.object.values [0].name), opts);
 
-         if (flags & flag_reproc)
+            value = value->u.object.values [0].value;
+            continue;
+
+         case json_integer:
+
+            out_integer (out, value->u.integer);
+            break;
+
+         case json_double:
+
+            if (out_reserve (out, 32))
+               out->next += format_double (value->u.dbl, out->next);
+
+            break;
+
+         case json_string:
+
+            out_string (out, value->u.string.ptr, value->u.string.length);
+            break;
+
+         case json_boolean:
+
+            if (value->u.boolean)
+               out_literal (out, "true");
+            else
+               out_literal (out, "false");
+
+            break;
+
+         default:
+
+            out_literal (out, "null");
+            break;
+      };
+
+      /* then close whatever that finished, and on to the next */
+
+      for (;;)
+      {
+         if (out->failed || !stack->length)
          {
-            flags &= ~ flag_reproc;
-            -- i;
+            stack->length = 0;
+            return;
          }
 
-         if (flags & flag_next)
-         {
-            flags = (flags & ~ flag_next) | flag_need_comma;
+         frame = stack_top (*stack, json_serialize_frame);
+         top = frame->value;
 
-            if (!top->parent)
-            {
-               /* root value done */
+         if (++ frame->index < (top->type == json_array ? top->u.array.length : top->u.object.length))
+            break;
+
+         stack->length -= sizeof (json_serialize_frame);
+
+         if (opts->mode == json_serialize_pretty)
+            out_newline (out, opts, -- depth);
+
+         out_char (out, top->type == json_array ? ']' : '}');
+      }
+
+      out_char (out, ',');
+
+      if (opts->mode == json_serialize_pretty)
+         out_newline (out, opts, depth);
+
+      if (top->type == json_array)
+      {
+         value = top->u.array.values [frame->index];
+         continue;
+      }
+
+      out_key (out, top->u.object.values [frame->index].name,
+               strlen (top->u.object.values [frame->index].name), opts);
+
+      value = top->u.object.values [frame->index].value;
+   }
+}
+
+void json_buffer_init (json_buffer * buffer, json_settings * settings)
+{
+   memset (buffer, 0, sizeof (json_buffer));
+   settings_init (&buffer->settings, settings);
+}
+
+void json_buffer_free (json_buffer * buffer)
+{
+   if (buffer->text)
+      buffer->settings.mem_free (buffer->text, buffer->settings.user_data);
+
+   buffer->text = 0;
+   buffer->length = buffer->capacity = 0;
+}
+
+int json_serialize (json_buffer * buffer, const json_value * value,
+                    const json_serialize_opts * opts)
+{
+   json_stack stack = { 0, 0, 0 };
+   json_out out;
+
+   out_init (&out, buffer, 0, 0);
+   serialize (&buffer->settings, &out, value, opts, 0, &stack);
+   stack_free (&buffer->settings, &stack);
+
+   return out_done (&out);
+}
+
+int json_serialize_sink (json_settings * settings, const json_value * value,
+                         const json_serialize_opts * opts, json_sink sink, void * user_data)
+{
+   json_settings sink_settings;
+   json_stack stack = { 0, 0, 0 };
+   json_out * out;
+   int result;
+
+   settings_init (&sink_settings, settings);
+
+   if (! (out = (json_out *) sink_settings.mem_alloc
+            (sizeof (json_out), 0, sink_settings.user_data)) )
+   {
+      return 0;
+   }
+
+   out_init (out, 0, sink, user_data);
+   serialize (&sink_settings, out, value, opts, 0, &stack);
+   stack_free (&sink_settings, &stack);
+
+   result = out_done (out);
+   sink_settings.mem_free (out, sink_settings.user_data);
+
+   return result;
+}
+
+/* Writers: the output of json_serialize a token at a time.  Outside NDEBUG
+ * builds they also keep what's open, to fail anything out of place.
+ */
+struct _json_writer
+{
+   json_settings settings;
+   json_serialize_opts opts;
+
+   json_buffer * buffer;
+   int fd;
+
+   size_t depth;
+   int first;      /* nothing written yet in the innermost container */
+   int after_key;
+   int started;    /* something of the document's been written */
+
+   json_stack frames;  /* for json_writer_value */
+
+   #ifndef NDEBUG
+      json_stack open;  /* '[' or '{' for each open container */
+      int done;         /* the root value is complete */
+   #endif
+
+   json_out out;
+};
+
+static int fd_sink (const json_char * text, size_t length, void * user_data)
+{
+   int fd = *(int *) user_data;
+
+   while (length)
+   {
+      long n = (long) write (fd, text, (unsigned int) (length > 0x40000000 ? 0x40000000 : length));
+
+      if (n < 0)
+      {
+         if (errno == EINTR)
+            continue;
+
+         return 0;
+      }
+
+      text += n;
+      length -= n;
+   }
+
+   return 1;
+}
+
+static json_writer * writer_new (json_settings * settings, const json_serialize_opts * opts)
+{
+   json_settings writer_settings;
+   json_writer * writer;
+
+   settings_init (&writer_settings, settings);
+
+   if (! (writer = (json_writer *) writer_settings.mem_alloc
+            (sizeof (json_writer), 1, writer_settings.user_data)) )
+   {
+      return 0;
+   }
+
+   writer->settings = writer_settings;
+
+   if (opts)
+      writer->opts = *opts;
+
+   return writer;
+}
+
+json_writer * json_writer_new (json_buffer * buffer, const json_serialize_opts * opts)
+{
+   json_writer * writer;
+
+   if (! (writer = writer_new (&buffer->settings, opts)) )
+      return 0;
+
+   writer->buffer = buffer;
+   out_init (&writer->out, buffer, 0, 0);
+
+   return writer;
+}
+
+json_writer * json_writer_new_fd
+   (json_settings * settings, int fd, const json_serialize_opts * opts)
+{
+   json_writer * writer;
+
+   if (! (writer = writer_new (settings, opts)) )
+      return 0;
+
+   writer->fd = fd;
+   out_init (&writer->out, 0, fd_sink, &writer->fd);
+
+   return writer;
+}
+
+void json_writer_free (json_writer * writer)
+{
+   if (!writer)
+      return;
+
+   stack_free (&writer->settings, &writer->frames);
+
+   #ifndef NDEBUG
+      stack_free (&writer->settings, &writer->open);
+   #endif
+
+   writer->settings.mem_free (writer, writer->settings.user_data);
+}
+
+/* Before a key or value: checks it's in place (where that's done), then the
+ * comma and line break that go before it.  `kind` is 'k' for a key, or 'v'.
+ */
+static int writer_next (json_writer * writer, int kind)
+{
+   json_out * out = &writer->out;
+
+   if (out->failed)
+      return 0;
+
+   #ifndef NDEBUG
+   {
+      int in = writer->open.length ? writer->open.mem [writer->open.length - 1] : 0;
+
+      if (writer->done
+            || (kind == 'k' && (in != '{' || writer->after_key))
+            || (kind == 'v' && in == '{' && !writer->after_key))
+      {
+         out->failed = 1;
+         return 0;
+      }
+   }
+   #endif
+
+   if (!writer->started)
+   {
+      /* a new document: pick up the buffer as it's been left */
+
+      if (writer->buffer)
+         out_init (out, writer->buffer, 0, 0);
+
+      writer->started = 1;
+   }
+
+   if (writer->after_key)
+   {
+      writer->after_key = 0;
+      return 1;
+   }
+
+   if (!writer->depth)
+      return 1;
+
+   if (!writer->first)
+      out_char (out, ',');
+
+   writer->first = 0;
+
+   if (writer->opts.mode == json_serialize_pretty)
+      out_newline (out, &writer->opts, writer->depth);
+
+   return !out->failed;
+}
+
+/* After a value: the document's done if that was the root */
+static int writer_value_done (json_writer * writer)
+{
+   #ifndef NDEBUG
+      if (!writer->depth)
+         writer->done = 1;
+   #endif
+
+   return !writer->out.failed;
+}
+
+static int writer_begin (json_writer * writer, json_char c)
+{
+   if (!writer_next (writer, 'v'))
+      return 0;
+
+   #ifndef NDEBUG
+   {
+      char * open;
+
+      if (! (open = (char *) stack_push (&writer->settings, &writer->open, 1)) )
+      {
+         writer->out.failed = 1;
+         return 0;
+      }
+
+      *open = c;
+   }
+   #endif
 
-               flags |= flag_done;
-               continue;
-            }
+   out_char (&writer->out, c);
 
-            if (top->parent->type == json_array)
-               flags |= flag_seek_value;
-               
-            if (!state.first_pass)
-            {
-               json_value * parent = top->parent;
+   ++ writer->depth;
+   writer->first = 1;
 
-               switch (parent->type)
-               {
-                  case json_object:
+   return !writer->out.failed;
+}
 
-                     parent->u.object.values
-                        [parent->u.object.length].value = top;
+static int writer_end (json_writer * writer, json_char c)
+{
+   json_out * out = &writer->out;
 
-                     break;
+   if (out->failed)
+      return 0;
 
-                  case json_array:
+   #ifndef NDEBUG
+      if (!writer->open.length || writer->after_key
+            || writer->open.mem [writer->open.length - 1] != (c == ']' ? '[' : '{'))
+      {
+         out->failed = 1;
+         return 0;
+      }
 
-                     parent->u.array.values
-                           [parent->u.array.length] = top;
+      -- writer->open.length;
+   #endif
 
-                     break;
+   -- writer->depth;
 
-                  default:
-                     break;
-               };
-            }
+   if (!writer->first && writer->opts.mode == json_serialize_pretty)
+      out_newline (out, &writer->opts, writer->depth);
 
-            if ( (++ top->parent->u.array.length) > state.uint_max)
-               goto e_toolong;
+   out_char (out, c);
+   writer->first = 0;
 
-            top = top->parent;
+   return writer_value_done (writer);
+}
 
-            continue;
-         }
-      }
+int json_writer_begin_object (json_writer * writer)
+{
+   return writer_begin (writer, '{');
+}
 
-      alloc = root;
-   }
+int json_writer_end_object (json_writer * writer)
+{
+   return writer_end (writer, '}');
+}
 
-   return root;
+int json_writer_begin_array (json_writer * writer)
+{
+   return writer_begin (writer, '[');
+}
 
-e_unknown_value:
+int json_writer_end_array (json_writer * writer)
+{
+   return writer_end (writer, ']');
+}
 
-   sprintf (error, "%d:%d: Unknown value", cur_line, e_off);
-   goto e_failed;
+int json_writer_key (json_writer * writer, const json_char * key, size_t length)
+{
+   if (!writer_next (writer, 'k'))
+      return 0;
 
-e_alloc_failure:
+   out_key (&writer->out, key, length, &writer->opts);
+   writer->after_key = 1;
 
-   strcpy (error, "Memory allocation failure");
-   goto e_failed;
+   return !writer->out.failed;
+}
 
-e_overflow:
+int json_writer_string (json_writer * writer, const json_char * string, size_t length)
+{
+   if (!writer_next (writer, 'v'))
+      return 0;
 
-   sprintf (error, "%d:%d: numeral parser have occurred overflow", cur_line, e_off);
-   goto e_failed;
+   out_string (&writer->out, string, length);
+   return writer_value_done (writer);
+}
 
-e_toolong:
+int json_writer_integer (json_writer * writer, json_int_t integer)
+{
+   if (!writer_next (writer, 'v'))
+      return 0;
 
-   sprintf (error, "%d:%d: Too long size object", cur_line, e_off);
-   goto e_failed;
+   out_integer (&writer->out, integer);
+   return writer_value_done (writer);
+}
 
-e_failed:
+int json_writer_double (json_writer * writer, double dbl)
+{
+   if (!writer_next (writer, 'v'))
+      return 0;
 
-   if (error_buf)
-   {
-      if (*error)
-         strcpy (error_buf, error);
-      else
-         strcpy (error_buf, "Unknown error");
-   }
+   if (out_reserve (&writer->out, 32))
+      writer->out.next += format_double (dbl, writer->out.next);
 
-   if (state.first_pass)
-      alloc = root;
+   return writer_value_done (writer);
+}
 
-   while (alloc)
-   {
-      top = alloc->_reserved.next_alloc;
-      free (alloc);
-      alloc = top;
-   }
+int json_writer_bool (json_writer * writer, int boolean)
+{
+   if (!writer_next (writer, 'v'))
+      return 0;
 
-   if (!state.first_pass)
-      json_value_free (root);
+   if (boolean)
+      out_literal (&writer->out, "true");
+   else
+      out_literal (&writer->out, "false");
 
-   return 0;
+   return writer_value_done (writer);
 }
 
-json_value * json_parse (const json_char * json)
+int json_writer_null (json_writer * writer)
 {
-   json_settings settings;
-   memset (&settings, 0, sizeof (json_settings));
+   if (!writer_next (writer, 'v'))
+      return 0;
 
-   return json_parse_ex (&settings, json, 0);
+   out_literal (&writer->out, "null");
+   return writer_value_done (writer);
 }
 
-void json_value_free (json_value * value)
+int json_writer_value (json_writer * writer, const json_value * value)
 {
-   json_value * cur_value;
-
-   if (!value)
-      return;
+   if (!writer_next (writer, 'v'))
+      return 0;
 
-   value->parent = 0;
+   serialize (&writer->settings, &writer->out, value, &writer->opts,
+              writer->depth, &writer->frames);
 
-   while (value)
-   {
-      switch (value->type)
-      {
-         case json_array:
+   return writer_value_done (writer);
+}
 
-            if (!value->u.array.length)
-            {
-               free (value->u.array.values);
-               break;
-            }
+int json_writer_flush (json_writer * writer)
+{
+   return out_done (&writer->out);
+}
 
-            value = value->u.array.values [-- value->u.array.length];
-            continue;
+int json_writer_finish (json_writer * writer)
+{
+   int result;
 
-         case json_object:
+   #ifndef NDEBUG
+      if (!writer->done)
+         writer->out.failed = 1;
 
-            if (!value->u.object.length)
-            {
-               free (value->u.object.values);
-               break;
-            }
+      writer->open.length = 0;
+      writer->done = 0;
+   #endif
 
-            value = value->u.object.values [-- value->u.object.length].value;
-            continue;
+   result = out_done (&writer->out);
 
-         case json_string:
+   if (!writer->buffer)
+      writer->out.next = writer->out.chunk;
 
-            free (value->u.string.ptr);
-            break;
+   writer->out.failed = 0;
+   writer->depth = 0;
+   writer->first = writer->after_key = writer->started = 0;
 
-         default:
-            break;
-      };
+   return result;
+}
 
-      cur_value = value;
-      value = value->parent;
-      free (cur_value);
-   }
+static int json_value_dump_sink(json_char const * text, size_t length, void * fp) {
+	return fwrite(text, sizeof(json_char), length, (FILE *)fp) == length;
 }
 
+// compact, through the serializer
 void json_value_dump(FILE * fp, json_value const * v) {
-	void (* const rec)(FILE * fp, json_value const * v) = json_value_dump;
-
 	assert(fp);
-	if (v) {
-		unsigned int i;
-		switch (v->type) {
-		case json_none:	// ??
-			fprintf(fp, "none");
-			break;
-		case json_object:
-			fprintf(fp, "{");
-			if (v->u.object.length >= 1) {
-				fprintf(fp, "\"%s\":", v->u.object.values[0].name);
-				rec(fp, v->u.object.values[0].value);
-			}
-			for (i=1; i<v->u.object.length; ++i) {
-				fprintf(fp, ",");
-				fprintf(fp, "\"%s\":", v->u.object.values[i].name);
-				rec(fp, v->u.object.values[i].value);
-			}
-			fprintf(fp, "}");
-			break;
-		case json_array:
-			fprintf(fp, "[");
-			if (v->u.array.length >= 1) {
-				rec(fp, v->u.array.values[0]);
-			}
-			for (i=1; i<v->u.array.length; ++i) {
-				fprintf(fp, ",");
-				rec(fp, v->u.array.values[i]);
-			}
-			fprintf(fp, "]");
-			break;
-		case json_integer:
-			fprintf(fp, "%ld", v->u.integer);
-			break;
-		case json_double:
-			fprintf(fp, "%lf", v->u.dbl);
-			break;
-		case json_string:
-			fprintf(fp, "\"%s\"", v->u.string.ptr);
-			break;
-		case json_boolean:
-			fprintf(fp, v->u.boolean ? "true" : "false");
-			break;
-		case json_null:
-			fprintf(fp, "null");
-			break;
-		default:
-			fprintf(stderr, "unknown format json value is passed\n");
-			break;
-		}
-	} else
+	if (v)
+		json_serialize_sink(NULL, v, NULL, json_value_dump_sink, fp);
+	else
 		fprintf(fp, "(NULL)");
 }
 
@@ -929,16 +8655,440 @@ bool json_type_equal (json_value const * lhs, json_value const * rhs) {
 #undef XOR
 
 json_value const * find_json_object(json_value const * v, char const * field) {
-	if (v && v->type == json_object) {
+	size_t length;
+	if (!v || v->type != json_object)
+		return NULL;
+	length = strlen(field);
+	if (object_index(v))
+		return find_json_object_hashed(v, field, length, json_key_hash(field, length));
+	else {
 		unsigned int i;
 		for (i=0; i<v->u.object.length; ++i) {
-			if (!strcmp(v->u.object.values[i].name, field))
+			// interned keys are the same pointer
+			if (v->u.object.values[i].name == field || !strcmp(v->u.object.values[i].name, field))
 				return v->u.object.values[i].value;
 		}
 	}
 	return NULL;
 }
 
+// the place of the first member of object `v` with key `field`, or its length
+static unsigned int object_member(json_value const * v, char const * field, size_t length, uint32_t hash) {
+	json_index const * index;
+	unsigned int i;
+	if ((index = object_index(v))) {
+		uint32_t const * hashes = (uint32_t const *)(index + 1);
+		uint32_t const * table = hashes + v->u.object.length;
+		uint32_t slot;
+		for (slot = hash & index->mask; table[slot]; slot = (slot + 1) & index->mask) {
+			i = table[slot] - 1;
+			if (hashes[i] == hash
+					&& (v->u.object.values[i].name == field
+						|| !strncmp(v->u.object.values[i].name, field, length))
+					&& !v->u.object.values[i].name[length])
+				return i;
+		}
+	} else {
+		for (i=0; i<v->u.object.length; ++i) {
+			if ((v->u.object.values[i].name == field
+						|| !strncmp(v->u.object.values[i].name, field, length))
+					&& !v->u.object.values[i].name[length])
+				return i;
+		}
+	}
+	return v->u.object.length;
+}
+
+json_value const * find_json_object_hashed(json_value const * v, char const * field, size_t length, uint32_t hash) {
+	unsigned int i;
+	if (!v || v->type != json_object)
+		return NULL;
+	i = object_member(v, field, length, hash);
+	return i < v->u.object.length ? v->u.object.values[i].value : NULL;
+}
+
+// Comparing: a walk over both trees at once, keeping its place on a stack
+// of frames, with each key of an object found in the other by its hash.
+// For the larger objects without an index (parsed without json_index_objects,
+// or put together by hand) the other's keys are sorted once and searched
+// instead.
+// A key repeated in an object pairs up in order with the same key repeated
+// in the other: the first with the first, the second with the second.
+typedef struct {
+   json_char const * name;
+   json_value const * value;
+   unsigned int index;
+} compare_key;
+
+typedef struct {
+   json_value const * lhs, * rhs;
+   unsigned int index;  // of the next child
+   size_t keys;         // offset of the sorted keys of rhs, or -1 if none
+   size_t used;         // offset of the bitmap of members of rhs taken, or -1
+   size_t mark;         // the length of the keys before this frame
+} compare_frame;
+
+static int compare_keys(void const * a, void const * b) {
+   compare_key const * x = (compare_key const *)a, * y = (compare_key const *)b;
+   int order = strcmp(x->name, y->name);
+   return order ? order : x->index < y->index ? -1 : x->index > y->index;
+}
+
+// the place of the first of the sorted keys named `name`, or `length`
+static unsigned int compare_search(compare_key const * keys, unsigned int length, json_char const * name) {
+   unsigned int low = 0, high = length, mid;
+   while (low < high) {
+      mid = low + (high - low) / 2;
+      if (strcmp(keys[mid].name, name) < 0)
+         low = mid + 1;
+      else
+         high = mid;
+   }
+   return low < length && !strcmp(keys[low].name, name) ? low : length;
+}
+
+static bool compare_double(double lhs, double rhs, json_compare_opts const * opts) {
+   double distance = lhs < rhs ? rhs - lhs : lhs - rhs;
+   if (!opts || opts->bitwise)
+      return !memcmp(&lhs, &rhs, sizeof(double));
+   return (lhs <= rhs && lhs >= rhs) || distance <= opts->tolerance;
+}
+
+// compare all but children
+static bool compare_node(json_value const * lhs, json_value const * rhs, json_compare_opts const * opts) {
+   if (!lhs || !rhs)
+      return lhs == rhs;
+   if (lhs->type != rhs->type)
+      return false;
+   switch (lhs->type) {
+   case json_object : return lhs->u.object.length == rhs->u.object.length;
+   case json_array  : return lhs->u.array.length == rhs->u.array.length;
+   case json_integer: return lhs->u.integer == rhs->u.integer;
+   case json_double : return compare_double(lhs->u.dbl, rhs->u.dbl, opts);
+   case json_string : return lhs->u.string.length == rhs->u.string.length
+                        && !memcmp(lhs->u.string.ptr, rhs->u.string.ptr, lhs->u.string.length * sizeof(json_char));
+   case json_boolean: return lhs->u.boolean == rhs->u.boolean;
+   default          : return true;
+   }
+}
+
+static int compare_push(json_settings * settings, json_stack * stack, json_stack * keys,
+                        json_value const * lhs, json_value const * rhs) {
+   compare_frame * frame = (compare_frame *)stack_push(settings, stack, sizeof(compare_frame));
+   if (!frame)
+      return 0;
+   frame->lhs = lhs;
+   frame->rhs = rhs;
+   frame->index = 0;
+   frame->keys = (size_t)-1;
+   frame->used = (size_t)-1;
+   frame->mark = keys->length;
+   return 1;
+}
+
+// the first time keys of an object aren't in the same place: sort the keys
+// of rhs if it's large with no index
+static int compare_sort(json_settings * settings, compare_frame * frame, json_stack * keys) {
+   json_value const * rhs = frame->rhs;
+   unsigned int i, length = rhs->u.object.length;
+   compare_key * sorted;
+   if (length < index_min || object_index(rhs))
+      return 1;
+   frame->keys = keys->length;
+   if (!(sorted = (compare_key *)stack_push(settings, keys, length * sizeof(compare_key))))
+      return 0;
+   for (i=0; i<length; ++i) {
+      sorted[i].name = rhs->u.object.values[i].name;
+      sorted[i].value = rhs->u.object.values[i].value;
+      sorted[i].index = i;
+   }
+   qsort(sorted, length, sizeof(compare_key), compare_keys);
+   return 1;
+}
+
+#define compare_taken(used, j) ((used)[(j) / 8] >> ((j) % 8) & 1)
+
+// the member of `rhs` paired with member `i` of `lhs` in `found` (NULL if
+// none); false if memory runs out
+static int compare_find(json_settings * settings, compare_frame * frame, json_stack * keys,
+                        unsigned int i, json_value const ** found) {
+   json_value const * lhs = frame->lhs, * rhs = frame->rhs;
+   json_char const * name = lhs->u.object.values[i].name;
+   unsigned int length = rhs->u.object.length, j;
+   compare_key const * sorted;
+   json_index const * index;
+   unsigned char * used;
+   size_t size;
+   // most often, keys come in the same order, and while they do, each pairs
+   // with the one in the same place.  Once they don't, those taken are
+   // marked, all those before this one to start with.
+   if (frame->used == (size_t)-1) {
+      if (rhs->u.object.values[i].name == name || !strcmp(rhs->u.object.values[i].name, name)) {
+         *found = rhs->u.object.values[i].value;
+         return 1;
+      }
+      if (!compare_sort(settings, frame, keys))
+         return 0;
+      frame->used = keys->length;
+      if (!(used = (unsigned char *)stack_push(settings, keys, (length + 7) / 8)))
+         return 0;
+      memset(used, 0, (length + 7) / 8);
+      for (j=0; j<i; ++j)
+         used[j / 8] |= 1 << (j % 8);
+   }
+   used = (unsigned char *)(keys->mem + frame->used);
+   if (frame->keys != (size_t)-1) {
+      // repeats of a key are next to each other, in order
+      sorted = (compare_key const *)(keys->mem + frame->keys);
+      for (j = compare_search(sorted, length, name);
+           j < length && !strcmp(sorted[j].name, name) && compare_taken(used, sorted[j].index); ++j)
+         ;
+      j = j < length && !strcmp(sorted[j].name, name) ? sorted[j].index : length;
+   } else {
+      size = strlen(name);
+      // an index has the hashes of its keys
+      j = object_member(rhs, name, size, (index = object_index(lhs))
+                           ? ((uint32_t const *)(index + 1))[i] : json_key_hash(name, size));
+      while (j < length && compare_taken(used, j))
+         for (++j; j < length && strcmp(rhs->u.object.values[j].name, name); ++j)
+            ;
+   }
+   *found = NULL;
+   if (j < length) {
+      used[j / 8] |= 1 << (j % 8);
+      *found = rhs->u.object.values[j].value;
+   }
+   return 1;
+}
+
+// the path to the child the top frame is at, as a JSON pointer
+static void compare_path(json_stack const * stack, char * path, size_t size) {
+   compare_frame const * frame = (compare_frame const *)stack->mem;
+   size_t used = 0;
+   char index[16];
+   json_char const * step;
+   if (!path || !size)
+      return;
+   for (; (char const *)frame < stack->mem + stack->length; ++frame) {
+      if (frame->lhs->type == json_object)
+         step = frame->lhs->u.object.values[frame->index - 1].name;
+      else {
+         sprintf(index, "%u", frame->index - 1);
+         step = index;
+      }
+      if (used + 1 < size)
+         path[used++] = '/';
+      for (; *step && used + 1 < size; ++step) {
+         // '~' and '/' escape as "~0" and "~1"
+         if (*step == '~' || *step == '/') {
+            if (used + 2 >= size)
+               break;
+            path[used++] = '~';
+            path[used++] = *step == '~' ? '0' : '1';
+         } else
+            path[used++] = *step;
+      }
+   }
+   path[used] = 0;
+}
+
+int json_value_compare(json_settings * settings, json_value const * lhs, json_value const * rhs,
+                       json_compare_opts const * opts, char * path, size_t path_size) {
+   json_settings compare_settings;
+   json_stack stack = { NULL, 0, 0 }, keys = { NULL, 0, 0 };
+   compare_frame * frame;
+   unsigned int i;
+   int result = 1;
+   settings_init(&compare_settings, settings);
+   if (path && path_size)
+      *path = 0;
+   if (!compare_node(lhs, rhs, opts))
+      return 0;
+   if (lhs && (lhs->type == json_object || lhs->type == json_array) && lhs != rhs
+         && !compare_push(&compare_settings, &stack, &keys, lhs, rhs))
+      result = -1;
+   while (result == 1 && stack.length) {
+      frame = stack_top(stack, compare_frame);
+      if (frame->index == (frame->lhs->type == json_array ? frame->lhs->u.array.length
+                                                          : frame->lhs->u.object.length)) {
+         keys.length = frame->mark;
+         stack.length -= sizeof(compare_frame);
+         continue;
+      }
+      i = frame->index++;
+      if (frame->lhs->type == json_array) {
+         lhs = frame->lhs->u.array.values[i];
+         rhs = frame->rhs->u.array.values[i];
+      } else {
+         lhs = frame->lhs->u.object.values[i].value;
+         if (!compare_find(&compare_settings, frame, &keys, i, &rhs)) {
+            result = -1;
+            break;
+         }
+      }
+      if (!compare_node(lhs, rhs, opts)) {
+         compare_path(&stack, path, path_size);
+         result = 0;
+      } else if (lhs && (lhs->type == json_object || lhs->type == json_array) && lhs != rhs
+            && !compare_push(&compare_settings, &stack, &keys, lhs, rhs))
+         result = -1;
+   }
+   stack_free(&compare_settings, &stack);
+   stack_free(&compare_settings, &keys);
+   return result;
+}
+
+// Hashing: a walk without recursing, as in comparing, that hashes each
+// value once all its children are.  Scalars hash their type and content, an
+// array what it holds in order, and an object the sum of a hash of each key
+// with its value's, so the order of keys doesn't count.  Two lanes of 64
+// bits, mixed differently, make up the 128 of the result.
+typedef struct {
+   uint64_t a, b;
+} hash_lanes;
+
+typedef struct {
+   json_value const * value;
+   unsigned int index;  // of the next child
+   hash_lanes hash;     // of the children so far
+} hash_frame;
+
+#define hash_k1 UINT64_C(0x9e3779b97f4a7c15)
+#define hash_k2 UINT64_C(0xc2b2ae3d27d4eb4f)
+#define hash_rotl(x, n) (((x) << (n)) | ((x) >> (64 - (n))))
+
+// murmur3's finalizer
+static uint64_t hash_mix(uint64_t h) {
+   h ^= h >> 33;
+   h *= UINT64_C(0xff51afd7ed558ccd);
+   h ^= h >> 33;
+   h *= UINT64_C(0xc4ceb9fe1a85ec53);
+   return h ^ (h >> 33);
+}
+
+static void hash_bytes(hash_lanes * h, void const * bytes, size_t length) {
+   char const * p = (char const *)bytes;
+   uint64_t word;
+   size_t left;
+   for (left = length; left >= 8; left -= 8, p += 8) {
+      memcpy(&word, p, 8);
+      h->a = hash_rotl(h->a ^ word * hash_k1, 31) * hash_k2;
+      h->b = hash_rotl(h->b ^ word * hash_k2, 29) * hash_k1;
+   }
+   if (left) {
+      word = 0;
+      memcpy(&word, p, left);
+      h->a = hash_rotl(h->a ^ word * hash_k1, 31) * hash_k2;
+      h->b = hash_rotl(h->b ^ word * hash_k2, 29) * hash_k1;
+   }
+   h->a = hash_mix(h->a ^ length);
+   h->b = hash_mix(h->b + length + h->a);
+}
+
+static hash_lanes hash_start(json_type type) {
+   hash_lanes h;
+   h.a = hash_k1 ^ type;
+   h.b = hash_k2 + type;
+   return h;
+}
+
+// the hash of a value with no children, or with `types`, only of its type
+static hash_lanes hash_scalar(json_value const * value, int types) {
+   hash_lanes h = hash_start(value ? value->type : json_none);
+   if (!value || types) {
+      hash_bytes(&h, NULL, 0);
+      return h;
+   }
+   switch (value->type) {
+   case json_integer: hash_bytes(&h, &value->u.integer, sizeof(json_int_t)); break;
+   case json_double : hash_bytes(&h, &value->u.dbl, sizeof(double)); break;
+   case json_string : hash_bytes(&h, value->u.string.ptr, value->u.string.length * sizeof(json_char)); break;
+   case json_boolean: hash_bytes(&h, &value->u.boolean, sizeof(int)); break;
+   default          : hash_bytes(&h, NULL, 0); break;
+   }
+   return h;
+}
+
+static unsigned int hash_length(json_value const * value) {
+   return value->type == json_array  ? value->u.array.length
+        : value->type == json_object ? value->u.object.length : 0;
+}
+
+// take in the hash of child `i` of the frame's value
+static void hash_child(hash_frame * frame, unsigned int i, hash_lanes child) {
+   json_char const * name;
+   if (frame->value->type == json_array) {
+      frame->hash.a = hash_mix(frame->hash.a * hash_k1 + child.a);
+      frame->hash.b = hash_mix(frame->hash.b * hash_k2 + child.b);
+   } else {
+      name = frame->value->u.object.values[i].name;
+      hash_bytes(&child, name, strlen(name) * sizeof(json_char));
+      frame->hash.a += child.a;
+      frame->hash.b += child.b;
+   }
+}
+
+static bool hash_push(json_settings * settings, json_stack * stack, json_value const * value) {
+   hash_frame * frame = (hash_frame *)stack_push(settings, stack, sizeof(hash_frame));
+   if (!frame)
+      return false;
+   frame->value = value;
+   frame->index = 0;
+   frame->hash = hash_start(value->type);
+   return true;
+}
+
+static bool hash_value(json_settings * settings, json_value const * value, int types, uint64_t hash[2]) {
+   json_settings hash_settings;
+   json_stack stack = { NULL, 0, 0 };
+   hash_frame * frame;
+   hash_lanes h = { 0, 0 };
+   unsigned int i;
+   bool result = true;
+   settings_init(&hash_settings, settings);
+   if (value && hash_length(value))
+      result = hash_push(&hash_settings, &stack, value);
+   else
+      h = hash_scalar(value, types);
+   while (result && stack.length) {
+      frame = stack_top(stack, hash_frame);
+      if (frame->index == hash_length(frame->value)) {
+         // done with the children
+         h = frame->hash;
+         hash_bytes(&h, &frame->index, sizeof(unsigned int));
+         stack.length -= sizeof(hash_frame);
+         if (stack.length) {
+            frame = stack_top(stack, hash_frame);
+            hash_child(frame, frame->index - 1, h);
+         }
+         continue;
+      }
+      i = frame->index++;
+      value = frame->value->type == json_array ? frame->value->u.array.values[i]
+                                               : frame->value->u.object.values[i].value;
+      if (value && hash_length(value))
+         result = hash_push(&hash_settings, &stack, value);
+      else
+         hash_child(frame, i, hash_scalar(value, types));
+   }
+   stack_free(&hash_settings, &stack);
+   if (result) {
+      hash[0] = h.a;
+      hash[1] = h.b;
+   }
+   return result;
+}
+
+#undef hash_rotl
+
+bool json_value_hash(json_settings * settings, json_value const * value, uint64_t hash[2]) {
+   return hash_value(settings, value, 0, hash);
+}
+
+bool json_type_hash(json_settings * settings, json_value const * value, uint64_t hash[2]) {
+   return hash_value(settings, value, 1, hash);
+}
+
 bool all_array_type(json_type ty, json_value const * js) {
 	if (js && js->type==json_array) {
 		size_t i;
@@ -952,58 +9102,259 @@ bool all_array_type(json_type ty, json_value const * js) {
 		return false;
 }
 
-static json_value * make_json_value_none(void) {
-   json_value * json_ = (json_value*)calloc(1, sizeof(json_value));
+static json_value * make_json_value_none(json_settings * settings) {
+   json_value * json_ = (json_value*)settings->mem_alloc(sizeof(json_value), 1, settings->user_data);
    if (!json_)
       return NULL;
    *json_ = json_value_none;
    return json_;
 }
 
-json_value * json_value_dup(json_value const * json) {
+static json_value * dup_value(json_settings * settings, json_value const * json, json_value * parent) {
    json_value * json_ = NULL;
    if (!json)
       return NULL;
-   json_ = make_json_value_none();
+   json_ = make_json_value_none(settings);
    if (!json_)
       return NULL;
 
    // copy tag
    json_->type = json->type;
+   json_->parent = parent;
    // copy body
         if (json->type == json_integer) { json_->u.integer = json->u.integer; }
    else if (json->type == json_double ) { json_->u.dbl     = json->u.dbl;     }
    else if (json->type == json_boolean) { json_->u.boolean = json->u.boolean; }
    else if (json->type == json_null   ) { }
    else if (json->type == json_string ) {
+      json_->u.string.ptr = (json_char*)settings->mem_alloc(
+                              (json->u.string.length + 1) * sizeof(json_char), 0, settings->user_data);
+      if (!json_->u.string.ptr) {
+         settings->mem_free(json_, settings->user_data);
+         return NULL;
+      }
       json_->u.string.length = json->u.string.length;
-      json_->u.string.ptr    = strdup(json->u.string.ptr);
+      memcpy(json_->u.string.ptr, json->u.string.ptr, (json->u.string.length + 1) * sizeof(json_char));
    } else if (json->type == json_object) {
-      size_t i;
-      json_->u.object.length = json->u.object.length;
-      json_->u.object.values = calloc(json->u.object.length
-                                     /* because inner type have no name, get size from the NULL */
-                                    , sizeof(*((json_value*)NULL)->u.object.values));
-      for (i=0; i<json_->u.object.length; ++i) {
-         json_->u.object.values[i].name  = strdup(json->u.object.values[i].name);
+      // keys are copied in behind the values, the same layout as a parse
+      size_t i, names_size = 0;
+      size_t values_size = json->u.object.length
+                             /* because inner type have no name, get size from the NULL */
+                             * sizeof(*((json_value*)NULL)->u.object.values);
+      json_index const * index = object_index(json);
+      size_t indexed = index ? index_size(json->u.object.length) : 0;
+      json_char * names;
+      for (i=0; i<json->u.object.length; ++i)
+         names_size += (strlen(json->u.object.values[i].name) + 1) * sizeof(json_char);
+      *(void **)&json_->u.object.values = settings->mem_alloc(values_size + indexed + names_size, 0, settings->user_data);
+      if (!json_->u.object.values) {
+         settings->mem_free(json_, settings->user_data);
+         return NULL;
+      }
+      if (indexed) {
+         // entry numbers don't change, so an index copies as it is
+         json_->_reserved.object_mem = (char *)json_->u.object.values + values_size;
+         memcpy(json_->_reserved.object_mem, index, indexed);
+      }
+      names = (json_char *)((char *)json_->u.object.values + values_size + indexed);
+      for (i=0; i<json->u.object.length; ++i) {
+         size_t name_size = (strlen(json->u.object.values[i].name) + 1) * sizeof(json_char);
+         json_->u.object.values[i].name = (json_char *)memcpy(names, json->u.object.values[i].name, name_size);
+         names += name_size / sizeof(json_char);
          // recursive copy
-         json_->u.object.values[i].value = json_value_dup(json->u.object.values[i].value);
+         json_->u.object.values[i].value = dup_value(settings, json->u.object.values[i].value, json_);
+         if (!json_->u.object.values[i].value) {
+            json_value_free_ex(settings, json_);
+            return NULL;
+         }
+         ++json_->u.object.length;
       }
    } else if (json->type == json_array) {
       size_t i;
-      json_->u.array.length = json->u.array.length;
-      json_->u.array.values = calloc(json->u.array.length, sizeof(json_value));
-      for (i=0; i<json_->u.array.length; ++i)
+      json_->u.array.values = (json_value**)settings->mem_alloc(
+                                json->u.array.length * sizeof(json_value*), 0, settings->user_data);
+      if (!json_->u.array.values) {
+         settings->mem_free(json_, settings->user_data);
+         return NULL;
+      }
+      for (i=0; i<json->u.array.length; ++i) {
          // recursive copy
-         json_->u.array.values[i] = json_value_dup(json->u.array.values[i]);
+         json_->u.array.values[i] = dup_value(settings, json->u.array.values[i], json_);
+         if (!json_->u.array.values[i]) {
+            json_value_free_ex(settings, json_);
+            return NULL;
+         }
+         ++json_->u.array.length;
+      }
    } else if (json->type == json_none) {
    } else {
-      free(json_);
+      settings->mem_free(json_, settings->user_data);
       return NULL;
    }
    return json_;
 }
 
+json_value * json_value_dup_ex(json_settings * settings, json_value const * json) {
+   json_settings dup_settings;
+   settings_init(&dup_settings, settings);
+   return dup_value(&dup_settings, json, NULL);
+}
+
+json_value * json_value_dup(json_value const * json) {
+   return json_value_dup_ex(NULL, json);
+}
+
+// Block copies: a first walk over the value adds up the memory the copy
+// will take, all of it, and a second carves the copy out of one block of
+// that size.  Both walks keep their place on a stack of frames rather than
+// recursing.  Every piece is aligned as a document's are, and objects keep
+// the layout of a parse (values, index, keys), so their index still works.
+typedef struct {
+   json_value const * value;
+   json_value * copy;
+   unsigned int index;
+} dup_frame;
+
+static unsigned int dup_length(json_value const * value) {
+   return value->type == json_array  ? value->u.array.length
+        : value->type == json_object ? value->u.object.length : 0;
+}
+
+static json_value const * dup_child(json_value const * value, unsigned int i) {
+   return value->type == json_array ? value->u.array.values[i] : value->u.object.values[i].value;
+}
+
+// the size of a value's node and of what it points at
+static size_t dup_size(json_value const * value) {
+   size_t size = 0;
+   unsigned int i;
+   switch (value->type) {
+   case json_string:
+      size = (value->u.string.length + 1) * sizeof(json_char);
+      break;
+   case json_array:
+      size = value->u.array.length * sizeof(json_value *);
+      break;
+   case json_object:
+      for (i=0; i<value->u.object.length; ++i)
+         size += (strlen(value->u.object.values[i].name) + 1) * sizeof(json_char);
+      size += value->u.object.length * sizeof(*value->u.object.values)
+            + (object_index(value) ? index_size(value->u.object.length) : 0);
+      break;
+   default:
+      break;
+   }
+   return align_size(sizeof(json_value)) + align_size(size);
+}
+
+// copy a value's node and what it points at to `*next`, moving it on, but
+// not the children, which are left for the walk to fill in
+static json_value * dup_node(json_value const * value, json_value * parent, char ** next) {
+   json_value * copy = (json_value *)*next;
+   char * body = *next + align_size(sizeof(json_value));
+   unsigned int i;
+   *next += dup_size(value);
+   *copy = *value;
+   copy->parent = parent;
+   copy->_reserved.object_mem = NULL;
+   if (value->type == json_string) {
+      copy->u.string.ptr = (json_char *)memcpy(body, value->u.string.ptr,
+                                               (value->u.string.length + 1) * sizeof(json_char));
+   } else if (value->type == json_array) {
+      copy->u.array.values = (json_value **)body;
+   } else if (value->type == json_object) {
+      size_t values_size = value->u.object.length * sizeof(*value->u.object.values);
+      json_index const * index = object_index(value);
+      size_t indexed = index ? index_size(value->u.object.length) : 0;
+      json_char * names = (json_char *)(body + values_size + indexed);
+      *(void **)&copy->u.object.values = body;
+      if (indexed) {
+         copy->_reserved.object_mem = body + values_size;
+         memcpy(copy->_reserved.object_mem, index, indexed);
+      }
+      for (i=0; i<value->u.object.length; ++i) {
+         size_t name_size = (strlen(value->u.object.values[i].name) + 1) * sizeof(json_char);
+         copy->u.object.values[i].name = (json_char *)memcpy(names, value->u.object.values[i].name, name_size);
+         names += name_size / sizeof(json_char);
+      }
+   }
+   return copy;
+}
+
+static int dup_push(json_settings * settings, json_stack * stack, json_value const * value, json_value * copy) {
+   dup_frame * frame = (dup_frame *)stack_push(settings, stack, sizeof(dup_frame));
+   if (!frame)
+      return 0;
+   frame->value = value;
+   frame->copy = copy;
+   frame->index = 0;
+   return 1;
+}
+
+// walk the value, measuring it (copy is NULL) or copying it to `next`
+static json_value * dup_walk(json_settings * settings, json_stack * stack, json_value const * value,
+                             size_t * size, char * next) {
+   json_value * root = next ? dup_node(value, NULL, &next) : NULL, * copy = NULL;
+   json_value const * child;
+   dup_frame * frame;
+   unsigned int i;
+   *size = dup_size(value);
+   stack->length = 0;
+   if (dup_length(value) && !dup_push(settings, stack, value, root))
+      return NULL;
+   while (stack->length) {
+      frame = stack_top(*stack, dup_frame);
+      if (frame->index == dup_length(frame->value)) {
+         stack->length -= sizeof(dup_frame);
+         continue;
+      }
+      child = dup_child(frame->value, i = frame->index++);
+      if (next) {
+         copy = dup_node(child, frame->copy, &next);
+         if (frame->value->type == json_array)
+            frame->copy->u.array.values[i] = copy;
+         else
+            frame->copy->u.object.values[i].value = copy;
+      } else
+         *size += dup_size(child);
+      if (dup_length(child) && !dup_push(settings, stack, child, copy))
+         return NULL;
+   }
+   return next ? root : (json_value *)value;
+}
+
+static json_value * dup_block(json_settings * settings, json_document * doc, json_value const * value) {
+   json_stack stack = { NULL, 0, 0 };
+   json_value * copy = NULL;
+   size_t size;
+   char * block;
+   if (!value)
+      return NULL;
+   if (dup_walk(settings, &stack, value, &size, NULL)) {
+      if (!doc)
+         block = (char *)settings->mem_alloc(size, 0, settings->user_data);
+      else if (settings->max_memory && (doc->used_memory += size) > settings->max_memory)
+         block = NULL;
+      else
+         block = (char *)arena_alloc(settings, &doc->arena, size);
+      // the stack has been as deep as it'll go, so this walk can't fail
+      if (block)
+         copy = dup_walk(settings, &stack, value, &size, block);
+   }
+   stack_free(settings, &stack);
+   return copy;
+}
+
+json_value * json_value_dup_block(json_settings * settings, json_value const * json) {
+   json_settings dup_settings;
+   settings_init(&dup_settings, settings);
+   return dup_block(&dup_settings, NULL, json);
+}
+
+json_value * json_document_dup(json_document * doc, json_value const * json) {
+   return dup_block(&doc->settings, doc, json);
+}
+
 
 //
 // constructor
@@ -1121,7 +9472,7 @@ bool json_value_read_if_uint64_t(uint64_t * x, json_value const * v) {
 			//&& v->u.integer <= UINT32_MAX
          )
 	{
-		*x = (uint32_t)v->u.integer;
+		*x = (uint64_t)v->u.integer;
 		return true;
 	} else
 		return false;
@@ -1256,3 +9607,47 @@ bool json_value_read_if_bool(bool * x, json_value const * v) {
 		return false;
 }
 
+// tape nodes read as the json_value of the same scalar would
+static bool node_scalar(json_value * v, json_node const * n) {
+	if (!n || n->type==json_array || n->type==json_object)
+		return false;
+	v->type = n->type;
+	switch (n->type) {
+	case json_string:
+		v->u.string.length = n->length;
+		v->u.string.ptr = (json_char *)n->u.string;
+		break;
+	case json_integer: v->u.integer = n->u.integer; break;
+	case json_double : v->u.dbl = n->u.dbl; break;
+	case json_boolean: v->u.boolean = n->u.boolean; break;
+	default: break;
+	}
+	return true;
+}
+
+#define NODE_READ_IF(type, name) \
+	bool json_node_read_if_##name(type * x, json_node const * n) { \
+		json_value v; \
+		return node_scalar(&v, n) && json_value_read_if_##name(x, &v); \
+	}
+
+NODE_READ_IF(unsigned int, uint)
+NODE_READ_IF(int, int)
+NODE_READ_IF(uint8_t, uint8_t)
+NODE_READ_IF(uint16_t, uint16_t)
+NODE_READ_IF(uint32_t, uint32_t)
+NODE_READ_IF(uint64_t, uint64_t)
+NODE_READ_IF(uintptr_t, uintptr_t)
+NODE_READ_IF(int8_t, int8_t)
+NODE_READ_IF(int16_t, int16_t)
+NODE_READ_IF(int32_t, int32_t)
+NODE_READ_IF(int64_t, int64_t)
+NODE_READ_IF(intptr_t, intptr_t)
+NODE_READ_IF(size_t, size_t)
+NODE_READ_IF(float, float)
+NODE_READ_IF(double, double)
+NODE_READ_IF(char, string)
+NODE_READ_IF(bool, bool)
+
+#undef NODE_READ_IF
+
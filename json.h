@@ -48,14 +48,37 @@
 
 #endif
 
+typedef struct _json_intern json_intern;
+
 typedef struct
 {
    unsigned long max_memory;
    int settings;
 
+   /* Custom allocator support (leave null to use malloc/free)
+    */
+
+   void * (* mem_alloc) (size_t, int zero, void * user_data);
+   void (* mem_free) (void *, void * user_data);
+
+   void * user_data;  /* will be passed to mem_alloc and mem_free */
+
+   /* Object keys are taken from (and added to) this table, if given, and
+    * parsing takes a single pass
+    */
+
+   json_intern * intern;
+
 } json_settings;
 
+#ifndef json_int_t
+   #define json_int_t int64_t
+#endif
+
 #define json_relaxed_commas 1
+#define json_single_pass    2  /* build the tree in one sweep of the input */
+#define json_index_objects  4  /* index the keys of large objects while parsing */
+#define json_two_stage      8  /* find the structure with SIMD first, then build the tree */
 
 typedef enum
 {
@@ -72,6 +95,9 @@ typedef enum
 
 extern const struct _json_value json_value_none;
 
+const struct _json_value * find_json_object
+   (const struct _json_value * v, char const * field);
+
 typedef struct _json_value
 {
    struct _json_value * parent;
@@ -81,7 +107,7 @@ typedef struct _json_value
    union
    {
       int boolean;
-      long integer;
+      json_int_t integer;
       double dbl;
 
       struct
@@ -144,14 +170,9 @@ typedef struct _json_value
 
          inline const struct _json_value &operator [] (const char * index) const
          { 
-            if (type != json_object)
-               return json_value_none;
-
-            for (unsigned int i = 0; i < u.object.length; ++ i)
-               if (!strcmp (u.object.values [i].name, index))
-                  return *u.object.values [i].value;
+            const struct _json_value * value = find_json_object (this, index);
 
-            return json_value_none;
+            return value ? *value : json_value_none;
          }
 
          inline operator const char * () const
@@ -166,7 +187,7 @@ typedef struct _json_value
             };
          }
 
-         inline operator long () const
+         inline operator json_int_t () const
          {  return u.integer;
          }
 
@@ -184,17 +205,470 @@ json_value * json_parse
 json_value * json_parse_ex
    (json_settings * settings, const json_char * json, char * error);
 
+/* As json_parse_ex, but reads exactly `length` characters of `json`, which
+ * needn't be terminated
+ */
+json_value * json_parse_n
+   (json_settings * settings, const json_char * json, size_t length, char * error);
+
+/* Parses the file at `path`, mapped into memory where it can be (and read
+ * where it can't, as from a pipe), and let go of before returning
+ */
+json_value * json_parse_file
+   (json_settings * settings, const char * path, char * error);
+
+/* As json_parse_n, for a large array: the input is split between its
+ * elements and the pieces parsed on `threads` threads at once (0 for one a
+ * CPU), then joined into the one array.  The result and any error are as
+ * from json_parse_n, which is what any other input (a small one, or one
+ * parsed with an intern table) gets.  The allocator must be safe to call
+ * from several threads, and `max_memory` applies to each piece.
+ */
+json_value * json_parse_parallel
+   (json_settings * settings, const json_char * json, size_t length, int threads, char * error);
+
+/* Events: rather than building the value, the parse calls the handler for
+ * each part of it as it goes, in document order, and keeps nothing that's
+ * done with (the memory used depends on the depth of nesting and the length
+ * of the longest string, not on the size of the input).  Strings passed to
+ * `key` and `string` are terminated and only valid for the call.  Any
+ * callback may be NULL, and returning 0 from one stops the parse, which then
+ * fails.
+ */
+typedef struct
+{
+   int (* start_object) (void * user_data);
+   int (* key) (const json_char * name, unsigned int length, void * user_data);
+   int (* end_object) (void * user_data);
+
+   int (* start_array) (void * user_data);
+   int (* end_array) (void * user_data);
+
+   int (* string) (const json_char * string, unsigned int length, void * user_data);
+   int (* integer) (json_int_t value, void * user_data);
+   int (* dbl) (double value, void * user_data);
+   int (* boolean) (int value, void * user_data);
+   int (* null) (void * user_data);
+
+} json_handler;
+
+/* Returns 0 on failure */
+int json_parse_events
+   (json_settings * settings, const json_handler * handler, void * user_data,
+    const json_char * json, size_t length, char * error);
+
 json_value * json_value_dup(json_value const * json);
 void json_value_free (json_value *);
 
+/* As above, allocating and freeing through the hooks in `settings` */
+json_value * json_value_dup_ex (json_settings * settings, json_value const * json);
+void json_value_free_ex (json_settings * settings, json_value *);
+
+/* Copies `json` into a single block, sized by a first walk over it, which
+ * is released with one call to the `mem_free` of `settings` (free if there
+ * isn't one) rather than with json_value_free.  Neither walk recurses, so
+ * any depth of nesting can be copied.
+ */
+json_value * json_value_dup_block (json_settings * settings, json_value const * json);
+
+/* Documents own every node, string and child array of the values parsed
+ * into them, carved out of a few large chunks, and release them all at once
+ * in json_document_free.  Values from a document must not be passed to
+ * json_value_free.  Parsing into a document always takes a single pass.
+ */
+typedef struct _json_document json_document;
+
+json_document * json_document_new
+   (json_settings * settings);  /* may be NULL */
+
+json_value * json_document_parse
+   (json_document * doc, const json_char * json, char * error);
+
+json_value * json_document_parse_n
+   (json_document * doc, const json_char * json, size_t length, char * error);
+
+/* Decodes strings in place, inside `json` itself: every string value and
+ * key of the result points into `json` rather than being copied, so the
+ * buffer must outlive the document and is left scrambled.
+ */
+json_value * json_document_parse_insitu
+   (json_document * doc, json_char * json, size_t length, char * error);
+
+/* Parses a file in situ, as json_parse_file reads it: the document keeps
+ * the mapping (a private one, so the file itself is left as it is) or the
+ * text read, which the strings point into, until it's reset or freed
+ */
+json_value * json_document_parse_file
+   (json_document * doc, const char * path, char * error);
+
+/* As json_value_dup_block, but the block is carved out of the document,
+ * counting towards its max_memory, and lives until it's reset or freed
+ */
+json_value * json_document_dup
+   (json_document * doc, json_value const * json);
+
+/* Releases every value parsed into the document, but keeps memory to parse
+ * the next ones into
+ */
+void json_document_reset (json_document * doc);
+
+void json_document_free (json_document * doc);
+
+/* Readers go through a sequence of JSON texts, as in newline delimited
+ * JSON or a log of concatenated documents, one root value at a time.  Each
+ * value lives in the reader's document until the next call to
+ * json_reader_next, which reuses its memory.  json_reader_next returns NULL
+ * at the end of the input (leaving `error` empty) or on an error, which
+ * ends the reading.
+ */
+typedef struct _json_reader json_reader;
+
+json_reader * json_reader_new
+   (json_settings * settings, const json_char * json, size_t length);
+
+/* Reads the input through `read`, which fills up to `size` characters of
+ * `buf` and returns how many it did, 0 at the end of the stream
+ */
+json_reader * json_reader_new_stream
+   (json_settings * settings, size_t (* read) (json_char * buf, size_t size, void * user_data),
+    void * user_data);
+
+json_value * json_reader_next (json_reader * reader, char * error);
+
+/* Offset in the input of the value last read (or that failed to parse) */
+size_t json_reader_offset (json_reader * reader);
+
+void json_reader_free (json_reader * reader);
+
+/* NDJSON pipelines parse newline delimited JSON, a value a line, on several
+ * threads.  The input is cut into batches of whole lines, which threads take
+ * as they're free and parse a line at a time (as json_parse_n would, errors
+ * and all) into a document of the batch's own.  Each record is then handed
+ * to `record`, which is never called on two threads at once: `value` lives
+ * until it returns, and is NULL for a line that failed to parse, `error`
+ * saying why.  `offset` is where the line starts in the input; blank lines
+ * are skipped.  Returning 0 from `record` stops the pipeline, which then
+ * fails.
+ */
+typedef int (* json_record_handler)
+   (json_value * value, size_t offset, const json_char * error, void * user_data);
+
+typedef struct
+{
+   int threads;          /* 0 for one a CPU */
+   int unordered;        /* records may reach the handler out of input order */
+   size_t batch;         /* least characters in a batch (0 for 64 KB) */
+   unsigned int window;  /* most batches parsed and not yet handled (0 for 4 a thread) */
+
+} json_ndjson_opts;
+
+/* Returns 0 on failure.  `opts` may be NULL.  The allocator must be safe to
+ * call from several threads, `max_memory` applies to each batch, and with
+ * an intern table it all runs on the calling thread.
+ */
+int json_parse_ndjson
+   (json_settings * settings, const json_char * json, size_t length,
+    const json_ndjson_opts * opts, json_record_handler record, void * user_data, char * error);
+
+/* Push parsers take the input a piece at a time, in pieces of any size and
+ * split anywhere, and parse each one as it's fed to them.  json_parser_finish
+ * ends the input and returns the value; after any failure the parser only
+ * returns that failure again.  A document passed to json_document_parser_new
+ * mustn't be used for another parse until the parser is finished or freed.
+ */
+typedef struct _json_parser json_parser;
+
+json_parser * json_parser_new
+   (json_settings * settings);  /* may be NULL */
+
+json_parser * json_document_parser_new
+   (json_document * doc);
+
+/* Returns 0 on failure */
+int json_parser_feed
+   (json_parser * parser, const json_char * json, size_t length, char * error);
+
+json_value * json_parser_finish (json_parser * parser, char * error);
+
+/* Also frees whatever's been parsed of an unfinished value */
+void json_parser_free (json_parser * parser);
+
+/* Lazy documents are for reading a few values out of a large input: the
+ * input is checked once, as by json_parse_n, and then only stepped over by
+ * cursors, which build no json_value for what they pass (arrays and objects
+ * are skipped by matching their brackets).  Strings, keys and values are
+ * decoded when they're asked for, into memory that lives until
+ * json_lazy_free.  The input must outlive the lazy document.
+ */
+typedef struct _json_lazy json_lazy;
+
+typedef struct
+{
+   json_lazy * lazy;
+
+   const json_char * key;    /* in an object, the opening quote of the key */
+   const json_char * value;  /* the first character of the value */
+
+} json_cursor;
+
+/* Returns NULL, with the error as from json_parse_n, if the input isn't valid */
+json_lazy * json_lazy_new
+   (json_settings * settings, const json_char * json, size_t length, char * error);
+
+void json_lazy_free (json_lazy * lazy);
+
+json_cursor json_lazy_root (json_lazy * lazy);
+
+json_type json_cursor_type (const json_cursor * cursor);
+
+/* Moving: onto the first element or member of the array or object the
+ * cursor is on, onto the one after it, or onto the member of the object it's
+ * on with the given key.  Each returns 0, leaving the cursor where it was,
+ * if there's no such value.
+ */
+int json_cursor_enter (json_cursor * cursor);
+int json_cursor_next (json_cursor * cursor);
+int json_cursor_find (json_cursor * cursor, const json_char * key);
+
+/* The key of the object member the cursor is on, or NULL */
+const json_char * json_cursor_key (const json_cursor * cursor, unsigned int * length);
+
+/* Reading: each returns 0 (or NULL) if the value isn't of that type.
+ * json_cursor_get_double takes integers too.
+ */
+const json_char * json_cursor_get_string (const json_cursor * cursor, unsigned int * length);
+int json_cursor_get_int (const json_cursor * cursor, json_int_t * x);
+int json_cursor_get_double (const json_cursor * cursor, double * x);
+int json_cursor_get_bool (const json_cursor * cursor, int * x);
+
+/* The whole value the cursor is on, built in the lazy document's memory */
+json_value * json_cursor_value (const json_cursor * cursor, char * error);
+
+/* Tapes hold a whole value in a single block: its nodes, 16 bytes each
+ * (with 8 byte pointers), one after another in document order, and then its
+ * strings.  The elements of an array follow its node, and the members of an
+ * object follow its, each a string node for the key and then the value.
+ * `u.skip` of an array or object counts the nodes it takes up, itself and
+ * all it holds, so that skipping them leads to the next sibling, which is
+ * what json_node_next does.  Strings are terminated.
+ */
+typedef struct
+{
+   json_type type;
+   unsigned int length;  /* of a string or key; elements or members */
+
+   union
+   {
+      int boolean;
+      json_int_t integer;
+      double dbl;
+      const json_char * string;
+      size_t skip;
+
+   } u;
+
+} json_node;
+
+typedef struct _json_tape json_tape;
+
+/* Parses as json_parse_n does, with the same errors */
+json_tape * json_tape_parse
+   (json_settings * settings, const json_char * json, size_t length, char * error);
+
+const json_node * json_tape_root (const json_tape * tape);
+
+/* How many nodes the tape holds */
+size_t json_tape_size (const json_tape * tape);
+
+void json_tape_free (json_tape * tape);
+
+const json_node * json_node_next (const json_node * node);
+
+/* As indexing a json_value and find_json_object, NULL if there's no such
+ * element or member
+ */
+const json_node * json_node_at (const json_node * array, unsigned int index);
+const json_node * json_node_find (const json_node * object, char const * field);
+
+/* Schemas check values for the shape of an example, as json_type_equal
+ * does: the same type, the same number of elements, each like the
+ * example's in its place, and the same keys, in any order, with values
+ * like the example's.  The example is compiled once, into a table with the
+ * hash of each key, and may nest up to 128 deep.  With
+ * json_schema_uniform_arrays, an array of one element in the example takes
+ * arrays of any length with elements all like it.  Returns NULL, with why
+ * in `error`, if the example has a key twice or memory runs out.
+ */
+#define json_schema_uniform_arrays  1
+
+typedef struct _json_schema json_schema;
+
+json_schema * json_schema_compile
+   (json_settings * settings, const json_value * example, int options, char * error);
+
+/* Returns 0 if `value` doesn't fit the schema, with where and why in `error`
+ * ("/a/0: Expected an integer").  Takes no memory, so may be run from
+ * several threads at once.
+ */
+int json_schema_check (const json_schema * schema, const json_value * value, char * error);
+
+/* Checks JSON text against the schema as it's parsed, stopping at the first
+ * value that doesn't fit, before any tree is built.  Events are passed on
+ * to `handler`, if it isn't NULL, once they've been checked.  Returns 0 if
+ * the text doesn't parse or fit, or the handler stops it, with the line
+ * and column of where in `error`.
+ */
+int json_schema_check_events
+   (const json_schema * schema, json_settings * settings, const json_handler * handler,
+    void * user_data, const json_char * json, size_t length, char * error);
+
+void json_schema_free (json_schema * schema);
+
+/* Intern tables hold one copy of each object key, for sharing between any
+ * number of parses: the keys of values parsed with the table point into it,
+ * so equal keys are the same pointer.  The table must outlive those values
+ * and can't be used by two parses at once.  `max_memory` bounds its size;
+ * when that's reached, new keys are copied into their objects as usual.
+ */
+json_intern * json_intern_new
+   (json_settings * settings);  /* may be NULL */
+
+/* The table's copy of `key` (added if need be), or NULL if it's full */
+const json_char * json_intern_key
+   (json_intern * intern, const json_char * key, size_t length);
+
+void json_intern_free (json_intern * intern);
+
+/* Serializing writes a value as JSON text, compact or pretty (a line for
+ * each element and member, indented by `indent` spaces a level), either
+ * appended to a buffer, which grows as needed, or passed a piece at a time
+ * to a sink.  Strings are escaped, and doubles written in the fewest digits
+ * that read back as the same double.
+ */
+#define json_serialize_compact  0
+#define json_serialize_pretty   1
+
+typedef struct
+{
+   int mode;
+   int indent;
+
+} json_serialize_opts;
+
+typedef struct
+{
+   json_char * text;  /* terminated; clear `length` to reuse the buffer */
+   size_t length, capacity;
+
+   json_settings settings;
+
+} json_buffer;
+
+void json_buffer_init
+   (json_buffer * buffer, json_settings * settings);  /* settings may be NULL */
+
+void json_buffer_free (json_buffer * buffer);
+
+/* Returns 0 if memory runs out (or goes over `max_memory`), leaving the
+ * buffer's text as it was.  `opts` may be NULL for compact.
+ */
+int json_serialize
+   (json_buffer * buffer, const json_value * value, const json_serialize_opts * opts);
+
+/* Returns 0 if the sink does */
+typedef int (* json_sink) (const json_char * text, size_t length, void * user_data);
+
+int json_serialize_sink
+   (json_settings * settings, const json_value * value, const json_serialize_opts * opts,
+    json_sink sink, void * user_data);
+
+/* Writers put out JSON text a token at a time, with no tree: into a
+ * buffer (reused by clearing its `length` between documents), or through a
+ * chunk kept in the writer and written to a file descriptor as it fills.
+ * Memory is only taken for the writer itself and the nesting it's seen, so
+ * any number of values can be written with no allocation for each.  Each
+ * returns 0 if the writer has failed, which it stays until
+ * json_writer_finish; unless NDEBUG is defined, that includes anything out
+ * of place (a key outside an object or twice over, a value in an object
+ * without a key, a mismatched end, or more after the root value).
+ */
+typedef struct _json_writer json_writer;
+
+json_writer * json_writer_new
+   (json_buffer * buffer, const json_serialize_opts * opts);
+
+json_writer * json_writer_new_fd
+   (json_settings * settings, int fd, const json_serialize_opts * opts);
+
+void json_writer_free (json_writer * writer);
+
+int json_writer_begin_object (json_writer * writer);
+int json_writer_end_object (json_writer * writer);
+int json_writer_begin_array (json_writer * writer);
+int json_writer_end_array (json_writer * writer);
+
+int json_writer_key (json_writer * writer, const json_char * key, size_t length);
+
+int json_writer_string (json_writer * writer, const json_char * string, size_t length);
+int json_writer_integer (json_writer * writer, json_int_t integer);
+int json_writer_double (json_writer * writer, double dbl);
+int json_writer_bool (json_writer * writer, int boolean);
+int json_writer_null (json_writer * writer);
+
+/* A whole tree, as json_serialize would write it */
+int json_writer_value (json_writer * writer, const json_value * value);
+
+/* Writes out what's been buffered for the file descriptor, or brings the
+ * buffer's `length` up to date
+ */
+int json_writer_flush (json_writer * writer);
+
+/* Ends the document, flushing it, and readies the writer for the next.
+ * Returns 0 if anything failed since the last (or, unless NDEBUG is
+ * defined, if the document isn't complete).
+ */
+int json_writer_finish (json_writer * writer);
+
 char const * json_type_to_string(json_type ty) ;
 
+// compact, as json_serialize_sink
 void json_value_dump(FILE * fp, json_value const * v);
 // compare json values
 bool json_value_equal(json_value const * lhs, json_value const * rhs);
 // compare type(schemas) of json values
 bool json_type_equal (json_value const * lhs, json_value const * rhs);
+// how json_value_compare takes doubles: with `bitwise`, as equal only when
+// their bits are; otherwise as equal when no further apart than `tolerance`
+// (0 for equal as numbers, so 0.0 is -0.0 and NaN isn't NaN)
+typedef struct {
+	int bitwise;
+	double tolerance;
+} json_compare_opts;
+// compare json values, in any order of keys, without recursing and finding
+// each key by hash (or by sorting the keys, for objects without an index).
+// A key repeated in an object pairs up in order with its repeats in the other.
+// Returns 1 if they're equal, 0 if not, with the JSON pointer ("/a/0", or ""
+// for the root) of the first value that differs in `path`, cut short to
+// `path_size`, and -1 if memory runs out.  `settings` and `opts` may be NULL,
+// the latter for bitwise doubles; `path` may be NULL.
+int json_value_compare(json_settings * settings, json_value const * lhs, json_value const * rhs,
+                       json_compare_opts const * opts, char * path, size_t path_size);
+// a 128 bit hash of a value (take hash[0] for 64 bits), the same for values
+// json_value_compare finds equal with bitwise doubles, whatever the order of
+// their keys.  Made in one pass, without recursing; false if memory runs out.
+// Not for use against hash flooding, and as the bytes of numbers go in as they
+// are in memory, the same only on machines of the same byte order.
+bool json_value_hash(json_settings * settings, json_value const * value, uint64_t hash[2]);
+// the same, of only what json_type_equal compares: the same for values it
+// finds equal
+bool json_type_hash (json_settings * settings, json_value const * value, uint64_t hash[2]);
+// the value of key `field` in object `v`, or NULL.  Objects of 16 keys or more
+// parsed with json_index_objects are hash indexed; others are searched in turn
 json_value const * find_json_object(json_value const * v, char const * field);
+// as find_json_object, with the key's length and json_key_hash given
+json_value const * find_json_object_hashed
+	(json_value const * v, char const * field, size_t length, uint32_t hash);
+uint32_t json_key_hash(json_char const * key, size_t length);
 // is_array && all (= ty) js
 bool all_array_type(json_type ty, json_value const * js);
 
@@ -242,6 +716,31 @@ bool json_value_read_if_string(char * ss, json_value const * v);
 
 bool json_value_read_if_bool(bool * b, json_value const * v);
 
+// as above, for tape nodes
+bool json_node_read_if_uint    (unsigned int * x, json_node const * n);
+bool json_node_read_if_int     (         int * x, json_node const * n);
+
+bool json_node_read_if_uint8_t (uint8_t      * x, json_node const * n);
+bool json_node_read_if_uint16_t(uint16_t     * x, json_node const * n);
+bool json_node_read_if_uint32_t(uint32_t     * x, json_node const * n);
+bool json_node_read_if_uint64_t(uint64_t     * x, json_node const * n);
+bool json_node_read_if_uintptr_t(uintptr_t   * x, json_node const * n);
+
+bool json_node_read_if_int8_t  ( int8_t      * x, json_node const * n);
+bool json_node_read_if_int16_t ( int16_t     * x, json_node const * n);
+bool json_node_read_if_int32_t ( int32_t     * x, json_node const * n);
+bool json_node_read_if_int64_t ( int64_t     * x, json_node const * n);
+bool json_node_read_if_intptr_t( intptr_t    * x, json_node const * n);
+
+bool json_node_read_if_size_t  ( size_t      * x, json_node const * n);
+
+bool json_node_read_if_float   ( float       * f, json_node const * n);
+bool json_node_read_if_double  ( double      * d, json_node const * n);
+
+bool json_node_read_if_string(char * ss, json_node const * n);
+
+bool json_node_read_if_bool(bool * b, json_node const * n);
+
 
 #ifdef __cplusplus
    } /* extern "C" */
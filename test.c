@@ -5,15 +5,21 @@
 # include <cstdint>
 # include <cstring>
 # include <cassert>
+# include <cfloat>
 #else
 # include <stdio.h>
 # include <stdlib.h>
 # include <stdint.h>
 # include <string.h>
 # include <assert.h>
+# include <float.h>
 #endif
 #include <error.h>
 #include <errno.h>
+#include <locale.h>
+#if !defined _WIN32
+#  include <unistd.h>
+#endif
 
 #include "json.h"
 
@@ -52,7 +58,7 @@ char * read_file (char const * file) {
 	FILE * fp = fopen(file, "r");
 	if (fp) {
 		int size = file_size(fp);
-		char * buf = (char*)malloc(size > 1 ? size : 1); // avoid undefined behaviour
+		char * buf = (char*)malloc(size + 1); // room for the terminator
 		if (buf) {
 			size_t rsize = fread(buf, 1, size, fp);
 			if (rsize<(size_t)size) {
@@ -67,21 +73,175 @@ char * read_file (char const * file) {
 	return NULL;
 }
 
+// return true if parsing given file with given settings is successed
+bool test_json_parse_file_ex(char const * dir, char const * filename, json_settings * settings) {
+	char path[256], error[128];
+	json_value * v;
+	sprintf(path, "%s" SEP "%s", dir, filename);
+	v = json_parse_file(settings, path, error);
+	if (!v && !strncmp(error, "Can't", 5))
+		fprintf(stderr, "read file <%s> failed: %s\n", path, error);
+	return json_value_free(v), v!=NULL;
+}
+
 // return true if parsing given file is successed
 bool test_json_parse_file(char const * dir, char const * filename) {
+	json_settings settings;
+	memset(&settings, 0, sizeof(json_settings));
+	return test_json_parse_file_ex(dir, filename, &settings);
+}
+
+// compare trees exactly: same order of fields, same bits of doubles
+static bool same_tree(json_value const * lhs, json_value const * rhs) {
+	unsigned int i;
+	if (!lhs || !rhs)
+		return lhs==rhs;
+	if (lhs->type!=rhs->type)
+		return false;
+	switch (lhs->type) {
+	case json_object:
+		if (lhs->u.object.length!=rhs->u.object.length)
+			return false;
+		for (i=0; i<lhs->u.object.length; ++i)
+			if (strcmp(lhs->u.object.values[i].name, rhs->u.object.values[i].name)
+					|| !same_tree(lhs->u.object.values[i].value, rhs->u.object.values[i].value))
+				return false;
+		return true;
+	case json_array:
+		if (lhs->u.array.length!=rhs->u.array.length)
+			return false;
+		for (i=0; i<lhs->u.array.length; ++i)
+			if (!same_tree(lhs->u.array.values[i], rhs->u.array.values[i]))
+				return false;
+		return true;
+	case json_integer: return lhs->u.integer==rhs->u.integer;
+	case json_double : return !memcmp(&lhs->u.dbl, &rhs->u.dbl, sizeof(double));
+	case json_string : return lhs->u.string.length==rhs->u.string.length
+						&& !memcmp(lhs->u.string.ptr, rhs->u.string.ptr, lhs->u.string.length+1);
+	case json_boolean: return lhs->u.boolean==rhs->u.boolean;
+	default          : return true;
+	}
+}
+
+// return true if parsing given file with `settings` (into a document, if
+// `document`) builds the same tree as the default two passes, or fails as
+// they do
+bool test_same_tree_file(char const * dir, char const * filename, int settings, bool document) {
 	char path[256];
 	char * buf=NULL;
+	json_settings with;
+	json_document * doc = NULL;
+	json_value * expect, * v;
+	bool result;
 	sprintf(path, "%s" SEP "%s", dir, filename);
 	buf = read_file(path);
-	if (buf) {
-		json_value * v = json_parse(buf);
-		return json_value_free(v), v!=NULL;
-	} else {
-		fprintf(stderr, "read file <%s> failed\n", path);
+	if (!buf)
+		return false;
+	memset(&with, 0, sizeof(json_settings));
+	with.settings = settings;
+	expect = json_parse(buf);
+	if (document) {
+		doc = json_document_new(&with);
+		v = doc ? json_document_parse(doc, buf, NULL) : NULL;
+	} else
+		v = json_parse_ex(&with, buf, NULL);
+	result = same_tree(expect, v) && (doc || !document);
+	json_value_free(expect);
+	if (document)
+		json_document_free(doc);
+	else
+		json_value_free(v);
+	free(buf);
+	return result;
+}
+
+// does walking the input with cursors read the same as the tree?
+static bool cursor_matches(json_cursor c, json_value const * v) {
+	json_cursor child = c;
+	unsigned int i, length;
+	char const * s;
+	json_int_t n;
+	double d;
+	int b;
+	if (json_cursor_type(&c) != v->type)
 		return false;
+	switch (v->type) {
+	case json_object:
+		for (i=0; i<v->u.object.length; ++i) {
+			if (!(i ? json_cursor_next(&child) : json_cursor_enter(&child)))
+				return false;
+			s = json_cursor_key(&child, &length);
+			if (!s || strcmp(s, v->u.object.values[i].name) || !cursor_matches(child, v->u.object.values[i].value))
+				return false;
+		}
+		return !(i ? json_cursor_next(&child) : json_cursor_enter(&child));
+	case json_array:
+		for (i=0; i<v->u.array.length; ++i) {
+			if (!(i ? json_cursor_next(&child) : json_cursor_enter(&child)) || !cursor_matches(child, v->u.array.values[i]))
+				return false;
+		}
+		return !(i ? json_cursor_next(&child) : json_cursor_enter(&child));
+	case json_integer: return json_cursor_get_int(&c, &n) && n == v->u.integer;
+	case json_double : return json_cursor_get_double(&c, &d) && !memcmp(&d, &v->u.dbl, sizeof(double));
+	case json_string : return (s = json_cursor_get_string(&c, &length)) && length == v->u.string.length
+						&& !memcmp(s, v->u.string.ptr, length + 1);
+	case json_boolean: return json_cursor_get_bool(&c, &b) && b == v->u.boolean;
+	default          : return true;
 	}
 }
 
+// return true if cursors over a lazy document read the same as the parsed tree (or fail as it does)
+bool test_lazy_file(char const * dir, char const * filename) {
+	char path[256];
+	char * buf=NULL;
+	char expect_error[128], error[128];
+	json_value * expect;
+	json_lazy * lazy;
+	bool result;
+	sprintf(path, "%s" SEP "%s", dir, filename);
+	buf = read_file(path);
+	if (!buf)
+		return false;
+	expect = json_parse_n(NULL, buf, strlen(buf), expect_error);
+	lazy = json_lazy_new(NULL, buf, strlen(buf), error);
+	if (!expect)
+		result = !lazy && !strcmp(expect_error, error);
+	else
+		result = lazy && cursor_matches(json_lazy_root(lazy), expect);
+	json_value_free(expect);
+	json_lazy_free(lazy);
+	free(buf);
+	return result;
+}
+
+// does the file read back the same after serializing it, compact and pretty?
+bool test_serialize_file(char const * dir, char const * filename) {
+	static json_serialize_opts const pretty = { json_serialize_pretty, 3 };
+	char path[256];
+	char * buf=NULL;
+	json_buffer out;
+	json_value * expect, * v, * w;
+	bool result;
+	sprintf(path, "%s" SEP "%s", dir, filename);
+	buf = read_file(path);
+	if (!buf)
+		return false;
+	expect = json_parse(buf);
+	json_buffer_init(&out, NULL);
+	result = expect && json_serialize(&out, expect, NULL);
+	v = result ? json_parse_ex(&out.settings, out.text, NULL) : NULL;
+	out.length = 0;
+	result = result && json_serialize(&out, expect, &pretty);
+	w = result ? json_parse_ex(&out.settings, out.text, NULL) : NULL;
+	result = result && same_tree(expect, v) && same_tree(expect, w);
+	json_buffer_free(&out);
+	json_value_free(expect);
+	json_value_free(v);
+	json_value_free(w);
+	free(buf);
+	return result;
+}
+
 bool test_json_parse (char const * s) {
 	json_value * v = json_parse(s);
 	json_value_free(v);
@@ -228,8 +388,1787 @@ void test_json_type_equal (void) {
 																[[\"other\", [\"+\", [\"fib\", [\"-\", \"y\", 1]], [\"fib\", [\"-\", \"y\", 2]]]]]]]]}"));
 }
 
+// feeds the text to a push parser `step` characters at a time
+static json_value * push_parse(json_parser * parser, char const * buf, size_t step, char * error) {
+	size_t n = strlen(buf), k;
+	for (; n; buf += k, n -= k) {
+		k = n < step ? n : step;
+		if (!json_parser_feed(parser, buf, k, error))
+			return NULL;
+	}
+	return json_parser_finish(parser, error);
+}
+
+bool test_push_file(char const * dir, char const * filename) {
+	static size_t const steps[] = { 1, 2, 3, 7, 4096 };
+	char path[256];
+	char * buf=NULL;
+	json_value * expect, * v;
+	json_parser * parser;
+	bool result = true;
+	size_t i;
+	sprintf(path, "%s" SEP "%s", dir, filename);
+	buf = read_file(path);
+	if (!buf)
+		return false;
+	expect = json_parse(buf);
+	for (i = 0; i < sizeof(steps)/sizeof(steps[0]); ++i) {
+		parser = json_parser_new(NULL);
+		v = push_parse(parser, buf, steps[i], NULL);
+		result = result && (expect ? same_tree(expect, v) : !v);
+		json_value_free(v);
+		json_parser_free(parser);
+	}
+	json_value_free(expect);
+	free(buf);
+	return result;
+}
+
+void test_document(void) {
+	json_settings settings;
+	json_document * doc = json_document_new(NULL);
+	json_value * x, * y;
+	char error[128];
+
+	// values of earlier parses stay valid, failed parses leave nothing behind
+	x = json_document_parse(doc, "{\"foo\":[1,2,\"three\"]}", NULL);
+	y = json_document_parse(doc, "[true, {\"bar\" null}]", error);
+	printf("test document parse failure (%s) is %s\n", error, !y ? "pass" : "fail");
+	y = json_document_parse(doc, "[\"foo\\u20AC\", {\"bar\":null}]", NULL);
+	printf("test document keeps values is %s\n"
+			, x && y && find_json_object(x, "foo")->u.array.length == 3
+			  && !strcmp(y->u.array.values[0]->u.string.ptr, "foo\xE2\x82\xAC") ? "pass" : "fail");
+	json_document_free(doc);
+
+	memset(&settings, 0, sizeof(json_settings));
+	settings.max_memory = 256;
+	doc = json_document_new(&settings);
+	x = json_document_parse(doc, "[1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16]", NULL);
+	printf("test document max_memory is %s\n", !x ? "pass" : "fail");
+	json_document_free(doc);
+}
+
+bool test_json_parse_n (char const * s, size_t length, bool expect) {
+	json_settings settings;
+	json_value * v;
+	bool result = true;
+	int mode;
+	for (mode=0; mode<2; ++mode) {
+		memset(&settings, 0, sizeof(json_settings));
+		settings.settings = mode ? json_single_pass : 0;
+		v = json_parse_n(&settings, s, length, NULL);
+		result = result && (v!=NULL)==expect;
+		json_value_free(v);
+	}
+	printf("test parse_n (%.*s) is %s\n", (int)length, s, result ? "pass" : "fail");
+	return result;
+}
+
+// parse `s` in both modes, requiring the same result: false when it's rejected
+static bool parse_number_both(char const * s, json_value * out) {
+	json_settings settings;
+	json_value * v[2];
+	bool result;
+	int mode;
+	for (mode=0; mode<2; ++mode) {
+		memset(&settings, 0, sizeof(json_settings));
+		settings.settings = mode ? json_single_pass : 0;
+		v[mode] = json_parse_ex(&settings, s, NULL);
+	}
+	result = v[0] && same_tree(v[0], v[1]);
+	if (result)
+		*out = *v[0];
+	json_value_free(v[0]);
+	json_value_free(v[1]);
+	return result;
+}
+
+bool test_number_integer(char const * s, json_int_t expect) {
+	json_value v;
+	bool result = parse_number_both(s, &v) && v.type == json_integer && v.u.integer == expect;
+	printf("test number (%s) is %s\n", s, result ? "pass" : "fail");
+	return result;
+}
+
+bool test_number_double(char const * s, double expect) {
+	json_value v;
+	bool result = parse_number_both(s, &v) && v.type == json_double
+		&& !memcmp(&v.u.dbl, &expect, sizeof(double));
+	printf("test number (%s) is %s\n", s, result ? "pass" : "fail");
+	return result;
+}
+
+bool test_number_invalid(char const * s) {
+	json_value v;
+	bool result = !parse_number_both(s, &v);
+	printf("test number (%s) rejected is %s\n", s, result ? "pass" : "fail");
+	return result;
+}
+
+void test_numbers(void) {
+	test_number_integer("0", 0);
+	test_number_integer("-0", 0);
+	test_number_integer("007", 7);
+	test_number_integer("9223372036854775807", INT64_MAX);
+	test_number_integer("-9223372036854775808", INT64_MIN);
+	test_number_invalid("9223372036854775808");
+	test_number_invalid("-9223372036854775809");
+	test_number_invalid("123456789012345678901234567890");
+	test_number_double("0.1", 0.1);
+	test_number_double("-2.5e-3", -2.5e-3);
+	test_number_double("1E+2", 100.0);
+	test_number_double("1.", 1.0);
+	test_number_double("-.5", -0.5);
+	test_number_double("9007199254740993.0", 9007199254740992.0); // halfway, to even
+	test_number_double("1.7976931348623157e308", DBL_MAX);
+	test_number_double("4.9406564584124654e-324", 4.9406564584124654e-324);
+	test_number_double("2.2250738585072011e-308", 2.2250738585072011e-308);
+	test_number_double("1e-400", 0.0);
+	test_number_double("0.1000000000000000055511151231257827021181583404541015625000001", 0.1);
+	test_number_double("123456789012345678901234567890.0", 123456789012345678901234567890.0);
+	test_number_invalid("1e400");
+	test_number_invalid("-");
+	test_number_invalid("1e");
+	test_number_invalid("1e+");
+	test_number_invalid("1.2.3");
+	test_number_invalid("1-2");
+	test_number_invalid("[0x10]");
+	test_number_invalid("[-inf]");
+	// a long number at the very end of an exact length buffer (no terminator
+	// to stop at), and one cut short by the length
+	{
+		static char const text[] = "1.00000000000000000000001";
+		char * buf = (char*)malloc(sizeof(text) - 1);
+		json_document * doc = json_document_new(NULL);
+		json_value * v, * w, * cut, * expect;
+		double one = 1.0;
+		memcpy(buf, text, sizeof(text) - 1);
+		v = json_parse_n(NULL, buf, sizeof(text) - 1, NULL);
+		w = json_document_parse_n(doc, buf, sizeof(text) - 1, NULL);
+		cut = json_parse_n(NULL, "12345678901234567890123.4567e10", 27, NULL);
+		expect = json_parse("12345678901234567890123.4567");
+		printf("test number at the end of the buffer is %s\n"
+					, v && v->type == json_double && !memcmp(&v->u.dbl, &one, sizeof(double))
+					&& w && same_tree(v, w) && cut && same_tree(expect, cut) ? "pass" : "fail");
+		json_value_free(v);
+		json_value_free(cut);
+		json_value_free(expect);
+		json_document_free(doc);
+		free(buf);
+	}
+	// the decimal point doesn't follow the locale
+	if (setlocale(LC_NUMERIC, "de_DE.UTF-8") || setlocale(LC_NUMERIC, "fr_FR.UTF-8")) {
+		test_number_double("1.5", 1.5);
+		setlocale(LC_NUMERIC, "C");
+	}
+}
+
+void test_json_parse_length(void) {
+	json_value * v;
+	json_settings settings;
+	test_json_parse_n("[1,2]]", 5, true);
+	test_json_parse_n("nullx", 4, true);
+	test_json_parse_n("true", 3, false);
+	test_json_parse_n("[false]", 5, false);
+	test_json_parse_n("\"\\u20AC\"", 5, false);
+	test_json_parse_n("\"foo\"", 4, false);
+	test_json_parse_n("{\"foo\":1}", 8, false);
+	memset(&settings, 0, sizeof(json_settings));
+	v = json_parse_n(&settings, "12345", 3, NULL);
+	printf("test parse_n number is %s\n", v && v->u.integer == 123 ? "pass" : "fail");
+	json_value_free(v);
+}
+
+void test_document_insitu(void) {
+	char buf[] = "{\"foo\":[\"bar\", \"b\\u00e9z\\n\"], \"k\\\"ey\":\"\"}";
+	json_document * doc = json_document_new(NULL);
+	json_value * v = json_document_parse_insitu(doc, buf, strlen(buf), NULL);
+	json_value const * foo = find_json_object(v, "foo");
+	bool result = v && foo && v->u.object.length == 2
+		&& v->u.object.values[0].name >= buf && v->u.object.values[0].name < buf + sizeof(buf)
+		&& !strcmp(v->u.object.values[1].name, "k\"ey")
+		&& foo->u.array.values[0]->u.string.ptr >= buf
+		&& foo->u.array.values[0]->u.string.ptr < buf + sizeof(buf)
+		&& !strcmp(foo->u.array.values[0]->u.string.ptr, "bar")
+		&& foo->u.array.values[1]->u.string.length == 5
+		&& !strcmp(foo->u.array.values[1]->u.string.ptr, "b\xC3\xA9z\n");
+	printf("test document in situ is %s\n", result ? "pass" : "fail");
+	json_document_free(doc);
+}
+
+// every key of a 100 key object (and a duplicate, which shouldn't be seen) is found
+static bool check_object_index(json_value const * v) {
+	char key[16];
+	int i;
+	if (!v)
+		return false;
+	for (i=0; i<100; ++i) {
+		json_value const * x;
+		sprintf(key, "key%d", i);
+		x = find_json_object(v, key);
+		if (!x || x->u.integer != i)
+			return false;
+		x = find_json_object_hashed(v, key, strlen(key), json_key_hash(key, strlen(key)));
+		if (!x || x->u.integer != i)
+			return false;
+	}
+	return !find_json_object(v, "key100") && !find_json_object(v, "key")
+		&& find_json_object_hashed(v, "key10x", 5, json_key_hash("key10x", 5))
+		&& !find_json_object_hashed(v, "key1000", 6, json_key_hash("key1000", 6));
+}
+
+void test_object_index(void) {
+	static char text[4096], copy[4096];
+	json_settings settings;
+	json_document * doc;
+	json_value * v, * w;
+	char * p = text;
+	int i, mode;
+	p += sprintf(p, "{");
+	for (i=99; i>=0; --i)
+		p += sprintf(p, "\"key%d\": %d, ", i, i);
+	sprintf(p, "\"key5\": 0}");
+	for (mode=0; mode<4; ++mode) {
+		memset(&settings, 0, sizeof(json_settings));
+		settings.settings = (mode & 1 ? json_single_pass : 0) | (mode & 2 ? json_index_objects : 0);
+		v = json_parse_ex(&settings, text, NULL);
+		// room for an index is only made when asked for
+		printf("test object index (settings %d) is %s\n", settings.settings
+					, check_object_index(v) && !v->_reserved.object_mem == !(mode & 2) ? "pass" : "fail");
+		w = json_value_dup(v);
+		printf("test object index dup (settings %d) is %s\n", settings.settings
+					, check_object_index(w) && !w->_reserved.object_mem == !(mode & 2) ? "pass" : "fail");
+		json_value_free(v);
+		json_value_free(w);
+	}
+	// put together by hand, with whatever follows the values where an index
+	// would be: it's not taken for one
+	v = json_parse(text);
+	w = (json_value*)malloc(sizeof(json_value));
+	*w = *v;
+	*(void **)&w->u.object.values = malloc(v->u.object.length * sizeof(*v->u.object.values) + 4096);
+	memcpy(w->u.object.values, v->u.object.values, v->u.object.length * sizeof(*v->u.object.values));
+	memset(w->u.object.values + w->u.object.length, 0xFF, 4096);
+	w->_reserved.object_mem = w->u.object.values + w->u.object.length;
+	printf("test object index by hand is %s\n", check_object_index(w) ? "pass" : "fail");
+	free(w->u.object.values);
+	free(w);
+	json_value_free(v);
+	doc = json_document_new(NULL);
+	printf("test object index document is %s\n"
+				, check_object_index(json_document_parse(doc, text, NULL)) ? "pass" : "fail");
+	strcpy(copy, text);
+	printf("test object index in situ is %s\n"
+				, check_object_index(json_document_parse_insitu(doc, copy, strlen(copy), NULL)) ? "pass" : "fail");
+	json_document_free(doc);
+}
+
+void test_intern(void) {
+	static char const text[] = "[{\"id\": 1, \"name\": \"a\"}, {\"name\": \"b\", \"id\": 2, \"x\\u0041\": 3}]";
+	char copy[sizeof(text)];
+	json_settings settings;
+	json_document * doc;
+	json_value * plain, * v, * w, * x;
+	char const * id;
+	bool result;
+	memset(&settings, 0, sizeof(json_settings));
+	plain = json_parse(text);
+	settings.intern = json_intern_new(NULL);
+	v = json_parse_ex(&settings, text, NULL);
+	w = json_parse_ex(&settings, text, NULL);
+	id = json_intern_key(settings.intern, "id", 2);
+	result = v && w && same_tree(plain, v) && same_tree(plain, w)
+		&& v->u.array.values[0]->u.object.values[0].name == id
+		&& v->u.array.values[1]->u.object.values[1].name == id
+		&& w->u.array.values[0]->u.object.values[0].name == id
+		&& !strcmp(v->u.array.values[1]->u.object.values[2].name, "xA")
+		&& find_json_object(w->u.array.values[1], id)->u.integer == 2;
+	printf("test intern is %s\n", result ? "pass" : "fail");
+	// documents, decoding in situ or not
+	doc = json_document_new(&settings);
+	strcpy(copy, text);
+	x = json_document_parse_insitu(doc, copy, strlen(copy), NULL);
+	result = x && same_tree(plain, x) && x->u.array.values[1]->u.object.values[1].name == id
+		&& same_tree(plain, json_document_parse(doc, text, NULL))
+		&& !json_document_parse(doc, "{\"id\": 1, \"id\"}", NULL);
+	printf("test intern document is %s\n", result ? "pass" : "fail");
+	json_document_free(doc);
+	json_value_free(v);
+	json_value_free(w);
+	json_intern_free(settings.intern);
+	// a table with no room left still parses, copying the keys it can't take
+	settings.max_memory = 64 * sizeof(void *) + 16;
+	settings.intern = json_intern_new(&settings);
+	settings.max_memory = 0;
+	id = json_intern_key(settings.intern, "id", 2);
+	v = json_parse_ex(&settings, "{\"id\": 1, \"a long key that won't fit\": 2}", NULL);
+	result = v && v->u.object.values[0].name == id
+		&& !json_intern_key(settings.intern, "a long key that won't fit", 25)
+		&& !strcmp(v->u.object.values[1].name, "a long key that won't fit");
+	printf("test intern saturated is %s\n", result ? "pass" : "fail");
+	json_value_free(v);
+	json_intern_free(settings.intern);
+	json_value_free(plain);
+}
+
+// allocator hooks: count what goes through them
+typedef struct {
+	long allocs, frees;
+} alloc_counter;
+
+static void * counting_alloc(size_t size, int zero, void * user_data) {
+	++((alloc_counter*)user_data)->allocs;
+	return zero ? calloc(1, size) : malloc(size);
+}
+
+static void counting_free(void * ptr, void * user_data) {
+	if (ptr)
+		++((alloc_counter*)user_data)->frees;
+	free(ptr);
+}
+
+void test_allocator_hooks(void) {
+	static char const * json = "{\"foo\":[1,2.5,\"three\",{\"four\":null}], \"bar\":\"baz\"}";
+	static int const modes[] = { 0, json_single_pass };
+	json_settings settings;
+	alloc_counter counter;
+	json_value * v, * dup;
+	json_document * doc;
+	long dup_allocs;
+	int i;
+
+	memset(&settings, 0, sizeof(json_settings));
+	settings.mem_alloc = counting_alloc;
+	settings.mem_free = counting_free;
+	settings.user_data = &counter;
+
+	for (i=0; i<2; ++i) {
+		settings.settings = modes[i];
+		memset(&counter, 0, sizeof(alloc_counter));
+		v = json_parse_ex(&settings, json, NULL);
+		dup_allocs = counter.allocs;
+		dup = json_value_dup_ex(&settings, v);
+		dup_allocs = counter.allocs - dup_allocs;
+		json_value_free_ex(&settings, v);
+		v = json_parse_ex(&settings, "{\"foo\":[1,2,\"three\" 4]}", NULL);
+		// only the copy is left
+		printf("test allocator hooks (settings %d) is %s\n", modes[i]
+				, !v && dup && dup_allocs > 0 && counter.allocs == counter.frees + dup_allocs ? "pass" : "fail");
+		json_value_free_ex(&settings, dup);
+		printf("test allocator hooks free (settings %d) is %s\n", modes[i]
+				, counter.allocs == counter.frees ? "pass" : "fail");
+	}
+
+	memset(&counter, 0, sizeof(alloc_counter));
+	settings.settings = 0;
+	doc = json_document_new(&settings);
+	v = json_document_parse(doc, json, NULL);
+	json_document_free(doc);
+	printf("test allocator hooks (document) is %s\n"
+			, v && counter.allocs > 0 && counter.allocs == counter.frees ? "pass" : "fail");
+}
+
+// events written down one per line, to compare with the same written from a tree
+typedef struct {
+	char * buf;
+	size_t length, capacity;
+	int stop_after; // stop the parse at this event (when not 0)
+} event_log;
+
+static int log_event(event_log * log, char const * kind, char const * text, size_t length) {
+	size_t n = strlen(kind) + length + 2;
+	if (log->length + n > log->capacity) {
+		log->capacity = (log->length + n) * 2;
+		log->buf = (char*)realloc(log->buf, log->capacity);
+	}
+	log->length += sprintf(log->buf + log->length, "%s ", kind);
+	memcpy(log->buf + log->length, text, length);
+	log->length += length;
+	log->buf[log->length++] = '\n';
+	return !log->stop_after || --log->stop_after;
+}
+
+static int on_start_object(void * log) { return log_event((event_log*)log, "{", "", 0); }
+static int on_end_object(void * log) { return log_event((event_log*)log, "}", "", 0); }
+static int on_start_array(void * log) { return log_event((event_log*)log, "[", "", 0); }
+static int on_end_array(void * log) { return log_event((event_log*)log, "]", "", 0); }
+static int on_null(void * log) { return log_event((event_log*)log, "null", "", 0); }
+static int on_key(json_char const * name, unsigned int length, void * log) {
+	return log_event((event_log*)log, "key", name, length);
+}
+static int on_string(json_char const * string, unsigned int length, void * log) {
+	return log_event((event_log*)log, "string", string, length);
+}
+static int on_integer(json_int_t value, void * log) {
+	char text[32];
+	return log_event((event_log*)log, "integer", text, sprintf(text, "%lld", (long long)value));
+}
+static int on_double(double value, void * log) {
+	char text[64];
+	return log_event((event_log*)log, "double", text, sprintf(text, "%a", value));
+}
+static int on_boolean(int value, void * log) {
+	return log_event((event_log*)log, "boolean", value ? "1" : "0", 1);
+}
+
+static json_handler const log_handler = {
+	on_start_object, on_key, on_end_object, on_start_array, on_end_array,
+	on_string, on_integer, on_double, on_boolean, on_null
+};
+
+static void log_tree(event_log * log, json_value const * v) {
+	unsigned int i;
+	switch (v->type) {
+	case json_object:
+		on_start_object(log);
+		for (i=0; i<v->u.object.length; ++i) {
+			on_key(v->u.object.values[i].name, (unsigned int)strlen(v->u.object.values[i].name), log);
+			log_tree(log, v->u.object.values[i].value);
+		}
+		on_end_object(log);
+		break;
+	case json_array:
+		on_start_array(log);
+		for (i=0; i<v->u.array.length; ++i)
+			log_tree(log, v->u.array.values[i]);
+		on_end_array(log);
+		break;
+	case json_string : on_string(v->u.string.ptr, v->u.string.length, log); break;
+	case json_integer: on_integer(v->u.integer, log); break;
+	case json_double : on_double(v->u.dbl, log); break;
+	case json_boolean: on_boolean(v->u.boolean, log); break;
+	default: on_null(log); break;
+	}
+}
+
+bool test_events_file(char const * dir, char const * filename) {
+	char path[256];
+	char * buf=NULL;
+	event_log events = {NULL, 0, 0, 0}, tree = {NULL, 0, 0, 0};
+	json_value * v;
+	bool result;
+	sprintf(path, "%s" SEP "%s", dir, filename);
+	buf = read_file(path);
+	if (!buf)
+		return false;
+	v = json_parse(buf);
+	if (v)
+		log_tree(&tree, v);
+	result = json_parse_events(NULL, &log_handler, &events, buf, strlen(buf), NULL) == !!v
+		&& (!v || (events.length == tree.length && !memcmp(events.buf, tree.buf, tree.length)));
+	json_value_free(v);
+	free(events.buf);
+	free(tree.buf);
+	free(buf);
+	return result;
+}
+
+void test_events(void) {
+	json_settings settings;
+	alloc_counter counter = {0, 0};
+	event_log log = {NULL, 0, 0, 0};
+	json_handler nothing;
+	char error[128];
+	char * big;
+	size_t i;
+	bool result;
+	// stopping from a callback fails the parse
+	log.stop_after = 3;
+	result = !json_parse_events(NULL, &log_handler, &log, "[1, [2, 3]]", 11, error)
+		&& log.length == 16 && !memcmp(log.buf, "[ \ninteger 1\n[ \n", 16) && !!strstr(error, "Stopped");
+	printf("test events stopped (%s) is %s\n", error, result ? "pass" : "fail");
+	free(log.buf);
+	memset(&nothing, 0, sizeof(json_handler));
+	result = json_parse_events(NULL, &nothing, NULL, "{\"a\": [\"b\", 1.5, null]}", 23, NULL)
+		&& !json_parse_events(NULL, &nothing, NULL, "{\"a\": [\"b\", 1.5, null}", 22, error);
+	printf("test events no callbacks (%s) is %s\n", error, result ? "pass" : "fail");
+	// the memory taken doesn't grow with the input
+	big = (char*)malloc(100000 * 48);
+	strcpy(big, "[");
+	for (i = 0; i < 100000; ++i)
+		sprintf(big + strlen(big), "%s{\"id\": %d, \"tags\": [\"a\", \"b\"]}", i ? "," : "", (int)i);
+	strcat(big, "]");
+	memset(&settings, 0, sizeof(json_settings));
+	settings.mem_alloc = counting_alloc;
+	settings.mem_free = counting_free;
+	settings.user_data = &counter;
+	result = json_parse_events(&settings, &nothing, NULL, big, strlen(big), NULL)
+		&& counter.allocs < 10 && counter.allocs == counter.frees;
+	printf("test events constant memory (%ld allocations) is %s\n", counter.allocs, result ? "pass" : "fail");
+	free(big);
+}
+
+void test_two_stage(void) {
+	static char const * texts[] = {
+		"[1,2,]", "{\"a\":1,}", "[1 2]", "{\"a\" 1}", "[1]x", "[tru]", "[truex]", "1x", "[\"a\"1]",
+		"[\"\\u00e9\\u20AC\\q\"]", "[\"\\u00g9\"]", "[\"abc", "\"\\", "[", "", "  ", "{\"a\"", "[-]", "[1e999]",
+		"{\"k\":{\"k\":[[],{}]},\"\\\"\":null}", "{\"a\\n\"\n\n1}", "[\"x\ny\",\n 1 2]", "{\"a\":1 \"b\":2}",
+		"{\"a\":]", "{,}", "[1,\"abc",
+	};
+	json_settings settings;
+	json_document * doc;
+	json_value * expect, * v;
+	char text[256], expect_error[128], error[128];
+	size_t i, n;
+	bool result = true;
+	memset(&settings, 0, sizeof(json_settings));
+	for (i = 0; i < sizeof(texts)/sizeof(texts[0]); ++i) {
+		settings.settings = 0;
+		expect = json_parse_ex(&settings, texts[i], expect_error);
+		settings.settings = json_two_stage;
+		v = json_parse_ex(&settings, texts[i], error);
+		if (!same_tree(expect, v) || (!v && strcmp(expect_error, error))) {
+			printf("two stage: %s (%s)\n", texts[i], v ? "parsed" : error);
+			result = false;
+		}
+		json_value_free(expect);
+		json_value_free(v);
+	}
+	printf("test two stage edge cases is %s\n", result ? "pass" : "fail");
+	// runs of backslashes and quotes on either side of every block boundary
+	result = true;
+	for (n = 50; n < 140; ++n) {
+		memset(text, 'x', n);
+		memcpy(text, "[\"", 2);
+		memcpy(text + n - 10, "\\\\\\\"\\\\\", \"", 10);
+		strcpy(text + n, "\\\"\"]");
+		settings.settings = 0;
+		expect = json_parse_ex(&settings, text, NULL);
+		settings.settings = json_two_stage;
+		v = json_parse_ex(&settings, text, NULL);
+		result = result && expect && same_tree(expect, v);
+		json_value_free(expect);
+		json_value_free(v);
+	}
+	printf("test two stage escapes across blocks is %s\n", result ? "pass" : "fail");
+	settings.settings = json_two_stage | json_index_objects;
+	doc = json_document_new(&settings);
+	v = json_document_parse(doc, "{\"a\": \"b\", \"c\": [1.5, true, null]}", NULL);
+	printf("test two stage document is %s\n"
+			, v && !strcmp(find_json_object(v, "a")->u.string.ptr, "b")
+				&& find_json_object(v, "c")->u.array.length == 3 ? "pass" : "fail");
+	json_document_free(doc);
+}
+
+void test_lazy(void) {
+	static char const text[] = "{\"meta\": {\"count\": 3, \"name\": \"a\\\"b\"}, \"items\": [1, 2.5, {\"x\": [true, null]}],"
+		" \"k\\u00e9y\": \"v\", \"skip\": [[[\"]\"], {\"}\": \"[\"}]], \"empty\": [], \"last\": -7}";
+	json_settings settings;
+	alloc_counter counter = {0, 0};
+	json_lazy * lazy;
+	json_cursor root, c;
+	json_value * v, * expect;
+	json_int_t n = 0;
+	double d = 0, half = 2.5;
+	char * big;
+	long allocs;
+	size_t i;
+	bool result;
+	lazy = json_lazy_new(NULL, text, strlen(text), NULL);
+	root = json_lazy_root(lazy);
+	c = root;
+	result = lazy && json_cursor_find(&c, "last") && json_cursor_get_int(&c, &n) && n == -7;
+	c = root;
+	result = result && json_cursor_find(&c, "k\xc3\xa9y") && !strcmp(json_cursor_get_string(&c, NULL), "v")
+		&& !strcmp(json_cursor_key(&c, NULL), "k\xc3\xa9y");
+	c = root;
+	result = result && !json_cursor_find(&c, "missing") && c.value == root.value
+		&& json_cursor_find(&c, "empty") && !json_cursor_enter(&c) && !json_cursor_find(&c, "x");
+	printf("test lazy find is %s\n", result ? "pass" : "fail");
+	c = root;
+	result = json_cursor_find(&c, "items") && json_cursor_enter(&c) && json_cursor_get_int(&c, &n) && n == 1
+		&& json_cursor_next(&c) && !json_cursor_get_int(&c, &n) && json_cursor_get_double(&c, &d) && !memcmp(&d, &half, sizeof(double))
+		&& json_cursor_next(&c) && json_cursor_type(&c) == json_object && !json_cursor_key(&c, NULL);
+	v = result ? json_cursor_value(&c, NULL) : NULL;
+	expect = json_parse("{\"x\": [true, null]}");
+	result = result && same_tree(v, expect) && !json_cursor_next(&c);
+	json_value_free(expect);
+	printf("test lazy elements is %s\n", result ? "pass" : "fail");
+	json_lazy_free(lazy);
+	// trailing commas, and errors as from json_parse_n
+	memset(&settings, 0, sizeof(json_settings));
+	settings.settings = json_relaxed_commas;
+	lazy = json_lazy_new(&settings, "{\"a\": 1,}", 9, NULL);
+	c = json_lazy_root(lazy);
+	result = lazy && json_cursor_enter(&c) && !json_cursor_next(&c);
+	json_lazy_free(lazy);
+	{
+		char expect_error[128], error[128];
+		json_parse_n(NULL, "{\"a\": 1 \"b\": 2}", 16, expect_error);
+		result = result && !json_lazy_new(NULL, "{\"a\": 1 \"b\": 2}", 16, error) && !strcmp(error, expect_error);
+	}
+	printf("test lazy commas and errors is %s\n", result ? "pass" : "fail");
+	// nothing is built for what's skipped
+	big = (char*)malloc(64 * 10000 + 64);
+	strcpy(big, "{\"rows\": [");
+	for (i=0; i<10000; ++i)
+		sprintf(big + strlen(big), "%s{\"id\": %d, \"name\": \"row %d\"}", i ? ", " : "", (int)i, (int)i);
+	strcat(big, "], \"total\": 10000}");
+	settings.settings = 0;
+	settings.mem_alloc = counting_alloc;
+	settings.mem_free = counting_free;
+	settings.user_data = &counter;
+	lazy = json_lazy_new(&settings, big, strlen(big), NULL);
+	allocs = counter.allocs;
+	c = json_lazy_root(lazy);
+	result = lazy && json_cursor_find(&c, "total") && json_cursor_get_int(&c, &n) && n == 10000
+		&& counter.allocs == allocs && allocs < 32;
+	json_lazy_free(lazy);
+	result = result && counter.allocs == counter.frees;
+	printf("test lazy skipping allocates nothing (%ld allocations) is %s\n", allocs, result ? "pass" : "fail");
+	free(big);
+}
+
+// hands out the text a few characters at a time
+typedef struct {
+	char const * text;
+	size_t step;
+} trickle;
+
+static size_t trickle_read(json_char * buf, size_t size, void * user_data) {
+	trickle * t = (trickle*)user_data;
+	size_t n = strlen(t->text);
+	if (n > t->step)
+		n = t->step;
+	if (n > size)
+		n = size;
+	memcpy(buf, t->text, n);
+	t->text += n;
+	return n;
+}
+
+static bool read_all(json_reader * reader, char const * expect, size_t const * offsets, char const * error) {
+	char message[128];
+	json_value * v;
+	int i = 0;
+	bool result = true;
+	while ((v = json_reader_next(reader, message))) {
+		result = result && v->type == json_integer && v->u.integer == expect[i] - '0'
+			&& json_reader_offset(reader) == offsets[i];
+		++i;
+	}
+	return result && !expect[i] && (error ? !!strstr(message, error) : !*message);
+}
+
+void test_reader(void) {
+	static char const text[] = "1\n2\n\n  3 4\t5\n";
+	static size_t const offsets[] = {0, 2, 7, 9, 11};
+	static char const bad[] = "1\n2\n[3,}\n4\n";
+	json_reader * reader;
+	json_settings settings;
+	alloc_counter counter = {0, 0};
+	trickle t;
+	char * records;
+	size_t i;
+	bool result;
+	reader = json_reader_new(NULL, text, strlen(text));
+	printf("test reader is %s\n", read_all(reader, "12345", offsets, NULL) ? "pass" : "fail");
+	json_reader_free(reader);
+	reader = json_reader_new(NULL, bad, strlen(bad));
+	printf("test reader error is %s\n", read_all(reader, "12", offsets, "Unexpected") && json_reader_offset(reader) == 4 ? "pass" : "fail");
+	json_reader_free(reader);
+	for (i = 1; i < 4; ++i) {
+		t.text = text;
+		t.step = i;
+		reader = json_reader_new_stream(NULL, trickle_read, &t);
+		printf("test reader stream (%d at a time) is %s\n", (int)i, read_all(reader, "12345", offsets, NULL) ? "pass" : "fail");
+		json_reader_free(reader);
+	}
+	t.text = "\"a\\u00e9\" {\"key\": [true, null]}[]";
+	t.step = 2;
+	reader = json_reader_new_stream(NULL, trickle_read, &t);
+	result = (json_reader_next(reader, NULL)->u.string.length == 3)
+		&& json_reader_next(reader, NULL)->type == json_object
+		&& json_reader_next(reader, NULL)->type == json_array
+		&& !json_reader_next(reader, NULL);
+	printf("test reader stream split tokens is %s\n", result ? "pass" : "fail");
+	json_reader_free(reader);
+	// one value much bigger than a read, 4 KB at a time
+	records = (char *)malloc(4 * 1024 * 1024 + 16);
+	strcpy(records, "[");
+	for (i = 0, t.step = 1; t.step < 4 * 1024 * 1024; ++i)
+		t.step += sprintf(records + t.step, "%d,", (int)i % 1000);
+	strcpy(records + t.step - 1, "] 7");
+	t.text = records;
+	t.step = 4096;
+	reader = json_reader_new_stream(NULL, trickle_read, &t);
+	{
+		json_value * v = json_reader_next(reader, NULL);
+		result = v && v->type == json_array && v->u.array.length == i
+			&& v->u.array.values[i - 1]->u.integer == (json_int_t)((i - 1) % 1000);
+		v = json_reader_next(reader, NULL);
+		result = result && v && v->u.integer == 7 && !json_reader_next(reader, NULL);
+	}
+	printf("test reader stream big value is %s\n", result ? "pass" : "fail");
+	json_reader_free(reader);
+	free(records);
+	// once warmed up, reading records doesn't allocate
+	records = (char *)malloc(1000 * 64);
+	for (i = 0, records[0] = 0; i < 1000; ++i)
+		sprintf(records + strlen(records), "{\"id\": %d, \"tags\": [\"a\", \"b\"]}\n", (int)i);
+	memset(&settings, 0, sizeof(json_settings));
+	settings.mem_alloc = counting_alloc;
+	settings.mem_free = counting_free;
+	settings.user_data = &counter;
+	reader = json_reader_new(&settings, records, strlen(records));
+	result = true;
+	for (i = 0; i < 1000; ++i) {
+		json_value * v = json_reader_next(reader, NULL);
+		result = result && v && find_json_object(v, "id")->u.integer == (json_int_t)i;
+		if (i == 10)
+			counter.allocs = 0;
+	}
+	result = result && !json_reader_next(reader, NULL) && counter.allocs == 0;
+	json_reader_free(reader);
+	printf("test reader reuses memory is %s\n", result ? "pass" : "fail");
+	free(records);
+}
+
+void test_parser(void) {
+	static char const * split[] = {
+		"[\"a\\u00e9\\\"b\\\\\", -12.5e-3, 123456789012, true, false, null]",
+		"{\"key\"\t:\n\"\\ud800\"}",
+		"\n\n  [1, 2,\n  x]",
+		"[\"\\u00g9\"]",
+		"[1, 2",
+		"\"abc",
+		"[1] 2",
+		"[tru]",
+	};
+	json_settings settings;
+	json_document * doc;
+	json_parser * parser;
+	json_value * expect, * v;
+	alloc_counter counter = {0, 0};
+	char e1[128], e2[128];
+	size_t i, step;
+	bool result = true;
+	// the same value or the same error (down to where it is) for every split
+	for (i = 0; i < sizeof(split)/sizeof(split[0]); ++i) {
+		*e1 = 0;
+		expect = json_parse_ex(NULL, split[i], e1);
+		for (step = 1; step < 8; ++step) {
+			*e2 = 0;
+			parser = json_parser_new(NULL);
+			v = push_parse(parser, split[i], step, e2);
+			result = result && (expect ? same_tree(expect, v) : !v) && !strcmp(e1, e2);
+			json_value_free(v);
+			json_parser_free(parser);
+		}
+		json_value_free(expect);
+	}
+	printf("test push parser split tokens is %s\n", result ? "pass" : "fail");
+	// a number cut off by its end can run straight into a key
+	memset(&settings, 0, sizeof(json_settings));
+	settings.settings = json_relaxed_commas;
+	expect = json_parse_ex(&settings, "{\"a\":12\"b\":3}", e1);
+	parser = json_parser_new(&settings);
+	result = !expect && json_parser_feed(parser, "{\"a\":1", 6, NULL)
+		&& !json_parser_feed(parser, "2\"b\":3}", 7, e2) && !strcmp(e1, e2);
+	printf("test push parser relaxed commas (%s) is %s\n", e2, result ? "pass" : "fail");
+	json_parser_free(parser);
+	parser = json_parser_new(NULL);
+	v = NULL;
+	result = json_parser_feed(parser, "[1, 2", 5, NULL) && json_parser_feed(parser, "3]", 2, NULL)
+		&& (v = json_parser_finish(parser, NULL))
+		&& v->u.array.length == 2 && v->u.array.values[1]->u.integer == 23;
+	json_value_free(v);
+	printf("test push parser number is %s\n", result ? "pass" : "fail");
+	result = !json_parser_finish(parser, e1) && !!strstr(e1, "finished");
+	json_parser_free(parser);
+	printf("test push parser finished (%s) is %s\n", e1, result ? "pass" : "fail");
+	// failures stick, and freeing an unfinished parse leaves nothing behind
+	settings.settings = 0;
+	settings.mem_alloc = counting_alloc;
+	settings.mem_free = counting_free;
+	settings.user_data = &counter;
+	parser = json_parser_new(&settings);
+	result = json_parser_feed(parser, "{\"foo\": [1, 2, {\"bar\": \"ba", 26, NULL)
+		&& !json_parser_feed(parser, "z\"}}]", 5, e1)
+		&& !json_parser_finish(parser, e2) && !strcmp(e1, e2);
+	json_parser_free(parser);
+	parser = json_parser_new(&settings);
+	result = result && json_parser_feed(parser, "{\"foo\": [1, 2, {\"bar\": \"ba", 26, NULL);
+	json_parser_free(parser);
+	printf("test push parser free (%s) is %s\n", e1
+			, result && counter.allocs == counter.frees ? "pass" : "fail");
+	doc = json_document_new(NULL);
+	parser = json_document_parser_new(doc);
+	v = push_parse(parser, "{\"foo\": [\"bar\", 1.5]}", 3, NULL);
+	json_parser_free(parser);
+	printf("test push parser document is %s\n"
+			, v && v->u.object.values[0].value->u.array.values[1]->type == json_double ? "pass" : "fail");
+	json_document_free(doc);
+}
+
+typedef struct {
+	char text[8192];
+	size_t length;
+	size_t limit;  // the sink fails once it's been given this much
+} sink_log;
+
+static int log_sink(json_char const * text, size_t length, void * user_data) {
+	sink_log * log = (sink_log*)user_data;
+	if (log->length + length > log->limit)
+		return 0;
+	memcpy(log->text + log->length, text, length);
+	log->length += length;
+	return 1;
+}
+
+// serialize the value of `json` and compare with `expect`
+static bool serializes_as(char const * json, json_serialize_opts const * opts, char const * expect) {
+	json_buffer out;
+	json_value * v = json_parse(json);
+	bool result;
+	json_buffer_init(&out, NULL);
+	result = v && json_serialize(&out, v, opts) && out.length == strlen(expect) && !strcmp(out.text, expect);
+	if (!result)
+		printf("serialize: %s as %s\n", json, out.text ? out.text : "(nothing)");
+	json_buffer_free(&out);
+	json_value_free(v);
+	return result;
+}
+
+void test_serialize(void) {
+	static char const * doubles[][2] = {
+		{"0.1", "0.1"}, {"1.0", "1.0"}, {"-0.0", "-0.0"}, {"1.5e300", "1.5e300"}, {"1e21", "1e21"},
+		{"1e20", "100000000000000000000.0"}, {"1e-7", "1e-7"}, {"0.000001", "0.000001"},
+		{"123.456", "123.456"}, {"5e-324", "5e-324"}, {"2.2250738585072014e-308", "2.2250738585072014e-308"},
+		{"1.7976931348623157e308", "1.7976931348623157e308"}, {"0.30000000000000004", "0.30000000000000004"},
+		{"9007199254740993.0", "9007199254740992.0"}, {"-2.5E-3", "-0.0025"}, {"1e23", "1e23"},
+	};
+	static json_serialize_opts const pretty = { json_serialize_pretty, 2 };
+	char json[64], text[64];
+	json_settings settings;
+	json_buffer out;
+	json_value * v, * w;
+	sink_log log;
+	char * big;
+	unsigned long long bits = 88172645463325252ULL;
+	size_t i;
+	bool result = true;
+	for (i = 0; i < sizeof(doubles)/sizeof(doubles[0]); ++i) {
+		sprintf(json, "[%s]", doubles[i][0]);
+		sprintf(text, "[%s]", doubles[i][1]);
+		result = serializes_as(json, NULL, text) && result;
+	}
+	printf("test serialize doubles is %s\n", result ? "pass" : "fail");
+	// random bits read back the same, but for infinities and NaN
+	json_buffer_init(&out, NULL);
+	result = true;
+	for (i = 0; i < 100000 && result; ++i) {
+		json_value d = json_value_from_real(0);
+		bits ^= bits << 13;
+		bits ^= bits >> 7;
+		bits ^= bits << 17;
+		memcpy(&d.u.dbl, &bits, sizeof(double));
+		if ((bits >> 52 & 0x7FF) == 0x7FF)
+			continue;
+		out.length = 0;
+		v = json_serialize(&out, &d, NULL) ? json_parse(out.text) : NULL;
+		result = v && v->type == json_double && !memcmp(&v->u.dbl, &d.u.dbl, sizeof(double));
+		json_value_free(v);
+	}
+	printf("test serialize doubles round trip is %s\n", result ? "pass" : "fail");
+	result = serializes_as("[\"a\\\"b\\\\c\\n\\u0001\\u001f\u00c3\u00a9/\\u0000.\\t\"]", NULL
+				, "[\"a\\\"b\\\\c\\n\\u0001\\u001f\u00c3\u00a9/\\u0000.\\t\"]")
+		&& serializes_as("{\"k\\\"\": -9223372036854775808, \"\": [true, false, null, {}, []]}", NULL
+				, "{\"k\\\"\":-9223372036854775808,\"\":[true,false,null,{},[]]}");
+	printf("test serialize escapes is %s\n", result ? "pass" : "fail");
+	result = serializes_as("{\"a\": [1, {}], \"b\": [], \"c\": {\"d\": \"e\"}}", &pretty
+				, "{\n  \"a\": [\n    1,\n    {}\n  ],\n  \"b\": [],\n  \"c\": {\n    \"d\": \"e\"\n  }\n}")
+		&& serializes_as("7", &pretty, "7");
+	printf("test serialize pretty is %s\n", result ? "pass" : "fail");
+	// the sink gets the same text as the buffer, more than one chunk of it,
+	// and output appends to what's in the buffer
+	big = (char*)malloc(7000);
+	strcpy(big, "[");
+	memset(json, 0, sizeof(json));
+	memset(json, 'x', 63);
+	for (i = 0; i < 100; ++i)
+		sprintf(big + strlen(big), "%s\"%s\"", i ? "," : "", json);
+	strcat(big, "]");
+	w = json_parse(big);
+	v = w->u.array.values[0];
+	out.length = 0;
+	log.length = 0;
+	log.limit = sizeof(log.text);
+	result = json_serialize(&out, w, NULL) && json_serialize(&out, w, &pretty)
+		&& json_serialize_sink(NULL, w, NULL, log_sink, &log) && log.length == 6601
+		&& !memcmp(out.text, big, log.length) && !memcmp(log.text, big, log.length)
+		&& out.length == 6601 + 6902 && !out.text[out.length];
+	printf("test serialize sink is %s\n", result ? "pass" : "fail");
+	// failing sinks and allocations fail the serializing, leaving the buffer as it was
+	log.length = 0;
+	log.limit = 5000;
+	memset(&settings, 0, sizeof(json_settings));
+	settings.max_memory = 4096;
+	json_buffer_free(&out);
+	json_buffer_init(&out, &settings);
+	result = !json_serialize_sink(NULL, w, NULL, log_sink, &log) && log.length == 4096
+		&& json_serialize(&out, v, NULL) && out.length == 65
+		&& !json_serialize(&out, w, NULL) && out.length == 65 && !memcmp(out.text + 1, json, 63) && !out.text[65];
+	printf("test serialize failure is %s\n", result ? "pass" : "fail");
+	json_value_free(w);
+	json_buffer_free(&out);
+	free(big);
+}
+
+// a record written through the writer, and the same as text
+static void write_record(json_writer * w, int id) {
+	json_writer_begin_object(w);
+	json_writer_key(w, "id", 2);
+	json_writer_integer(w, id);
+	json_writer_key(w, "name", 4);
+	json_writer_string(w, "a\"b\n", 4);
+	json_writer_key(w, "tags", 4);
+	json_writer_begin_array(w);
+	json_writer_string(w, "x", 1);
+	json_writer_double(w, 1.5);
+	json_writer_bool(w, 1);
+	json_writer_null(w);
+	json_writer_end_array(w);
+	json_writer_key(w, "empty", 5);
+	json_writer_begin_object(w);
+	json_writer_end_object(w);
+	json_writer_end_object(w);
+}
+
+void test_writer(void) {
+	static json_serialize_opts const pretty = { json_serialize_pretty, 2 };
+	static char const record[] = "{\"id\": 7, \"name\": \"a\\\"b\\n\", \"tags\": [\"x\", 1.5, true, null], \"empty\": {}}";
+	json_settings settings;
+	alloc_counter counter = {0, 0};
+	json_buffer out, expect;
+	json_writer * w;
+	json_value * v, * tree;
+	char * text;
+	FILE * fp;
+	long allocs;
+	int i, m;
+	bool result = true;
+	v = json_parse(record);
+	tree = json_parse("{\"k\": [1, [2, {}]]}");
+	json_buffer_init(&out, NULL);
+	json_buffer_init(&expect, NULL);
+	// the same as serializing the tree, compact and pretty
+	for (m = 0; m < 2; ++m) {
+		out.length = expect.length = 0;
+		w = json_writer_new(&out, m ? &pretty : NULL);
+		write_record(w, 7);
+		result = json_writer_finish(w) && json_serialize(&expect, v, m ? &pretty : NULL)
+			&& out.length == expect.length && !strcmp(out.text, expect.text) && result;
+		json_writer_free(w);
+	}
+	// nested, with a tree written in the middle
+	for (m = 0; m < 2; ++m) {
+		out.length = 0;
+		w = json_writer_new(&out, m ? &pretty : NULL);
+		json_writer_begin_array(w);
+		write_record(w, 7);
+		json_writer_value(w, tree);
+		json_writer_end_array(w);
+		result = json_writer_finish(w) && !strcmp(out.text, m
+			? "[\n  {\n    \"id\": 7,\n    \"name\": \"a\\\"b\\n\",\n    \"tags\": [\n"
+				"      \"x\",\n      1.5,\n      true,\n      null\n    ],\n    \"empty\": {}\n  },\n"
+				"  {\n    \"k\": [\n      1,\n      [\n        2,\n        {}\n      ]\n    ]\n  }\n]"
+			: "[{\"id\":7,\"name\":\"a\\\"b\\n\",\"tags\":[\"x\",1.5,true,null],\"empty\":{}},{\"k\":[1,[2,{}]]}]")
+			&& result;
+		if (!result)
+			printf("writer: %s\n", out.text);
+		json_writer_free(w);
+	}
+	printf("test writer is %s\n", result ? "pass" : "fail");
+	// rows go into the reused buffer without allocating
+	memset(&settings, 0, sizeof(json_settings));
+	settings.mem_alloc = counting_alloc;
+	settings.mem_free = counting_free;
+	settings.user_data = &counter;
+	json_buffer_free(&out);
+	json_buffer_init(&out, &settings);
+	w = json_writer_new(&out, NULL);
+	for (m = 0; m < 2; ++m) {
+		allocs = counter.allocs;
+		out.length = 0;
+		json_writer_begin_array(w);
+		for (i = 0; i < 10000; ++i)
+			write_record(w, i);
+		json_writer_end_array(w);
+		result = json_writer_finish(w);
+	}
+	printf("test writer rows is %s\n", result && counter.allocs == allocs ? "pass" : "fail");
+	json_writer_free(w);
+	// through a file descriptor, a chunk at a time
+	fp = tmpfile();
+	w = json_writer_new_fd(NULL, fileno(fp), NULL);
+	json_writer_begin_array(w);
+	for (i = 0; i < 10000; ++i)
+		write_record(w, i);
+	json_writer_end_array(w);
+	result = json_writer_finish(w);
+	json_writer_free(w);
+	text = (char*)malloc(out.length + 1);
+	rewind(fp);
+	result = result && fread(text, 1, out.length + 1, fp) == out.length && !memcmp(text, out.text, out.length);
+	fclose(fp);
+	free(text);
+	printf("test writer fd is %s\n", result ? "pass" : "fail");
+	json_buffer_free(&out);
+	json_buffer_free(&expect);
+	json_value_free(v);
+	json_value_free(tree);
+	printf("test writer frees is %s\n", counter.allocs == counter.frees ? "pass" : "fail");
+#ifndef NDEBUG
+	// anything out of place fails the writer until it's finished
+	json_buffer_init(&out, NULL);
+	w = json_writer_new(&out, NULL);
+	result = json_writer_begin_array(w) && !json_writer_key(w, "k", 1) && !json_writer_end_array(w)
+		&& !json_writer_finish(w) && out.length == 0;
+	result = result && json_writer_begin_object(w) && !json_writer_integer(w, 1) && !json_writer_finish(w);
+	result = result && json_writer_begin_object(w) && json_writer_key(w, "k", 1) && !json_writer_key(w, "k", 1)
+		&& !json_writer_finish(w);
+	result = result && json_writer_begin_object(w) && json_writer_key(w, "k", 1) && !json_writer_end_object(w)
+		&& !json_writer_finish(w);
+	result = result && json_writer_begin_array(w) && !json_writer_end_object(w) && !json_writer_finish(w);
+	result = result && json_writer_null(w) && !json_writer_null(w) && !json_writer_finish(w);
+	result = result && json_writer_begin_array(w) && !json_writer_finish(w) && !json_writer_finish(w);
+	result = result && json_writer_integer(w, -12) && json_writer_finish(w) && !strcmp(out.text, "-12");
+	json_writer_free(w);
+	json_buffer_free(&out);
+	printf("test writer checks is %s\n", result ? "pass" : "fail");
+#endif
+}
+
+// parsing in parallel gives what parsing in one piece does, trees and errors alike
+static bool parallel_matches(char const * json, size_t length, int threads) {
+	char expect_error[128], error[128];
+	json_value * expect = json_parse_n(NULL, json, length, expect_error);
+	json_value * v = json_parse_parallel(NULL, json, length, threads, error);
+	bool result = same_tree(expect, v) && (v || !strcmp(expect_error, error));
+	if (!result)
+		printf("parallel: %s / %s\n", v ? "parsed" : error, expect ? "parsed" : expect_error);
+	json_value_free(expect);
+	json_value_free(v);
+	return result;
+}
+
+// run before anything else parses, so that the scanners are first used from
+// several threads at once
+void test_parallel_first(void) {
+	char * text = (char*)malloc(300000 * 16 + 2);
+	char error[128];
+	json_value * v, * expect;
+	size_t length = 1;
+	int i;
+	text[0] = '[';
+	for (i = 0; i < 300000; ++i)
+		length += sprintf(text + length, "%s\"%d\"", i ? "," : "", i);
+	strcpy(text + length, "]");
+	v = json_parse_parallel(NULL, text, length + 1, 4, error);
+	expect = json_parse_n(NULL, text, length + 1, NULL);
+	printf("test parallel first parse is %s\n", v && v->u.array.length == 300000 && same_tree(expect, v) ? "pass" : "fail");
+	json_value_free(v);
+	json_value_free(expect);
+	free(text);
+}
+
+void test_parallel(void) {
+	size_t const size = 1 << 20;
+	char * text = (char*)malloc(size + 256), * bad;
+	json_value * v;
+	size_t length, n;
+	int i;
+	bool result = true;
+	strcpy(text, " \n[");
+	for (length = 3, i = 0; length < size; ++i) {
+		if (i)
+			length += sprintf(text + length, i % 7 ? "," : ",\n ");
+		switch (i % 5) {
+		case 0: length += sprintf(text + length, "{\"id\": %d, \"s\": \"a,b]}\", \"t\": [1, [2, {\"u\": \"\\\\\"}]]}", i); break;
+		case 1: length += sprintf(text + length, "\"\\\"],[\\\\\\\\\\\"{\""); break;
+		case 2: length += sprintf(text + length, "[[[[], {}]], \"%d\"]", i); break;
+		case 3: length += sprintf(text + length, "-1.5e%d", i % 300); break;
+		case 4: length += sprintf(text + length, "{\"k\\\\\": \"\\\\\\\\\", \"n\": null}"); break;
+		}
+	}
+	strcpy(text + length, "] \n");
+	length += 3;
+	for (n = 0; n < 3; ++n)
+		result = parallel_matches(text, length - n * 40000, n + 2) && result;
+	v = json_parse_n(NULL, text, length, NULL);
+	result = result && v && v->type == json_array && v->u.array.values[1]->parent == v;
+	json_value_free(v);
+	printf("test parallel is %s\n", result ? "pass" : "fail");
+	// errors in the middle, and a comma too many where the array might be split
+	bad = (char*)malloc(length + 1);
+	result = true;
+	for (n = 1; n < 16; ++n) {
+		memcpy(bad, text, length + 1);
+		switch (n % 4) {
+		case 0: bad[length * n / 16] = '"'; break;
+		case 1: bad[length * n / 16] = ']'; break;
+		case 2: memcpy(strchr(bad + length * n / 16, ','), ",,", 2); break;
+		case 3: memcpy(strchr(bad + length * n / 16, ','), ", ,", 3); break;
+		}
+		result = parallel_matches(bad, length, 4) && result;
+	}
+	printf("test parallel errors is %s\n", result ? "pass" : "fail");
+	result = parallel_matches(text + 3, length - 3, 4)
+		&& parallel_matches("[1, 2, 3]", 9, 4)
+		&& parallel_matches("[1, 2,]", 7, 4);
+	printf("test parallel elsewise is %s\n", result ? "pass" : "fail");
+	free(bad);
+	free(text);
+}
+
+// every record the pipeline hands on is what json_parse_n makes of its line
+typedef struct {
+	char const * json;
+	char * seen;
+	bool ordered;
+	size_t last;
+	long count, bad, wrong, stop_after;
+	int inside;
+} ndjson_log;
+
+static int check_record(json_value * value, size_t offset, json_char const * error, void * user_data) {
+	ndjson_log * log = (ndjson_log*)user_data;
+	char expect_error[128];
+	json_value * expect = json_parse_n(NULL, log->json + offset, strcspn(log->json + offset, "\n"), expect_error);
+	if (log->inside++ || log->seen[offset]++ || !same_tree(expect, value)
+			|| (!value && strcmp(error, expect_error))
+			|| (log->ordered && log->count && offset <= log->last))
+		++log->wrong;
+	log->last = offset;
+	log->bad += !value;
+	json_value_free(expect);
+	--log->inside;
+	return ++log->count != log->stop_after;
+}
+
+static bool ndjson_matches(char const * json, size_t length, json_ndjson_opts const * opts
+			, long records, long bad) {
+	ndjson_log log = { json, (char*)calloc(length + 1, 1), !opts || !opts->unordered, 0, 0, 0, 0, 0, 0 };
+	char error[128];
+	bool result = json_parse_ndjson(NULL, json, length, opts, check_record, &log, error)
+		&& !*error && log.count == records && log.bad == bad && !log.wrong;
+	if (!result)
+		printf("ndjson: %ld records, %ld bad, %ld wrong: %s\n", log.count, log.bad, log.wrong, error);
+	free(log.seen);
+	return result;
+}
+
+void test_ndjson(void) {
+	json_ndjson_opts opts = { 0, 0, 200, 0 };
+	ndjson_log log;
+	char * text = (char*)malloc(1 << 20), error[128];
+	size_t length = 0;
+	long records = 0, bad = 0;
+	int i, threads;
+	bool result = true;
+	for (i = 0; i < 5000; ++i) {
+		switch (i % 9) {
+		case 0: length += sprintf(text + length, "{\"id\": %d, \"tags\": [\"a\", \"b\\n\"], \"ok\": true}\n", i); break;
+		case 1: length += sprintf(text + length, "  [%d, -1.5e3, null, {\"x\": {}}]\r\n", i); break;
+		case 2: length += sprintf(text + length, "\n \t\n"); continue;
+		case 3: length += sprintf(text + length, "\"s%d\"\n", i); break;
+		case 4: length += sprintf(text + length, i % 4 ? "%d\n" : "{\"id\" %d}\n", i); bad += !(i % 4); break;
+		default: length += sprintf(text + length, "{\"k\": \"%*d\"}\n", i % 300, i); break;
+		}
+		++records;
+	}
+	for (threads = 1; threads <= 4; ++threads) {
+		opts.threads = threads;
+		opts.unordered = threads % 2;
+		opts.window = threads == 2 ? 1 : 0;
+		result = ndjson_matches(text, length, &opts, records, bad) && result;
+	}
+	result = ndjson_matches(text, length, NULL, records, bad)
+		&& ndjson_matches(text, length - 1, NULL, records, bad)
+		&& ndjson_matches("", 0, NULL, 0, 0)
+		&& ndjson_matches(" 1 2\n\n[", 7, NULL, 2, 2);
+	printf("test ndjson is %s\n", result ? "pass" : "fail");
+	// the handler stops it, and isn't called again
+	memset(&log, 0, sizeof(log));
+	log.json = text;
+	log.seen = (char*)calloc(length, 1);
+	log.stop_after = 100;
+	opts.threads = 3;
+	result = !json_parse_ndjson(NULL, text, length, &opts, check_record, &log, error)
+		&& !strcmp(error, "Stopped by the handler") && log.count == 100 && !log.wrong;
+	printf("test ndjson stop is %s\n", result ? "pass" : "fail");
+	free(log.seen);
+	free(text);
+}
+
+// parsing a file, mapped or read, gives what parsing its text does
+static bool parse_file_matches(char const * path) {
+	char * buf = read_file(path), error[128];
+	json_document * doc = json_document_new(NULL);
+	json_value * expect = json_parse_n(NULL, buf, strlen(buf), NULL);
+	json_value * v = json_parse_file(NULL, path, error);
+	json_value * in_doc = json_document_parse_file(doc, path, error);
+	char * after = read_file(path);
+	bool result = expect && same_tree(expect, v) && same_tree(expect, in_doc) && !strcmp(buf, after);
+	json_value_free(expect);
+	json_value_free(v);
+	json_document_free(doc);
+	free(buf);
+	free(after);
+	return result;
+}
+
+void test_parse_file(void) {
+	char path[256], error[128];
+	json_document * doc = json_document_new(NULL);
+	json_value * v, * first;
+	bool result = true;
+	int i;
+	for (i = 0; i < valid_file_size; ++i) {
+		sprintf(path, "tests" SEP "%s", valid_files[i]);
+		result = parse_file_matches(path) && result;
+	}
+	// the document holds on to every file parsed into it, until reset
+	sprintf(path, "tests" SEP "%s", valid_files[0]);
+	first = json_document_parse_file(doc, path, NULL);
+	for (i = 1; i < valid_file_size; ++i) {
+		sprintf(path, "tests" SEP "%s", valid_files[i]);
+		v = json_document_parse_file(doc, path, NULL);
+		result = result && v;
+	}
+	sprintf(path, "tests" SEP "%s", valid_files[0]);
+	v = json_parse_file(NULL, path, NULL);
+	result = result && same_tree(first, v);
+	json_value_free(v);
+	json_document_reset(doc);
+	result = result && !json_parse_file(NULL, "tests" SEP "missing.json", error)
+		&& !strncmp(error, "Can't open the file: ", 21)
+		&& !json_document_parse_file(doc, "tests" SEP "missing.json", error)
+		&& !strncmp(error, "Can't open the file: ", 21);
+	json_document_free(doc);
+	printf("test parse file is %s\n", result ? "pass" : "fail");
+#if !defined _WIN32
+	// a pipe is read rather than mapped
+	{
+		char const * text = "{\"a\": [1, \"two\"]}";
+		int fds[2];
+		result = !pipe(fds) && write(fds[1], text, strlen(text)) == (long)strlen(text);
+		close(fds[1]);
+		sprintf(path, "/dev/fd/%d", fds[0]);
+		v = json_parse_file(NULL, path, error);
+		close(fds[0]);
+		first = json_parse_n(NULL, text, strlen(text), NULL);
+		result = result && same_tree(first, v);
+		json_value_free(v);
+		json_value_free(first);
+		printf("test parse pipe is %s\n", result ? "pass" : "fail");
+	}
+#endif
+}
+
+// a tape holds what the tree does: returns the node after the value's, or
+// NULL if they differ
+static json_node const * same_tape(json_node const * n, json_value const * v) {
+	unsigned int i;
+	if (n->type != v->type)
+		return NULL;
+	switch (v->type) {
+	case json_object:
+		if (n->length != v->u.object.length)
+			return NULL;
+		for (i = 0, ++n; n && i < v->u.object.length; ++i)
+			n = n->type == json_string && !strcmp(n->u.string, v->u.object.values[i].name)
+				? same_tape(n + 1, v->u.object.values[i].value) : NULL;
+		return n;
+	case json_array:
+		if (n->length != v->u.array.length)
+			return NULL;
+		for (i = 0, ++n; n && i < v->u.array.length; ++i)
+			n = same_tape(n, v->u.array.values[i]);
+		return n;
+	case json_string:
+		return n->length == v->u.string.length
+			&& !memcmp(n->u.string, v->u.string.ptr, n->length + 1) ? n + 1 : NULL;
+	case json_integer: return n->u.integer == v->u.integer ? n + 1 : NULL;
+	case json_double : return !memcmp(&n->u.dbl, &v->u.dbl, sizeof(double)) ? n + 1 : NULL;
+	case json_boolean: return n->u.boolean == v->u.boolean ? n + 1 : NULL;
+	default: return n + 1;
+	}
+}
+
+static bool tape_matches(char const * json) {
+	char expect_error[128], error[128];
+	json_value * v = json_parse_n(NULL, json, strlen(json), expect_error);
+	json_tape * tape = json_tape_parse(NULL, json, strlen(json), error);
+	json_node const * root = tape ? json_tape_root(tape) : NULL;
+	bool result = v && tape ? same_tape(root, v) == root + json_tape_size(tape)
+			&& json_node_next(root) == root + json_tape_size(tape)
+		: !v && !tape && !strcmp(expect_error, error);
+	json_value_free(v);
+	json_tape_free(tape);
+	return result;
+}
+
+void test_tape(void) {
+	static char const * docs[] = {
+		"{\"a\": [1, 2.5, {\"b\": null}], \"c\": \"d\\u00e9\", \"e\": [], \"f\": {}, \"g\": true}",
+		"[[[[]]], [{}, {\"x\": [false]}], \"\", -0, 1e400]",
+		"\"just a string\"", "12", "{\"a\": 1,}", "[1, 2", "{\"a\" 1}", "",
+	};
+	char path[256], * buf, s[256];
+	json_tape * tape;
+	json_node const * root, * n;
+	int64_t i64;
+	double d;
+	bool b, result = sizeof(void*) != 8 || sizeof(json_node) == 16;
+	int i;
+	for (i = 0; i < (int)(sizeof(docs)/sizeof(docs[0])); ++i)
+		result = tape_matches(docs[i]) && result;
+	for (i = 0; i < valid_file_size; ++i) {
+		sprintf(path, "tests" SEP "%s", valid_files[i]);
+		buf = read_file(path);
+		result = tape_matches(buf) && result;
+		free(buf);
+	}
+	printf("test tape is %s\n", result ? "pass" : "fail");
+	// finding members and elements, and reading them
+	tape = json_tape_parse(NULL, docs[0], strlen(docs[0]), NULL);
+	root = json_tape_root(tape);
+	n = json_node_find(root, "a");
+	result = n && json_node_at(n, 0)->u.integer == 1
+		&& json_node_read_if_double(&d, json_node_at(n, 1)) && d > 2.4 && d < 2.6
+		&& json_node_find(json_node_at(n, 2), "b")->type == json_null
+		&& !json_node_at(n, 3) && !json_node_at(root, 0)
+		&& json_node_read_if_int64_t(&i64, json_node_at(n, 0)) && i64 == 1
+		&& !json_node_read_if_int64_t(&i64, n)
+		&& json_node_read_if_string(s, json_node_find(root, "c")) && !strcmp(s, "d\xc3\xa9")
+		&& json_node_read_if_bool(&b, json_node_find(root, "g")) && b
+		&& json_node_find(root, "e")->length == 0 && json_node_next(json_node_find(root, "e")) == json_node_find(root, "f") - 1
+		&& !json_node_find(root, "h") && !json_node_find(n, "a");
+	json_tape_free(tape);
+	printf("test tape access is %s\n", result ? "pass" : "fail");
+}
+
+// a block copy is the same tree, and all that's left of it is one allocation
+static bool dup_block_matches(json_value const * v) {
+	json_settings settings;
+	alloc_counter counter;
+	json_document * doc = json_document_new(NULL);
+	json_value * w;
+	bool result;
+	memset(&settings, 0, sizeof(json_settings));
+	memset(&counter, 0, sizeof(alloc_counter));
+	settings.mem_alloc = counting_alloc;
+	settings.mem_free = counting_free;
+	settings.user_data = &counter;
+	w = json_value_dup_block(&settings, v);
+	result = w && !w->parent && same_tree(v, w) && counter.allocs == counter.frees + 1
+		&& same_tree(v, json_document_dup(doc, v));
+	counting_free(w, &counter);
+	json_document_free(doc);
+	return result && counter.allocs == counter.frees;
+}
+
+void test_dup_block(void) {
+	static char text[4096];
+	enum { depth = 100000 };
+	char path[256], * buf, * p = text;
+	json_settings settings;
+	json_document * doc;
+	json_value * v, * w;
+	bool result = true;
+	int i;
+	for (i = 0; i < valid_file_size; ++i) {
+		sprintf(path, "tests" SEP "%s", valid_files[i]);
+		buf = read_file(path);
+		v = json_parse(buf);
+		result = dup_block_matches(v) && result;
+		json_value_free(v);
+		free(buf);
+	}
+	printf("test dup block is %s\n", result ? "pass" : "fail");
+	// objects keep their index, built or not
+	p += sprintf(p, "{");
+	for (i=99; i>=0; --i)
+		p += sprintf(p, "\"key%d\": %d, ", i, i);
+	sprintf(p, "\"key5\": 0}");
+	v = json_parse(text);
+	w = json_value_dup_block(NULL, v);
+	result = check_object_index(w);
+	free(w);
+	w = json_value_dup_block(NULL, v);
+	result = result && check_object_index(v) && check_object_index(w) && dup_block_matches(v);
+	free(w);
+	json_value_free(v);
+	printf("test dup block index is %s\n", result ? "pass" : "fail");
+	// deep nesting, which a recursive copy would run out of stack on
+	buf = (char*)malloc(depth * 2 + 1);
+	memset(buf, '[', depth);
+	memset(buf + depth, ']', depth);
+	buf[depth * 2] = 0;
+	v = json_parse(buf);
+	w = json_value_dup_block(NULL, v);
+	for (i = 1, p = (char*)w; w && w->type == json_array && w->u.array.length; ++i)
+		w = w->u.array.values[0];
+	result = v && w && i == depth && w->parent && w->parent->u.array.values[0] == w;
+	free(p);
+	json_value_free(v);
+	free(buf);
+	printf("test dup block deep is %s\n", result ? "pass" : "fail");
+	// a document counts the copies towards its limit
+	memset(&settings, 0, sizeof(json_settings));
+	settings.max_memory = 12000;
+	doc = json_document_new(&settings);
+	v = json_parse(text);
+	w = json_document_dup(doc, v);
+	result = w && same_tree(v, w) && !json_document_dup(doc, v);
+	json_document_reset(doc);
+	result = result && json_document_dup(doc, v) && !json_value_dup_block(NULL, NULL);
+	json_value_free(v);
+	json_document_free(doc);
+	printf("test dup block document is %s\n", result ? "pass" : "fail");
+}
+
+// hashes of two texts are the same (or not), for values or only their types
+static bool same_hash(char const * lhs, char const * rhs, bool types) {
+	json_value * l = json_parse(lhs), * r = json_parse(rhs);
+	uint64_t hl[2], hr[2];
+	bool result = l && r && (types ? json_type_hash(NULL, l, hl) && json_type_hash(NULL, r, hr)
+		: json_value_hash(NULL, l, hl) && json_value_hash(NULL, r, hr));
+	json_value_free(l);
+	json_value_free(r);
+	return result && hl[0] == hr[0] && hl[1] == hr[1];
+}
+
+// comparing gives 1 or 0, with the path where they first differ
+static bool compares(char const * lhs, char const * rhs, json_compare_opts const * opts, int expect, char const * expect_path) {
+	json_value * l = json_parse(lhs), * r = json_parse(rhs);
+	char path[64];
+	bool result = l && r && json_value_compare(NULL, l, r, opts, path, sizeof(path)) == expect
+		&& !strcmp(path, expect_path);
+	json_value_free(l);
+	json_value_free(r);
+	return result;
+}
+
+void test_compare(void) {
+	static char text[4096], swapped[4096], repeated[4096];
+	enum { depth = 100000 };
+	json_compare_opts opts = { 0, 0 };
+	char path[256], * buf, * p = text, * q = swapped;
+	json_value * v, * w, built;
+	bool result = true;
+	int i;
+	for (i = 0; i < valid_file_size; ++i) {
+		sprintf(path, "tests" SEP "%s", valid_files[i]);
+		buf = read_file(path);
+		v = json_parse(buf);
+		w = json_value_dup_block(NULL, v);
+		result = result && json_value_compare(NULL, v, w, NULL, NULL, 0) == 1
+			&& json_value_compare(NULL, v, v, NULL, NULL, 0) == 1;
+		json_value_free(v);
+		free(w);
+		free(buf);
+	}
+	result = result && json_value_compare(NULL, NULL, NULL, NULL, NULL, 0) == 1
+		&& compares("{\"b\": [1, {\"x\": 2.5}], \"a\": \"s\"}", "{\"a\": \"s\", \"b\": [1, {\"x\": 2.5}]}", NULL, 1, "")
+		&& compares("{\"a\": 1, \"b\": [1, {\"x/~y\": 2}]}", "{\"b\": [1, {\"x/~y\": 3}], \"a\": 1}", NULL, 0, "/b/1/x~1~0y")
+		&& compares("{\"a\": 1, \"b\": 2}", "{\"a\": 1, \"c\": 2}", NULL, 0, "/b")
+		&& compares("[1, 2]", "[1, 2, 3]", NULL, 0, "")
+		&& compares("[\"a\\u0000b\"]", "[\"a\\u0000c\"]", NULL, 0, "/0")
+		&& compares("{}", "[]", NULL, 0, "");
+	printf("test compare is %s\n", result ? "pass" : "fail");
+	// doubles, bitwise or not
+	result = compares("[0.30000000000000004]", "[0.3]", NULL, 0, "/0")
+		&& compares("[0.0]", "[-0.0]", NULL, 0, "/0")
+		&& compares("[0.0]", "[-0.0]", &opts, 1, "")
+		&& compares("[0.30000000000000004]", "[0.3]", &opts, 0, "/0");
+	opts.tolerance = 1e-9;
+	result = result && compares("[0.30000000000000004]", "[0.3]", &opts, 1, "")
+		&& compares("[0.3]", "[0.31]", &opts, 0, "/0");
+	opts.bitwise = 1;
+	result = result && compares("[0.30000000000000004]", "[0.3]", &opts, 0, "/0");
+	printf("test compare doubles is %s\n", result ? "pass" : "fail");
+	// a repeated key pairs with its repeats in order, whichever side it's on,
+	// so that equal values hash the same
+	result = compares("{\"a\": 1, \"a\": 1}", "{\"a\": 1, \"b\": 1}", NULL, 0, "/a")
+		&& compares("{\"a\": 1, \"b\": 1}", "{\"a\": 1, \"a\": 1}", NULL, 0, "/b")
+		&& compares("{\"x\": 0, \"a\": 1, \"a\": 2}", "{\"a\": 1, \"a\": 2, \"x\": 0}", NULL, 1, "")
+		&& compares("{\"a\": 1, \"a\": 2, \"x\": 0}", "{\"x\": 0, \"a\": 1, \"a\": 2}", NULL, 1, "")
+		&& compares("{\"a\": 1, \"a\": 2}", "{\"a\": 2, \"a\": 1}", NULL, 0, "/a")
+		&& !same_hash("{\"a\": 1, \"a\": 1}", "{\"a\": 1, \"b\": 1}", false)
+		&& same_hash("{\"x\": 0, \"a\": 1, \"a\": 2}", "{\"a\": 1, \"a\": 2, \"x\": 0}", false);
+	printf("test compare repeated keys is %s\n", result ? "pass" : "fail");
+	// wide objects, indexed by the parser or not
+	p += sprintf(p, "{");
+	q += sprintf(q, "{");
+	for (i=0; i<100; ++i) {
+		p += sprintf(p, "%s\"key%d\": %d", i ? ", " : "", i, i);
+		q += sprintf(q, "%s\"key%d\": %d", i ? ", " : "", 99 - i, 99 - i == 42 ? -1 : 99 - i);
+	}
+	sprintf(p, "}");
+	sprintf(q, "}");
+	result = compares(text, text, NULL, 1, "") && compares(text, swapped, NULL, 0, "/key42");
+	v = json_parse(text);
+	w = json_parse(swapped);
+	// as if put together by hand, with no room for an index
+	built = *w;
+	built._reserved.object_mem = NULL;
+	result = result && json_value_compare(NULL, v, &built, NULL, path, sizeof(path)) == 0 && !strcmp(path, "/key42")
+		&& json_value_compare(NULL, &built, v, NULL, path, 4) == 0 && !strcmp(path, "/ke");
+	w->u.object.values[57].value->u.integer = 42;
+	result = result && json_value_compare(NULL, v, &built, NULL, path, sizeof(path)) == 1;
+	json_value_free(w);
+	// with "key5" twice and no "key6"
+	strcpy(repeated, text);
+	strstr(repeated, "\"key6\"")[4] = '5';
+	w = json_parse(repeated);
+	built = *v;
+	built._reserved.object_mem = NULL;
+	result = result && compares(repeated, text, NULL, 0, "/key5") && compares(text, repeated, NULL, 0, "/key6")
+		&& json_value_compare(NULL, w, &built, NULL, path, sizeof(path)) == 0 && !strcmp(path, "/key5");
+	json_value_free(v);
+	json_value_free(w);
+	printf("test compare objects is %s\n", result ? "pass" : "fail");
+	// deep nesting
+	buf = (char*)malloc(depth * 2 + 2);
+	memset(buf, '[', depth);
+	buf[depth] = '1';
+	memset(buf + depth + 1, ']', depth);
+	buf[depth * 2 + 1] = 0;
+	v = json_parse(buf);
+	buf[depth] = '2';
+	w = json_parse(buf);
+	p = (char*)malloc(depth * 2 + 1);
+	result = v && w && json_value_compare(NULL, v, w, NULL, p, depth * 2 + 1) == 0
+		&& strlen(p) == depth * 2 && !strncmp(p, "/0/0", 4);
+	json_value_free(v);
+	json_value_free(w);
+	free(buf);
+	free(p);
+	printf("test compare deep is %s\n", result ? "pass" : "fail");
+}
+
+static int compare_uint64(void const * a, void const * b) {
+	uint64_t x = *(uint64_t const *)a, y = *(uint64_t const *)b;
+	return x < y ? -1 : x > y;
+}
+
+void test_hash(void) {
+	static char const * same[][2] = {
+		{ "{\"b\": [1, {\"x\": 2.5}], \"a\": \"s\"}", "{\"a\": \"s\", \"b\": [1, {\"x\": 2.5}]}" },
+		{ "[]", "[ ]" }, { "{}", "{ }" }, { "\"\\u0041\"", "\"A\"" }, { "null", "null" },
+	};
+	static char const * different[][2] = {
+		{ "[1, 2]", "[2, 1]" }, { "{\"a\": 1, \"b\": 2}", "{\"a\": 2, \"b\": 1}" }, { "{\"a\": [1]}", "{\"a\": 1}" },
+		{ "[[]]", "[]" }, { "[]", "{}" }, { "\"\"", "[]" }, { "1", "1.0" }, { "0.0", "-0.0" }, { "true", "false" },
+		{ "[\"ab\", \"c\"]", "[\"a\", \"bc\"]" }, { "{\"ab\": \"c\"}", "{\"a\": \"bc\"}" }, { "[1, [2]]", "[[1], 2]" },
+		{ "\"a\\u0000\"", "\"a\"" }, { "{\"a\": {}}", "{\"a\": []}" }, { "[null]", "[null, null]" },
+	};
+	static char const * same_types[][2] = {
+		{ "[1, {\"a\": \"x\", \"b\": true}]", "[2, {\"b\": false, \"a\": \"y\"}]" }, { "3", "4" },
+	};
+	static char const * different_types[][2] = {
+		{ "[1]", "[\"1\"]" }, { "{\"a\": 1}", "{\"b\": 1}" }, { "[1]", "[1, 2]" }, { "1", "1.5" },
+	};
+	enum { count = 10000, depth = 100000 };
+	uint64_t * hashes = (uint64_t*)malloc(count * sizeof(uint64_t)), h[2], g[2];
+	char path[256], text[64], * buf;
+	json_value * v, * w;
+	bool result = true;
+	int i;
+	for (i = 0; i < valid_file_size; ++i) {
+		sprintf(path, "tests" SEP "%s", valid_files[i]);
+		buf = read_file(path);
+		v = json_parse(buf);
+		w = json_value_dup_block(NULL, v);
+		result = result && json_value_hash(NULL, v, h) && json_value_hash(NULL, w, g) && h[0] == g[0] && h[1] == g[1]
+			&& json_type_hash(NULL, v, h) && json_type_hash(NULL, w, g) && h[0] == g[0] && h[1] == g[1];
+		json_value_free(v);
+		free(w);
+		free(buf);
+	}
+	for (i = 0; i < (int)(sizeof(same)/sizeof(same[0])); ++i)
+		result = result && same_hash(same[i][0], same[i][1], false) && same_hash(same[i][0], same[i][1], true);
+	for (i = 0; i < (int)(sizeof(different)/sizeof(different[0])); ++i)
+		result = result && !same_hash(different[i][0], different[i][1], false);
+	result = result && json_value_hash(NULL, NULL, h);
+	printf("test hash is %s\n", result ? "pass" : "fail");
+	result = true;
+	for (i = 0; i < (int)(sizeof(same_types)/sizeof(same_types[0])); ++i)
+		result = result && same_hash(same_types[i][0], same_types[i][1], true)
+			&& !same_hash(same_types[i][0], same_types[i][1], false);
+	for (i = 0; i < (int)(sizeof(different_types)/sizeof(different_types[0])); ++i)
+		result = result && !same_hash(different_types[i][0], different_types[i][1], true);
+	printf("test type hash is %s\n", result ? "pass" : "fail");
+	// no two of many small values share even 64 bits
+	for (i = 0; i < count; ++i) {
+		switch (i % 4) {
+		case 0: sprintf(text, "%d", i); break;
+		case 1: sprintf(text, "[%d, %d]", i / 100, i % 100); break;
+		case 2: sprintf(text, "{\"k%d\": %d}", i / 100, i % 100); break;
+		default: sprintf(text, "\"%d\"", i); break;
+		}
+		v = json_parse(text);
+		result = json_value_hash(NULL, v, h) && result;
+		hashes[i] = h[0];
+		json_value_free(v);
+	}
+	qsort(hashes, count, sizeof(uint64_t), compare_uint64);
+	for (i = 1; i < count; ++i)
+		result = result && hashes[i] != hashes[i - 1];
+	free(hashes);
+	// deep nesting
+	buf = (char*)malloc(depth * 2 + 1);
+	memset(buf, '[', depth);
+	memset(buf + depth, ']', depth);
+	buf[depth * 2] = 0;
+	v = json_parse(buf);
+	result = result && v && json_value_hash(NULL, v, h) && json_type_hash(NULL, v, g);
+	json_value_free(v);
+	free(buf);
+	printf("test hash spread is %s\n", result ? "pass" : "fail");
+}
+
+// a schema takes what json_type_equal does, checking trees or text
+static bool schema_agrees(char const * example, char const * text) {
+	json_value * e = json_parse(example), * v = json_parse(text);
+	json_schema * schema = json_schema_compile(NULL, e, 0, NULL);
+	bool expect = json_type_equal(e, v);
+	bool result = schema && json_schema_check(schema, v, NULL) == expect
+		&& json_schema_check_events(schema, NULL, NULL, NULL, text, strlen(text), NULL) == expect;
+	json_schema_free(schema);
+	json_value_free(e);
+	json_value_free(v);
+	return result;
+}
+
+// checking fails with `expect` at the end of the error, from both
+static bool schema_fails(char const * example, int options, char const * text, char const * expect) {
+	json_value * e = json_parse(example), * v = json_parse(text);
+	json_schema * schema = json_schema_compile(NULL, e, options, NULL);
+	char tree_error[128], error[128];
+	bool result = schema && !json_schema_check(schema, v, tree_error)
+		&& !json_schema_check_events(schema, NULL, NULL, NULL, text, strlen(text), error)
+		&& !strcmp(tree_error, expect) && strlen(error) > strlen(expect)
+		&& !strcmp(error + strlen(error) - strlen(expect), expect);
+	json_schema_free(schema);
+	json_value_free(e);
+	json_value_free(v);
+	return result;
+}
+
+void test_schema(void) {
+	static char const * examples[] = {
+		"{\"a\": [1, {\"b\": \"x\"}], \"c\": true}", "[1, \"a\", null]", "{}", "[]", "1", "{\"a\": {}}",
+	};
+	static char const * texts[] = {
+		"{\"c\": false, \"a\": [7, {\"b\": \"\"}]}", "{\"a\": [1, {\"b\": 2}], \"c\": true}", "{\"a\": [1, {\"b\": \"x\"}]}",
+		"{\"a\": [1, {\"b\": \"x\"}], \"c\": true, \"d\": 1}", "{\"a\": [1, {\"b\": \"x\"}], \"a\": true}",
+		"{\"a\": [1, {\"b\": \"x\"}, 3], \"c\": true}", "[2, \"b\", null]", "[2, \"b\"]", "[2, 3, null]", "{}", "[]",
+		"3", "1.5", "\"1\"", "{\"a\": {}}", "{\"a\": []}", "{\"a\": {\"b\": 1}}", "[[]]", "null",
+	};
+	static char const * schema_text = "{\"a\": [1, {\"b\": \"x\"}], \"c\": true}";
+	char text[4096], swapped[4096], error[128], * p = text, * q = swapped, * deep;
+	event_log checked = {NULL, 0, 0, 0}, plain = {NULL, 0, 0, 0};
+	json_value * e, * v;
+	json_schema * schema;
+	bool result = true;
+	int i, j;
+	for (i = 0; i < (int)(sizeof(examples)/sizeof(examples[0])); ++i)
+		for (j = 0; j < (int)(sizeof(texts)/sizeof(texts[0])); ++j)
+			result = schema_agrees(examples[i], texts[j]) && result;
+	// (all but the one with a key twice, which can't be an example)
+	for (i = 0; i < (int)(sizeof(texts)/sizeof(texts[0])); ++i)
+		result = (i == 4 || schema_agrees(texts[i], texts[i])) && result;
+	printf("test schema is %s\n", result ? "pass" : "fail");
+	// where and why
+	result = schema_fails(schema_text, 0, "{\"a\": [1, {\"b\": 2}], \"c\": true}", "/a/1/b: Expected a string")
+		&& schema_fails(schema_text, 0, "{\"a\": [1, {\"b\": \"x\", \"~/\": 1}], \"c\": true}", "/a/1: Unexpected key \"~/\"")
+		&& schema_fails(schema_text, 0, "[]", "Expected an object")
+		&& schema_fails(schema_text, 0, "{\"a\": [1], \"c\": true}", "/a: Expected 2 elements")
+		&& schema_fails("[1]", 0, "[1, 2]", "Expected 1 elements")
+		&& schema_fails("{\"a\": {\"~/\": 1}, \"b\": 1}", 0, "{\"a\": {\"~/\": \"x\"}, \"b\": 1}", "/a/~0~1: Expected an integer");
+	e = json_parse(schema_text);
+	schema = json_schema_compile(NULL, e, 0, NULL);
+	v = json_parse("{\"a\": [1, {\"b\": \"x\"}], \"d\": true}");
+	result = result && !json_schema_check(schema, v, error) && !strcmp(error, "Missing key \"c\"");
+	json_value_free(v);
+	strcpy(text, "{\"a\": [1, {\"b\": \"x\"}], \"d\": true}");
+	result = result && !json_schema_check_events(schema, NULL, NULL, NULL, text, strlen(text), error)
+		&& !strcmp(error, "1:25: Unexpected key \"d\"");
+	strcpy(text, "{\"a\": [1, {\"b\": \"x\"}], \"a\": [1, {\"b\": \"x\"}]}");
+	result = result && !json_schema_check_events(schema, NULL, NULL, NULL, text, strlen(text), error)
+		&& !!strstr(error, ": Duplicate key \"a\"");
+	strcpy(text, "{\"a\": [1, {\"b\": \"x\"}]}");
+	result = result && !json_schema_check_events(schema, NULL, NULL, NULL, text, strlen(text), error)
+		&& !!strstr(error, ": Missing key \"c\"");
+	// the first value that doesn't fit stops the parse, before any bad syntax
+	strcpy(text, "{\"a\": [\"1\", }");
+	result = result && !json_schema_check_events(schema, NULL, NULL, NULL, text, strlen(text), error)
+		&& !!strstr(error, ": /a/0: Expected an integer");
+	// checked events go on to a handler as they are
+	strcpy(text, "{\"c\": false, \"a\": [7, {\"b\": \"\"}]}");
+	result = result && json_schema_check_events(schema, NULL, &log_handler, &checked, text, strlen(text), error)
+		&& !*error && json_parse_events(NULL, &log_handler, &plain, text, strlen(text), NULL)
+		&& checked.length == plain.length && !memcmp(checked.buf, plain.buf, plain.length);
+	free(checked.buf);
+	free(plain.buf);
+	json_schema_free(schema);
+	json_value_free(e);
+	printf("test schema errors is %s\n", result ? "pass" : "fail");
+	// arrays all of a kind
+	result = schema_fails("[{\"id\": 1}]", json_schema_uniform_arrays, "[{\"id\": 2}, {\"id\": \"x\"}]", "/1/id: Expected an integer")
+		&& schema_fails("{\"a\": [[1]]}", json_schema_uniform_arrays, "{\"a\": [[], [1, 2], [3, null]]}", "/a/2/1: Expected an integer");
+	e = json_parse("{\"ids\": [1], \"pair\": [1, \"a\"]}");
+	schema = json_schema_compile(NULL, e, json_schema_uniform_arrays, NULL);
+	for (i = 0; i < 3; ++i) {
+		char const * ok = i == 0 ? "{\"pair\": [2, \"b\"], \"ids\": []}"
+			: i == 1 ? "{\"ids\": [1, 2, 3], \"pair\": [2, \"b\"]}" : "{\"ids\": [5], \"pair\": [2, \"b\"]}";
+		v = json_parse(ok);
+		result = result && json_schema_check(schema, v, error) && !*error
+			&& json_schema_check_events(schema, NULL, NULL, NULL, ok, strlen(ok), error) && !*error;
+		json_value_free(v);
+	}
+	json_schema_free(schema);
+	json_value_free(e);
+	printf("test schema uniform arrays is %s\n", result ? "pass" : "fail");
+	// wide objects, any order; examples that can't compile
+	p += sprintf(p, "{");
+	q += sprintf(q, "{");
+	for (i=0; i<100; ++i) {
+		p += sprintf(p, "%s\"key%d\": %s", i ? ", " : "", i, i % 2 ? "1" : "\"s\"");
+		q += sprintf(q, "%s\"key%d\": %s", i ? ", " : "", 99 - i, (99 - i) % 2 ? "2" : "\"t\"");
+	}
+	sprintf(p, "}");
+	sprintf(q, "}");
+	result = schema_agrees(text, swapped) && schema_agrees(swapped, text);
+	e = json_parse("{\"a\": 1, \"b\": 2, \"a\": 3}");
+	result = result && !json_schema_compile(NULL, e, 0, error) && !strcmp(error, "Duplicate key in the schema: a")
+		&& !json_schema_compile(NULL, NULL, 0, error);
+	json_value_free(e);
+	deep = (char*)malloc(2 * 200 + 2);
+	for (i = 128; i <= 129; ++i) {
+		memset(deep, '[', i);
+		deep[i] = '1';
+		memset(deep + i + 1, ']', i);
+		deep[2 * i + 1] = 0;
+		e = json_parse(deep);
+		schema = json_schema_compile(NULL, e, 0, error);
+		result = result && (i == 128 ? schema && json_schema_check(schema, e, NULL)
+						&& json_schema_check_events(schema, NULL, NULL, NULL, deep, strlen(deep), NULL)
+			: !schema && !strcmp(error, "Schema nested over 128 deep"));
+		json_schema_free(schema);
+		json_value_free(e);
+	}
+	free(deep);
+	printf("test schema compile is %s\n", result ? "pass" : "fail");
+}
+
 int main () {
 	int i;
+	test_parallel_first();
 	for (i=0; i<valid_file_size; ++i) {
 		// require success
 		printf("test json_parse(%s) is %s\n", valid_files[i]
@@ -240,6 +2179,80 @@ int main () {
 		printf("test json_parse(%s) is %s\n", invalid_files[i]
 					, !test_json_parse_file("tests", invalid_files[i]) ? "pass" : "fail");
 	}
+	for (i=0; i<valid_file_size; ++i) {
+		printf("test single pass json_parse(%s) is %s\n", valid_files[i]
+					, test_same_tree_file("tests", valid_files[i], json_single_pass, false) ? "pass" : "fail");
+	}
+	for (i=0; i<invalid_file_size; ++i) {
+		printf("test single pass json_parse(%s) is %s\n", invalid_files[i]
+					, test_same_tree_file("tests", invalid_files[i], json_single_pass, false) ? "pass" : "fail");
+	}
+	for (i=0; i<valid_file_size; ++i) {
+		printf("test document json_parse(%s) is %s\n", valid_files[i]
+					, test_same_tree_file("tests", valid_files[i], 0, true) ? "pass" : "fail");
+	}
+	for (i=0; i<invalid_file_size; ++i) {
+		printf("test document json_parse(%s) is %s\n", invalid_files[i]
+					, test_same_tree_file("tests", invalid_files[i], 0, true) ? "pass" : "fail");
+	}
+	for (i=0; i<valid_file_size; ++i) {
+		printf("test two stage json_parse(%s) is %s\n", valid_files[i]
+					, test_same_tree_file("tests", valid_files[i], json_two_stage, false) ? "pass" : "fail");
+	}
+	for (i=0; i<invalid_file_size; ++i) {
+		printf("test two stage json_parse(%s) is %s\n", invalid_files[i]
+					, test_same_tree_file("tests", invalid_files[i], json_two_stage, false) ? "pass" : "fail");
+	}
+	for (i=0; i<valid_file_size; ++i) {
+		printf("test events json_parse(%s) is %s\n", valid_files[i]
+					, test_events_file("tests", valid_files[i]) ? "pass" : "fail");
+	}
+	for (i=0; i<invalid_file_size; ++i) {
+		printf("test events json_parse(%s) is %s\n", invalid_files[i]
+					, test_events_file("tests", invalid_files[i]) ? "pass" : "fail");
+	}
+	for (i=0; i<valid_file_size; ++i) {
+		printf("test lazy json_parse(%s) is %s\n", valid_files[i]
+					, test_lazy_file("tests", valid_files[i]) ? "pass" : "fail");
+	}
+	for (i=0; i<invalid_file_size; ++i) {
+		printf("test lazy json_parse(%s) is %s\n", invalid_files[i]
+					, test_lazy_file("tests", invalid_files[i]) ? "pass" : "fail");
+	}
+	for (i=0; i<valid_file_size; ++i) {
+		printf("test serialize json_parse(%s) is %s\n", valid_files[i]
+					, test_serialize_file("tests", valid_files[i]) ? "pass" : "fail");
+	}
+	for (i=0; i<valid_file_size; ++i) {
+		printf("test push json_parse(%s) is %s\n", valid_files[i]
+					, test_push_file("tests", valid_files[i]) ? "pass" : "fail");
+	}
+	for (i=0; i<invalid_file_size; ++i) {
+		printf("test push json_parse(%s) is %s\n", invalid_files[i]
+					, test_push_file("tests", invalid_files[i]) ? "pass" : "fail");
+	}
+	test_json_parse_length();
+	test_numbers();
+	test_object_index();
+	test_intern();
+	test_document();
+	test_document_insitu();
+	test_allocator_hooks();
+	test_reader();
+	test_parser();
+	test_events();
+	test_two_stage();
+	test_lazy();
+	test_serialize();
+	test_writer();
+	test_parallel();
+	test_ndjson();
+	test_parse_file();
+	test_tape();
+	test_dup_block();
+	test_compare();
+	test_hash();
+	test_schema();
 	test_json_value_equal();
 	test_json_type_equal ();
 	return 0;